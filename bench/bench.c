@@ -0,0 +1,378 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sh2ck.h"
+#include "synth.h"
+
+#define BENCH_MAX_ITERATIONS 1000
+#define BENCH_ATLAS_WIDTH 1024
+#define BENCH_TGX_WIDTH 1600
+#define BENCH_TGX_HEIGHT 1200
+
+enum Stage {
+	STAGE_LOAD,
+	STAGE_DECODE,
+	STAGE_BBOX,
+	STAGE_PACK,
+	STAGE_COMPOSE,
+	STAGE_ENCODE,
+	STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = {"load", "decode",  "bbox",
+                                               "pack", "compose", "encode"};
+
+struct Case {
+	const char *name;
+	/*0 for a tgx file*/
+	int data_type;
+	int image_count;
+	char file[256];
+	int sample_count[STAGE_COUNT];
+	double samples[STAGE_COUNT][BENCH_MAX_ITERATIONS];
+	double bytes[STAGE_COUNT];
+};
+
+static struct Case cases[] = {
+    {"gm1_tgx", GM1_DATA_TGX, 200},
+    {"gm1_animation", GM1_DATA_ANIMATION, 600},
+    {"gm1_tgx_and_tile", GM1_DATA_TGX_AND_TILE, 800},
+    {"gm1_tgx_font", GM1_DATA_TGX_FONT, 200},
+    {"gm1_bitmap", GM1_DATA_BITMAP, 24},
+    {"gm1_tgx_const_size", GM1_DATA_TGX_CONST_SIZE, 300},
+    {"gm1_bitmap_other", GM1_DATA_BITMAP_OTHER, 24},
+    {"tgx", 0, 1},
+};
+
+#define CASE_COUNT ((int)(sizeof(cases) / sizeof(cases[0])))
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void addSample(struct Case *c, int stage, double start, double end,
+                      double bytes)
+{
+	c->samples[stage][c->sample_count[stage]++] = end - start;
+	c->bytes[stage] = bytes;
+}
+
+static long fileSize(const char *file)
+{
+	struct stat file_stat;
+	if (stat(file, &file_stat) == -1) {
+		return 0;
+	}
+	return file_stat.st_size;
+}
+
+static double pixelBytes(struct Sh2ckImageList *image_list)
+{
+	double bytes = 0;
+	for (int i = 0; i < image_list->image_count; i++) {
+		bytes += (double)image_list->images[i].width *
+		         image_list->images[i].height * sizeof(struct Sh2ckColor);
+	}
+	return bytes;
+}
+
+static int runGm1(struct Case *c, const char *output)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList image_list;
+	struct Sh2ckImage atlas;
+	struct Sh2ckRect atlas_size;
+	struct Sh2ckRect bbox;
+	struct Sh2ckOffset *offsets = NULL;
+	int assemble = c->data_type == GM1_DATA_TGX_AND_TILE;
+
+	double t0 = now();
+	if (sh2ckGm1CreateFromFile(&gm1, c->file) == -1) {
+		return -1;
+	}
+	double t1 = now();
+	if (sh2ckGm1CreateImageList(&image_list, 100 * 1024 * 1024, &gm1, 0,
+	                            assemble) == -1) {
+		sh2ckGm1Delete(&gm1);
+		return -1;
+	}
+	double t2 = now();
+	double decoded = pixelBytes(&image_list);
+	if (image_list.type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		offsets = malloc(sizeof(*offsets) * image_list.image_count);
+		if (offsets == NULL) {
+			sh2ckImageDeleteList(&image_list);
+			sh2ckGm1Delete(&gm1);
+			return -1;
+		}
+		sh2ckShrinkAnimationImages(&image_list, offsets);
+	} else {
+		for (int i = 0; i < image_list.image_count; i++) {
+			sh2ckImageBoundingBox(&bbox, &image_list.images[i]);
+		}
+	}
+	double t3 = now();
+	int ret = sh2ckImageLayoutAtlas(
+	    &image_list, &atlas_size, BENCH_ATLAS_WIDTH,
+	    image_list.type != SH2CK_IMAGE_TYPE_ANIMATION, assemble);
+	double t4 = now();
+	if (ret == 0) {
+		ret = sh2ckImageComposeAtlas(&atlas, &image_list, offsets, &atlas_size);
+	}
+	double t5 = now();
+	if (ret == 0) {
+		ret = sh2ckImageSave(&atlas, output);
+		sh2ckImageDelete(&atlas, NULL);
+	}
+	double t6 = now();
+
+	if (ret == 0) {
+		double atlas_bytes = (double)atlas_size.width * atlas_size.height *
+		                     sizeof(struct Sh2ckColor);
+		addSample(c, STAGE_LOAD, t0, t1, fileSize(c->file));
+		addSample(c, STAGE_DECODE, t1, t2, decoded);
+		addSample(c, STAGE_BBOX, t2, t3, decoded);
+		addSample(c, STAGE_PACK, t3, t4, decoded);
+		addSample(c, STAGE_COMPOSE, t4, t5, atlas_bytes);
+		addSample(c, STAGE_ENCODE, t5, t6, atlas_bytes);
+	}
+	free(offsets);
+	sh2ckImageDeleteList(&image_list);
+	sh2ckGm1Delete(&gm1);
+	return ret;
+}
+
+static int runTgx(struct Case *c, const char *output)
+{
+	struct Tgx tgx;
+	struct Sh2ckImage image;
+	struct Sh2ckRect bbox;
+
+	double t0 = now();
+	if (sh2ckTgxCreateFromFile(&tgx, c->file) == -1) {
+		return -1;
+	}
+	double t1 = now();
+	if (sh2ckTgxCreateImage(&image, tgx.width, tgx.height, tgx.data, tgx.size,
+	                        NULL) == -1) {
+		sh2ckTgxDelete(&tgx);
+		return -1;
+	}
+	double t2 = now();
+	sh2ckImageBoundingBox(&bbox, &image);
+	double t3 = now();
+	int ret = sh2ckImageSave(&image, output);
+	double t4 = now();
+
+	if (ret == 0) {
+		double bytes =
+		    (double)image.width * image.height * sizeof(struct Sh2ckColor);
+		addSample(c, STAGE_LOAD, t0, t1, fileSize(c->file));
+		addSample(c, STAGE_DECODE, t1, t2, bytes);
+		addSample(c, STAGE_BBOX, t2, t3, bytes);
+		addSample(c, STAGE_ENCODE, t3, t4, bytes);
+	}
+	sh2ckImageDelete(&image, NULL);
+	sh2ckTgxDelete(&tgx);
+	return ret;
+}
+
+static int doubleCmp(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+struct Summary {
+	double min;
+	double median;
+	double p95;
+	double mb_per_s;
+};
+
+static void summarize(struct Summary *summary, struct Case *c, int stage)
+{
+	int count = c->sample_count[stage];
+	double *samples = c->samples[stage];
+	qsort(samples, count, sizeof(*samples), doubleCmp);
+	summary->min = samples[0];
+	summary->median = samples[count / 2];
+	summary->p95 = samples[(count * 95 + 99) / 100 - 1];
+	summary->mb_per_s = 0;
+	if (summary->median > 0) {
+		summary->mb_per_s = c->bytes[stage] / (1024 * 1024) / summary->median;
+	}
+}
+
+static void printReport(FILE *fp)
+{
+	struct Summary summary;
+	fprintf(fp, "%-20s %-8s %10s %10s %10s %10s\n", "case", "stage",
+	        "min ms", "median ms", "p95 ms", "MB/s");
+	for (int i = 0; i < CASE_COUNT; i++) {
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			if (cases[i].sample_count[stage] == 0) {
+				continue;
+			}
+			summarize(&summary, &cases[i], stage);
+			fprintf(fp, "%-20s %-8s %10.3f %10.3f %10.3f %10.1f\n",
+			        cases[i].name, stage_names[stage], summary.min * 1e3,
+			        summary.median * 1e3, summary.p95 * 1e3,
+			        summary.mb_per_s);
+		}
+	}
+}
+
+static int writeJson(const char *file, int iterations)
+{
+	struct Summary summary;
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL) {
+		return -1;
+	}
+	fprintf(fp, "{\n  \"iterations\": %d,\n  \"cases\": [", iterations);
+	for (int i = 0; i < CASE_COUNT; i++) {
+		fprintf(fp, "%s\n    {\"name\": \"%s\", \"stages\": {",
+		        i == 0 ? "" : ",", cases[i].name);
+		int first = 1;
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			if (cases[i].sample_count[stage] == 0) {
+				continue;
+			}
+			summarize(&summary, &cases[i], stage);
+			fprintf(fp,
+			        "%s\n      \"%s\": {\"min_ms\": %.4f, \"median_ms\": "
+			        "%.4f, \"p95_ms\": %.4f, \"bytes\": %.0f, "
+			        "\"mb_per_s\": %.2f}",
+			        first ? "" : ",", stage_names[stage], summary.min * 1e3,
+			        summary.median * 1e3, summary.p95 * 1e3,
+			        cases[i].bytes[stage], summary.mb_per_s);
+			first = 0;
+		}
+		fprintf(fp, "\n    }}");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	return fclose(fp);
+}
+
+static void printHelp(FILE *fp)
+{
+	fprintf(fp,
+	        "Usage: sh2ck_bench [options]\n\n"
+	        "Benchmark the conversion stages on a synthetic corpus\n"
+	        "options:\n"
+	        "\t-h, --help\t\tThis help\n"
+	        "\t-n iterations\t\tRuns per case (default 10)\n"
+	        "\t--json file\t\tWrite the results as json\n"
+	        "\t--dir dir\t\tKeep the corpus and outputs in dir\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = 10;
+	const char *json_file = NULL;
+	const char *dir = NULL;
+	char tmp_dir[] = "/tmp/sh2ck_bench_XXXXXX";
+	char output[256];
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
+			printHelp(stdout);
+			return 0;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_file = argv[++i];
+		} else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else {
+			printHelp(stderr);
+			return 1;
+		}
+	}
+	if (iterations < 1 || iterations > BENCH_MAX_ITERATIONS) {
+		fprintf(stderr, "Error: iterations have to be between 1 and %d\n",
+		        BENCH_MAX_ITERATIONS);
+		return 1;
+	}
+
+	if (dir == NULL) {
+		dir = mkdtemp(tmp_dir);
+		if (dir == NULL) {
+			fprintf(stderr, "Error on creating directory\n");
+			return 1;
+		}
+	} else {
+		mkdir(dir, 0775);
+	}
+
+	for (int i = 0; i < CASE_COUNT; i++) {
+		struct Case *c = &cases[i];
+		int ret = 0;
+		if (c->data_type == 0) {
+			snprintf(c->file, sizeof(c->file), "%s/%s.tgx", dir, c->name);
+			ret = synthWriteTgx(c->file, BENCH_TGX_WIDTH, BENCH_TGX_HEIGHT,
+			                    i + 1);
+		} else {
+			snprintf(c->file, sizeof(c->file), "%s/%s.gm1", dir, c->name);
+			ret = synthWriteGm1(c->file, c->data_type, c->image_count, i + 1);
+		}
+		if (ret == -1) {
+			fprintf(stderr, "Error on writing %s\n", c->file);
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < CASE_COUNT; i++) {
+		struct Case *c = &cases[i];
+		snprintf(output, sizeof(output), "%s/%s.png", dir, c->name);
+		for (int j = 0; j < iterations; j++) {
+			int ret = c->data_type == 0 ? runTgx(c, output) : runGm1(c, output);
+			if (ret == -1) {
+				fprintf(stderr, "Error on converting %s\n", c->file);
+				return 1;
+			}
+		}
+	}
+
+	printReport(stdout);
+	if (json_file != NULL && writeJson(json_file, iterations) != 0) {
+		fprintf(stderr, "Error on writing %s\n", json_file);
+		return 1;
+	}
+
+	if (dir == tmp_dir) {
+		for (int i = 0; i < CASE_COUNT; i++) {
+			remove(cases[i].file);
+			snprintf(output, sizeof(output), "%s/%s.png", dir, cases[i].name);
+			remove(output);
+		}
+		rmdir(dir);
+	}
+	return 0;
+}
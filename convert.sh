@@ -28,18 +28,27 @@ then
 	mkdir $asset_dir 
 fi
 
+list=`mktemp`
 for i in $gm_dir/*.gm1 
 do
 	file=`basename "${i}" .gm1`
-	echo "Convert: ${file}"
 	if [ "${pack}" = "pack" ]; then
 		if [ "${file}" = "tile_land_macros" ]; then
+			echo "Convert: ${file}"
 			bin/sh2ck --pack "$i" "$asset_dir/" "${file}"
 		else
-			bin/sh2ck --assemble --sort --pack "$i" "$asset_dir/" "${file}"
+			printf '%s\t%s\t%s\n' "$i" "$asset_dir/" "${file}" >> "$list"
 		fi
 	else
-		bin/sh2ck --assemble  "$i" "$asset_dir/$file" "${file}"
+		printf '%s\t%s\t%s\n' "$i" "$asset_dir/$file" "${file}" >> "$list"
 	fi
 done
 
+if [ "${pack}" = "pack" ]; then
+	bin/sh2ck --assemble --sort --pack $SH2CK_FLAGS --batch "$list"
+else
+	bin/sh2ck --assemble $SH2CK_FLAGS --batch "$list"
+fi
+ret=$?
+rm -f "$list"
+exit $ret
@@ -0,0 +1,711 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "image.h"
+#include "io.h"
+#include "memory.h"
+
+#define ATLAS_NO_PAGE 0xffff
+#define ATLAS_HASH_SEED 0xcbf29ce484222325ULL
+#define ATLAS_HASH_PRIME 0x100000001b3ULL
+
+struct AtlasItem {
+	int entry;
+	int width;
+	int height;
+};
+
+static int itemCmp(const void *a, const void *b)
+{
+	const struct AtlasItem *item_a = a;
+	const struct AtlasItem *item_b = b;
+	if (item_a->height != item_b->height) {
+		return item_b->height - item_a->height;
+	}
+	return item_a->entry - item_b->entry;
+}
+
+/*the bounding box of a fully transparent frame is negative*/
+static int clampSize(int size)
+{
+	return size > 0 ? size : 0;
+}
+
+static struct Sh2ckImage *entryImage(struct SharedAtlas *atlas,
+                                     struct AtlasEntry *entry)
+{
+	return &atlas->lists[entry->list].images[entry->image];
+}
+
+static struct Sh2ckOffset entryOffset(struct SharedAtlas *atlas,
+                                      struct AtlasEntry *entry)
+{
+	struct Sh2ckOffset offset = {0, 0};
+	if (atlas->image_offsets != NULL &&
+	    atlas->image_offsets[entry->list] != NULL) {
+		offset = atlas->image_offsets[entry->list][entry->image];
+	}
+	return offset;
+}
+
+/*fnv-1a over whole pixels*/
+static uint64_t hashEntry(struct SharedAtlas *atlas, struct AtlasEntry *entry)
+{
+	struct Sh2ckImage *image = entryImage(atlas, entry);
+	struct Sh2ckOffset offset = entryOffset(atlas, entry);
+	int width = clampSize(image->width);
+	int height = clampSize(image->height);
+	uint64_t hash = ATLAS_HASH_SEED;
+	hash = (hash ^ (uint32_t)width) * ATLAS_HASH_PRIME;
+	hash = (hash ^ (uint32_t)height) * ATLAS_HASH_PRIME;
+	for (int y = 0; y < height; y++) {
+		struct Sh2ckColor *row =
+		    image->pixel + (y + offset.y) * image->pitch + offset.x;
+		for (int x = 0; x < width; x++) {
+			uint32_t pixel;
+			memcpy(&pixel, &row[x], sizeof(pixel));
+			hash = (hash ^ pixel) * ATLAS_HASH_PRIME;
+		}
+	}
+	return hash;
+}
+
+static int atlasInit(struct SharedAtlas *atlas, struct Sh2ckImageList *lists,
+                     struct Sh2ckOffset **image_offsets, int list_count,
+                     int page_width, int page_height)
+{
+	memset(atlas, 0, sizeof(*atlas));
+	atlas->page_width = page_width;
+	atlas->page_height = page_height;
+	atlas->lists = lists;
+	atlas->list_count = list_count;
+	atlas->image_offsets = image_offsets;
+	atlas->first_entry = sh2ckMemoryAlloc(sizeof(int) * (list_count + 1));
+	if (atlas->first_entry == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < list_count; i++) {
+		atlas->first_entry[i] = atlas->entry_count;
+		atlas->entry_count += lists[i].image_count;
+	}
+	atlas->first_entry[list_count] = atlas->entry_count;
+	atlas->entries =
+	    sh2ckMemoryAlloc(sizeof(*atlas->entries) * (atlas->entry_count + 1));
+	if (atlas->entries == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < list_count; i++) {
+		for (int j = 0; j < lists[i].image_count; j++) {
+			struct AtlasEntry *entry = sh2ckAtlasEntry(atlas, i, j);
+			entry->list = i;
+			entry->image = j;
+			entry->page = ATLAS_NO_PAGE;
+			entry->hash = hashEntry(atlas, entry);
+		}
+	}
+	return 0;
+}
+
+static int addPage(struct SharedAtlas *atlas)
+{
+	struct Sh2ckRect *pages = sh2ckMemoryRealloc(
+	    atlas->pages, sizeof(*pages) * (atlas->page_count + 1));
+	if (pages == NULL) {
+		return -1;
+	}
+	atlas->pages = pages;
+	uint8_t *dirty = sh2ckMemoryRealloc(atlas->dirty, atlas->page_count + 1);
+	if (dirty == NULL) {
+		return -1;
+	}
+	atlas->dirty = dirty;
+	memset(&pages[atlas->page_count], 0, sizeof(*pages));
+	dirty[atlas->page_count] = 1;
+	return atlas->page_count++;
+}
+
+/*sorted by decreasing height, only the images without a page*/
+static struct AtlasItem *createItems(struct SharedAtlas *atlas, int *count)
+{
+	struct AtlasItem *items =
+	    sh2ckMemoryAlloc(sizeof(*items) * (atlas->entry_count + 1));
+	if (items == NULL) {
+		return NULL;
+	}
+	*count = 0;
+	for (int i = 0; i < atlas->entry_count; i++) {
+		if (atlas->entries[i].page != ATLAS_NO_PAGE) {
+			continue;
+		}
+		struct Sh2ckImage *image = entryImage(atlas, &atlas->entries[i]);
+		struct AtlasItem *item = &items[(*count)++];
+		item->entry = i;
+		item->width = clampSize(image->width);
+		item->height = clampSize(image->height);
+		if (item->width + 1 > atlas->page_width ||
+		    item->height > atlas->page_height) {
+			sh2ckMemoryFree(items);
+			return NULL;
+		}
+	}
+	qsort(items, *count, sizeof(*items), itemCmp);
+	return items;
+}
+
+/*next fit by decreasing height, one pixel between the images as in
+ * sh2ckImageLayoutAtlas*/
+static int packShelves(struct SharedAtlas *atlas, struct AtlasItem *items,
+                       int count)
+{
+	int page = -1;
+	int shelf_y = 0;
+	int shelf_height = 0;
+	int x = 0;
+	for (int i = 0; i < count; i++) {
+		struct AtlasItem *item = &items[i];
+		if (page == -1 || x + item->width + 1 > atlas->page_width) {
+			shelf_y = page == -1 ? 0 : shelf_y + shelf_height + 1;
+			shelf_height = item->height;
+			x = 0;
+			if (page == -1 || shelf_y + item->height > atlas->page_height) {
+				if ((page = addPage(atlas)) == -1) {
+					return -1;
+				}
+				shelf_y = 0;
+			}
+		}
+		struct AtlasEntry *entry = &atlas->entries[item->entry];
+		struct Sh2ckImage *image = entryImage(atlas, entry);
+		entry->page = page;
+		image->x = x;
+		image->y = shelf_y;
+		x += item->width + 1;
+	}
+	return 0;
+}
+
+/*raises the skyline of a page below a placed image and its gap*/
+static void skylineRaise(int *skyline, int x, int width, int bottom)
+{
+	for (int i = x; i < x + width; i++) {
+		if (skyline[i] < bottom) {
+			skyline[i] = bottom;
+		}
+	}
+}
+
+/*the lowest position for width columns, with a sliding window maximum
+ * over the skyline, -1 if it does not fit*/
+static int skylineFind(const int *skyline, int page_width, int page_height,
+                       int width, int height, int *queue, int *position)
+{
+	int head = 0;
+	int tail = 0;
+	int best = -1;
+	for (int i = 0; i < page_width; i++) {
+		while (tail > head && skyline[queue[tail - 1]] <= skyline[i]) {
+			tail--;
+		}
+		queue[tail++] = i;
+		int start = i - width + 1;
+		if (start < 0) {
+			continue;
+		}
+		if (queue[head] < start) {
+			head++;
+		}
+		int y = skyline[queue[head]];
+		if (y + height <= page_height && (best == -1 || y < best)) {
+			best = y;
+			*position = start;
+		}
+	}
+	return best;
+}
+
+/*bottom left placement into the space above the images that are already
+ * on a page, holes below the skyline stay unused*/
+static int packSkyline(struct SharedAtlas *atlas, struct AtlasItem *items,
+                       int count)
+{
+	int width = atlas->page_width;
+	int *queue = sh2ckMemoryAlloc(sizeof(int) * width);
+	int *skylines =
+	    sh2ckMemoryAlloc(sizeof(int) * width * (atlas->page_count + 1));
+	if (queue == NULL || skylines == NULL) {
+		sh2ckMemoryFree(queue);
+		sh2ckMemoryFree(skylines);
+		return -1;
+	}
+	memset(skylines, 0, sizeof(int) * width * atlas->page_count);
+	for (int i = 0; i < atlas->entry_count; i++) {
+		struct AtlasEntry *entry = &atlas->entries[i];
+		if (entry->page == ATLAS_NO_PAGE) {
+			continue;
+		}
+		struct Sh2ckImage *image = entryImage(atlas, entry);
+		skylineRaise(&skylines[entry->page * width], image->x,
+		             clampSize(image->width) + 1,
+		             image->y + clampSize(image->height) + 1);
+	}
+
+	for (int i = 0; i < count; i++) {
+		struct AtlasItem *item = &items[i];
+		int page = -1;
+		int x = 0;
+		int y = -1;
+		for (int j = 0; j < atlas->page_count && page == -1; j++) {
+			y = skylineFind(&skylines[j * width], width, atlas->page_height,
+			                item->width + 1, item->height, queue, &x);
+			if (y != -1) {
+				page = j;
+			}
+		}
+		if (page == -1) {
+			int *tmp = sh2ckMemoryRealloc(
+			    skylines, sizeof(int) * width * (atlas->page_count + 1));
+			if (tmp == NULL || (page = addPage(atlas)) == -1) {
+				sh2ckMemoryFree(queue);
+				sh2ckMemoryFree(tmp != NULL ? tmp : skylines);
+				return -1;
+			}
+			skylines = tmp;
+			memset(&skylines[page * width], 0, sizeof(int) * width);
+			x = 0;
+			y = 0;
+		}
+		struct AtlasEntry *entry = &atlas->entries[item->entry];
+		struct Sh2ckImage *image = entryImage(atlas, entry);
+		entry->page = page;
+		image->x = x;
+		image->y = y;
+		atlas->dirty[page] = 1;
+		skylineRaise(&skylines[page * width], x, item->width + 1,
+		             y + item->height + 1);
+	}
+	sh2ckMemoryFree(queue);
+	sh2ckMemoryFree(skylines);
+	return 0;
+}
+
+/*used size of every page, the width is halved while the used part fits as
+ * in sh2ckImageLayoutAtlas*/
+static void measurePages(struct SharedAtlas *atlas)
+{
+	for (int i = 0; i < atlas->page_count; i++) {
+		memset(&atlas->pages[i], 0, sizeof(atlas->pages[i]));
+	}
+	for (int i = 0; i < atlas->entry_count; i++) {
+		struct AtlasEntry *entry = &atlas->entries[i];
+		struct Sh2ckImage *image = entryImage(atlas, entry);
+		struct Sh2ckRect *used = &atlas->pages[entry->page];
+		if (image->x + clampSize(image->width) + 1 > used->width) {
+			used->width = image->x + clampSize(image->width) + 1;
+		}
+		if (image->y + clampSize(image->height) > used->height) {
+			used->height = image->y + clampSize(image->height);
+		}
+	}
+	for (int i = 0; i < atlas->page_count; i++) {
+		struct Sh2ckRect *page = &atlas->pages[i];
+		int width = atlas->page_width;
+		while (width > 1 && page->width <= width / 2) {
+			width /= 2;
+		}
+		page->width = width;
+		if (page->height == 0) {
+			page->height = 1;
+		}
+	}
+}
+
+static int layoutItems(struct SharedAtlas *atlas, int assembled, int update)
+{
+	int count = 0;
+	struct AtlasItem *items = createItems(atlas, &count);
+	if (items == NULL) {
+		return -1;
+	}
+	int ret = update ? packSkyline(atlas, items, count)
+	                 : packShelves(atlas, items, count);
+	sh2ckMemoryFree(items);
+	if (ret == -1) {
+		return -1;
+	}
+	measurePages(atlas);
+	for (int i = 0; i < atlas->list_count; i++) {
+		sh2ckImageListPlaceTiles(&atlas->lists[i], assembled);
+	}
+	return 0;
+}
+
+int sh2ckAtlasLayout(struct SharedAtlas *atlas, struct Sh2ckImageList *lists,
+                     struct Sh2ckOffset **image_offsets, int list_count,
+                     int page_width, int page_height, int assembled)
+{
+	if (atlasInit(atlas, lists, image_offsets, list_count, page_width,
+	              page_height) == -1 ||
+	    layoutItems(atlas, assembled, 0) == -1) {
+		sh2ckAtlasDelete(atlas);
+		return -1;
+	}
+	return 0;
+}
+
+static struct AtlasFile *findFile(struct AtlasIndex *index, const char *name)
+{
+	for (int i = 0; i < index->file_count; i++) {
+		if (strcmp(index->files[i].name, name) == 0) {
+			return &index->files[i];
+		}
+	}
+	return NULL;
+}
+
+/*puts every image back into its previous slot if it still fits there,
+ * returns the number of images kept*/
+static int reuseSlots(struct SharedAtlas *atlas, const char *const *names,
+                      struct AtlasIndex *previous)
+{
+	uint8_t *taken = sh2ckMemoryAlloc(previous->image_count + 1);
+	if (taken == NULL) {
+		return -1;
+	}
+	memset(taken, 0, previous->image_count + 1);
+	for (int i = 0; i < previous->page_count; i++) {
+		if (addPage(atlas) == -1) {
+			sh2ckMemoryFree(taken);
+			return -1;
+		}
+		atlas->dirty[i] = 0;
+	}
+
+	int kept = 0;
+	for (int i = 0; i < atlas->list_count; i++) {
+		struct AtlasFile *file = findFile(previous, names[i]);
+		int count = file != NULL ? file->image_count : 0;
+		if (count > atlas->lists[i].image_count) {
+			count = atlas->lists[i].image_count;
+		}
+		for (int j = 0; j < count; j++) {
+			int slot_index = file->first_image + j;
+			struct AtlasSlot *slot = &previous->images[slot_index];
+			struct AtlasEntry *entry = sh2ckAtlasEntry(atlas, i, j);
+			struct Sh2ckImage *image = entryImage(atlas, entry);
+			int width = clampSize(image->width);
+			int height = clampSize(image->height);
+			if (taken[slot_index] || width > clampSize(slot->width) ||
+			    height > clampSize(slot->height) ||
+			    slot->x + width + 1 > atlas->page_width ||
+			    slot->y + height > atlas->page_height) {
+				continue;
+			}
+			taken[slot_index] = 1;
+			entry->page = slot->page;
+			image->x = slot->x;
+			image->y = slot->y;
+			if (entry->hash != slot->hash || image->width != slot->width ||
+			    image->height != slot->height) {
+				atlas->dirty[slot->page] = 1;
+			}
+			kept++;
+		}
+	}
+	/*the pixels of images that moved or are gone have to be cleared*/
+	for (int i = 0; i < previous->image_count; i++) {
+		if (!taken[i]) {
+			atlas->dirty[previous->images[i].page] = 1;
+		}
+	}
+	sh2ckMemoryFree(taken);
+	return kept;
+}
+
+int sh2ckAtlasUpdate(struct SharedAtlas *atlas, struct Sh2ckImageList *lists,
+                     struct Sh2ckOffset **image_offsets,
+                     const char *const *names, int list_count, int page_width,
+                     int page_height, int assembled,
+                     struct AtlasIndex *previous)
+{
+	if (atlasInit(atlas, lists, image_offsets, list_count, page_width,
+	              page_height) == -1) {
+		sh2ckAtlasDelete(atlas);
+		return -1;
+	}
+	int kept = reuseSlots(atlas, names, previous);
+	if (kept == -1) {
+		sh2ckAtlasDelete(atlas);
+		return -1;
+	}
+	/*nothing left of the previous layout, shelves pack better*/
+	if (kept == 0) {
+		atlas->page_count = 0;
+		if (layoutItems(atlas, assembled, 0) == -1) {
+			sh2ckAtlasDelete(atlas);
+			return -1;
+		}
+		return 0;
+	}
+	if (layoutItems(atlas, assembled, 1) == -1) {
+		sh2ckAtlasDelete(atlas);
+		return -1;
+	}
+
+	/*drop the pages at the end that lost all of their images*/
+	int last_page = -1;
+	for (int i = 0; i < atlas->entry_count; i++) {
+		if (atlas->entries[i].page > last_page) {
+			last_page = atlas->entries[i].page;
+		}
+	}
+	atlas->page_count = last_page + 1;
+	for (int i = 0; i < atlas->page_count && i < previous->page_count; i++) {
+		if (atlas->pages[i].width != previous->pages[i].width ||
+		    atlas->pages[i].height != previous->pages[i].height) {
+			atlas->dirty[i] = 1;
+		}
+	}
+	return 0;
+}
+
+struct AtlasEntry *sh2ckAtlasEntry(struct SharedAtlas *atlas, int list,
+                                   int image)
+{
+	return &atlas->entries[atlas->first_entry[list] + image];
+}
+
+int sh2ckAtlasComposePage(struct SharedAtlas *atlas, int page,
+                          struct Sh2ckImage *image)
+{
+	struct Sh2ckRect *size = &atlas->pages[page];
+	if (sh2ckImageCreate(image, NULL, size->width, size->height) == -1) {
+		return -1;
+	}
+	sh2ckImageClear(image, 0x00);
+	for (int i = 0; i < atlas->entry_count; i++) {
+		struct AtlasEntry *entry = &atlas->entries[i];
+		if (entry->page != page) {
+			continue;
+		}
+		struct Sh2ckImage *source = entryImage(atlas, entry);
+		struct Sh2ckOffset offset = entryOffset(atlas, entry);
+		for (int y = 0; y < clampSize(source->height); y++) {
+			memcpy(image->pixel + (source->y + y) * image->width + source->x,
+			       source->pixel + (y + offset.y) * source->pitch + offset.x,
+			       sizeof(*image->pixel) * clampSize(source->width));
+		}
+	}
+	return 0;
+}
+
+/*names are quoted with quotes doubled, as they may contain commas*/
+static void writeName(FILE *fp, const char *name)
+{
+	fputc('"', fp);
+	for (const char *c = name; *c != '\0'; c++) {
+		if (*c == '"') {
+			fputc('"', fp);
+		}
+		fputc(*c, fp);
+	}
+	fputc('"', fp);
+}
+
+int sh2ckAtlasWriteIndex(struct SharedAtlas *atlas, const char *const *names,
+                         const char *file)
+{
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	fprintf(fp, "!shared\n");
+	fprintf(fp, "[pages,%d,2,i,i]\n", atlas->page_count);
+	fprintf(fp, "#width,height\n");
+	for (int i = 0; i < atlas->page_count; i++) {
+		fprintf(fp, "%d,%d\n", atlas->pages[i].width, atlas->pages[i].height);
+	}
+	fprintf(fp, "[files,%d,3,s,i,i]\n", atlas->list_count);
+	fprintf(fp, "#name,first_image,images\n");
+	for (int i = 0; i < atlas->list_count; i++) {
+		writeName(fp, names[i]);
+		fprintf(fp, ",%d,%d\n", atlas->first_entry[i],
+		        atlas->lists[i].image_count);
+	}
+	fprintf(fp, "[images,%d,6,i,i,i,i,i,s]\n", atlas->entry_count);
+	fprintf(fp, "#page,posx,posy,width,height,hash\n");
+	for (int i = 0; i < atlas->entry_count; i++) {
+		struct AtlasEntry *entry = &atlas->entries[i];
+		struct Sh2ckImage *image = entryImage(atlas, entry);
+		fprintf(fp, "%d,%d,%d,%d,%d,%016llx\n", entry->page, image->x,
+		        image->y, image->width, image->height,
+		        (unsigned long long)entry->hash);
+	}
+	if (ferror(fp)) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+/*reads a name written by writeName, -1 if it does not fit into
+ * ATLAS_NAME_SIZE*/
+static int readName(FILE *fp, char *name)
+{
+	int length = 0;
+	if (fscanf(fp, " ") == EOF || fgetc(fp) != '"') {
+		return -1;
+	}
+	for (;;) {
+		int c = fgetc(fp);
+		if (c == '"') {
+			c = fgetc(fp);
+			if (c != '"') {
+				ungetc(c, fp);
+				break;
+			}
+		}
+		if (c == EOF || length == ATLAS_NAME_SIZE - 1) {
+			return -1;
+		}
+		name[length++] = c;
+	}
+	name[length] = '\0';
+	return 0;
+}
+
+static int readIndex(struct AtlasIndex *index, FILE *fp)
+{
+	if (fscanf(fp, "!shared [pages,%d,2,i,i] #width,height",
+	           &index->page_count) != 1 ||
+	    index->page_count < 0 || index->page_count >= ATLAS_NO_PAGE) {
+		return -1;
+	}
+	index->pages =
+	    sh2ckMemoryAlloc(sizeof(*index->pages) * (index->page_count + 1));
+	if (index->pages == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < index->page_count; i++) {
+		int width;
+		int height;
+		if (fscanf(fp, "%d,%d", &width, &height) != 2) {
+			return -1;
+		}
+		index->pages[i].x = 0;
+		index->pages[i].y = 0;
+		index->pages[i].width = width;
+		index->pages[i].height = height;
+	}
+
+	if (fscanf(fp, " [files,%d,3,s,i,i] #name,first_image,images",
+	           &index->file_count) != 1 ||
+	    index->file_count < 0) {
+		return -1;
+	}
+	index->files =
+	    sh2ckMemoryAlloc(sizeof(*index->files) * (index->file_count + 1));
+	if (index->files == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < index->file_count; i++) {
+		struct AtlasFile *file = &index->files[i];
+		if (readName(fp, file->name) == -1 ||
+		    fscanf(fp, ",%d,%d", &file->first_image, &file->image_count) !=
+		        2) {
+			return -1;
+		}
+	}
+
+	if (fscanf(fp, " [images,%d,6,i,i,i,i,i,s] #page,posx,posy,width,height,"
+	               "hash",
+	           &index->image_count) != 1 ||
+	    index->image_count < 0) {
+		return -1;
+	}
+	index->images =
+	    sh2ckMemoryAlloc(sizeof(*index->images) * (index->image_count + 1));
+	if (index->images == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < index->image_count; i++) {
+		struct AtlasSlot *slot = &index->images[i];
+		unsigned long long hash;
+		if (fscanf(fp, "%d,%d,%d,%d,%d,%llx", &slot->page, &slot->x,
+		           &slot->y, &slot->width, &slot->height, &hash) != 6 ||
+		    slot->page < 0 || slot->page >= index->page_count ||
+		    slot->x < 0 || slot->y < 0) {
+			return -1;
+		}
+		slot->hash = hash;
+	}
+	for (int i = 0; i < index->file_count; i++) {
+		struct AtlasFile *file = &index->files[i];
+		if (file->first_image < 0 || file->image_count < 0 ||
+		    file->first_image + file->image_count > index->image_count) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int sh2ckAtlasReadIndex(struct AtlasIndex *index, const char *file)
+{
+	memset(index, 0, sizeof(*index));
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+	int ret = readIndex(index, fp);
+	fclose(fp);
+	if (ret == -1) {
+		sh2ckAtlasDeleteIndex(index);
+	}
+	return ret;
+}
+
+void sh2ckAtlasDeleteIndex(struct AtlasIndex *index)
+{
+	if (index != NULL) {
+		sh2ckMemoryFree(index->pages);
+		sh2ckMemoryFree(index->files);
+		sh2ckMemoryFree(index->images);
+		index->pages = NULL;
+		index->files = NULL;
+		index->images = NULL;
+	}
+}
+
+void sh2ckAtlasDelete(struct SharedAtlas *atlas)
+{
+	if (atlas != NULL) {
+		sh2ckMemoryFree(atlas->pages);
+		sh2ckMemoryFree(atlas->dirty);
+		sh2ckMemoryFree(atlas->first_entry);
+		sh2ckMemoryFree(atlas->entries);
+		atlas->pages = NULL;
+		atlas->dirty = NULL;
+		atlas->first_entry = NULL;
+		atlas->entries = NULL;
+		atlas->page_count = 0;
+		atlas->entry_count = 0;
+	}
+}
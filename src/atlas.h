@@ -0,0 +1,128 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_ATLAS_H
+#define SH2CK_ATLAS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Atlas pages shared by the images of many files. The images are placed by
+ * height into shelves, a new page is started when a page is full.
+ * sh2ckAtlasUpdate starts from a previous layout instead and only moves what
+ * changed, so only the pages marked dirty have to be written again.*/
+
+#define ATLAS_NAME_SIZE 256
+
+struct Sh2ckImage;
+struct Sh2ckImageList;
+struct Sh2ckOffset;
+struct Sh2ckRect;
+
+struct AtlasEntry {
+	uint16_t list;
+	uint16_t image;
+	uint16_t page;
+	/*hash of the pixels, to find changed images on the next update*/
+	uint64_t hash;
+};
+
+struct SharedAtlas {
+	int page_width;
+	int page_height;
+	int page_count;
+	/*used size of every page*/
+	struct Sh2ckRect *pages;
+	/*pages whose content changed since the previous layout*/
+	uint8_t *dirty;
+	int list_count;
+	struct Sh2ckImageList *lists;
+	/*offsets of trimmed images, per list, may be NULL*/
+	struct Sh2ckOffset **image_offsets;
+	/*index of the first entry of every list*/
+	int *first_entry;
+	int entry_count;
+	/*one entry per image, in list order*/
+	struct AtlasEntry *entries;
+};
+
+/*Places all images of the lists, sets their positions and the page of
+ * every entry. The lists are not owned by the atlas and have to stay valid
+ * until it is deleted.*/
+int sh2ckAtlasLayout(struct SharedAtlas *atlas, struct Sh2ckImageList *lists,
+                     struct Sh2ckOffset **image_offsets, int list_count,
+                     int page_width, int page_height, int assembled);
+
+/*A previous layout as read back from the index*/
+struct AtlasSlot {
+	int page;
+	int x;
+	int y;
+	int width;
+	int height;
+	uint64_t hash;
+};
+
+struct AtlasFile {
+	char name[ATLAS_NAME_SIZE];
+	int first_image;
+	int image_count;
+};
+
+struct AtlasIndex {
+	int page_count;
+	struct Sh2ckRect *pages;
+	int file_count;
+	struct AtlasFile *files;
+	int image_count;
+	struct AtlasSlot *images;
+};
+
+/*Like sh2ckAtlasLayout, but keeps every image of a file that is also in the
+ * previous layout at its old place if it still fits there. Images that are
+ * new or grew are placed into the free space of the pages, or on new pages.
+ * Only the pages with changed content are marked dirty.*/
+int sh2ckAtlasUpdate(struct SharedAtlas *atlas, struct Sh2ckImageList *lists,
+                     struct Sh2ckOffset **image_offsets,
+                     const char *const *names, int list_count, int page_width,
+                     int page_height, int assembled,
+                     struct AtlasIndex *previous);
+
+struct AtlasEntry *sh2ckAtlasEntry(struct SharedAtlas *atlas, int list,
+                                   int image);
+
+int sh2ckAtlasComposePage(struct SharedAtlas *atlas, int page,
+                          struct Sh2ckImage *image);
+
+/*writes the pages, the files and the page, rect and hash of every image*/
+int sh2ckAtlasWriteIndex(struct SharedAtlas *atlas, const char *const *names,
+                         const char *file);
+
+int sh2ckAtlasReadIndex(struct AtlasIndex *index, const char *file);
+
+void sh2ckAtlasDeleteIndex(struct AtlasIndex *index);
+
+void sh2ckAtlasDelete(struct SharedAtlas *atlas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_ATLAS_H
@@ -0,0 +1,252 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cache.h"
+
+#define CACHE_READ_BUFFER_SIZE (64 * 1024)
+#define CACHE_FNV_PRIME 0x100000001b3ULL
+
+struct Manifest {
+	int entry_count;
+	int capacity;
+	struct CacheEntry *entries;
+};
+
+uint64_t cacheHashBytes(uint64_t hash, const void *data, int size)
+{
+	const uint8_t *bytes = data;
+	for (int i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= CACHE_FNV_PRIME;
+	}
+	return hash;
+}
+
+int cacheHashFile(const char *file, uint64_t *hash)
+{
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	uint8_t *buffer = malloc(CACHE_READ_BUFFER_SIZE);
+	if (buffer == NULL) {
+		fclose(fp);
+		return -1;
+	}
+	uint64_t h = CACHE_HASH_SEED;
+	size_t read = 0;
+	while ((read = fread(buffer, 1, CACHE_READ_BUFFER_SIZE, fp)) > 0) {
+		h = cacheHashBytes(h, buffer, read);
+	}
+	int error = ferror(fp);
+	free(buffer);
+	fclose(fp);
+	if (error) {
+		return -1;
+	}
+	*hash = h;
+	return 0;
+}
+
+static void manifestPath(char *buffer, int size, const char *output_dir)
+{
+	snprintf(buffer, size, "%s/%s", output_dir, CACHE_MANIFEST_NAME);
+}
+
+static int manifestAdd(struct Manifest *manifest, struct CacheEntry *entry)
+{
+	if (manifest->entry_count == manifest->capacity) {
+		int capacity = manifest->capacity ? manifest->capacity * 2 : 64;
+		struct CacheEntry *entries =
+		    realloc(manifest->entries, sizeof(*entries) * capacity);
+		if (entries == NULL) {
+			return -1;
+		}
+		manifest->entries = entries;
+		manifest->capacity = capacity;
+	}
+	manifest->entries[manifest->entry_count++] = *entry;
+	return 0;
+}
+
+static struct CacheEntry *manifestFind(struct Manifest *manifest,
+                                       const char *name)
+{
+	for (int i = 0; i < manifest->entry_count; i++) {
+		if (strcmp(manifest->entries[i].name, name) == 0) {
+			return &manifest->entries[i];
+		}
+	}
+	return NULL;
+}
+
+/*a missing manifest is not an error, it is just empty*/
+static int manifestLoad(struct Manifest *manifest, const char *output_dir)
+{
+	char string_buffer[512];
+	manifest->entry_count = 0;
+	manifest->capacity = 0;
+	manifest->entries = NULL;
+
+	manifestPath(string_buffer, sizeof(string_buffer), output_dir);
+	FILE *fp = fopen(string_buffer, "r");
+	if (fp == NULL) {
+		return 0;
+	}
+
+	struct CacheEntry entry;
+	unsigned long long hash;
+	unsigned long long options;
+	long long size;
+	long long mtime;
+	while (fscanf(fp, "%llx %llx %lld %lld %255[^\n]\n", &hash, &options,
+	              &size, &mtime, entry.name) == 5) {
+		entry.hash = hash;
+		entry.options = options;
+		entry.size = size;
+		entry.mtime = mtime;
+		if (manifestAdd(manifest, &entry) == -1) {
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+/*write to a temporary file first so an interrupted run never leaves a
+ * truncated manifest behind*/
+static int manifestSave(struct Manifest *manifest, const char *output_dir)
+{
+	char path[512];
+	char tmp_path[520];
+	manifestPath(path, sizeof(path), output_dir);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	FILE *fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < manifest->entry_count; i++) {
+		struct CacheEntry *entry = &manifest->entries[i];
+		fprintf(fp, "%016llx %016llx %lld %lld %s\n",
+		        (unsigned long long)entry->hash,
+		        (unsigned long long)entry->options, (long long)entry->size,
+		        (long long)entry->mtime, entry->name);
+	}
+	if (fclose(fp) != 0) {
+		remove(tmp_path);
+		return -1;
+	}
+	return rename(tmp_path, path);
+}
+
+static void manifestDelete(struct Manifest *manifest)
+{
+	free(manifest->entries);
+}
+
+int cacheIsUpToDate(const char *output_dir, const char *name,
+                    const char *input_file, uint64_t options,
+                    const char *const *outputs, int output_count)
+{
+	struct stat input_stat;
+	struct stat output_stat;
+	struct Manifest manifest;
+	uint64_t hash = 0;
+
+	if (stat(input_file, &input_stat) == -1) {
+		return 0;
+	}
+	for (int i = 0; i < output_count; i++) {
+		if (stat(outputs[i], &output_stat) == -1) {
+			return 0;
+		}
+	}
+	if (manifestLoad(&manifest, output_dir) == -1) {
+		manifestDelete(&manifest);
+		return 0;
+	}
+
+	struct CacheEntry *entry = manifestFind(&manifest, name);
+	if (entry == NULL || entry->options != options) {
+		manifestDelete(&manifest);
+		return 0;
+	}
+
+	/*unchanged size and modification time, no need to hash the file*/
+	if (entry->size == input_stat.st_size &&
+	    entry->mtime == input_stat.st_mtime) {
+		manifestDelete(&manifest);
+		return 1;
+	}
+
+	if (cacheHashFile(input_file, &hash) == -1 || entry->hash != hash) {
+		manifestDelete(&manifest);
+		return 0;
+	}
+
+	/*only touched, remember the new stat so the next run skips hashing*/
+	entry->size = input_stat.st_size;
+	entry->mtime = input_stat.st_mtime;
+	manifestSave(&manifest, output_dir);
+	manifestDelete(&manifest);
+	return 1;
+}
+
+int cacheUpdate(const char *output_dir, const char *name,
+                const char *input_file, uint64_t options)
+{
+	struct stat input_stat;
+	struct Manifest manifest;
+	struct CacheEntry entry;
+
+	if (strlen(name) >= CACHE_NAME_SIZE) {
+		return -1;
+	}
+	if (stat(input_file, &input_stat) == -1) {
+		return -1;
+	}
+	if (cacheHashFile(input_file, &entry.hash) == -1) {
+		return -1;
+	}
+	strcpy(entry.name, name);
+	entry.options = options;
+	entry.size = input_stat.st_size;
+	entry.mtime = input_stat.st_mtime;
+
+	if (manifestLoad(&manifest, output_dir) == -1) {
+		manifestDelete(&manifest);
+		return -1;
+	}
+	struct CacheEntry *old = manifestFind(&manifest, name);
+	if (old != NULL) {
+		*old = entry;
+	} else if (manifestAdd(&manifest, &entry) == -1) {
+		manifestDelete(&manifest);
+		return -1;
+	}
+	int ret = manifestSave(&manifest, output_dir);
+	manifestDelete(&manifest);
+	return ret;
+}
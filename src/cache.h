@@ -0,0 +1,48 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#define CACHE_MANIFEST_NAME "sh2ck.manifest"
+#define CACHE_NAME_SIZE 256
+
+#define CACHE_HASH_SEED 0xcbf29ce484222325ULL
+
+struct CacheEntry {
+	char name[CACHE_NAME_SIZE];
+	uint64_t hash;
+	uint64_t options;
+	int64_t size;
+	int64_t mtime;
+};
+
+uint64_t cacheHashBytes(uint64_t hash, const void *data, int size);
+
+int cacheHashFile(const char *file, uint64_t *hash);
+
+/*returns 1 if the outputs of name in output_dir are up to date*/
+int cacheIsUpToDate(const char *output_dir, const char *name,
+                    const char *input_file, uint64_t options,
+                    const char *const *outputs, int output_count);
+
+int cacheUpdate(const char *output_dir, const char *name,
+                const char *input_file, uint64_t options);
+
+#endif  // CACHE_H
@@ -0,0 +1,508 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "delta.h"
+#include "image.h"
+#include "io.h"
+#include "memory.h"
+
+#define DELTA_HEADER_SIZE 24
+#define DELTA_FRAME_HEADER_SIZE 8
+#define DELTA_BLOCK_HEADER_SIZE 4
+
+struct DeltaWriter {
+	uint8_t *data;
+	uint32_t size;
+	uint32_t capacity;
+};
+
+/*returns the offset of the size new bytes*/
+static int64_t writerGrow(struct DeltaWriter *writer, uint32_t size)
+{
+	if (writer->size + size > writer->capacity) {
+		uint32_t capacity = writer->capacity ? writer->capacity * 2 : 4096;
+		while (capacity < writer->size + size) {
+			capacity *= 2;
+		}
+		uint8_t *data = sh2ckMemoryRealloc(writer->data, capacity);
+		if (data == NULL) {
+			return -1;
+		}
+		writer->data = data;
+		writer->capacity = capacity;
+	}
+	uint32_t offset = writer->size;
+	writer->size += size;
+	return offset;
+}
+
+static uint16_t read16(const uint8_t *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint32_t read32(const uint8_t *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static void write16(uint8_t *data, uint16_t value)
+{
+	memcpy(data, &value, sizeof(value));
+}
+
+static void write32(uint8_t *data, uint32_t value)
+{
+	memcpy(data, &value, sizeof(value));
+}
+
+static int blocksX(struct DeltaAnimation *animation)
+{
+	return (animation->width + animation->block_size - 1) /
+	       animation->block_size;
+}
+
+static int blocksY(struct DeltaAnimation *animation)
+{
+	return (animation->height + animation->block_size - 1) /
+	       animation->block_size;
+}
+
+/*blocks on the right and bottom edge are cut to the canvas*/
+static void blockRect(struct DeltaAnimation *animation, int bx, int by,
+                      struct Sh2ckRect *rect)
+{
+	int size = animation->block_size;
+	rect->x = bx * size;
+	rect->y = by * size;
+	rect->width = animation->width - rect->x < size ? animation->width - rect->x
+	                                                : size;
+	rect->height =
+	    animation->height - rect->y < size ? animation->height - rect->y : size;
+}
+
+static int blockEmpty(const struct Sh2ckColor *canvas, int pitch,
+                      const struct Sh2ckRect *rect)
+{
+	for (int y = rect->y; y < rect->y + rect->height; y++) {
+		const struct Sh2ckColor *row = canvas + y * pitch;
+		for (int x = rect->x; x < rect->x + rect->width; x++) {
+			if (row[x].a | row[x].r | row[x].g | row[x].b) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static int blockEqual(const struct Sh2ckColor *a, const struct Sh2ckColor *b,
+                      int pitch, const struct Sh2ckRect *rect)
+{
+	for (int y = rect->y; y < rect->y + rect->height; y++) {
+		if (memcmp(a + y * pitch + rect->x, b + y * pitch + rect->x,
+		           rect->width * sizeof(*a)) != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*the bounding box of a fully transparent frame is negative*/
+static int frameWidth(struct Sh2ckImage *image)
+{
+	return image->width > 0 ? image->width : 0;
+}
+
+static int frameHeight(struct Sh2ckImage *image)
+{
+	return image->height > 0 ? image->height : 0;
+}
+
+static void composeFrame(struct DeltaAnimation *animation,
+                         struct Sh2ckColor *canvas, struct Sh2ckImage *image,
+                         const struct Sh2ckOffset *offset,
+                         const struct Sh2ckPos *center)
+{
+	int left = animation->center_x - center->x;
+	int top = animation->center_y - center->y;
+	memset(canvas, 0,
+	       sizeof(*canvas) * animation->width * animation->height);
+	if (frameWidth(image) == 0) {
+		return;
+	}
+	for (int y = 0; y < frameHeight(image); y++) {
+		memcpy(canvas + (top + y) * animation->width + left,
+		       image->pixel + (y + offset->y) * image->pitch + offset->x,
+		       sizeof(*canvas) * frameWidth(image));
+	}
+}
+
+/*Writes the blocks of the frame in current, all non-empty ones for a
+ * keyframe, otherwise the ones that differ from previous.*/
+static int writeFrame(struct DeltaAnimation *animation,
+                      struct DeltaWriter *writer,
+                      const struct Sh2ckColor *current,
+                      const struct Sh2ckColor *previous, int key)
+{
+	struct Sh2ckRect rect;
+	int64_t frame = writerGrow(writer, DELTA_FRAME_HEADER_SIZE);
+	uint32_t block_count = 0;
+	if (frame == -1) {
+		return -1;
+	}
+	for (int by = 0; by < blocksY(animation); by++) {
+		for (int bx = 0; bx < blocksX(animation); bx++) {
+			blockRect(animation, bx, by, &rect);
+			if (key ? blockEmpty(current, animation->width, &rect)
+			        : blockEqual(current, previous, animation->width, &rect)) {
+				continue;
+			}
+			int row_size = rect.width * sizeof(*current);
+			int64_t offset = writerGrow(
+			    writer, DELTA_BLOCK_HEADER_SIZE + row_size * rect.height);
+			if (offset == -1) {
+				return -1;
+			}
+			write16(writer->data + offset, bx);
+			write16(writer->data + offset + 2, by);
+			offset += DELTA_BLOCK_HEADER_SIZE;
+			for (int y = rect.y; y < rect.y + rect.height; y++) {
+				memcpy(writer->data + offset,
+				       current + y * animation->width + rect.x, row_size);
+				offset += row_size;
+			}
+			block_count++;
+		}
+	}
+	write16(writer->data + frame, key ? DELTA_FRAME_KEY : 0);
+	write16(writer->data + frame + 2, 0);
+	write32(writer->data + frame + 4, block_count);
+	return 0;
+}
+
+static int countBlocks(struct DeltaAnimation *animation,
+                       const struct Sh2ckColor *current,
+                       const struct Sh2ckColor *previous, int key)
+{
+	struct Sh2ckRect rect;
+	int count = 0;
+	for (int by = 0; by < blocksY(animation); by++) {
+		for (int bx = 0; bx < blocksX(animation); bx++) {
+			blockRect(animation, bx, by, &rect);
+			if (key ? !blockEmpty(current, animation->width, &rect)
+			        : !blockEqual(current, previous, animation->width, &rect)) {
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/*Fully transparent frames draw nothing and are left out, if every frame is
+ * empty the canvas is 0x0.*/
+static void canvasBounds(struct DeltaAnimation *animation,
+                         struct Sh2ckImageList *image_list)
+{
+	struct Sh2ckAnimation *frames = image_list->data;
+	int found = 0;
+	int minx = 0;
+	int miny = 0;
+	int maxx = 0;
+	int maxy = 0;
+	for (int i = 0; i < image_list->image_count; i++) {
+		struct Sh2ckPos *center = &frames->frames[i].center;
+		struct Sh2ckImage *image = &image_list->images[i];
+		if (frameWidth(image) == 0 || frameHeight(image) == 0) {
+			continue;
+		}
+		if (!found || -center->x < minx) {
+			minx = -center->x;
+		}
+		if (!found || -center->y < miny) {
+			miny = -center->y;
+		}
+		if (!found || frameWidth(image) - center->x > maxx) {
+			maxx = frameWidth(image) - center->x;
+		}
+		if (!found || frameHeight(image) - center->y > maxy) {
+			maxy = frameHeight(image) - center->y;
+		}
+		found = 1;
+	}
+	animation->width = maxx - minx;
+	animation->height = maxy - miny;
+	animation->center_x = -minx;
+	animation->center_y = -miny;
+}
+
+static void writeHeader(struct DeltaAnimation *animation, uint8_t *data)
+{
+	memcpy(data, DELTA_MAGIC, 4);
+	write32(data + 4, DELTA_VERSION);
+	write32(data + 8, animation->frame_count);
+	write16(data + 12, animation->block_size);
+	write16(data + 14, animation->width);
+	write16(data + 16, animation->height);
+	write16(data + 18, animation->center_x);
+	write16(data + 20, animation->center_y);
+	write16(data + 22, 0);
+}
+
+int sh2ckDeltaCreate(struct DeltaAnimation *animation,
+                     struct Sh2ckImageList *image_list,
+                     const struct Sh2ckOffset *image_offsets, int block_size,
+                     int max_chain)
+{
+	struct DeltaWriter writer = {NULL, 0, 0};
+	struct Sh2ckOffset no_offset = {0, 0};
+	struct Sh2ckAnimation *frames = image_list->data;
+
+	animation->buffer = NULL;
+	animation->size = 0;
+	if (image_list->type != SH2CK_IMAGE_TYPE_ANIMATION || block_size < 1 ||
+	    block_size > UINT16_MAX) {
+		return -1;
+	}
+	animation->frame_count = image_list->image_count;
+	animation->block_size = block_size;
+	canvasBounds(animation, image_list);
+	if (animation->width > UINT16_MAX || animation->height > UINT16_MAX) {
+		return -1;
+	}
+
+	int canvas_size = animation->width * animation->height + 1;
+	struct Sh2ckColor *current =
+	    sh2ckMemoryAlloc(sizeof(*current) * canvas_size);
+	struct Sh2ckColor *previous =
+	    sh2ckMemoryAlloc(sizeof(*previous) * canvas_size);
+	if (current == NULL || previous == NULL ||
+	    writerGrow(&writer, DELTA_HEADER_SIZE + sizeof(uint32_t) *
+	                                                animation->frame_count) ==
+	        -1) {
+		sh2ckMemoryFree(current);
+		sh2ckMemoryFree(previous);
+		sh2ckMemoryFree(writer.data);
+		return -1;
+	}
+
+	int chain = 0;
+	for (int i = 0; i < animation->frame_count; i++) {
+		composeFrame(animation, current, &image_list->images[i],
+		             image_offsets ? &image_offsets[i] : &no_offset,
+		             &frames->frames[i].center);
+		/*start a new chain if the chain is long enough or a delta would
+		 * not save much over a keyframe*/
+		int key = i == 0 || chain >= max_chain ||
+		          countBlocks(animation, current, previous, 0) >
+		              countBlocks(animation, current, previous, 1) / 2;
+		write32(writer.data + DELTA_HEADER_SIZE + i * sizeof(uint32_t),
+		        writer.size);
+		if (writeFrame(animation, &writer, current, previous, key) == -1) {
+			sh2ckMemoryFree(current);
+			sh2ckMemoryFree(previous);
+			sh2ckMemoryFree(writer.data);
+			return -1;
+		}
+		chain = key ? 0 : chain + 1;
+
+		struct Sh2ckColor *tmp = previous;
+		previous = current;
+		current = tmp;
+	}
+	sh2ckMemoryFree(current);
+	sh2ckMemoryFree(previous);
+
+	writeHeader(animation, writer.data);
+	animation->buffer = writer.data;
+	animation->size = writer.size;
+	return 0;
+}
+
+int sh2ckDeltaSave(struct DeltaAnimation *animation, const char *file)
+{
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fwrite(animation->buffer, 1, animation->size, fp) < animation->size) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+static uint32_t frameOffset(struct DeltaAnimation *animation, int frame)
+{
+	return read32(animation->buffer + DELTA_HEADER_SIZE +
+	              frame * sizeof(uint32_t));
+}
+
+/*checks that every frame and block lies inside of the buffer and canvas*/
+static int deltaValidate(struct DeltaAnimation *animation)
+{
+	struct Sh2ckRect rect;
+	uint32_t table_end =
+	    DELTA_HEADER_SIZE + sizeof(uint32_t) * animation->frame_count;
+	for (int i = 0; i < animation->frame_count; i++) {
+		uint32_t offset = frameOffset(animation, i);
+		if (offset < table_end ||
+		    offset > animation->size - DELTA_FRAME_HEADER_SIZE) {
+			return -1;
+		}
+		if (i == 0 && !sh2ckDeltaIsKeyFrame(animation, 0)) {
+			return -1;
+		}
+		uint32_t block_count = read32(animation->buffer + offset + 4);
+		offset += DELTA_FRAME_HEADER_SIZE;
+		for (uint32_t k = 0; k < block_count; k++) {
+			if (offset > animation->size - DELTA_BLOCK_HEADER_SIZE) {
+				return -1;
+			}
+			int bx = read16(animation->buffer + offset);
+			int by = read16(animation->buffer + offset + 2);
+			if (bx >= blocksX(animation) || by >= blocksY(animation)) {
+				return -1;
+			}
+			blockRect(animation, bx, by, &rect);
+			offset += DELTA_BLOCK_HEADER_SIZE;
+			uint32_t size =
+			    rect.width * rect.height * sizeof(struct Sh2ckColor);
+			if (size > animation->size - offset) {
+				return -1;
+			}
+			offset += size;
+		}
+	}
+	return 0;
+}
+
+int sh2ckDeltaLoad(struct DeltaAnimation *animation, const char *file)
+{
+	animation->buffer = NULL;
+	animation->size = 0;
+	animation->frame_count = 0;
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return -1;
+	}
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < DELTA_HEADER_SIZE || size > UINT32_MAX) {
+		fclose(fp);
+		return -1;
+	}
+	animation->buffer = sh2ckMemoryAlloc(size);
+	if (animation->buffer == NULL ||
+	    fread(animation->buffer, 1, size, fp) < (size_t)size) {
+		fclose(fp);
+		sh2ckDeltaDelete(animation);
+		return -1;
+	}
+	fclose(fp);
+
+	uint8_t *data = animation->buffer;
+	animation->size = size;
+	animation->frame_count = read32(data + 8);
+	animation->block_size = read16(data + 12);
+	animation->width = read16(data + 14);
+	animation->height = read16(data + 16);
+	animation->center_x = (int16_t)read16(data + 18);
+	animation->center_y = (int16_t)read16(data + 20);
+	if (memcmp(data, DELTA_MAGIC, 4) != 0 ||
+	    read32(data + 4) != DELTA_VERSION || animation->block_size == 0 ||
+	    animation->frame_count >
+	        (int64_t)(size - DELTA_HEADER_SIZE) / sizeof(uint32_t) ||
+	    deltaValidate(animation) == -1) {
+		sh2ckDeltaDelete(animation);
+		return -1;
+	}
+	return 0;
+}
+
+int sh2ckDeltaIsKeyFrame(struct DeltaAnimation *animation, int frame)
+{
+	uint32_t offset = frameOffset(animation, frame);
+	return (read16(animation->buffer + offset) & DELTA_FRAME_KEY) != 0;
+}
+
+int sh2ckDeltaApplyFrame(struct DeltaAnimation *animation, int frame,
+                         struct Sh2ckImage *canvas)
+{
+	struct Sh2ckRect rect;
+	if (frame < 0 || frame >= animation->frame_count ||
+	    canvas->width < animation->width ||
+	    canvas->height < animation->height) {
+		return -1;
+	}
+	if (sh2ckDeltaIsKeyFrame(animation, frame)) {
+		sh2ckImageClear(canvas, 0x00);
+	}
+	uint32_t offset = frameOffset(animation, frame);
+	uint32_t block_count = read32(animation->buffer + offset + 4);
+	const uint8_t *data =
+	    animation->buffer + offset + DELTA_FRAME_HEADER_SIZE;
+	for (uint32_t k = 0; k < block_count; k++) {
+		blockRect(animation, read16(data), read16(data + 2), &rect);
+		data += DELTA_BLOCK_HEADER_SIZE;
+		int row_size = rect.width * sizeof(struct Sh2ckColor);
+		for (int y = rect.y; y < rect.y + rect.height; y++) {
+			memcpy(canvas->pixel + y * canvas->pitch + rect.x, data,
+			       row_size);
+			data += row_size;
+		}
+	}
+	return 0;
+}
+
+int sh2ckDeltaDecodeFrame(struct DeltaAnimation *animation, int frame,
+                          struct Sh2ckImage *canvas)
+{
+	if (frame < 0 || frame >= animation->frame_count) {
+		return -1;
+	}
+	int key = frame;
+	while (!sh2ckDeltaIsKeyFrame(animation, key)) {
+		key--;
+	}
+	for (int i = key; i <= frame; i++) {
+		if (sh2ckDeltaApplyFrame(animation, i, canvas) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void sh2ckDeltaDelete(struct DeltaAnimation *animation)
+{
+	if (animation != NULL) {
+		sh2ckMemoryFree(animation->buffer);
+		animation->buffer = NULL;
+		animation->size = 0;
+	}
+}
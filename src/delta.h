@@ -0,0 +1,88 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_DELTA_H
+#define SH2CK_DELTA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Animations stored as keyframes and deltas. All frames are aligned on their
+ * center in one canvas, which is split into square blocks. A keyframe holds
+ * every block that is not fully transparent, a delta only the blocks that
+ * differ from the previous frame. Blocks are stored as rgba pixels.*/
+
+#define DELTA_MAGIC "SH2A"
+#define DELTA_VERSION 1
+
+#define DELTA_DEFAULT_BLOCK_SIZE 16
+/*frames a delta chain may grow to before the next keyframe*/
+#define DELTA_DEFAULT_MAX_CHAIN 16
+
+#define DELTA_FRAME_KEY 1
+
+struct Sh2ckImage;
+struct Sh2ckImageList;
+struct Sh2ckOffset;
+
+struct DeltaAnimation {
+	int frame_count;
+	int block_size;
+	int width;
+	int height;
+	/*center of the frames in the canvas*/
+	int center_x;
+	int center_y;
+	uint32_t size;
+	uint8_t *buffer;
+};
+
+/*Encodes the frames of an animation list. image_offsets are the offsets of
+ * the trimmed images in their pixels, as returned by
+ * sh2ckShrinkAnimationImages, or NULL if the images were not trimmed.*/
+int sh2ckDeltaCreate(struct DeltaAnimation *animation,
+                     struct Sh2ckImageList *image_list,
+                     const struct Sh2ckOffset *image_offsets, int block_size,
+                     int max_chain);
+
+int sh2ckDeltaSave(struct DeltaAnimation *animation, const char *file);
+
+int sh2ckDeltaLoad(struct DeltaAnimation *animation, const char *file);
+
+/*returns 1 if frame is a keyframe*/
+int sh2ckDeltaIsKeyFrame(struct DeltaAnimation *animation, int frame);
+
+/*Applies the blocks of frame to canvas, which has to hold frame - 1 unless
+ * frame is a keyframe. canvas has to be animation->width *
+ * animation->height.*/
+int sh2ckDeltaApplyFrame(struct DeltaAnimation *animation, int frame,
+                         struct Sh2ckImage *canvas);
+
+/*reconstructs frame into canvas from the keyframe before it*/
+int sh2ckDeltaDecodeFrame(struct DeltaAnimation *animation, int frame,
+                          struct Sh2ckImage *canvas);
+
+void sh2ckDeltaDelete(struct DeltaAnimation *animation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_DELTA_H
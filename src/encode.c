@@ -0,0 +1,392 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "encode.h"
+#include "io.h"
+#include "memory.h"
+#include "thread.h"
+
+#define ENCODE_WINDOW_SIZE 32768
+#define ENCODE_RGBA_BYTES 4
+
+struct EncodeChunk {
+	int first;
+	int count;
+	int last;
+	int failed;
+	/*deflated rows*/
+	uint8_t *data;
+	size_t size;
+	/*adler32 and size of the filtered rows*/
+	uint32_t adler;
+	size_t length;
+};
+
+struct EncodeTask {
+	int width;
+	int bytes_per_pixel;
+	int stride;
+	int dictionary_rows;
+	EncodeRowFunction rows;
+	void *context;
+	const uint8_t *zero_row;
+	struct EncodeChunk *chunks;
+};
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) {
+		return a;
+	}
+	return pb <= pc ? b : c;
+}
+
+static uint32_t filterCost(const uint8_t *line, int length)
+{
+	uint32_t cost = 0;
+	for (int i = 1; i < length; i++) {
+		cost += abs((int8_t)line[i]);
+	}
+	return cost;
+}
+
+/*writes filter type and filtered row to line*/
+static void filterLine(uint8_t *line, int type, const uint8_t *row,
+                       const uint8_t *prior, int stride, int bpp)
+{
+	uint8_t *out = line + 1;
+
+	line[0] = type;
+	switch (type) {
+	case 0:
+		memcpy(out, row, stride);
+		break;
+	case 1:
+		memcpy(out, row, bpp);
+		for (int i = bpp; i < stride; i++) {
+			out[i] = row[i] - row[i - bpp];
+		}
+		break;
+	case 2:
+		for (int i = 0; i < stride; i++) {
+			out[i] = row[i] - prior[i];
+		}
+		break;
+	case 3:
+		for (int i = 0; i < bpp; i++) {
+			out[i] = row[i] - prior[i] / 2;
+		}
+		for (int i = bpp; i < stride; i++) {
+			out[i] = row[i] - (row[i - bpp] + prior[i]) / 2;
+		}
+		break;
+	default:
+		for (int i = 0; i < bpp; i++) {
+			out[i] = row[i] - prior[i];
+		}
+		for (int i = bpp; i < stride; i++) {
+			out[i] = row[i] - paeth(row[i - bpp], prior[i], prior[i - bpp]);
+		}
+		break;
+	}
+}
+
+/*writes the row with the filter that has the smallest sum of absolute
+ * differences, like libpng does. Indexed rows are not filtered, as libpng
+ * does not filter them either. scratch holds one line.*/
+static void filterRow(uint8_t *line, uint8_t *scratch, const uint8_t *row,
+                      const uint8_t *prior, int stride, int bpp)
+{
+	filterLine(line, 0, row, prior, stride, bpp);
+	if (bpp == 1) {
+		return;
+	}
+	uint32_t best = filterCost(line, stride + 1);
+	for (int type = 1; type <= 4; type++) {
+		filterLine(scratch, type, row, prior, stride, bpp);
+		uint32_t cost = filterCost(scratch, stride + 1);
+		if (cost < best) {
+			best = cost;
+			memcpy(line, scratch, stride + 1);
+		}
+	}
+}
+
+/*raw deflate of size bytes, every chunk but the last ends on a sync flush so
+ * the next one starts at a byte boundary*/
+static int deflateChunk(struct EncodeChunk *chunk, const uint8_t *dictionary,
+                        int dictionary_size, const uint8_t *data,
+                        size_t size)
+{
+	z_stream stream;
+	int flush = chunk->last ? Z_FINISH : Z_SYNC_FLUSH;
+
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+	                 -MAX_WBITS, 8, Z_FILTERED) != Z_OK) {
+		return -1;
+	}
+	if (dictionary_size > 0 &&
+	    deflateSetDictionary(&stream, dictionary, dictionary_size) != Z_OK) {
+		deflateEnd(&stream);
+		return -1;
+	}
+	size_t capacity = deflateBound(&stream, size) + 16;
+	chunk->data = sh2ckMemoryAlloc(capacity);
+	if (chunk->data == NULL) {
+		deflateEnd(&stream);
+		return -1;
+	}
+	stream.next_in = (uint8_t *)data;
+	stream.avail_in = size;
+	stream.next_out = chunk->data;
+	stream.avail_out = capacity;
+
+	int ret = deflate(&stream, flush);
+	while (ret == Z_OK && stream.avail_out == 0) {
+		uint8_t *grown = sh2ckMemoryRealloc(chunk->data, capacity * 2);
+		if (grown == NULL) {
+			break;
+		}
+		chunk->data = grown;
+		stream.next_out = chunk->data + capacity;
+		stream.avail_out = capacity;
+		capacity *= 2;
+		ret = deflate(&stream, flush);
+	}
+	chunk->size = capacity - stream.avail_out;
+	deflateEnd(&stream);
+	if (ret != (chunk->last ? Z_STREAM_END : Z_OK) ||
+	    (!chunk->last && stream.avail_out == 0)) {
+		sh2ckMemoryFree(chunk->data);
+		chunk->data = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*Filters the rows of the chunk together with up to dictionary_rows rows in
+ * front of it. Those are the dictionary, so the chunk compresses as well as
+ * in a single stream.*/
+static void encodeChunk(void *context, int index)
+{
+	struct EncodeTask *task = context;
+	struct EncodeChunk *chunk = &task->chunks[index];
+	int line_size = task->stride + 1;
+	int dictionary_rows = chunk->first < task->dictionary_rows
+	                          ? chunk->first
+	                          : task->dictionary_rows;
+	int prior_rows = chunk->first - dictionary_rows > 0 ? 1 : 0;
+	int row_count = prior_rows + dictionary_rows + chunk->count;
+	int line_count = dictionary_rows + chunk->count;
+
+	uint8_t *raw =
+	    sh2ckMemoryAlloc((size_t)task->width * ENCODE_RGBA_BYTES * row_count);
+	uint8_t *lines = sh2ckMemoryAlloc((size_t)line_size * (line_count + 1));
+	if (raw == NULL || lines == NULL) {
+		sh2ckMemoryFree(raw);
+		sh2ckMemoryFree(lines);
+		chunk->failed = 1;
+		return;
+	}
+	task->rows(task->context, raw,
+	           chunk->first - dictionary_rows - prior_rows, row_count);
+
+	uint8_t *scratch = lines + (size_t)line_size * line_count;
+	for (int i = 0; i < line_count; i++) {
+		const uint8_t *row = raw + (size_t)task->stride * (prior_rows + i);
+		const uint8_t *prior = prior_rows + i > 0 ? row - task->stride
+		                                          : task->zero_row;
+		filterRow(lines + (size_t)line_size * i, scratch, row, prior,
+		          task->stride, task->bytes_per_pixel);
+	}
+
+	int dictionary_size = dictionary_rows * line_size;
+	if (dictionary_size > ENCODE_WINDOW_SIZE) {
+		dictionary_size = ENCODE_WINDOW_SIZE;
+	}
+	const uint8_t *data = lines + (size_t)line_size * dictionary_rows;
+	chunk->length = (size_t)line_size * chunk->count;
+	chunk->adler = adler32(1, data, chunk->length);
+	if (deflateChunk(chunk, data - dictionary_size, dictionary_size, data,
+	                 chunk->length) == -1) {
+		chunk->failed = 1;
+	}
+	sh2ckMemoryFree(raw);
+	sh2ckMemoryFree(lines);
+}
+
+static void writeUint32(uint8_t *buffer, uint32_t value)
+{
+	buffer[0] = value >> 24;
+	buffer[1] = value >> 16;
+	buffer[2] = value >> 8;
+	buffer[3] = value;
+}
+
+static int writeChunk(FILE *fp, const char *type, const uint8_t *data,
+                      size_t size)
+{
+	uint8_t length[4];
+	uint8_t crc[4];
+	uint32_t sum = crc32(0, (const uint8_t *)type, 4);
+	if (size > 0) {
+		sum = crc32(sum, data, size);
+	}
+	writeUint32(length, size);
+	writeUint32(crc, sum);
+	if (fwrite(length, 4, 1, fp) != 1 || fwrite(type, 4, 1, fp) != 1 ||
+	    (size > 0 && fwrite(data, size, 1, fp) != 1) ||
+	    fwrite(crc, 4, 1, fp) != 1) {
+		return -1;
+	}
+	return 0;
+}
+
+static int writeHeader(FILE *fp, const struct EncodeHeader *header)
+{
+	static const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+	                                     '\r', '\n', 0x1A, '\n'};
+	/*8 bit, deflate, adaptive filters, no interlace*/
+	uint8_t ihdr[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0};
+	/*zlib header of a 32k window at the default level*/
+	static const uint8_t zlib_header[2] = {0x78, 0x9C};
+
+	writeUint32(ihdr, header->width);
+	writeUint32(ihdr + 4, header->height);
+	if (header->palette_size > 0) {
+		ihdr[9] = 3;
+	}
+	if (fwrite(signature, sizeof(signature), 1, fp) != 1 ||
+	    writeChunk(fp, "IHDR", ihdr, sizeof(ihdr)) == -1) {
+		return -1;
+	}
+	if (header->palette_size > 0 &&
+	    writeChunk(fp, "PLTE", header->palette, header->palette_size * 3) ==
+	        -1) {
+		return -1;
+	}
+	if (header->palette_size > 0 && header->alpha_size > 0 &&
+	    writeChunk(fp, "tRNS", header->alpha, header->alpha_size) == -1) {
+		return -1;
+	}
+	return writeChunk(fp, "IDAT", zlib_header, sizeof(zlib_header));
+}
+
+/*deflates count chunks starting at chunk first and appends them to the
+ * file in order*/
+static int encodeChunks(FILE *fp, struct EncodeTask *task, int first, int count,
+                        int chunk_count, int chunk_rows, int height,
+                        uint32_t *adler, struct Sh2ckThreadPool *pool)
+{
+	int ret = 0;
+	for (int i = 0; i < count; i++) {
+		struct EncodeChunk *chunk = &task->chunks[i];
+		memset(chunk, 0, sizeof(*chunk));
+		chunk->first = (first + i) * chunk_rows;
+		chunk->count = height - chunk->first < chunk_rows
+		                   ? height - chunk->first
+		                   : chunk_rows;
+		chunk->last = first + i == chunk_count - 1;
+	}
+	sh2ckThreadPoolParallelFor(pool, count, encodeChunk, task);
+	for (int i = 0; i < count; i++) {
+		struct EncodeChunk *chunk = &task->chunks[i];
+		if (ret == 0 &&
+		    (chunk->failed ||
+		     writeChunk(fp, "IDAT", chunk->data, chunk->size) == -1)) {
+			ret = -1;
+		}
+		*adler = adler32_combine(*adler, chunk->adler, chunk->length);
+		sh2ckMemoryFree(chunk->data);
+	}
+	return ret;
+}
+
+int sh2ckEncodePngParallel(const char *file, const struct EncodeHeader *header,
+                           EncodeRowFunction rows, void *context,
+                           struct Sh2ckThreadPool *pool)
+{
+	int width = header->width;
+	int height = header->height;
+	if (width <= 0 || height <= 0) {
+		return -1;
+	}
+	int bytes_per_pixel = header->palette_size > 0 ? 1 : ENCODE_RGBA_BYTES;
+	int stride = width * bytes_per_pixel;
+	int chunk_rows = ENCODE_CHUNK_SIZE / (stride + 1);
+	if (chunk_rows < 1) {
+		chunk_rows = 1;
+	}
+	int dictionary_rows = (ENCODE_WINDOW_SIZE + stride) / (stride + 1);
+	if (dictionary_rows > chunk_rows) {
+		dictionary_rows = chunk_rows;
+	}
+	int chunk_count = (height + chunk_rows - 1) / chunk_rows;
+	/*two chunks per thread keep every thread busy while bounding memory*/
+	int batch_size = sh2ckThreadPoolThreadCount(pool) * 2;
+
+	struct EncodeTask task = {width, bytes_per_pixel, stride, dictionary_rows,
+	                          rows,  context,         NULL,   NULL};
+	uint8_t *zero_row = sh2ckMemoryAlloc(stride);
+	task.chunks = sh2ckMemoryAlloc(sizeof(*task.chunks) * batch_size);
+	if (zero_row == NULL || task.chunks == NULL) {
+		sh2ckMemoryFree(zero_row);
+		sh2ckMemoryFree(task.chunks);
+		return -1;
+	}
+	memset(zero_row, 0, stride);
+	task.zero_row = zero_row;
+
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		sh2ckMemoryFree(zero_row);
+		sh2ckMemoryFree(task.chunks);
+		return -1;
+	}
+	int ret = writeHeader(fp, header);
+	uint32_t adler = adler32(0, NULL, 0);
+	for (int i = 0; ret == 0 && i < chunk_count; i += batch_size) {
+		int count = chunk_count - i < batch_size ? chunk_count - i
+		                                         : batch_size;
+		ret = encodeChunks(fp, &task, i, count, chunk_count, chunk_rows,
+		                   height, &adler, pool);
+	}
+	if (ret == 0) {
+		uint8_t trailer[4];
+		writeUint32(trailer, adler);
+		if (writeChunk(fp, "IDAT", trailer, sizeof(trailer)) == -1 ||
+		    writeChunk(fp, "IEND", NULL, 0) == -1) {
+			ret = -1;
+		}
+	}
+	if (sh2ckIoClose(fp) != 0) {
+		ret = -1;
+	}
+	sh2ckMemoryFree(zero_row);
+	sh2ckMemoryFree(task.chunks);
+	return ret;
+}
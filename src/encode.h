@@ -0,0 +1,64 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_ENCODE_H
+#define SH2CK_ENCODE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Sh2ckThreadPool;
+
+/*bytes of filtered rows deflated by one task*/
+#define ENCODE_CHUNK_SIZE (128 * 1024)
+
+/*an 8 bit indexed png if palette_size is above 0, rgba otherwise*/
+struct EncodeHeader {
+	int width;
+	int height;
+	/*rgb of every palette entry*/
+	const uint8_t *palette;
+	int palette_size;
+	/*alpha of the first alpha_size palette entries*/
+	const uint8_t *alpha;
+	int alpha_size;
+};
+
+/*writes the rows first to first + count into rows, packed without any
+ * padding, with one byte per pixel for indexed pngs and four for rgba. rows
+ * has room for four bytes per pixel in both cases, so rgba pixels may be
+ * built in place first.*/
+typedef void (*EncodeRowFunction)(void *context, uint8_t *rows, int first,
+                                  int count);
+
+/*Writes a png. The rows are filtered and deflated in chunks of about
+ * ENCODE_CHUNK_SIZE bytes on the threads of pool. Every chunk is primed
+ * with the rows in front of it as dictionary, the chunks are joined into one
+ * zlib stream. rows may be called from several threads at once. pool may be
+ * NULL.*/
+int sh2ckEncodePngParallel(const char *file, const struct EncodeHeader *header,
+                           EncodeRowFunction rows, void *context,
+                           struct Sh2ckThreadPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_ENCODE_H
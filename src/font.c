@@ -0,0 +1,156 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "font.h"
+#include "gm1.h"
+#include "image.h"
+#include "io.h"
+#include "memory.h"
+
+#define FONT_GLYPH_FIELDS 8
+
+void sh2ckFontTrimGlyphs(struct Sh2ckImageList *image_list,
+                         struct Sh2ckOffset *offsets)
+{
+	for (int i = 0; i < image_list->image_count; i++) {
+		struct Sh2ckRect bounds;
+		sh2ckImageBoundingBox(&bounds, &image_list->images[i]);
+		image_list->images[i].width = bounds.width;
+		image_list->images[i].height = bounds.height;
+		offsets[i].x = bounds.x;
+		offsets[i].y = bounds.y;
+	}
+}
+
+int sh2ckFontCreateGlyphTable(struct GlyphTable *table, const struct Gm1 *gm1,
+                              const struct Sh2ckImageList *image_list,
+                              const struct Sh2ckOffset *offsets,
+                              const struct Sh2ckRect *atlas_size)
+{
+	table->glyph_count = image_list->image_count;
+	table->line_height = 0;
+	table->atlas_width = atlas_size->width;
+	table->atlas_height = atlas_size->height;
+	table->glyphs = sh2ckMemoryAlloc(sizeof(*table->glyphs) *
+	                                 (image_list->image_count + 1));
+	if (table->glyphs == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < image_list->image_count; i++) {
+		const struct Gm1ImageHeader *header = &gm1->image_headers[i];
+		const struct Sh2ckImage *image = &image_list->images[i];
+		struct Glyph *glyph = &table->glyphs[i];
+		glyph->x = image->x;
+		glyph->y = image->y;
+		glyph->width = image->width;
+		glyph->height = image->height;
+		glyph->bearing_x = offsets[i].x;
+		glyph->bearing_y = header->tile_position_y + offsets[i].y;
+		glyph->advance = header->image_width;
+		if (header->tile_position_y + header->image_height >
+		    table->line_height) {
+			table->line_height =
+			    header->tile_position_y + header->image_height;
+		}
+	}
+	return 0;
+}
+
+int sh2ckFontSaveGlyphTable(const struct GlyphTable *table, const char *file)
+{
+	uint32_t header[5] = {FONT_GLYPHS_VERSION, table->glyph_count,
+	                      table->line_height, table->atlas_width,
+	                      table->atlas_height};
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	fwrite(FONT_GLYPHS_MAGIC, 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+	for (int i = 0; i < table->glyph_count; i++) {
+		const struct Glyph *glyph = &table->glyphs[i];
+		int16_t fields[FONT_GLYPH_FIELDS] = {glyph->x,         glyph->y,
+		                                     glyph->width,     glyph->height,
+		                                     glyph->bearing_x, glyph->bearing_y,
+		                                     glyph->advance,   0};
+		fwrite(fields, sizeof(fields), 1, fp);
+	}
+	if (ferror(fp)) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+int sh2ckFontLoadGlyphTable(struct GlyphTable *table, const char *file)
+{
+	char magic[4];
+	uint32_t header[5];
+	memset(table, 0, sizeof(*table));
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+	    fread(header, sizeof(header), 1, fp) != 1 ||
+	    memcmp(magic, FONT_GLYPHS_MAGIC, 4) != 0 ||
+	    header[0] != FONT_GLYPHS_VERSION || header[1] > INT16_MAX) {
+		fclose(fp);
+		return -1;
+	}
+	table->glyph_count = header[1];
+	table->line_height = header[2];
+	table->atlas_width = header[3];
+	table->atlas_height = header[4];
+	table->glyphs =
+	    sh2ckMemoryAlloc(sizeof(*table->glyphs) * (table->glyph_count + 1));
+	if (table->glyphs == NULL) {
+		fclose(fp);
+		return -1;
+	}
+	for (int i = 0; i < table->glyph_count; i++) {
+		int16_t fields[FONT_GLYPH_FIELDS];
+		if (fread(fields, sizeof(fields), 1, fp) != 1) {
+			fclose(fp);
+			sh2ckFontDeleteGlyphTable(table);
+			return -1;
+		}
+		struct Glyph *glyph = &table->glyphs[i];
+		glyph->x = fields[0];
+		glyph->y = fields[1];
+		glyph->width = fields[2];
+		glyph->height = fields[3];
+		glyph->bearing_x = fields[4];
+		glyph->bearing_y = fields[5];
+		glyph->advance = fields[6];
+	}
+	fclose(fp);
+	return 0;
+}
+
+void sh2ckFontDeleteGlyphTable(struct GlyphTable *table)
+{
+	if (table != NULL) {
+		sh2ckMemoryFree(table->glyphs);
+		table->glyphs = NULL;
+		table->glyph_count = 0;
+	}
+}
@@ -0,0 +1,85 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_FONT_H
+#define SH2CK_FONT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Metrics of the glyphs of a font packed into one atlas. The file starts
+ * with FONT_GLYPHS_MAGIC, the version, the glyph count, the line height and
+ * the atlas width and height as uint32, followed by one struct Glyph per
+ * image of the font, in the order of the gm1 file, as eight int16.*/
+
+#define FONT_GLYPHS_MAGIC "SH2G"
+#define FONT_GLYPHS_VERSION 1
+
+struct Gm1;
+struct Sh2ckImageList;
+struct Sh2ckOffset;
+struct Sh2ckRect;
+
+struct Glyph {
+	/*trimmed glyph in the atlas, 0 wide and high if it has no pixels*/
+	int16_t x;
+	int16_t y;
+	int16_t width;
+	int16_t height;
+	/*top left corner of the trimmed glyph, relative to the pen position
+	 * at the top of the line*/
+	int16_t bearing_x;
+	int16_t bearing_y;
+	/*distance to the pen position of the next glyph*/
+	int16_t advance;
+};
+
+struct GlyphTable {
+	int glyph_count;
+	int line_height;
+	int atlas_width;
+	int atlas_height;
+	struct Glyph *glyphs;
+};
+
+/*trims every glyph to its visible pixels, the offsets of the trimmed images
+ * in the source images are stored in offsets*/
+void sh2ckFontTrimGlyphs(struct Sh2ckImageList *image_list,
+                         struct Sh2ckOffset *offsets);
+
+/*image_list has to be trimmed with sh2ckFontTrimGlyphs and laid out into an
+ * atlas of atlas_size. The vertical offset of every glyph is taken from the
+ * tile_position_y of its image header.*/
+int sh2ckFontCreateGlyphTable(struct GlyphTable *table, const struct Gm1 *gm1,
+                              const struct Sh2ckImageList *image_list,
+                              const struct Sh2ckOffset *offsets,
+                              const struct Sh2ckRect *atlas_size);
+
+int sh2ckFontSaveGlyphTable(const struct GlyphTable *table, const char *file);
+
+int sh2ckFontLoadGlyphTable(struct GlyphTable *table, const char *file);
+
+void sh2ckFontDeleteGlyphTable(struct GlyphTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_FONT_H
@@ -16,29 +16,33 @@
  */
 
 #include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "gm1.h"
 #include "image.h"
+#include "io.h"
+#include "memory.h"
+#include "sprite.h"
 #include "tgx.h"
-int gm1CreateFromFile(struct Gm1 *gm1, const char *file)
+#include "thread.h"
+
+static void gm1Init(struct Gm1 *gm1)
 {
-	FILE *fp = fopen(file, "rb");
-	if (fp == NULL) {
-		return -1;
-	}
-	if (fseek(fp, 0, SEEK_END)) {
-		fclose(fp);
-		return -1;
-	}
-	int file_size = ftell(fp);
-	if (file_size == 0) {
-		fclose(fp);
-		return -1;
-	}
-	fseek(fp, 0, SEEK_SET);
+	gm1->palette = NULL;
+	gm1->image_offset_list = NULL;
+	gm1->image_size_list = NULL;
+	gm1->image_headers = NULL;
+	gm1->image_data = NULL;
+	gm1->image_data_size = 0;
+}
 
+/*reads everything in front of the image data, on error the caller has to
+ * clean up with sh2ckGm1Delete*/
+static int gm1ReadHeaders(struct Gm1 *gm1, FILE *fp)
+{
 	/*read gm1 file header*/
 	if (fread(&gm1->header.unknown1, sizeof(gm1->header.unknown1), 1, fp) < 1 ||
 	    fread(&gm1->header.unknown2, sizeof(gm1->header.unknown2), 1, fp) < 1 ||
@@ -90,50 +94,45 @@ int gm1CreateFromFile(struct Gm1 *gm1, const char *file)
 
 	    fread(&gm1->header.unknown18, sizeof(gm1->header.unknown18), 1, fp) <
 	        1) {
-		gm1Delete(gm1);
-		fclose(fp);
 		return -1;
 	}
 
 	/* read palette*/
-	gm1->palette =
-	    malloc(sizeof(*gm1->palette) * GM1_PALETTE_SIZE * GM1_PALETTE_COUNT);
+	gm1->palette = sh2ckMemoryAlloc(sizeof(*gm1->palette) * GM1_PALETTE_SIZE *
+	                                GM1_PALETTE_COUNT);
 	if (gm1->palette == NULL) {
-		gm1Delete(gm1);
-		fclose(fp);
 		return -1;
 	}
-	fread(gm1->palette, sizeof(*gm1->palette),
-	      GM1_PALETTE_SIZE * GM1_PALETTE_COUNT, fp);
+	if (fread(gm1->palette, sizeof(*gm1->palette),
+	          GM1_PALETTE_SIZE * GM1_PALETTE_COUNT,
+	          fp) < GM1_PALETTE_SIZE * GM1_PALETTE_COUNT) {
+		return -1;
+	}
 
-	gm1->image_offset_list =
-	    malloc(sizeof(*(gm1->image_offset_list)) * gm1->header.image_count);
+	gm1->image_offset_list = sh2ckMemoryAlloc(
+	    sizeof(*(gm1->image_offset_list)) * gm1->header.image_count);
 	if (gm1->image_offset_list == NULL) {
-		gm1Delete(gm1);
-		fclose(fp);
 		return -1;
 	}
 
-	for (unsigned int i = 0; i < gm1->header.image_count; i++) {
-		fread(&gm1->image_offset_list[i], sizeof(*(gm1->image_offset_list)), 1,
-		      fp);
+	if (fread(gm1->image_offset_list, sizeof(*(gm1->image_offset_list)),
+	          gm1->header.image_count, fp) < gm1->header.image_count) {
+		return -1;
 	}
 
-	gm1->image_size_list =
-	    malloc(sizeof(*(gm1->image_size_list)) * gm1->header.image_count);
+	gm1->image_size_list = sh2ckMemoryAlloc(sizeof(*(gm1->image_size_list)) *
+	                                        gm1->header.image_count);
 	if (gm1->image_size_list == NULL) {
-		gm1Delete(gm1);
-		fclose(fp);
 		return -1;
 	}
-	for (unsigned int i = 0; i < gm1->header.image_count; i++) {
-		fread(&gm1->image_size_list[i], sizeof(*(gm1->image_size_list)), 1, fp);
+	if (fread(gm1->image_size_list, sizeof(*(gm1->image_size_list)),
+	          gm1->header.image_count, fp) < gm1->header.image_count) {
+		return -1;
 	}
 
-	gm1->image_headers =
-	    malloc(sizeof(*(gm1->image_headers)) * gm1->header.image_count);
+	gm1->image_headers = sh2ckMemoryAlloc(sizeof(*(gm1->image_headers)) *
+	                                      gm1->header.image_count);
 	if (gm1->image_headers == NULL) {
-		gm1Delete(gm1);
 		return -1;
 	}
 
@@ -161,16 +160,42 @@ int gm1CreateFromFile(struct Gm1 *gm1, const char *file)
 		          sizeof(gm1->image_headers[i].drawing_box_width), 1, fp) < 1 ||
 		    fread(&gm1->image_headers[i].performance_id,
 		          sizeof(gm1->image_headers[i].performance_id), 1, fp) < 1) {
-			gm1Delete(gm1);
-			fclose(fp);
 			return -1;
 		}
 	}
+	return 0;
+}
+
+int sh2ckGm1CreateFromFile(struct Gm1 *gm1, const char *file)
+{
+	gm1Init(gm1);
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return -1;
+	}
+	int file_size = ftell(fp);
+	if (file_size == 0) {
+		fclose(fp);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_SET);
+
+	if (gm1ReadHeaders(gm1, fp) == -1) {
+		sh2ckGm1Delete(gm1);
+		fclose(fp);
+		return -1;
+	}
 
 	int file_position = ftell(fp);
-	gm1->image_data = (uint8_t *)malloc(file_size - file_position);
+	gm1->image_data_size = file_size - file_position;
+	gm1->image_data = (uint8_t *)sh2ckMemoryAlloc(file_size - file_position);
 	if (gm1->image_data == NULL) {
-		gm1Delete(gm1);
+		sh2ckGm1Delete(gm1);
 		fclose(fp);
 		return -1;
 	}
@@ -178,71 +203,73 @@ int gm1CreateFromFile(struct Gm1 *gm1, const char *file)
 	if (file_size - file_position < gm1->header.data_size ||
 	    fread(gm1->image_data, sizeof(*gm1->image_data),
 	          file_size - file_position, fp) < file_size - file_position) {
-		gm1Delete(gm1);
+		sh2ckGm1Delete(gm1);
 		fclose(fp);
 		return -1;
 	}
 
+	fclose(fp);
 	return 0;
 }
 
-void gm1Delete(struct Gm1 *gm1)
+void sh2ckGm1Delete(struct Gm1 *gm1)
 {
 	if (gm1 != NULL) {
-		free(gm1->palette);
-		free(gm1->image_offset_list);
-		free(gm1->image_size_list);
-		free(gm1->image_headers);
-		free(gm1->image_data);
+		sh2ckMemoryFree(gm1->palette);
+		sh2ckMemoryFree(gm1->image_offset_list);
+		sh2ckMemoryFree(gm1->image_size_list);
+		sh2ckMemoryFree(gm1->image_headers);
+		sh2ckMemoryFree(gm1->image_data);
+		gm1->palette = NULL;
+		gm1->image_offset_list = NULL;
+		gm1->image_size_list = NULL;
+		gm1->image_headers = NULL;
+		gm1->image_data = NULL;
 	}
 }
 
-static int decodeTile(struct Image *image, uint8_t *data, struct Pos *offset)
+/*first column and width of every row of the tile diamond, the tile data
+ * stores the rows one after another*/
+struct TileSpan {
+	uint8_t x;
+	uint8_t width;
+};
+
+static const struct TileSpan tile_spans[GM1_TILE_HEIGHT] = {
+    {14, 2},  {12, 6},  {10, 10}, {8, 14}, {6, 18}, {4, 22},
+    {2, 26},  {0, 30},  {0, 30},  {2, 26}, {4, 22}, {6, 18},
+    {8, 14},  {10, 10}, {12, 6},  {14, 2}};
+
+/*converts count 16 bit pixels, each pixel is built as one word like in
+ * sh2ckImageClear so the compiler can vectorize the loop*/
+static void convertPixels(struct Sh2ckColor *restrict pixel,
+                          const uint8_t *restrict data, int count)
 {
-	int i = 0;
-	int j = 2;
-	int x = 0;
-	int y = offset->y;
-	uint16_t color = 0x0;
-
-	while (y < offset->y + GM1_TILE_HEIGHT / 2) {
-		x = offset->x + GM1_TILE_WIDTH / 2 - j / 2;
-		while (x < offset->x + GM1_TILE_WIDTH / 2 + j / 2) {
-			color = data[i];
-			i++;
-			color |= (data[i] << 8);
-			i++;
-			image->pixel[y * image->width + x].a = 0xFF;
-			image->pixel[y * image->width + x].r = COLOR_CONVERT_RED(color);
-			image->pixel[y * image->width + x].g = COLOR_CONVERT_GREEN(color);
-			image->pixel[y * image->width + x].b = COLOR_CONVERT_BLUE(color);
-			x++;
-		}
-		j += 4;
-		y++;
-	}
-	j = 30;
-	x = 0;
-	while (y < offset->y + GM1_TILE_HEIGHT) {
-		x = offset->x + GM1_TILE_WIDTH / 2 - j / 2;
-		while (x < offset->x + GM1_TILE_WIDTH / 2 + j / 2) {
-			color = data[i];
-			i++;
-			color |= (data[i] << 8);
-			i++;
-			image->pixel[y * image->width + x].a = 0xFF;
-			image->pixel[y * image->width + x].r = COLOR_CONVERT_RED(color);
-			image->pixel[y * image->width + x].g = COLOR_CONVERT_GREEN(color);
-			image->pixel[y * image->width + x].b = COLOR_CONVERT_BLUE(color);
-			x++;
-		}
-		j -= 4;
-		y++;
+	for (int i = 0; i < count; i++) {
+		uint32_t color = data[2 * i] | (data[2 * i + 1] << 8);
+		uint32_t word = 0xFF000000 | ((color & SH2CK_COLOR_MASK_RED) << 9) |
+		                ((color & SH2CK_COLOR_MASK_GREEN) << 6) |
+		                ((color & SH2CK_COLOR_MASK_BLUE) << 3);
+		memcpy(&pixel[i], &word, sizeof(word));
+	}
+}
+
+static int decodeTile(struct Sh2ckImage *image, uint8_t *data,
+                      struct Sh2ckPos *offset)
+{
+	struct Sh2ckColor *row =
+	    image->pixel + offset->y * image->width + offset->x;
+
+	for (int y = 0; y < GM1_TILE_HEIGHT; y++) {
+		const struct TileSpan *span = &tile_spans[y];
+		convertPixels(row + span->x, data, span->width);
+		data += span->width * 2;
+		row += image->width;
 	}
 	return 0;
 }
 
-static int decodeTgxAndTile(struct Image *image, struct Rect *rect,
+static int decodeTgxAndTile(struct Sh2ckImage *image, struct Sh2ckRect *rect,
                             struct Gm1ImageHeader *header, uint8_t *data,
                             int size)
 {
@@ -250,65 +277,104 @@ static int decodeTgxAndTile(struct Image *image, struct Rect *rect,
 		return -1;
 	}
 	if (size > 512) {
-		struct Rect rect2 = {rect->x + header->horizontal_offset, rect->y,
-		                     rect->width - header->horizontal_offset,
-		                     rect->height};
-		if (tgxDecode(image, &rect2, data + 512, size - 512, NULL) == -1) {
+		struct Sh2ckRect rect2 = {rect->x + header->horizontal_offset, rect->y,
+		                          rect->width - header->horizontal_offset,
+		                          rect->height};
+		if (sh2ckTgxDecode(image, &rect2, data + 512, size - 512, NULL) == -1) {
 			return -1;
 		}
 	}
 
-	struct Pos offset = {rect->x, rect->y + header->tile_position_y};
+	struct Sh2ckPos offset = {rect->x, rect->y + header->tile_position_y};
 	return decodeTile(image, data, &offset);
 }
 
-static int decodeBitmap(struct Image *image, int width, int height,
-                        uint8_t *data, int size)
+static int decodeBitmap(struct Sh2ckImage *image, uint8_t *data, int size)
 {
-	int i = 0;
-	int j = 0;
-	uint16_t color = 0;
-	image->width = width;
-	image->height = height;
-	image->pitch = width;
-	image->pixel = malloc(sizeof(*image->pixel) * width * height);
+	int pixel_count = image->width * image->height;
 
-	if (image->pixel == NULL) {
-		return -1;
+	if (pixel_count > size / 2) {
+		pixel_count = size / 2;
 	}
+	convertPixels(image->pixel, data, pixel_count);
+	return 0;
+}
 
-	while (i < size) {
-		color = data[i];
-		i++;
-		color |= (data[i] << 8);
-		i++;
-		image->pixel[j].a = 0xFF;
-		image->pixel[j].r = COLOR_CONVERT_RED(color);
-		image->pixel[j].g = COLOR_CONVERT_GREEN(color);
-		image->pixel[j].b = COLOR_CONVERT_BLUE(color);
-		j++;
+/*size of an image as stored in the file, tile parts are not assembled*/
+static void imageSize(struct Gm1 *gm1, int index, int *width, int *height)
+{
+	if (gm1->header.data_type == GM1_DATA_TGX_AND_TILE) {
+		*width = GM1_TILE_WIDTH;
+	} else {
+		*width = gm1->image_headers[index].image_width;
+	}
+	*height = gm1->image_headers[index].image_height;
+}
+
+static int decodeImage(struct Sh2ckImage *image, struct Gm1 *gm1, int index,
+                       int palette, uint8_t *data)
+{
+	struct Gm1ImageHeader *header = &gm1->image_headers[index];
+	int size = gm1->image_size_list[index];
+	struct Sh2ckRect rect = {0, 0, image->width, image->height};
+
+	switch (gm1->header.data_type) {
+		case GM1_DATA_TGX_AND_TILE:
+			sh2ckImageClear(image, 0x00);
+			return decodeTgxAndTile(image, &rect, header, data, size);
+		case GM1_DATA_TGX:
+		case GM1_DATA_TGX_FONT:
+		case GM1_DATA_TGX_CONST_SIZE:
+			return sh2ckTgxDecode(image, &rect, data, size, NULL);
+		case GM1_DATA_ANIMATION:
+			return sh2ckTgxDecode(image, &rect, data, size,
+			                      gm1->palette + palette * GM1_PALETTE_SIZE);
+		case GM1_DATA_BITMAP:
+		case GM1_DATA_BITMAP_OTHER:
+			return decodeBitmap(image, data, size);
+		default:
+			return -1;
 	}
-	return 0;
 }
 
-int gm1CreateTileObjectList(struct ImageList *image_list, int pixel_buffer_size,
-                            struct Gm1 *gm1)
+static int countObjects(struct Gm1 *gm1)
 {
 	int object_count = 0;
-	struct TileObjectList *object_list = NULL;
 	for (int i = 0; i < gm1->header.image_count; i++) {
 		if (gm1->image_headers[i].part == gm1->image_headers[i].parts - 1) {
 			object_count++;
 		}
 	}
+	return object_count;
+}
 
-	if (imageCreateList(image_list, pixel_buffer_size, object_count,
-	                    object_count, gm1->header.image_count,
-	                    IMAGE_TYPE_TILE) == -1) {
+static void imageInfo(struct Sh2ckImage *image, int width, int height)
+{
+	image->x = 0;
+	image->y = 0;
+	image->width = width;
+	image->height = height;
+	image->pitch = width;
+	image->pixel = NULL;
+}
+
+/*fills the tile object list and the image sizes, no pixels are decoded*/
+static int tileObjectListInfo(struct Sh2ckImageList *image_list,
+                              int pixel_buffer_size, struct Gm1 *gm1,
+                              unsigned int assemble)
+{
+	int object_count = countObjects(gm1);
+	struct Sh2ckTileObjectList *object_list = NULL;
+
+	if (sh2ckImageCreateList(image_list, pixel_buffer_size,
+	                         assemble ? object_count : gm1->header.image_count,
+	                         object_count, gm1->header.image_count,
+	                         SH2CK_IMAGE_TYPE_TILE) == -1) {
 		return -1;
 	}
 
-	object_list = (struct TileObjectList *)image_list->data;
+	object_list = (struct Sh2ckTileObjectList *)image_list->data;
+	object_list->assembled = assemble != 0;
 
 	int tile_start = 0;
 	int tile = 0;
@@ -328,9 +394,10 @@ int gm1CreateTileObjectList(struct ImageList *image_list, int pixel_buffer_size,
 		int x = 0;
 		int y = 0;
 
-		if (tileObjectCreate(&object_list->objects[j], part_count,
-		                     tile_start) == -1) {
-			tileObjectDeleteList(object_list);
+		if (j >= object_count || i + part_count > gm1->header.image_count ||
+		    sh2ckTileObjectCreate(&object_list->objects[j], part_count,
+		                          tile_start) == -1) {
+			sh2ckImageDeleteList(image_list);
 			return -1;
 		}
 		tile_start += part_count;
@@ -338,21 +405,34 @@ int gm1CreateTileObjectList(struct ImageList *image_list, int pixel_buffer_size,
 
 		while (part < part_count) {
 			if (xtile < current_length) {
-				y = ytile * GM1_TILE_HEIGHT / 2;
-				x = (image_width / 2) -
-				    current_length * (GM1_TILE_WIDTH + 2) / 2 +
-				    xtile * (GM1_TILE_WIDTH + 2) + 1;
-				object_list->tiles[tile].id = part;
-				object_list->tiles[tile].x = xtile;
-				object_list->tiles[tile].y = ytile;
-				object_list->tiles[tile].rect.width = GM1_TILE_WIDTH;
-				object_list->tiles[tile].rect.height =
-				    gm1->image_headers[i].image_height;
-				object_list->tiles[tile].rect.x = x;
-				object_list->tiles[tile].rect.y = y;
-				height = y + gm1->image_headers[i].image_height;
-				if (height > image_height) {
-					image_height = height;
+				struct Sh2ckTilePart *tile_part = &object_list->tiles[tile];
+				tile_part->id = part;
+				tile_part->x = xtile;
+				tile_part->y = ytile;
+				tile_part->rect.width = GM1_TILE_WIDTH;
+				tile_part->rect.height = gm1->image_headers[i].image_height;
+				tile_part->elevation = gm1->image_headers[i].tile_position_y;
+				/*rows grow by one tile until the middle of the diamond*/
+				tile_part->grid.x = ytile < max_length
+				                        ? xtile
+				                        : ytile - max_length + 1 + xtile;
+				tile_part->grid.y = ytile - tile_part->grid.x;
+				if (assemble) {
+					y = ytile * GM1_TILE_HEIGHT / 2;
+					x = (image_width / 2) -
+					    current_length * (GM1_TILE_WIDTH + 2) / 2 +
+					    xtile * (GM1_TILE_WIDTH + 2) + 1;
+					tile_part->rect.x = x;
+					tile_part->rect.y = y;
+					height = y + gm1->image_headers[i].image_height;
+					if (height > image_height) {
+						image_height = height;
+					}
+				} else {
+					tile_part->rect.x = 0;
+					tile_part->rect.y = 0;
+					imageInfo(&image_list->images[i], GM1_TILE_WIDTH,
+					          gm1->image_headers[i].image_height);
 				}
 				xtile++;
 				i++;
@@ -369,235 +449,304 @@ int gm1CreateTileObjectList(struct ImageList *image_list, int pixel_buffer_size,
 			}
 		}
 
-		if (imageCreate(&image_list->images[j], image_list, image_width,
-		                image_height) == -1) {
-			tileObjectDeleteList(object_list);
-			return -1;
-		}
-		j++;
-	}
-
-	int k = 0;
-	for (j = 0; j < object_list->object_count; j++) {
-		imageClear(&image_list->images[j], 0x00);
-		for (i = 0; i < object_list->objects[j].part_count; i++) {
-			object_list->tiles[k].rect.y =
-			    (image_list->images[j].height -
-			     (object_list->tiles[k].rect.y +
-			      object_list->tiles[k].rect.height));
-
-			if (decodeTgxAndTile(&image_list->images[j],
-			                     &object_list->tiles[k].rect,
-			                     &gm1->image_headers[k],
-			                     gm1->image_data + gm1->image_offset_list[k],
-			                     gm1->image_size_list[k]) == -1) {
-				tileObjectDeleteList(object_list);
-				return -1;
+		if (assemble) {
+			/*tiles are placed from the bottom of the object image*/
+			for (int k = tile - part_count; k < tile; k++) {
+				object_list->tiles[k].rect.y =
+				    image_height - (object_list->tiles[k].rect.y +
+				                    object_list->tiles[k].rect.height);
 			}
-			k++;
+			imageInfo(&image_list->images[j], image_width, image_height);
 		}
+		for (int k = tile - part_count; k < tile; k++) {
+			struct Sh2ckTilePart *tile_part = &object_list->tiles[k];
+			tile_part->footprint.x = tile_part->rect.x;
+			tile_part->footprint.y = tile_part->rect.y + tile_part->elevation;
+			tile_part->footprint.width = GM1_TILE_WIDTH;
+			tile_part->footprint.height = GM1_TILE_HEIGHT;
+		}
+		j++;
 	}
 
 	return 0;
 }
 
-int gm1CreateUnAssembledTileObjectList(struct ImageList *image_list,
-                                       int pixel_buffer_size, struct Gm1 *gm1)
+int sh2ckGm1CreateImageListInfo(struct Sh2ckImageList *image_list,
+                                int pixel_buffer_size, struct Gm1 *gm1,
+                                unsigned int assemble)
 {
+	int type = SH2CK_IMAGE_TYPE_OTHER;
 	int object_count = 0;
-	struct TileObjectList *object_list = NULL;
-	for (int i = 0; i < gm1->header.image_count; i++) {
-		if (gm1->image_headers[i].part == gm1->image_headers[i].parts - 1) {
-			object_count++;
-		}
+
+	switch (gm1->header.data_type) {
+		case GM1_DATA_TGX_AND_TILE:
+			return tileObjectListInfo(image_list, pixel_buffer_size, gm1,
+			                          assemble);
+		case GM1_DATA_ANIMATION:
+			type = SH2CK_IMAGE_TYPE_ANIMATION;
+			object_count = gm1->header.image_count;
+			break;
+		case GM1_DATA_TGX:
+		case GM1_DATA_TGX_FONT:
+		case GM1_DATA_TGX_CONST_SIZE:
+		case GM1_DATA_BITMAP:
+		case GM1_DATA_BITMAP_OTHER:
+			break;
+		default:
+			return -1;
 	}
 
-	if (imageCreateList(image_list, pixel_buffer_size, gm1->header.image_count,
-	                    object_count, gm1->header.image_count,
-	                    IMAGE_TYPE_TILE) == -1) {
+	if (sh2ckImageCreateList(image_list, pixel_buffer_size,
+	                         gm1->header.image_count, object_count, 0, type)) {
 		return -1;
 	}
-
-	object_list = (struct TileObjectList *)image_list->data;
-
-	int tile_start = 0;
-	int tile = 0;
-	int i = 0;
-	int j = 0;
-	while (i < gm1->header.image_count) {
-		int part_count = gm1->image_headers[i].parts;
-		int part = 0;
-		int max_length = sqrt(part_count);
-		int current_length = 1;
-		int xtile = 0;
-		int ytile = 0;
-
-		if (tileObjectCreate(&object_list->objects[j], part_count,
-		                     tile_start) == -1) {
-			tileObjectDeleteList(object_list);
-			return -1;
+	for (int i = 0; i < image_list->image_count; i++) {
+		int width = 0;
+		int height = 0;
+		imageSize(gm1, i, &width, &height);
+		imageInfo(&image_list->images[i], width, height);
+	}
+	if (type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		struct Sh2ckAnimation *animation =
+		    (struct Sh2ckAnimation *)image_list->data;
+		for (int i = 0; i < image_list->image_count; i++) {
+			animation->frames[i].id = i;
+			animation->frames[i].center.x = gm1->header.center_x;
+			animation->frames[i].center.y = gm1->header.center_y;
 		}
-		tile_start += part_count;
-		object_list->objects[j].id = j;
+	}
+	return 0;
+}
 
-		while (part < part_count) {
-			if (xtile < current_length) {
-				object_list->tiles[tile].id = part;
-				object_list->tiles[tile].x = xtile;
-				object_list->tiles[tile].y = ytile;
-				object_list->tiles[tile].rect.width = GM1_TILE_WIDTH;
-				object_list->tiles[tile].rect.height =
-				    gm1->image_headers[i].image_height;
-				object_list->tiles[tile].rect.x = 0;
-				object_list->tiles[tile].rect.y = 0;
-
-				if (imageCreate(&image_list->images[i], image_list,
-				                GM1_TILE_WIDTH,
-				                gm1->image_headers[i].image_height) == -1) {
-					tileObjectDeleteList(object_list);
-					return -1;
-				}
+static int checkImageData(struct Gm1 *gm1, int index)
+{
+	if (gm1->image_offset_list[index] > gm1->image_data_size ||
+	    gm1->image_size_list[index] >
+	        gm1->image_data_size - gm1->image_offset_list[index]) {
+		return -1;
+	}
+	return 0;
+}
 
-				xtile++;
-				i++;
-				part++;
-				tile++;
-			} else {
-				xtile = 0;
-				ytile++;
-				if (ytile < max_length) {
-					current_length++;
-				} else {
-					current_length--;
-				}
+int sh2ckGm1DecodeListImage(struct Sh2ckImageList *image_list, struct Gm1 *gm1,
+                            int index, int palette, struct Sh2ckImage *image)
+{
+	struct Sh2ckImage *info = &image_list->images[index];
+	image->x = info->x;
+	image->y = info->y;
+	image->width = info->width;
+	image->height = info->height;
+	image->pitch = info->width;
+
+	if (image_list->type == SH2CK_IMAGE_TYPE_TILE &&
+	    ((struct Sh2ckTileObjectList *)image_list->data)->assembled) {
+		struct Sh2ckTileObjectList *object_list = image_list->data;
+		struct Sh2ckTileObject *object = &object_list->objects[index];
+		sh2ckImageClear(image, 0x00);
+		for (int k = object->tile_start;
+		     k < object->tile_start + object->part_count; k++) {
+			if (checkImageData(gm1, k) == -1 ||
+			    decodeTgxAndTile(image, &object_list->tiles[k].rect,
+			                     &gm1->image_headers[k],
+			                     gm1->image_data + gm1->image_offset_list[k],
+			                     gm1->image_size_list[k]) == -1) {
+				return -1;
 			}
 		}
+		return 0;
+	}
 
-		j++;
+	if (checkImageData(gm1, index) == -1) {
+		return -1;
 	}
+	return decodeImage(image, gm1, index, palette,
+	                   gm1->image_data + gm1->image_offset_list[index]);
+}
 
-	for (i = 0; i < image_list->image_count; i++) {
-		struct Rect rect = {0, 0, image_list->images[i].width,
-			                image_list->images[i].height};
-		imageClear(&image_list->images[i], 0x00);
-		if (decodeTgxAndTile(&image_list->images[i], &rect,
-		                     &gm1->image_headers[i],
-		                     gm1->image_data + gm1->image_offset_list[i],
-		                     gm1->image_size_list[i]) == -1) {
-			tileObjectDeleteList(object_list);
-			return -1;
-		}
+struct DecodeItem {
+	int size;
+	int image;
+};
+
+struct DecodeTask {
+	struct Sh2ckImageList *image_list;
+	struct Gm1 *gm1;
+	int palette;
+	/*images by decreasing size*/
+	struct DecodeItem *items;
+	atomic_int failed;
+};
+
+static int decodeItemCmp(const void *a, const void *b)
+{
+	const struct DecodeItem *item_a = a;
+	const struct DecodeItem *item_b = b;
+	if (item_a->size != item_b->size) {
+		return item_b->size - item_a->size;
 	}
+	return item_a->image - item_b->image;
+}
 
-	return 0;
+static void decodeTaskImage(void *context, int index)
+{
+	struct DecodeTask *task = context;
+	int image = task->items[index].image;
+	if (sh2ckGm1DecodeListImage(task->image_list, task->gm1, image,
+	                            task->palette,
+	                            &task->image_list->images[image]) == -1) {
+		atomic_store(&task->failed, 1);
+	}
 }
 
-int gm1CreateAnimation(struct ImageList *image_list, int pixel_buffer_size,
-                       struct Gm1 *gm1, int palette)
+/*Every image, or assembled object, only writes its own pixels, so they are
+ * decoded in parallel. The largest go first so a big keep at the end of the
+ * file does not leave the other threads waiting.*/
+static int decodeImages(struct Sh2ckImageList *image_list, struct Gm1 *gm1,
+                        int palette, struct Sh2ckThreadPool *pool)
 {
-	struct Animation *animation;
-	if (imageCreateList(image_list, pixel_buffer_size, gm1->header.image_count,
-	                    gm1->header.image_count, 0, IMAGE_TYPE_ANIMATION)) {
+	struct DecodeTask task = {image_list, gm1, palette, NULL, 0};
+	task.items =
+	    sh2ckMemoryAlloc(sizeof(*task.items) * (image_list->image_count + 1));
+	if (task.items == NULL) {
 		return -1;
 	}
-	animation = (struct Animation *)image_list->data;
 	for (int i = 0; i < image_list->image_count; i++) {
-		if (tgxCreateImage(&(image_list->images[i]),
-		                   gm1->image_headers[i].image_width,
-		                   gm1->image_headers[i].image_height,
-		                   gm1->image_data + gm1->image_offset_list[i],
-		                   gm1->image_size_list[i],
-		                   gm1->palette + palette * GM1_PALETTE_SIZE) == -1) {
-			imageDeleteList(image_list);
+		struct Sh2ckImage *image = &image_list->images[i];
+		task.items[i].size = image->width * image->height;
+		task.items[i].image = i;
+	}
+	qsort(task.items, image_list->image_count, sizeof(*task.items),
+	      decodeItemCmp);
+	sh2ckThreadPoolParallelFor(pool, image_list->image_count, decodeTaskImage,
+	                           &task);
+	sh2ckMemoryFree(task.items);
+	return atomic_load(&task.failed) ? -1 : 0;
+}
+
+static int createImageList(struct Sh2ckImageList *image_list,
+                           int pixel_buffer_size, struct Gm1 *gm1, int palette,
+                           unsigned int assemble, struct Sh2ckThreadPool *pool)
+{
+	if (sh2ckGm1CreateImageListInfo(image_list, 0, gm1, assemble) == -1) {
+		return -1;
+	}
+	if (pixel_buffer_size == 0) {
+		pixel_buffer_size = sh2ckImageListPixelSize(image_list);
+	}
+	if (sh2ckImageListAllocatePixels(image_list, pixel_buffer_size) == -1) {
+		sh2ckImageDeleteList(image_list);
+		return -1;
+	}
+	if (sh2ckThreadPoolThreadCount(pool) > 1) {
+		if (decodeImages(image_list, gm1, palette, pool) == -1) {
+			sh2ckImageDeleteList(image_list);
+			return -1;
+		}
+		return 0;
+	}
+	for (int i = 0; i < image_list->image_count; i++) {
+		if (sh2ckGm1DecodeListImage(image_list, gm1, i, palette,
+		                            &image_list->images[i]) == -1) {
+			sh2ckImageDeleteList(image_list);
 			return -1;
 		}
-		animation->frames[i].id = i;
-		animation->frames[i].center.x = gm1->header.center_x;
-		animation->frames[i].center.y = gm1->header.center_y;
 	}
 	return 0;
 }
 
-int gm1CreateImageList(struct ImageList *image_list, int pixel_buffer_size,
-                       struct Gm1 *gm1, int palette, unsigned int assemble)
+int sh2ckGm1EncodeListSprite(struct Sh2ckImageList *image_list, struct Gm1 *gm1,
+                             int index, struct Sh2ckImage *image,
+                             struct Sprite *sprite)
 {
+	struct Sh2ckImage *info = &image_list->images[index];
 	switch (gm1->header.data_type) {
-		case GM1_DATA_TGX_AND_TILE:
-		    if (assemble != 0) {
-				if (gm1CreateTileObjectList(image_list, pixel_buffer_size,
-				                            gm1) == -1) {
-					return -1;
-				}
-			} else {
-				if (gm1CreateUnAssembledTileObjectList(
-				        image_list, pixel_buffer_size, gm1) == -1) {
-					return -1;
-				}
-			}
-		    break;
 		case GM1_DATA_TGX:
 		case GM1_DATA_TGX_FONT:
 		case GM1_DATA_TGX_CONST_SIZE:
-		    if (imageCreateList(image_list, pixel_buffer_size,
-			                    gm1->header.image_count, 0, 0,
-			                    IMAGE_TYPE_OTHER)) {
-				return -1;
-			}
-			for (int i = 0; i < image_list->image_count; i++) {
-				if (tgxCreateImage(&(image_list->images[i]),
-				                   gm1->image_headers[i].image_width,
-				                   gm1->image_headers[i].image_height,
-				                   gm1->image_data + gm1->image_offset_list[i],
-				                   gm1->image_size_list[i], NULL) == -1) {
-					imageDeleteList(image_list);
-					return -1;
-				}
-			}
-			break;
 		case GM1_DATA_ANIMATION:
-		    if (gm1CreateAnimation(image_list, pixel_buffer_size, gm1,
-			                       palette) == -1) {
+			if (checkImageData(gm1, index) == -1) {
 				return -1;
 			}
-			break;
-		case GM1_DATA_BITMAP:
-		case GM1_DATA_BITMAP_OTHER:
-		    if (imageCreateList(image_list, pixel_buffer_size,
-			                    gm1->header.image_count, 0, 0,
-			                    IMAGE_TYPE_OTHER)) {
+			return sh2ckSpriteEncodeTgx(
+			    sprite, info->width, info->height,
+			    gm1->image_data + gm1->image_offset_list[index],
+			    gm1->image_size_list[index],
+			    gm1->header.data_type == GM1_DATA_ANIMATION);
+		default:
+			if (sh2ckGm1DecodeListImage(image_list, gm1, index, 0,
+			                            image) == -1) {
 				return -1;
 			}
-			for (int i = 0; i < image_list->image_count; i++) {
-				if (decodeBitmap(&(image_list->images[i]),
-				                 gm1->image_headers[i].image_width,
-				                 gm1->image_headers[i].image_height,
-				                 gm1->image_data + gm1->image_offset_list[i],
-				                 gm1->image_size_list[i]) == -1) {
-					imageDeleteList(image_list);
-					return -1;
-				}
-			}
-			break;
-		default:
-			return -1;
-			break;
+			return sh2ckSpriteEncodeImage(sprite, image);
 	}
-	return 0;
 }
 
-int gm1SaveHeader(struct Gm1 *gm1, const char *file)
+int sh2ckGm1CreateTileObjectList(struct Sh2ckImageList *image_list,
+                                 int pixel_buffer_size, struct Gm1 *gm1)
+{
+	return createImageList(image_list, pixel_buffer_size, gm1, 0, 1, NULL);
+}
+
+int sh2ckGm1CreateUnAssembledTileObjectList(struct Sh2ckImageList *image_list,
+                                            int pixel_buffer_size,
+                                            struct Gm1 *gm1)
+{
+	return createImageList(image_list, pixel_buffer_size, gm1, 0, 0, NULL);
+}
+
+int sh2ckGm1CreateAnimation(struct Sh2ckImageList *image_list,
+                            int pixel_buffer_size, struct Gm1 *gm1, int palette)
+{
+	return createImageList(image_list, pixel_buffer_size, gm1, palette, 0,
+	                       NULL);
+}
+
+int sh2ckGm1CreateImageList(struct Sh2ckImageList *image_list,
+                            int pixel_buffer_size, struct Gm1 *gm1, int palette,
+                            unsigned int assemble)
+{
+	return createImageList(image_list, pixel_buffer_size, gm1, palette,
+	                       assemble, NULL);
+}
+
+int sh2ckGm1CreateImageListParallel(struct Sh2ckImageList *image_list,
+                                    int pixel_buffer_size, struct Gm1 *gm1,
+                                    int palette, unsigned int assemble,
+                                    struct Sh2ckThreadPool *pool)
+{
+	return createImageList(image_list, pixel_buffer_size, gm1, palette,
+	                       assemble, pool);
+}
+
+const char *sh2ckGm1DataTypeName(uint32_t data_type)
 {
-	FILE *fp = fopen(file, "w");
-	if (fp == NULL) {
-		return -1;
-	}
 	const static char *data_type_lookup[] = {
 	    "TGX",    "ANIMATION",      "TGX_AND_TILE", "TGX_FONT",
 	    "BITMAP", "TGX_CONST_SIZE", "BITMAP_OTHER"};
+	if (data_type < GM1_DATA_TGX || data_type > GM1_DATA_BITMAP_OTHER) {
+		return "UNKNOWN";
+	}
+	return data_type_lookup[data_type - 1];
+}
+
+const char *sh2ckGm1SizeTypeName(uint32_t size_type)
+{
 	const static char *size_type_lookup[] = {
 	    "UNDEFINDED", "30x30",   "55x55",   "75x75",
 	    "UNKNOWN_4",  "100x100", "110x110", "130x130",
 	    "UNKNOWN_8",  "185x185", "250x250", "180x180"};
+	if (size_type > GM1_SIZE_180x180) {
+		return "UNKNOWN";
+	}
+	return size_type_lookup[size_type];
+}
+
+int sh2ckGm1SaveHeader(struct Gm1 *gm1, const char *file)
+{
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
 	fprintf(fp,
 	        "{\n\"unknown1\": %d,\n"
 	        "  \"uint32_unknown2\": %d,\n"
@@ -623,46 +772,138 @@ int gm1SaveHeader(struct Gm1 *gm1, const char *file)
 	        "  \"uint32_unknown18\": %d\n}\n",
 	        gm1->header.unknown1, gm1->header.unknown2, gm1->header.unknown3,
 	        gm1->header.image_count, gm1->header.unknown4,
-	        data_type_lookup[gm1->header.data_type - 1], gm1->header.unknown5,
-	        gm1->header.unknown6, size_type_lookup[gm1->header.size_type],
+	        sh2ckGm1DataTypeName(gm1->header.data_type), gm1->header.unknown5,
+	        gm1->header.unknown6, sh2ckGm1SizeTypeName(gm1->header.size_type),
 	        gm1->header.unknown7, gm1->header.unknown8, gm1->header.unknown9,
 	        gm1->header.width, gm1->header.height, gm1->header.unknown12,
 	        gm1->header.unknown13, gm1->header.unknown14, gm1->header.unknown15,
 	        gm1->header.center_x, gm1->header.center_y, gm1->header.data_size,
 	        gm1->header.unknown18);
-	fclose(fp);
+	sh2ckIoClose(fp);
 	return 0;
 }
 
-int gm1IsTileObject(struct Gm1 *gm1)
+/*csv doubles quotes, json (escape '\\') also escapes control characters*/
+static void printQuoted(const char *string, char escape, FILE *fp)
+{
+	fputc('"', fp);
+	for (const char *c = string; *c != '\0'; c++) {
+		unsigned char ch = *c;
+		if (escape == '\\' && ch < 0x20) {
+			if (ch == '\n') {
+				fputs("\\n", fp);
+			} else if (ch == '\t') {
+				fputs("\\t", fp);
+			} else {
+				fprintf(fp, "\\u%04x", ch);
+			}
+			continue;
+		}
+		if (ch == '"' || ch == escape) {
+			fputc(escape, fp);
+		}
+		fputc(ch, fp);
+	}
+	fputc('"', fp);
+}
+
+void sh2ckGm1PrintInfoCsvHeader(FILE *fp)
+{
+	fprintf(fp,
+	        "file,data_type,size_type,image_count,image,width,height,"
+	        "position_x,position_y,part,parts,tile_position_y,"
+	        "tile_placement_alignment,horizontal_offset,drawing_box_width,"
+	        "performance_id,offset,size\n");
+}
+
+void sh2ckGm1PrintInfo(struct Gm1 *gm1, const char *name, int format, FILE *fp)
+{
+	if (format == GM1_INFO_CSV) {
+		for (unsigned int i = 0; i < gm1->header.image_count; i++) {
+			struct Gm1ImageHeader *header = &gm1->image_headers[i];
+			printQuoted(name, '"', fp);
+			fprintf(fp,
+			        ",%s,%s,%u,%u,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%u,"
+			        "%u\n",
+			        sh2ckGm1DataTypeName(gm1->header.data_type),
+			        sh2ckGm1SizeTypeName(gm1->header.size_type),
+			        gm1->header.image_count, i, header->image_width,
+			        header->image_height, header->position_x,
+			        header->position_y, header->part, header->parts,
+			        header->tile_position_y,
+			        header->tile_placement_alignment,
+			        header->horizontal_offset, header->drawing_box_width,
+			        header->performance_id, gm1->image_offset_list[i],
+			        gm1->image_size_list[i]);
+		}
+		return;
+	}
+
+	fprintf(fp, "{\n  \"file\": ");
+	printQuoted(name, '\\', fp);
+	fprintf(fp,
+	        ",\n  \"data_type\": \"%s\",\n"
+	        "  \"size_type\": \"%s\",\n"
+	        "  \"image_count\": %u,\n"
+	        "  \"width\": %u,\n"
+	        "  \"height\": %u,\n"
+	        "  \"center_x\": %u,\n"
+	        "  \"center_y\": %u,\n"
+	        "  \"data_size\": %u,\n"
+	        "  \"images\": [",
+	        sh2ckGm1DataTypeName(gm1->header.data_type),
+	        sh2ckGm1SizeTypeName(gm1->header.size_type),
+	        gm1->header.image_count, gm1->header.width, gm1->header.height,
+	        gm1->header.center_x, gm1->header.center_y, gm1->header.data_size);
+	for (unsigned int i = 0; i < gm1->header.image_count; i++) {
+		struct Gm1ImageHeader *header = &gm1->image_headers[i];
+		fprintf(fp,
+		        "%s\n    {\"width\": %d, \"height\": %d, "
+		        "\"position_x\": %d, \"position_y\": %d, \"part\": %d, "
+		        "\"parts\": %d, \"tile_position_y\": %d, "
+		        "\"tile_placement_alignment\": %d, "
+		        "\"horizontal_offset\": %d, \"drawing_box_width\": %d, "
+		        "\"performance_id\": %d, \"offset\": %u, \"size\": %u}",
+		        i == 0 ? "" : ",", header->image_width, header->image_height,
+		        header->position_x, header->position_y, header->part,
+		        header->parts, header->tile_position_y,
+		        header->tile_placement_alignment, header->horizontal_offset,
+		        header->drawing_box_width, header->performance_id,
+		        gm1->image_offset_list[i], gm1->image_size_list[i]);
+	}
+	fprintf(fp, "\n  ]\n}");
+}
+
+int sh2ckGm1IsTileObject(struct Gm1 *gm1)
 {
 	return gm1->header.data_type == GM1_DATA_TGX_AND_TILE;
 }
 
-int gm1IsAnimation(struct Gm1 *gm1)
+int sh2ckGm1IsAnimation(struct Gm1 *gm1)
 {
 	return gm1->header.data_type == GM1_DATA_ANIMATION ||
 	       gm1->header.data_type == GM1_DATA_TGX_CONST_SIZE;
 }
 
-int gm1SavePalette(struct Gm1 *gm1, const char *file)
+int sh2ckGm1SavePalette(struct Gm1 *gm1, const char *file)
 {
-	FILE *fp = fopen(file, "w");
+	FILE *fp = sh2ckIoOpen(file);
 	if (fp == NULL) {
 		return -1;
 	}
 	fwrite(gm1->palette, GM1_PALETTE_SIZE, GM1_PALETTE_COUNT, fp);
-	fclose(fp);
+	sh2ckIoClose(fp);
 	return 0;
 }
 
-int gm1CreatePaletteImage(struct Image *image, const uint16_t *palette,
-                          int size)
+int sh2ckGm1CreatePaletteImage(struct Sh2ckImage *image,
+                               const uint16_t *palette, int size)
 {
 	const int linewidth = 256;
 	const int linecount = (GM1_PALETTE_COUNT * GM1_PALETTE_SIZE) / linewidth;
 
-	if (imageCreate(image, NULL, size * linewidth, size * linecount) == -1) {
+	if (sh2ckImageCreate(image, NULL, size * linewidth,
+	                     size * linecount) == -1) {
 		return -1;
 	}
 	int j = 0;
@@ -671,11 +912,11 @@ int gm1CreatePaletteImage(struct Image *image, const uint16_t *palette,
 		for (int x = 0; x < image->width; x++) {
 			image->pixel[y * image->width + x].a = 0xFF;
 			image->pixel[y * image->width + x].r =
-			    COLOR_CONVERT_RED(palette[j * linewidth + k]);
+			    SH2CK_COLOR_CONVERT_RED(palette[j * linewidth + k]);
 			image->pixel[y * image->width + x].g =
-			    COLOR_CONVERT_GREEN(palette[j * linewidth + k]);
+			    SH2CK_COLOR_CONVERT_GREEN(palette[j * linewidth + k]);
 			image->pixel[y * image->width + x].b =
-			    COLOR_CONVERT_BLUE(palette[j * linewidth + k]);
+			    SH2CK_COLOR_CONVERT_BLUE(palette[j * linewidth + k]);
 			if (x % size == 0) {
 				k++;
 			}
@@ -687,3 +928,190 @@ int gm1CreatePaletteImage(struct Image *image, const uint16_t *palette,
 	}
 	return 0;
 }
+
+static void cacheInit(struct Gm1Reader *reader)
+{
+	for (int i = 0; i < GM1_READER_CACHE_SIZE; i++) {
+		reader->cache[i].index = -1;
+		reader->cache[i].palette = -1;
+		reader->cache[i].last_use = 0;
+		reader->cache[i].capacity = 0;
+		reader->cache[i].image.pixel = NULL;
+	}
+	reader->use_counter = 0;
+}
+
+int sh2ckGm1ReaderOpen(struct Gm1Reader *reader, const char *file,
+                       int cache_size)
+{
+	gm1Init(&reader->gm1);
+	reader->buffer = NULL;
+	reader->buffer_size = 0;
+	reader->cache_size = cache_size;
+	if (reader->cache_size < 1) {
+		reader->cache_size = 1;
+	} else if (reader->cache_size > GM1_READER_CACHE_SIZE) {
+		reader->cache_size = GM1_READER_CACHE_SIZE;
+	}
+	cacheInit(reader);
+
+	reader->fp = fopen(file, "rb");
+	if (reader->fp == NULL) {
+		return -1;
+	}
+	if (fseek(reader->fp, 0, SEEK_END)) {
+		sh2ckGm1ReaderClose(reader);
+		return -1;
+	}
+	long file_size = ftell(reader->fp);
+	fseek(reader->fp, 0, SEEK_SET);
+
+	if (gm1ReadHeaders(&reader->gm1, reader->fp) == -1) {
+		sh2ckGm1ReaderClose(reader);
+		return -1;
+	}
+	reader->data_offset = ftell(reader->fp);
+	reader->data_size = file_size - reader->data_offset;
+
+	for (unsigned int i = 0; i < reader->gm1.header.image_count; i++) {
+		if ((long)reader->gm1.image_offset_list[i] +
+		        (long)reader->gm1.image_size_list[i] >
+		    reader->data_size) {
+			sh2ckGm1ReaderClose(reader);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void sh2ckGm1ReaderClose(struct Gm1Reader *reader)
+{
+	if (reader != NULL) {
+		for (int i = 0; i < GM1_READER_CACHE_SIZE; i++) {
+			sh2ckMemoryFree(reader->cache[i].image.pixel);
+			reader->cache[i].image.pixel = NULL;
+		}
+		sh2ckMemoryFree(reader->buffer);
+		reader->buffer = NULL;
+		if (reader->fp != NULL) {
+			fclose(reader->fp);
+			reader->fp = NULL;
+		}
+		sh2ckGm1Delete(&reader->gm1);
+	}
+}
+
+int sh2ckGm1ReaderImageCount(struct Gm1Reader *reader)
+{
+	return reader->gm1.header.image_count;
+}
+
+const struct Gm1ImageHeader *sh2ckGm1ReaderImageHeader(struct Gm1Reader *reader,
+                                                       int index)
+{
+	if (index < 0 || index >= sh2ckGm1ReaderImageCount(reader)) {
+		return NULL;
+	}
+	return &reader->gm1.image_headers[index];
+}
+
+int sh2ckGm1ReaderImageBufferSize(struct Gm1Reader *reader, int index)
+{
+	int width = 0;
+	int height = 0;
+	if (index < 0 || index >= sh2ckGm1ReaderImageCount(reader)) {
+		return -1;
+	}
+	imageSize(&reader->gm1, index, &width, &height);
+	return sizeof(struct Sh2ckColor) * width * height;
+}
+
+static uint8_t *readImageData(struct Gm1Reader *reader, int index)
+{
+	int size = reader->gm1.image_size_list[index];
+	if (size > reader->buffer_size) {
+		uint8_t *buffer = sh2ckMemoryRealloc(reader->buffer, size);
+		if (buffer == NULL) {
+			return NULL;
+		}
+		reader->buffer = buffer;
+		reader->buffer_size = size;
+	}
+	if (fseek(reader->fp,
+	          reader->data_offset + reader->gm1.image_offset_list[index],
+	          SEEK_SET) ||
+	    fread(reader->buffer, 1, size, reader->fp) < size) {
+		return NULL;
+	}
+	return reader->buffer;
+}
+
+int sh2ckGm1ReaderDecode(struct Gm1Reader *reader, int index, int palette,
+                         struct Sh2ckImage *image)
+{
+	int width = 0;
+	int height = 0;
+	if (index < 0 || index >= sh2ckGm1ReaderImageCount(reader) || palette < 0 ||
+	    palette >= GM1_PALETTE_COUNT) {
+		return -1;
+	}
+	imageSize(&reader->gm1, index, &width, &height);
+	image->x = 0;
+	image->y = 0;
+	image->width = width;
+	image->height = height;
+	image->pitch = width;
+
+	uint8_t *data = readImageData(reader, index);
+	if (data == NULL) {
+		return -1;
+	}
+	return decodeImage(image, &reader->gm1, index, palette, data);
+}
+
+const struct Sh2ckImage *sh2ckGm1ReaderGetImage(struct Gm1Reader *reader,
+                                                int index, int palette)
+{
+	struct Gm1CacheEntry *entry = NULL;
+	if (index < 0 || (uint32_t)index >= reader->gm1.header.image_count) {
+		return NULL;
+	}
+	reader->use_counter++;
+
+	for (int i = 0; i < reader->cache_size; i++) {
+		if (reader->cache[i].index == index &&
+		    reader->cache[i].palette == palette) {
+			reader->cache[i].last_use = reader->use_counter;
+			return &reader->cache[i].image;
+		}
+	}
+
+	/*evict the least recently used entry*/
+	for (int i = 0; i < reader->cache_size; i++) {
+		if (entry == NULL || reader->cache[i].last_use < entry->last_use) {
+			entry = &reader->cache[i];
+		}
+	}
+
+	int size = sh2ckGm1ReaderImageBufferSize(reader, index);
+	if (entry == NULL || size == -1) {
+		return NULL;
+	}
+	entry->index = -1;
+	if (size > entry->capacity) {
+		sh2ckMemoryFree(entry->image.pixel);
+		entry->capacity = 0;
+		entry->image.pixel = sh2ckMemoryAlloc(size);
+		if (entry->image.pixel == NULL) {
+			return NULL;
+		}
+		entry->capacity = size;
+	}
+	if (sh2ckGm1ReaderDecode(reader, index, palette, &entry->image) == -1) {
+		return NULL;
+	}
+	entry->index = index;
+	entry->palette = palette;
+	entry->last_use = reader->use_counter;
+	return &entry->image;
+}
@@ -15,12 +15,20 @@
  *
  */
 
-#ifndef GM1_H
-#define GM1_H
+#ifndef SH2CK_GM1_H
+#define SH2CK_GM1_H
 
 #include "image.h"
 
 #include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Sprite;
+struct Sh2ckThreadPool;
 
 #define GM1_PALETTE_SIZE 256
 #define GM1_PALETTE_COUNT 10
@@ -111,29 +119,128 @@ struct Gm1 {
 	uint32_t *image_size_list;
 	struct Gm1ImageHeader *image_headers;
 	uint8_t *image_data;
+	uint32_t image_data_size;
+};
+
+#define GM1_INFO_JSON 0
+#define GM1_INFO_CSV 1
+
+#define GM1_READER_CACHE_SIZE 16
+
+struct Gm1CacheEntry {
+	int index;
+	int palette;
+	int capacity;
+	unsigned long last_use;
+	struct Sh2ckImage image;
 };
 
-int gm1SaveHeader(struct Gm1 *gm1, const char *file);
+/*Random access to the images of a gm1 file. Only the headers are read on
+ * open, image data is read and decoded on demand.*/
+struct Gm1Reader {
+	struct Gm1 gm1;
+	FILE *fp;
+	long data_offset;
+	long data_size;
+	uint8_t *buffer;
+	int buffer_size;
+	int cache_size;
+	unsigned long use_counter;
+	struct Gm1CacheEntry cache[GM1_READER_CACHE_SIZE];
+};
+
+int sh2ckGm1SaveHeader(struct Gm1 *gm1, const char *file);
+
+const char *sh2ckGm1DataTypeName(uint32_t data_type);
+
+const char *sh2ckGm1SizeTypeName(uint32_t size_type);
+
+/*json prints one object per file, csv one row per image*/
+void sh2ckGm1PrintInfo(struct Gm1 *gm1, const char *name, int format, FILE *fp);
+
+void sh2ckGm1PrintInfoCsvHeader(FILE *fp);
+
+int sh2ckGm1CreateFromFile(struct Gm1 *gm1, const char *file);
+
+/*a pixel_buffer_size of 0 sizes the pixel buffer to fit all images*/
+int sh2ckGm1CreateImageList(struct Sh2ckImageList *image_list,
+                            int pixel_buffer_size, struct Gm1 *Gm1, int palette,
+                            unsigned int assemble);
+
+/*like sh2ckGm1CreateImageList, but decodes the images, or assembles the tile
+ * objects, on the threads of pool*/
+int sh2ckGm1CreateImageListParallel(struct Sh2ckImageList *image_list,
+                                    int pixel_buffer_size, struct Gm1 *gm1,
+                                    int palette, unsigned int assemble,
+                                    struct Sh2ckThreadPool *pool);
+
+/*Creates the image list with image sizes, tile objects and animation frames
+ * but does not decode any pixels. With a pixel_buffer_size of 0 the images
+ * have no pixels at all.*/
+int sh2ckGm1CreateImageListInfo(struct Sh2ckImageList *image_list,
+                                int pixel_buffer_size, struct Gm1 *gm1,
+                                unsigned int assemble);
+
+/*Decodes image index of a list created with sh2ckGm1CreateImageListInfo into
+ * image->pixel, which has to hold the pixels of image index. Size and
+ * position of image are taken from the list. Has to be called before the
+ * list is laid out into an atlas.*/
+int sh2ckGm1DecodeListImage(struct Sh2ckImageList *image_list, struct Gm1 *gm1,
+                            int index, int palette, struct Sh2ckImage *image);
+
+/*Encodes image index of a list created with sh2ckGm1CreateImageListInfo as a
+ * sprite. Tgx images are converted from their tokens and animations keep
+ * their palette indices, all others are decoded into image first, like with
+ * sh2ckGm1DecodeListImage.*/
+int sh2ckGm1EncodeListSprite(struct Sh2ckImageList *image_list, struct Gm1 *gm1,
+                             int index, struct Sh2ckImage *image,
+                             struct Sprite *sprite);
+
+int sh2ckGm1CreateTileObjectList(struct Sh2ckImageList *image_list,
+                                 int pixel_buffer_size, struct Gm1 *gm1);
+int sh2ckGm1CreateUnAssembledTileObjectList(struct Sh2ckImageList *image_list,
+                                            int pixel_buffer_size,
+                                            struct Gm1 *gm1);
+
+void sh2ckGm1Delete(struct Gm1 *Gm1);
+
+int sh2ckGm1IsTileObject(struct Gm1 *gm1);
+
+int sh2ckGm1IsAnimation(struct Gm1 *gm1);
+
+int sh2ckGm1SavePalette(struct Gm1 *gm1, const char *file);
+
+int sh2ckGm1CreatePaletteImage(struct Sh2ckImage *image,
+                               const uint16_t *palette, int size);
 
-int gm1CreateFromFile(struct Gm1 *gm1, const char *file);
+/*cache_size is the number of decoded images kept by sh2ckGm1ReaderGetImage,
+ * between 1 and GM1_READER_CACHE_SIZE*/
+int sh2ckGm1ReaderOpen(struct Gm1Reader *reader, const char *file,
+                       int cache_size);
 
-int gm1CreateImageList(struct ImageList *image_list, int pixel_buffer_size,
-                       struct Gm1 *Gm1, int palette, unsigned int assemble);
+void sh2ckGm1ReaderClose(struct Gm1Reader *reader);
 
-int gm1CreateTileObjectList(struct ImageList *image_list, int pixel_buffer_size,
-                            struct Gm1 *gm1);
-int gm1CreateUnAssembledTileObjectList(struct ImageList *image_list,
-                                       int pixel_buffer_size, struct Gm1 *gm1);
+int sh2ckGm1ReaderImageCount(struct Gm1Reader *reader);
 
-void gm1Delete(struct Gm1 *Gm1);
+const struct Gm1ImageHeader *sh2ckGm1ReaderImageHeader(struct Gm1Reader *reader,
+                                                       int index);
 
-int gm1IsTileObject(struct Gm1 *gm1);
+/*bytes needed for the pixels of image index*/
+int sh2ckGm1ReaderImageBufferSize(struct Gm1Reader *reader, int index);
 
-int gm1IsAnimation(struct Gm1 *gm1);
+/*decodes image index into image->pixel, which has to hold at least
+ * sh2ckGm1ReaderImageBufferSize bytes. Tile parts are not assembled.*/
+int sh2ckGm1ReaderDecode(struct Gm1Reader *reader, int index, int palette,
+                         struct Sh2ckImage *image);
 
-int gm1SavePalette(struct Gm1 *gm1, const char *file);
+/*like sh2ckGm1ReaderDecode but the image is owned by the reader and stays valid
+ * until it is evicted from the cache by later calls. NULL if index is out of
+ * range.*/
+const struct Sh2ckImage *sh2ckGm1ReaderGetImage(struct Gm1Reader *reader,
+                                                int index, int palette);
 
-int gm1CreatePaletteImage(struct Image *image, const uint16_t *palette,
-                          int size);
+#ifdef __cplusplus
+}
+#endif
 
-#endif  // GM1_H
+#endif  // SH2CK_GM1_H
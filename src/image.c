@@ -19,15 +19,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "encode.h"
 #include "image.h"
+#include "io.h"
+#include "memory.h"
+#include "thread.h"
 
-uint16_t imageGetColor16Bit(uint8_t *data)
+uint16_t sh2ckImageGetColor16Bit(uint8_t *data)
 {
 	return (*data) | (*(data + 1) << 8);
 }
 
-int imageCreate(struct Image *image, struct ImageList *image_list, int width,
-                int height)
+int sh2ckImageCreate(struct Sh2ckImage *image,
+                     struct Sh2ckImageList *image_list, int width, int height)
 {
 	image->x = 0;
 	image->y = 0;
@@ -36,12 +40,12 @@ int imageCreate(struct Image *image, struct ImageList *image_list, int width,
 	image->pitch = width;
 	image->pixel = NULL;
 	if (image_list == NULL) {
-		image->pixel = malloc(sizeof(*image->pixel) * width * height);
+		image->pixel = sh2ckMemoryAlloc(sizeof(*image->pixel) * width * height);
 	} else {
 		int allocation_size = sizeof(*image->pixel) * width * height;
-		if ((image_list->free + allocation_size) <
+		if ((image_list->free + allocation_size) <=
 		    (image_list->pixel_buffer + image_list->pixel_buffer_size)) {
-			image->pixel = (struct Color *)image_list->free;
+			image->pixel = (struct Sh2ckColor *)image_list->free;
 			image_list->free += allocation_size;
 		} else {
 			return -1;
@@ -53,103 +57,338 @@ int imageCreate(struct Image *image, struct ImageList *image_list, int width,
 	return 0;
 }
 
-int imageSave(struct Image *image, const char *file)
+#define PALETTE_COLOR_COUNT (1 << 15)
+
+/*The colours of images that fit into an 8 bit palette. Decoded pixels come
+ * from 16 bit colours, so an opaque pixel is looked up by its rgb555 value.
+ * Transparent pixels are all 0 and share the first entry.*/
+struct ImagePalette {
+	int color_count;
+	int transparent;
+	uint32_t used[PALETTE_COLOR_COUNT / 32];
+	uint8_t index[PALETTE_COLOR_COUNT];
+	uint8_t rgb[3 * SH2CK_IMAGE_PALETTE_SIZE];
+	uint8_t alpha[1];
+};
+
+static int colorKey(struct Sh2ckColor color)
+{
+	return ((color.r >> 3) << 10) | ((color.g >> 3) << 5) | (color.b >> 3);
+}
+
+/*adds the colours of the pixels of image that start at offset, -1 if they do
+ * not fit into a palette*/
+static int paletteAdd(struct ImagePalette *palette, struct Sh2ckImage *image,
+                      struct Sh2ckOffset offset)
+{
+	int last_key = -1;
+	for (int y = 0; y < image->height; y++) {
+		const struct Sh2ckColor *row =
+		    image->pixel + (y + offset.y) * image->pitch + offset.x;
+		for (int x = 0; x < image->width; x++) {
+			struct Sh2ckColor color = row[x];
+			if (color.a == 0 && (color.r | color.g | color.b) == 0) {
+				palette->transparent = 1;
+				continue;
+			}
+			if (color.a != 0xFF || ((color.r | color.g | color.b) & 0x07)) {
+				return -1;
+			}
+			int key = colorKey(color);
+			if (key == last_key) {
+				continue;
+			}
+			last_key = key;
+			uint32_t bit = 1u << (key & 31);
+			if (!(palette->used[key >> 5] & bit)) {
+				palette->used[key >> 5] |= bit;
+				palette->color_count++;
+				if (palette->color_count > SH2CK_IMAGE_PALETTE_SIZE) {
+					return -1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/*numbers the colours in rgb555 order after the transparent entry, -1 if
+ * they do not fit*/
+static int paletteFinish(struct ImagePalette *palette)
+{
+	int size = palette->color_count + palette->transparent;
+	if (size == 0 || size > SH2CK_IMAGE_PALETTE_SIZE) {
+		return -1;
+	}
+	memset(palette->rgb, 0, sizeof(palette->rgb));
+	palette->alpha[0] = 0;
+	int entry = palette->transparent;
+	for (int key = 0; key < PALETTE_COLOR_COUNT; key++) {
+		if (palette->used[key >> 5] & (1u << (key & 31))) {
+			palette->index[key] = entry;
+			palette->rgb[3 * entry] = SH2CK_COLOR_CONVERT_RED(key);
+			palette->rgb[3 * entry + 1] = SH2CK_COLOR_CONVERT_GREEN(key);
+			palette->rgb[3 * entry + 2] = SH2CK_COLOR_CONVERT_BLUE(key);
+			entry++;
+		}
+	}
+	return 0;
+}
+
+static struct ImagePalette *paletteCreate(void)
+{
+	struct ImagePalette *palette = sh2ckMemoryAlloc(sizeof(*palette));
+	if (palette != NULL) {
+		memset(palette, 0, sizeof(*palette));
+	}
+	return palette;
+}
+
+/*the palette of image, or NULL if it needs rgba*/
+static struct ImagePalette *imagePalette(struct Sh2ckImage *image)
+{
+	struct Sh2ckOffset offset = {0, 0};
+	struct ImagePalette *palette = paletteCreate();
+	if (palette != NULL && (paletteAdd(palette, image, offset) == -1 ||
+	                        paletteFinish(palette) == -1)) {
+		sh2ckMemoryFree(palette);
+		return NULL;
+	}
+	return palette;
+}
+
+/*png wants rgba or palette indices, the pixels are bgra. rows may be
+ * pixel.*/
+static void packRows(uint8_t *rows, const struct Sh2ckColor *pixel, int count,
+                     const struct ImagePalette *palette)
 {
-	FILE *fp = fopen(file, "wb");
+	if (palette != NULL) {
+		for (int i = 0; i < count; i++) {
+			struct Sh2ckColor color = pixel[i];
+			rows[i] = color.a == 0 ? 0 : palette->index[colorKey(color)];
+		}
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		struct Sh2ckColor color = pixel[i];
+		rows[4 * i] = color.r;
+		rows[4 * i + 1] = color.g;
+		rows[4 * i + 2] = color.b;
+		rows[4 * i + 3] = color.a;
+	}
+}
+
+/*writes height rows of band->width pixels, fill is called for every band of
+ * up to band->height rows starting at band->y, if fill is NULL band already
+ * holds all rows. With a palette the pixels are written as indices.*/
+static int savePng(const char *file, struct Sh2ckImage *band, int height,
+                   void (*fill)(void *context, struct Sh2ckImage *band),
+                   void *context, const struct ImagePalette *palette)
+{
+	/*freed after longjmp from libpng*/
+	uint8_t *volatile indices = NULL;
+	if (palette != NULL) {
+		indices = sh2ckMemoryAlloc(band->width);
+		if (indices == NULL) {
+			return -1;
+		}
+	}
+	FILE *fp = sh2ckIoOpen(file);
 	if (fp == NULL) {
+		sh2ckMemoryFree(indices);
 		return -1;
 	}
 	png_structp png_ptr =
 	    png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png_ptr == NULL) {
-		fclose(fp);
+		sh2ckMemoryFree(indices);
+		sh2ckIoClose(fp);
 		return -1;
 	}
 
 	png_infop info_ptr = png_create_info_struct(png_ptr);
 	if (info_ptr == NULL) {
 		png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
-		fclose(fp);
+		sh2ckMemoryFree(indices);
+		sh2ckIoClose(fp);
 		return -1;
 	}
 
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		png_destroy_write_struct(&png_ptr, &info_ptr);
-		fclose(fp);
+		sh2ckMemoryFree(indices);
+		sh2ckIoClose(fp);
 		return -1;
 	}
 
 	png_init_io(png_ptr, fp);
-	png_set_IHDR(png_ptr, info_ptr, image->width, image->height, 8,
-	             PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
-	             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	if (palette != NULL) {
+		int size = palette->color_count + palette->transparent;
+		png_set_IHDR(png_ptr, info_ptr, band->width, height, 8,
+		             PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+		             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_set_PLTE(png_ptr, info_ptr, (png_const_colorp)palette->rgb, size);
+		if (palette->transparent) {
+			png_set_tRNS(png_ptr, info_ptr, palette->alpha, 1, NULL);
+		}
+	} else {
+		png_set_IHDR(png_ptr, info_ptr, band->width, height, 8,
+		             PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+		             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	}
 
 	png_write_info(png_ptr, info_ptr);
 
-	png_set_bgr(png_ptr);
-	for (int i = 0; i < image->height; i++) {
-		png_write_row(png_ptr, (png_bytep)&image->pixel[i * image->width]);
+	if (palette == NULL) {
+		png_set_bgr(png_ptr);
+	}
+	for (int y = 0; y < height; y += band->height) {
+		int rows = height - y;
+		if (rows > band->height) {
+			rows = band->height;
+		}
+		band->y = y;
+		if (fill != NULL) {
+			fill(context, band);
+		}
+		for (int i = 0; i < rows; i++) {
+			struct Sh2ckColor *row = &band->pixel[i * band->width];
+			if (indices != NULL) {
+				packRows(indices, row, band->width, palette);
+				png_write_row(png_ptr, indices);
+			} else {
+				png_write_row(png_ptr, (png_bytep)row);
+			}
+		}
 	}
 
 	png_write_end(png_ptr, info_ptr);
 	png_destroy_write_struct(&png_ptr, &info_ptr);
-	fclose(fp);
+	sh2ckMemoryFree(indices);
+	sh2ckIoClose(fp);
 	return 0;
 }
 
-void imageClear(struct Image *image, uint32_t color)
+/*the parallel encoder only pays off for images of several chunks*/
+static int encodeInParallel(struct Sh2ckThreadPool *pool, int width, int height)
+{
+	return sh2ckThreadPoolThreadCount(pool) > 1 &&
+	       (int64_t)height * (width * sizeof(struct Sh2ckColor) + 1) >
+	           2 * ENCODE_CHUNK_SIZE;
+}
+
+static void encodeHeader(struct EncodeHeader *header, int width, int height,
+                         const struct ImagePalette *palette)
+{
+	memset(header, 0, sizeof(*header));
+	header->width = width;
+	header->height = height;
+	if (palette != NULL) {
+		header->palette = palette->rgb;
+		header->palette_size = palette->color_count + palette->transparent;
+		header->alpha = palette->alpha;
+		header->alpha_size = palette->transparent;
+	}
+}
+
+struct ImageRows {
+	struct Sh2ckImage *image;
+	const struct ImagePalette *palette;
+};
+
+static void imageRows(void *context, uint8_t *rows, int first, int count)
+{
+	struct ImageRows *image_rows = context;
+	struct Sh2ckImage *image = image_rows->image;
+	packRows(rows, image->pixel + first * image->width, count * image->width,
+	         image_rows->palette);
+}
+
+int sh2ckImageSaveParallel(struct Sh2ckImage *image, const char *file,
+                           struct Sh2ckThreadPool *pool)
 {
-	struct Color c;
+	int ret = 0;
+	struct ImagePalette *palette = imagePalette(image);
+	if (encodeInParallel(pool, image->width, image->height)) {
+		struct EncodeHeader header;
+		struct ImageRows rows = {image, palette};
+		encodeHeader(&header, image->width, image->height, palette);
+		ret = sh2ckEncodePngParallel(file, &header, imageRows, &rows, pool);
+	} else {
+		struct Sh2ckImage band = *image;
+		if (band.height <= 0) {
+			band.height = 1;
+		}
+		ret = savePng(file, &band, image->height, NULL, NULL, palette);
+	}
+	sh2ckMemoryFree(palette);
+	return ret;
+}
+
+int sh2ckImageSave(struct Sh2ckImage *image, const char *file)
+{
+	return sh2ckImageSaveParallel(image, file, NULL);
+}
+
+void sh2ckImageClear(struct Sh2ckImage *image, uint32_t color)
+{
+	struct Sh2ckColor c;
 	memcpy(&c, &color, sizeof(c));
 	for (int i = 0; i < image->width * image->height; i++) {
 		image->pixel[i] = c;
 	}
 }
 
-void imageDelete(struct Image *image, struct ImageList *image_list)
+void sh2ckImageDelete(struct Sh2ckImage *image,
+                      struct Sh2ckImageList *image_list)
 {
 	if ((image_list == NULL) && (image != NULL)) {
-		free(image->pixel);
+		sh2ckMemoryFree(image->pixel);
 	}
 }
 
-int imageCreateList(struct ImageList *image_list, int pixel_buffer_size,
-                    int count, int object_count, int tile_count, int type)
+int sh2ckImageCreateList(struct Sh2ckImageList *image_list,
+                         int pixel_buffer_size, int count, int object_count,
+                         int tile_count, int type)
 {
 	image_list->image_count = count;
 	image_list->type = type;
 	image_list->pixel_buffer_size = pixel_buffer_size;
-	image_list->images = malloc(sizeof(*image_list->images) * count);
-	image_list->pixel_buffer = malloc(pixel_buffer_size);
+	image_list->images = sh2ckMemoryAlloc(sizeof(*image_list->images) * count);
+	image_list->pixel_buffer = NULL;
+	if (pixel_buffer_size > 0) {
+		image_list->pixel_buffer = sh2ckMemoryAlloc(pixel_buffer_size);
+	}
 	image_list->free = image_list->pixel_buffer;
 
 	if (image_list->images == NULL) {
 		return -1;
 	}
-	if (image_list->pixel_buffer == NULL) {
+	if (pixel_buffer_size > 0 && image_list->pixel_buffer == NULL) {
 		return -1;
 	}
 
-	if (type == IMAGE_TYPE_TILE) {
-		image_list->data = malloc(sizeof(struct TileObjectList));
+	if (type == SH2CK_IMAGE_TYPE_TILE) {
+		image_list->data = sh2ckMemoryAlloc(sizeof(struct Sh2ckTileObjectList));
 		if (image_list->data == NULL) {
-			free(image_list->images);
+			sh2ckMemoryFree(image_list->images);
 			return -1;
 		}
-		if (tileObjectCreateList(image_list->data, object_count, tile_count)) {
-			free(image_list->data);
-			free(image_list->images);
+		if (sh2ckTileObjectCreateList(image_list->data, object_count,
+		                              tile_count)) {
+			sh2ckMemoryFree(image_list->data);
+			sh2ckMemoryFree(image_list->images);
 			return -1;
 		}
-	} else if (type == IMAGE_TYPE_ANIMATION) {
-		image_list->data = malloc(sizeof(struct Animation));
+	} else if (type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		image_list->data = sh2ckMemoryAlloc(sizeof(struct Sh2ckAnimation));
 		if (image_list->data == NULL) {
-			free(image_list->images);
+			sh2ckMemoryFree(image_list->images);
 			return -1;
 		}
-		if (animationCreate(image_list->data, object_count)) {
-			free(image_list->data);
-			free(image_list->images);
+		if (sh2ckAnimationCreate(image_list->data, object_count)) {
+			sh2ckMemoryFree(image_list->data);
+			sh2ckMemoryFree(image_list->images);
 			return -1;
 		}
 
@@ -163,40 +402,205 @@ int imageCreateList(struct ImageList *image_list, int pixel_buffer_size,
 	return 0;
 }
 
-void imageDeleteList(struct ImageList *image_list)
+int sh2ckImageListPixelSize(struct Sh2ckImageList *image_list)
+{
+	int size = 0;
+	for (int i = 0; i < image_list->image_count; i++) {
+		size += sizeof(struct Sh2ckColor) * image_list->images[i].width *
+		        image_list->images[i].height;
+	}
+	return size;
+}
+
+int sh2ckImageListAllocatePixels(struct Sh2ckImageList *image_list,
+                                 int pixel_buffer_size)
+{
+	if (image_list->pixel_buffer != NULL) {
+		return -1;
+	}
+	image_list->pixel_buffer_size = pixel_buffer_size;
+	image_list->pixel_buffer = sh2ckMemoryAlloc(pixel_buffer_size);
+	image_list->free = image_list->pixel_buffer;
+	if (image_list->pixel_buffer == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < image_list->image_count; i++) {
+		struct Sh2ckImage *image = &image_list->images[i];
+		if (sh2ckImageCreate(image, image_list, image->width, image->height) ==
+		    -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void sh2ckImageDeleteList(struct Sh2ckImageList *image_list)
 {
 	if (image_list != NULL) {
 		for (int i = 0; i < image_list->image_count; i++) {
-			imageDelete(&image_list->images[i], image_list);
+			sh2ckImageDelete(&image_list->images[i], image_list);
 		}
-		free(image_list->images);
-		free(image_list->pixel_buffer);
+		sh2ckMemoryFree(image_list->images);
+		sh2ckMemoryFree(image_list->pixel_buffer);
 		if (image_list->data != NULL) {
-			if (image_list->type == IMAGE_TYPE_TILE) {
-				tileObjectDeleteList(image_list->data);
+			if (image_list->type == SH2CK_IMAGE_TYPE_TILE) {
+				sh2ckTileObjectDeleteList(image_list->data);
 			}
-			free(image_list->data);
+			sh2ckMemoryFree(image_list->data);
 		}
 	}
 }
 
-int tileObjectCreate(struct TileObject *object, int part_count, int start_index)
+/*rounded up, so the last row or column of an odd size is kept*/
+static int halfSize(int size)
+{
+	return (size + 1) / 2;
+}
+
+static int16_t halfPos(int pos)
+{
+	return pos >= 0 ? pos / 2 : -halfSize(-pos);
+}
+
+void sh2ckImageDownscaleHalf(struct Sh2ckImage *half,
+                             const struct Sh2ckImage *image)
+{
+	for (int y = 0; y < half->height; y++) {
+		int rows = 2 * y + 1 < image->height ? 2 : 1;
+		for (int x = 0; x < half->width; x++) {
+			int columns = 2 * x + 1 < image->width ? 2 : 1;
+			uint32_t b = 0;
+			uint32_t g = 0;
+			uint32_t r = 0;
+			uint32_t a = 0;
+			for (int j = 0; j < rows; j++) {
+				const struct Sh2ckColor *src =
+				    &image->pixel[(2 * y + j) * image->pitch + 2 * x];
+				for (int i = 0; i < columns; i++) {
+					b += src[i].b * src[i].a;
+					g += src[i].g * src[i].a;
+					r += src[i].r * src[i].a;
+					a += src[i].a;
+				}
+			}
+			struct Sh2ckColor *dst = &half->pixel[y * half->pitch + x];
+			if (a == 0) {
+				memset(dst, 0, sizeof(*dst));
+				continue;
+			}
+			int count = rows * columns;
+			dst->b = (b + a / 2) / a;
+			dst->g = (g + a / 2) / a;
+			dst->r = (r + a / 2) / a;
+			dst->a = (a + count / 2) / count;
+		}
+	}
+}
+
+static void copyHalfRect(struct Sh2ckRect *half, const struct Sh2ckRect *rect)
+{
+	half->x = halfPos(rect->x);
+	half->y = halfPos(rect->y);
+	half->width = halfSize(rect->width);
+	half->height = halfSize(rect->height);
+}
+
+static void copyHalfData(struct Sh2ckImageList *half,
+                         struct Sh2ckImageList *image_list)
+{
+	if (image_list->type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		struct Sh2ckAnimation *animation = image_list->data;
+		struct Sh2ckAnimation *half_animation = half->data;
+		for (int i = 0; i < animation->frame_count; i++) {
+			half_animation->frames[i].id = animation->frames[i].id;
+			half_animation->frames[i].center.x =
+			    halfPos(animation->frames[i].center.x);
+			half_animation->frames[i].center.y =
+			    halfPos(animation->frames[i].center.y);
+		}
+	} else if (image_list->type == SH2CK_IMAGE_TYPE_TILE) {
+		struct Sh2ckTileObjectList *objects = image_list->data;
+		struct Sh2ckTileObjectList *half_objects = half->data;
+		half_objects->assembled = objects->assembled;
+		memcpy(half_objects->objects, objects->objects,
+		       sizeof(*objects->objects) * objects->object_count);
+		for (int i = 0; i < objects->tile_count; i++) {
+			struct Sh2ckTilePart *tile = &objects->tiles[i];
+			struct Sh2ckTilePart *half_tile = &half_objects->tiles[i];
+			*half_tile = *tile;
+			copyHalfRect(&half_tile->rect, &tile->rect);
+			copyHalfRect(&half_tile->footprint, &tile->footprint);
+			half_tile->elevation = halfPos(tile->elevation);
+		}
+	}
+}
+
+struct HalfTask {
+	struct Sh2ckImageList *half;
+	struct Sh2ckImageList *image_list;
+};
+
+static void downscaleTaskImage(void *context, int index)
+{
+	struct HalfTask *task = context;
+	sh2ckImageDownscaleHalf(&task->half->images[index],
+	                        &task->image_list->images[index]);
+}
+
+int sh2ckImageListCreateHalf(struct Sh2ckImageList *half,
+                             struct Sh2ckImageList *image_list,
+                             struct Sh2ckThreadPool *pool)
+{
+	int object_count = 0;
+	int tile_count = 0;
+	if (image_list->type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		object_count = ((struct Sh2ckAnimation *)image_list->data)->frame_count;
+	} else if (image_list->type == SH2CK_IMAGE_TYPE_TILE) {
+		struct Sh2ckTileObjectList *objects = image_list->data;
+		object_count = objects->object_count;
+		tile_count = objects->tile_count;
+	}
+	if (sh2ckImageCreateList(half, 0, image_list->image_count, object_count,
+	                         tile_count, image_list->type) == -1) {
+		return -1;
+	}
+	for (int i = 0; i < image_list->image_count; i++) {
+		half->images[i].width = halfSize(image_list->images[i].width);
+		half->images[i].height = halfSize(image_list->images[i].height);
+	}
+	if (sh2ckImageListAllocatePixels(half,
+	                                 sh2ckImageListPixelSize(half)) == -1) {
+		sh2ckImageDeleteList(half);
+		return -1;
+	}
+	copyHalfData(half, image_list);
+
+	struct HalfTask task = {half, image_list};
+	sh2ckThreadPoolParallelFor(pool, image_list->image_count,
+	                           downscaleTaskImage, &task);
+	return 0;
+}
+
+int sh2ckTileObjectCreate(struct Sh2ckTileObject *object, int part_count,
+                          int start_index)
 {
 	object->part_count = part_count;
 	object->tile_start = start_index;
 	return 0;
 }
 
-void tileObjectDelete(struct TileObject *object) {}
+void sh2ckTileObjectDelete(struct Sh2ckTileObject *object) {}
 
-int tileObjectCreateList(struct TileObjectList *objects_list, int object_count,
-                         int tile_count)
+int sh2ckTileObjectCreateList(struct Sh2ckTileObjectList *objects_list,
+                              int object_count, int tile_count)
 {
+	objects_list->assembled = 1;
 	objects_list->object_count = object_count;
 	objects_list->tile_count = tile_count;
 	objects_list->objects =
-	    malloc(sizeof(*objects_list->objects) * object_count);
-	objects_list->tiles = malloc(sizeof(*objects_list->tiles) * tile_count);
+	    sh2ckMemoryAlloc(sizeof(*objects_list->objects) * object_count);
+	objects_list->tiles =
+	    sh2ckMemoryAlloc(sizeof(*objects_list->tiles) * tile_count);
 
 	if (objects_list->objects == NULL) {
 		return -1;
@@ -208,21 +612,22 @@ int tileObjectCreateList(struct TileObjectList *objects_list, int object_count,
 	return 0;
 }
 
-void tileObjectDeleteList(struct TileObjectList *object_list)
+void sh2ckTileObjectDeleteList(struct Sh2ckTileObjectList *object_list)
 {
 	if (object_list != NULL) {
 		for (int i = 0; i < object_list->object_count; i++) {
-			tileObjectDelete(&object_list->objects[i]);
+			sh2ckTileObjectDelete(&object_list->objects[i]);
 		}
-		free(object_list->objects);
-		free(object_list->tiles);
+		sh2ckMemoryFree(object_list->objects);
+		sh2ckMemoryFree(object_list->tiles);
 	}
 }
 
-int animationCreate(struct Animation *animation, int frame_count)
+int sh2ckAnimationCreate(struct Sh2ckAnimation *animation, int frame_count)
 {
 	animation->frame_count = frame_count;
-	animation->frames = malloc(sizeof(*animation->frames) * frame_count);
+	animation->frames =
+	    sh2ckMemoryAlloc(sizeof(*animation->frames) * frame_count);
 
 	if (animation->frames == NULL) {
 		return -1;
@@ -231,24 +636,24 @@ int animationCreate(struct Animation *animation, int frame_count)
 	return 0;
 }
 
-void animationDelete(struct Animation *animation)
+void sh2ckAnimationDelete(struct Sh2ckAnimation *animation)
 {
 	if (animation != NULL) {
-		free(animation->frames);
+		sh2ckMemoryFree(animation->frames);
 	}
 }
 
-int imageWriteData(struct ImageList *image_list, const char *file)
+int sh2ckImageWriteData(struct Sh2ckImageList *image_list, const char *file)
 {
-	FILE *fp = fopen(file, "w");
+	FILE *fp = sh2ckIoOpen(file);
 	if (fp == NULL) {
 		return -1;
 	}
 
 	int type = image_list->type;
-	if (type == IMAGE_TYPE_TILE) {
+	if (type == SH2CK_IMAGE_TYPE_TILE) {
 		fprintf(fp, "!tile\n");
-	} else if (type == IMAGE_TYPE_ANIMATION) {
+	} else if (type == SH2CK_IMAGE_TYPE_ANIMATION) {
 		fprintf(fp, "!anim\n");
 	} else {
 		fprintf(fp, "!other\n");
@@ -261,9 +666,9 @@ int imageWriteData(struct ImageList *image_list, const char *file)
 		        image_list->images[i].y, image_list->images[i].width,
 		        image_list->images[i].height);
 	}
-	if (type == IMAGE_TYPE_TILE) {
-		struct TileObjectList *objects =
-		    (struct TileObjectList *)image_list->data;
+	if (type == SH2CK_IMAGE_TYPE_TILE) {
+		struct Sh2ckTileObjectList *objects =
+		    (struct Sh2ckTileObjectList *)image_list->data;
 		fprintf(fp, "[objects,%d,2,i,i]\n", objects->object_count);
 		fprintf(fp, "#tile_start,tiles\n");
 		int num_tiles = 0;
@@ -279,55 +684,120 @@ int imageWriteData(struct ImageList *image_list, const char *file)
 			        objects->tiles[i].rect.y, objects->tiles[i].rect.width,
 			        objects->tiles[i].rect.height);
 		}
-	} else if (type == IMAGE_TYPE_ANIMATION) {
-		struct Animation *animation = (struct Animation *)image_list->data;
+	} else if (type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		struct Sh2ckAnimation *animation =
+		    (struct Sh2ckAnimation *)image_list->data;
 		fprintf(fp, "[animation,%d,2,i,i]\n", animation->frame_count);
 		for (int i = 0; i < animation->frame_count; i++) {
 			fprintf(fp, "%d,%d\n", animation->frames[i].center.x,
 			        animation->frames[i].center.y);
 		}
 	}
-	return 0;
+	return sh2ckIoClose(fp);
+}
+
+int sh2ckImageWriteFootprints(struct Sh2ckImageList *image_list,
+                              const char *file)
+{
+	if (image_list->type != SH2CK_IMAGE_TYPE_TILE) {
+		return -1;
+	}
+	struct Sh2ckTileObjectList *objects = image_list->data;
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+
+	fprintf(fp, "!footprints\n");
+	fprintf(fp, "[objects,%d,8,i,i,i,i,i,i,i,i]\n", objects->object_count);
+	fprintf(fp, "#tile_start,tiles,size,elevation,posx,posy,width,height\n");
+	for (int i = 0; i < objects->object_count; i++) {
+		struct Sh2ckTileObject *object = &objects->objects[i];
+		struct Sh2ckTilePart *tiles = &objects->tiles[object->tile_start];
+		int size = 0;
+		int elevation = 0;
+		int minx = INT16_MAX;
+		int miny = INT16_MAX;
+		int maxx = 0;
+		int maxy = 0;
+		for (int j = 0; j < object->part_count; j++) {
+			struct Sh2ckRect *footprint = &tiles[j].footprint;
+			if (tiles[j].grid.x + 1 > size) {
+				size = tiles[j].grid.x + 1;
+			}
+			if (tiles[j].elevation > elevation) {
+				elevation = tiles[j].elevation;
+			}
+			if (footprint->x < minx) {
+				minx = footprint->x;
+			}
+			if (footprint->y < miny) {
+				miny = footprint->y;
+			}
+			if (footprint->x + footprint->width > maxx) {
+				maxx = footprint->x + footprint->width;
+			}
+			if (footprint->y + footprint->height > maxy) {
+				maxy = footprint->y + footprint->height;
+			}
+		}
+		/*every tile has its own image if the objects are not assembled*/
+		if (object->part_count == 0 || !objects->assembled) {
+			minx = 0;
+			miny = 0;
+			maxx = 0;
+			maxy = 0;
+		}
+		fprintf(fp, "%d,%d,%d,%d,%d,%d,%d,%d\n", object->tile_start,
+		        object->part_count, size, elevation, minx, miny, maxx - minx,
+		        maxy - miny);
+	}
+	fprintf(fp, "[tiles,%d,8,i,i,i,i,i,i,i,i]\n", objects->tile_count);
+	fprintf(fp, "#x,y,depth,posx,posy,width,height,elevation\n");
+	for (int i = 0; i < objects->tile_count; i++) {
+		struct Sh2ckTilePart *tile = &objects->tiles[i];
+		fprintf(fp, "%d,%d,%d,%d,%d,%d,%d,%d\n", tile->grid.x, tile->grid.y,
+		        tile->grid.x + tile->grid.y, tile->footprint.x,
+		        tile->footprint.y, tile->footprint.width,
+		        tile->footprint.height, tile->elevation);
+	}
+	return sh2ckIoClose(fp);
 }
 
-static void boundingBox(struct Rect *bbox, struct Image *image)
+void sh2ckImageBoundingBox(struct Sh2ckRect *bbox, struct Sh2ckImage *image)
 {
 	int minx = image->width;
 	int miny = image->height;
-	int maxx = 0;
-	int maxy = 0;
+	int maxx = -1;
+	int maxy = -1;
 	for (int y = 0; y < image->height; y++) {
+		const struct Sh2ckColor *row = image->pixel + y * image->pitch;
 		for (int x = 0; x < image->width; x++) {
-			if (image->pixel[y * image->width + x].a == 0xFF) {
-				if (minx >= x) {
-					minx = x;
-				}
-				if (miny >= y) {
-					miny = y;
-				}
-				if (maxx <= x) {
-					maxx = x;
-				}
-				if (maxy <= y) {
-					maxy = y;
-				}
+			if (row[x].a != 0) {
+				minx = x < minx ? x : minx;
+				maxx = x > maxx ? x : maxx;
+				miny = y < miny ? y : miny;
+				maxy = y;
 			}
 		}
 	}
+	if (maxx < 0) {
+		bbox->x = 0;
+		bbox->y = 0;
+		bbox->width = 0;
+		bbox->height = 0;
+		return;
+	}
 	bbox->x = minx;
 	bbox->y = miny;
-	bbox->width = maxx - minx;
-	bbox->height = maxy - miny;
+	bbox->width = maxx - minx + 1;
+	bbox->height = maxy - miny + 1;
 }
 
 struct CmpVal {
 	uint16_t id;
 	uint16_t height;
 };
-struct Offset {
-	int16_t x;
-	int16_t y;
-};
 
 static int heightCmp(const void *a, const void *b)
 {
@@ -336,13 +806,14 @@ static int heightCmp(const void *a, const void *b)
 	return img_a->height - img_b->height;
 }
 
-void shrinkAnimationImages(struct ImageList *image_list,
-                           struct Offset *source_offsets)
+void sh2ckShrinkAnimationImages(struct Sh2ckImageList *image_list,
+                                struct Sh2ckOffset *source_offsets)
 {
-	struct Animation *animation = (struct Animation *)image_list->data;
+	struct Sh2ckAnimation *animation =
+	    (struct Sh2ckAnimation *)image_list->data;
 	for (int i = 0; i < image_list->image_count; i++) {
-		struct Rect bbox;
-		boundingBox(&bbox, &image_list->images[i]);
+		struct Sh2ckRect bbox;
+		sh2ckImageBoundingBox(&bbox, &image_list->images[i]);
 		image_list->images[i].width = bbox.width;
 		image_list->images[i].height = bbox.height;
 		animation->frames[i].center.x -= bbox.x;
@@ -352,15 +823,35 @@ void shrinkAnimationImages(struct ImageList *image_list,
 	}
 }
 
-static int layout(struct ImageList *image_list, struct Rect *atlas_size,
-                  struct Offset *image_offsets, int width, int sort,
-                  int assembled)
+void sh2ckImageListPlaceTiles(struct Sh2ckImageList *image_list, int assembled)
 {
-	if (image_list->type == IMAGE_TYPE_ANIMATION) {
-		shrinkAnimationImages(image_list, image_offsets);
+	if (image_list->type != SH2CK_IMAGE_TYPE_TILE) {
+		return;
+	}
+	struct Sh2ckTileObjectList *tile_objects = image_list->data;
+	if (!assembled) {
+		for (int i = 0; i < tile_objects->tile_count; i++) {
+			tile_objects->tiles[i].rect.x += image_list->images[i].x;
+			tile_objects->tiles[i].rect.y += image_list->images[i].y;
+		}
+		return;
+	}
+	for (int i = 0; i < tile_objects->object_count; i++) {
+		struct Sh2ckTileObject *object = &tile_objects->objects[i];
+		for (int j = object->tile_start;
+		     j < object->tile_start + object->part_count; j++) {
+			tile_objects->tiles[j].rect.x += image_list->images[i].x;
+			tile_objects->tiles[j].rect.y += image_list->images[i].y;
+		}
 	}
+}
 
-	struct CmpVal *vals = malloc(sizeof(*vals) * image_list->image_count);
+int sh2ckImageLayoutAtlas(struct Sh2ckImageList *image_list,
+                          struct Sh2ckRect *atlas_size, int width, int sort,
+                          int assembled)
+{
+	struct CmpVal *vals =
+	    sh2ckMemoryAlloc(sizeof(*vals) * image_list->image_count);
 	if (vals == NULL) {
 		return -1;
 	}
@@ -369,7 +860,7 @@ static int layout(struct ImageList *image_list, struct Rect *atlas_size,
 		vals[i].id = (uint16_t)i;
 		vals[i].height = (uint16_t)image_list->images[i].height;
 	}
-	if (sort && (image_list->type != IMAGE_TYPE_ANIMATION)) {
+	if (sort && (image_list->type != SH2CK_IMAGE_TYPE_ANIMATION)) {
 		qsort(vals, image_list->image_count, sizeof(*vals), heightCmp);
 	}
 
@@ -379,10 +870,10 @@ static int layout(struct ImageList *image_list, struct Rect *atlas_size,
 	int maxy = 0;
 	int maxx = 0;
 	for (int i = 0; i < image_list->image_count; i++) {
-		struct Image *image = &image_list->images[vals[i].id];
+		struct Sh2ckImage *image = &image_list->images[vals[i].id];
 		if ((posx + image->width + 1) > width) {
 			if (x == 0) {
-				free(vals);
+				sh2ckMemoryFree(vals);
 				return -1;
 			}
 			x = 0;
@@ -394,16 +885,6 @@ static int layout(struct ImageList *image_list, struct Rect *atlas_size,
 		image->x = posx;
 		image->y = posy;
 
-		if (assembled && (image_list->type == IMAGE_TYPE_TILE)) {
-			struct TileObjectList *tile_objects = image_list->data;
-			struct TileObject *object = &tile_objects->objects[vals[i].id];
-			for (int j = object->tile_start;
-			     j < object->tile_start + object->part_count; j++) {
-				tile_objects->tiles[j].rect.x += posx;
-				tile_objects->tiles[j].rect.y += posy;
-			}
-		}
-
 		posx = posx + image->width + 1;
 		if (posx > maxx) {
 			maxx = posx;
@@ -412,61 +893,180 @@ static int layout(struct ImageList *image_list, struct Rect *atlas_size,
 			maxy = posy + image->height;
 		}
 	}
-	if ((!assembled) && (image_list->type == IMAGE_TYPE_TILE)) {
-		struct TileObjectList *tile_objects = image_list->data;
-		for (int i = 0; i < tile_objects->tile_count; i++) {
-			tile_objects->tiles[i].rect.x += image_list->images[i].x;
-			tile_objects->tiles[i].rect.y += image_list->images[i].y;
-		}
+	sh2ckImageListPlaceTiles(image_list, assembled);
+	if (maxx <= (width / 2)) {
+		width = width / 2;
 	}
 	atlas_size->x = 0;
 	atlas_size->y = 0;
-	atlas_size->width = maxx;
+	atlas_size->width = width;
 	atlas_size->height = maxy;
 
-	free(vals);
+	sh2ckMemoryFree(vals);
 	return 0;
 }
 
-static void placeImage(struct Image *atlas, struct Offset offset,
-                       struct Image *image)
+/*copies the rows of image that lie inside of band*/
+static void placeImage(struct Sh2ckImage *band, struct Sh2ckOffset offset,
+                       struct Sh2ckImage *image)
 {
-	for (int y = 0; y < image->height; y++) {
-		for (int x = 0; x < image->width; x++) {
-			int posx = image->x + x;
-			int posy = image->y + y;
-			atlas->pixel[posy * atlas->width + posx] =
-			    image->pixel[(y + offset.y) * (image->pitch) + x + offset.x];
-		}
+	int first = image->y > band->y ? image->y : band->y;
+	int last = image->y + image->height;
+	if (last > band->y + band->height) {
+		last = band->y + band->height;
+	}
+	for (int y = first; y < last; y++) {
+		memcpy(&band->pixel[(y - band->y) * band->width + image->x],
+		       &image->pixel[(y - image->y + offset.y) * image->pitch +
+		                     offset.x],
+		       sizeof(*image->pixel) * image->width);
 	}
 }
 
-int imagecreateAtlas(struct Image *atlas, struct ImageList *image_list,
-                     int width, int sort, int assembled)
+void sh2ckImageComposeAtlasBand(struct Sh2ckImage *band,
+                                struct Sh2ckImageList *image_list,
+                                const struct Sh2ckOffset *image_offsets)
 {
-	struct Rect atlas_size;
-	struct Offset *image_offsets = NULL;
-	if (image_list->type == IMAGE_TYPE_ANIMATION) {
-		image_offsets =
-		    malloc(sizeof(*image_offsets) * image_list->image_count);
+	memset(band->pixel, 0,
+	       sizeof(*band->pixel) * band->width * band->height);
+	for (int i = 0; i < image_list->image_count; i++) {
+		struct Sh2ckOffset offset = {0, 0};
+		if (image_offsets != NULL) {
+			offset = image_offsets[i];
+		}
+		placeImage(band, offset, &image_list->images[i]);
 	}
-	if (layout(image_list, &atlas_size, image_offsets, width, sort,
-	           assembled) != 0) {
+}
+
+int sh2ckImageComposeAtlas(struct Sh2ckImage *atlas,
+                           struct Sh2ckImageList *image_list,
+                           const struct Sh2ckOffset *image_offsets,
+                           const struct Sh2ckRect *atlas_size)
+{
+	if (sh2ckImageCreate(atlas, NULL, atlas_size->width, atlas_size->height) ==
+	    -1) {
 		return -1;
 	}
+	sh2ckImageComposeAtlasBand(atlas, image_list, image_offsets);
+	return 0;
+}
 
-	if (atlas_size.width <= (width / 2)) {
-		width = width / 2;
+struct AtlasBands {
+	struct Sh2ckImageList *image_list;
+	const struct Sh2ckOffset *image_offsets;
+	const struct ImagePalette *palette;
+	int width;
+	int height;
+};
+
+static void fillAtlasBand(void *context, struct Sh2ckImage *band)
+{
+	struct AtlasBands *bands = context;
+	int height = band->height;
+	/*the last band is cut to the atlas, so nothing is composed below it*/
+	if (band->y + band->height > bands->height) {
+		band->height = bands->height - band->y;
 	}
-	imageCreate(atlas, NULL, width, atlas_size.height);
-	imageClear(atlas, 0x00);
+	sh2ckImageComposeAtlasBand(band, bands->image_list, bands->image_offsets);
+	band->height = height;
+}
+
+/*composes the rows straight into the buffer of the encoder*/
+static void atlasRows(void *context, uint8_t *rows, int first, int count)
+{
+	struct AtlasBands *bands = context;
+	struct Sh2ckImage band = {0, first, bands->width, count, bands->width,
+	                          (struct Sh2ckColor *)rows};
+	sh2ckImageComposeAtlasBand(&band, bands->image_list, bands->image_offsets);
+	packRows(rows, band.pixel, count * band.width, bands->palette);
+}
+
+/*the palette of all images of the atlas, its gaps are transparent*/
+static struct ImagePalette *atlasPalette(
+    struct Sh2ckImageList *image_list, const struct Sh2ckOffset *image_offsets)
+{
+	struct ImagePalette *palette = paletteCreate();
+	if (palette == NULL) {
+		return NULL;
+	}
+	palette->transparent = 1;
 	for (int i = 0; i < image_list->image_count; i++) {
-		struct Offset offset = {0, 0};
-		if (image_list->type == IMAGE_TYPE_ANIMATION) {
+		struct Sh2ckOffset offset = {0, 0};
+		if (image_offsets != NULL) {
 			offset = image_offsets[i];
 		}
-		placeImage(atlas, offset, &image_list->images[i]);
+		if (paletteAdd(palette, &image_list->images[i], offset) == -1) {
+			sh2ckMemoryFree(palette);
+			return NULL;
+		}
+	}
+	if (paletteFinish(palette) == -1) {
+		sh2ckMemoryFree(palette);
+		return NULL;
+	}
+	return palette;
+}
+
+static int saveAtlasBands(struct AtlasBands *bands, int band_height,
+                          const char *file, struct Sh2ckThreadPool *pool)
+{
+	struct Sh2ckImage band;
+
+	if (encodeInParallel(pool, bands->width, bands->height)) {
+		struct EncodeHeader header;
+		encodeHeader(&header, bands->width, bands->height, bands->palette);
+		return sh2ckEncodePngParallel(file, &header, atlasRows, bands, pool);
+	}
+	if (band_height > bands->height) {
+		band_height = bands->height;
+	}
+	if (band_height <= 0) {
+		band_height = 1;
+	}
+	if (sh2ckImageCreate(&band, NULL, bands->width, band_height) == -1) {
+		return -1;
+	}
+	int ret = savePng(file, &band, bands->height, fillAtlasBand, bands,
+	                  bands->palette);
+	sh2ckImageDelete(&band, NULL);
+	return ret;
+}
+
+int sh2ckImageSaveAtlas(struct Sh2ckImageList *image_list,
+                        const struct Sh2ckOffset *image_offsets,
+                        const struct Sh2ckRect *atlas_size, int band_height,
+                        const char *file, struct Sh2ckThreadPool *pool)
+{
+	struct AtlasBands bands = {image_list, image_offsets, NULL,
+	                           atlas_size->width, atlas_size->height};
+	struct ImagePalette *palette = atlasPalette(image_list, image_offsets);
+	bands.palette = palette;
+	int ret = saveAtlasBands(&bands, band_height, file, pool);
+	sh2ckMemoryFree(palette);
+	return ret;
+}
+
+int sh2ckImageCreateAtlas(struct Sh2ckImage *atlas,
+                          struct Sh2ckImageList *image_list, int width,
+                          int sort, int assembled)
+{
+	struct Sh2ckRect atlas_size;
+	struct Sh2ckOffset *image_offsets = NULL;
+	if (image_list->type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		image_offsets =
+		    sh2ckMemoryAlloc(sizeof(*image_offsets) * image_list->image_count);
+		if (image_offsets == NULL) {
+			return -1;
+		}
+		sh2ckShrinkAnimationImages(image_list, image_offsets);
+	}
+	if (sh2ckImageLayoutAtlas(image_list, &atlas_size, width, sort,
+	                          assembled) != 0 ||
+	    sh2ckImageComposeAtlas(atlas, image_list, image_offsets,
+	                           &atlas_size) != 0) {
+		sh2ckMemoryFree(image_offsets);
+		return -1;
 	}
-	free(image_offsets);
+	sh2ckMemoryFree(image_offsets);
 	return 0;
 }
@@ -15,124 +15,234 @@
  *
  */
 
-#ifndef IMAGE_H
-#define IMAGE_H
+#ifndef SH2CK_IMAGE_H
+#define SH2CK_IMAGE_H
 
 #include <stdint.h>
 
-#define COLOR_MASK_BLUE 0x001F
-#define COLOR_MASK_GREEN 0x03E0
-#define COLOR_MASK_RED 0x7C00
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-#define COLOR_CONVERT_BLUE(c) ((uint8_t)((COLOR_MASK_BLUE & (c)) << 3))
-#define COLOR_CONVERT_GREEN(c) ((uint8_t)((COLOR_MASK_GREEN & (c)) >> 2))
-#define COLOR_CONVERT_RED(c) ((uint8_t)((COLOR_MASK_RED & (c)) >> 7))
+struct Sh2ckThreadPool;
 
-#define IMAGE_TYPE_ANIMATION 0x0
-#define IMAGE_TYPE_TILE 0x1
-#define IMAGE_TYPE_OTHER 0x2
+#define SH2CK_COLOR_MASK_BLUE 0x001F
+#define SH2CK_COLOR_MASK_GREEN 0x03E0
+#define SH2CK_COLOR_MASK_RED 0x7C00
 
-struct Pos {
+#define SH2CK_COLOR_CONVERT_BLUE(c) \
+	((uint8_t)((SH2CK_COLOR_MASK_BLUE & (c)) << 3))
+#define SH2CK_COLOR_CONVERT_GREEN(c) \
+	((uint8_t)((SH2CK_COLOR_MASK_GREEN & (c)) >> 2))
+#define SH2CK_COLOR_CONVERT_RED(c) \
+	((uint8_t)((SH2CK_COLOR_MASK_RED & (c)) >> 7))
+
+#define SH2CK_IMAGE_TYPE_ANIMATION 0x0
+#define SH2CK_IMAGE_TYPE_TILE 0x1
+#define SH2CK_IMAGE_TYPE_OTHER 0x2
+
+/*pngs with at most this many colours are written with a palette*/
+#define SH2CK_IMAGE_PALETTE_SIZE 256
+
+/*rows of the atlas composed at once by sh2ckImageSaveAtlas*/
+#define SH2CK_IMAGE_ATLAS_BAND_HEIGHT 64
+
+struct Sh2ckPos {
 	int16_t x;
 	int16_t y;
 };
 
-struct Rect {
+struct Sh2ckRect {
 	int16_t x;
 	int16_t y;
 	int16_t width;
 	int16_t height;
 };
 
-struct Color {
+struct Sh2ckOffset {
+	int16_t x;
+	int16_t y;
+};
+
+struct Sh2ckColor {
 	uint8_t b;
 	uint8_t g;
 	uint8_t r;
 	uint8_t a;
 };
 
-struct Image {
+struct Sh2ckImage {
 	int16_t x;
 	int16_t y;
 	int16_t width;
 	int16_t height;
 	int16_t pitch;
-	struct Color *pixel;
+	struct Sh2ckColor *pixel;
 };
 
-struct ImageList {
+struct Sh2ckImageList {
 	int type;
 	int image_count;
 	int pixel_buffer_size;
-	struct Image *images;
+	struct Sh2ckImage *images;
 	void *data;
 	uint8_t *free;
 	uint8_t *pixel_buffer;
 };
 
-struct TilePart {
+struct Sh2ckTilePart {
 	uint16_t id;
 	int16_t x;
 	int16_t y;
-	struct Rect rect;
+	struct Sh2ckRect rect;
+	/*position on the map inside of the object, x + y is the depth*/
+	struct Sh2ckPos grid;
+	/*the ground diamond of the tile in the image of its object*/
+	struct Sh2ckRect footprint;
+	/*pixels the part rises above the top of its diamond*/
+	int16_t elevation;
 };
 
-struct TileObject {
+struct Sh2ckTileObject {
 	uint16_t id;
 	int16_t part_count;
 	int16_t tile_start;
 };
 
-struct TileObjectList {
+struct Sh2ckTileObjectList {
+	/*1 if each image is an assembled object, 0 if each image is a tile*/
+	int assembled;
 	int object_count;
 	int tile_count;
-	struct TileObject *objects;
-	struct TilePart *tiles;
+	struct Sh2ckTileObject *objects;
+	struct Sh2ckTilePart *tiles;
 };
 
-struct AnimationFrame {
+struct Sh2ckAnimationFrame {
 	uint16_t id;
-	struct Pos center;
+	struct Sh2ckPos center;
 };
 
-struct Animation {
+struct Sh2ckAnimation {
 	int frame_count;
-	struct AnimationFrame *frames;
+	struct Sh2ckAnimationFrame *frames;
 };
 
-uint16_t imageGetColor16Bit(uint8_t *data);
+uint16_t sh2ckImageGetColor16Bit(uint8_t *data);
+
+int sh2ckImageCreate(struct Sh2ckImage *image,
+                     struct Sh2ckImageList *image_list, int width, int height);
+
+/*images whose colours fit into SH2CK_IMAGE_PALETTE_SIZE entries are written as
+ * indexed png*/
+int sh2ckImageSave(struct Sh2ckImage *image, const char *file);
+
+/*like sh2ckImageSave, but large images are deflated in chunks on the threads of
+ * pool. The file differs from sh2ckImageSave, the pixels do not.*/
+int sh2ckImageSaveParallel(struct Sh2ckImage *image, const char *file,
+                           struct Sh2ckThreadPool *pool);
+
+void sh2ckImageClear(struct Sh2ckImage *image, uint32_t color);
+
+void sh2ckImageDelete(struct Sh2ckImage *image,
+                      struct Sh2ckImageList *image_list);
+
+int sh2ckImageCreateList(struct Sh2ckImageList *image_list,
+                         int pixel_buffer_size, int count, int object_count,
+                         int tile_count, int type);
+
+/*bytes needed for the pixels of all images in the list*/
+int sh2ckImageListPixelSize(struct Sh2ckImageList *image_list);
+
+/*allocates the pixel buffer of a list created with a pixel_buffer_size of 0
+ * and assigns every image its pixels*/
+int sh2ckImageListAllocatePixels(struct Sh2ckImageList *image_list,
+                                 int pixel_buffer_size);
+
+void sh2ckImageDeleteList(struct Sh2ckImageList *image_list);
+
+/*averages every 2x2 block of image into one pixel of half, weighted by alpha
+ * so transparent pixels do not darken the edges. half has to be
+ * (width + 1) / 2 by (height + 1) / 2.*/
+void sh2ckImageDownscaleHalf(struct Sh2ckImage *half,
+                             const struct Sh2ckImage *image);
+
+/*creates a list with every image of image_list at half the size, and the
+ * animation centers and tile rects scaled to match. Has to be called before
+ * image_list is trimmed or laid out.*/
+int sh2ckImageListCreateHalf(struct Sh2ckImageList *half,
+                             struct Sh2ckImageList *image_list,
+                             struct Sh2ckThreadPool *pool);
+
+int sh2ckTileObjectCreate(struct Sh2ckTileObject *object, int part_count,
+                          int start_index);
+
+void sh2ckTileObjectDelete(struct Sh2ckTileObject *object);
 
-int imageCreate(struct Image *image, struct ImageList *image_list, int width,
-                int height);
+int sh2ckTileObjectCreateList(struct Sh2ckTileObjectList *object_list,
+                              int object_count, int tile_count);
 
-int imageSave(struct Image *image, const char *file);
+void sh2ckTileObjectDeleteList(struct Sh2ckTileObjectList *object_list);
 
-void imageClear(struct Image *image, uint32_t color);
+int sh2ckAnimationCreate(struct Sh2ckAnimation *animation, int frame_count);
 
-void imageDelete(struct Image *image, struct ImageList *image_list);
+void sh2ckAnimationDelete(struct Sh2ckAnimation *animation);
 
-int imageCreateList(struct ImageList *image_list, int pixel_buffer_size,
-                    int count, int object_count, int tile_count, int type);
+int sh2ckImageWriteData(struct Sh2ckImageList *image_list, const char *file);
 
-void imageDeleteList(struct ImageList *image_list);
+/*writes the map position, depth, ground diamond and elevation of every tile
+ * and the size, highest elevation and ground bounds of every object. The
+ * bounds are 0 if the objects are not assembled.*/
+int sh2ckImageWriteFootprints(struct Sh2ckImageList *image_list,
+                              const char *file);
 
-int tileObjectCreate(struct TileObject *object, int part_count,
-                     int start_index);
+/*bounds of the pixels that are not fully transparent, 0 wide and high at 0, 0
+ * if there are none*/
+void sh2ckImageBoundingBox(struct Sh2ckRect *bbox, struct Sh2ckImage *image);
 
-void tileObjectDelete(struct TileObject *object);
+/*trims animation frames to their bounding box, the offsets of the trimmed
+ * images in the source images are stored in source_offsets*/
+void sh2ckShrinkAnimationImages(struct Sh2ckImageList *image_list,
+                                struct Sh2ckOffset *source_offsets);
 
-int tileObjectCreateList(struct TileObjectList *object_list, int object_count,
-                         int tile_count);
+/*moves the tile rects of a tile list to the atlas positions of their
+ * images*/
+void sh2ckImageListPlaceTiles(struct Sh2ckImageList *image_list, int assembled);
 
-void tileObjectDeleteList(struct TileObjectList *object_list);
+/*assigns atlas positions to the images, atlas_size receives the texture
+ * size*/
+int sh2ckImageLayoutAtlas(struct Sh2ckImageList *image_list,
+                          struct Sh2ckRect *atlas_size, int width, int sort,
+                          int assembled);
 
-int animationCreate(struct Animation *animation, int frame_count);
+/*image_offsets may be NULL if no images were trimmed*/
+int sh2ckImageComposeAtlas(struct Sh2ckImage *atlas,
+                           struct Sh2ckImageList *image_list,
+                           const struct Sh2ckOffset *image_offsets,
+                           const struct Sh2ckRect *atlas_size);
 
-void animationDelete(struct Animation *animation);
+/*composes the rows band->y to band->y + band->height of a laid out atlas into
+ * band, which has the width of the atlas*/
+void sh2ckImageComposeAtlasBand(struct Sh2ckImage *band,
+                                struct Sh2ckImageList *image_list,
+                                const struct Sh2ckOffset *image_offsets);
 
-int imageWriteData(struct ImageList *image_list, const char *file);
+/*composes a laid out atlas band by band and writes each band to the png
+ * right away, so only band_height rows of the atlas are held in memory.
+ * With a pool, large atlases are composed and deflated in chunks on its
+ * threads instead, as in sh2ckImageSaveParallel.*/
+int sh2ckImageSaveAtlas(struct Sh2ckImageList *image_list,
+                        const struct Sh2ckOffset *image_offsets,
+                        const struct Sh2ckRect *atlas_size, int band_height,
+                        const char *file, struct Sh2ckThreadPool *pool);
 
-int imagecreateAtlas(struct Image *atlas, struct ImageList *image_list,
-                     int width, int sort, int assembled);
+/*shrink, layout and compose in one step*/
+int sh2ckImageCreateAtlas(struct Sh2ckImage *atlas,
+                          struct Sh2ckImageList *image_list, int width,
+                          int sort, int assembled);
 
-#endif  // IMAGE_H
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_IMAGE_H
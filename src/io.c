@@ -0,0 +1,385 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "memory.h"
+
+#define IO_REQUEST_PREFETCH 0
+#define IO_REQUEST_WRITE 1
+#define IO_REQUEST_CALL 2
+
+/*files a thread may have open with sh2ckIoOpen at once, more are written
+ * directly*/
+#define IO_STREAM_COUNT 4
+
+#define IO_READ_SIZE (64 * 1024)
+
+struct IoRequest {
+	int type;
+	char *file;
+	/*allocated by open_memstream, so it is released with free and not
+	 * through the allocator*/
+	char *data;
+	size_t size;
+	int *failed;
+	IoFunction function;
+	void *context;
+	struct IoRequest *next;
+};
+
+struct IoQueue {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/*prefetches run before writes*/
+	struct IoRequest *prefetch_head;
+	struct IoRequest *prefetch_tail;
+	struct IoRequest *write_head;
+	struct IoRequest *write_tail;
+	/*bytes of the queued files, sh2ckIoClose waits while they exceed
+	 * max_bytes*/
+	int64_t queued_bytes;
+	int64_t max_bytes;
+	int shutdown;
+};
+
+struct IoStream {
+	FILE *fp;
+	char *file;
+	char *data;
+	size_t size;
+};
+
+static _Thread_local struct IoQueue *thread_queue;
+static _Thread_local int *thread_failed;
+static _Thread_local struct IoStream thread_streams[IO_STREAM_COUNT];
+
+static void prefetchFile(const char *file)
+{
+	int fd = open(file, O_RDONLY);
+	if (fd == -1) {
+		return;
+	}
+#ifdef POSIX_FADV_WILLNEED
+	if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0) {
+		close(fd);
+		return;
+	}
+#endif
+	char *buffer = sh2ckMemoryAlloc(IO_READ_SIZE);
+	if (buffer != NULL) {
+		while (read(fd, buffer, IO_READ_SIZE) > 0) {
+		}
+		sh2ckMemoryFree(buffer);
+	}
+	close(fd);
+}
+
+static int writeFile(struct IoRequest *request)
+{
+	FILE *fp = fopen(request->file, "wb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (request->size > 0 &&
+	    fwrite(request->data, request->size, 1, fp) != 1) {
+		fclose(fp);
+		return -1;
+	}
+	return fclose(fp);
+}
+
+static void runRequest(struct IoRequest *request)
+{
+	if (request->type == IO_REQUEST_PREFETCH) {
+		prefetchFile(request->file);
+	} else if (request->type == IO_REQUEST_WRITE) {
+		if (writeFile(request) == -1) {
+			fprintf(stderr, "Error on writing %s\n", request->file);
+			if (request->failed != NULL) {
+				*request->failed = 1;
+			}
+		}
+	} else {
+		request->function(request->context);
+	}
+}
+
+static void deleteRequest(struct IoRequest *request)
+{
+	free(request->data);
+	sh2ckMemoryFree(request->file);
+	sh2ckMemoryFree(request);
+}
+
+/*A write stays at the head of its list until the file is written, so
+ * sh2ckIoFileSize still finds it. Only this thread removes requests.*/
+static void *ioThread(void *context)
+{
+	struct IoQueue *queue = context;
+	pthread_mutex_lock(&queue->mutex);
+	for (;;) {
+		struct IoRequest *request = queue->prefetch_head;
+		if (request != NULL) {
+			queue->prefetch_head = request->next;
+			if (queue->prefetch_head == NULL) {
+				queue->prefetch_tail = NULL;
+			}
+			pthread_mutex_unlock(&queue->mutex);
+			runRequest(request);
+			deleteRequest(request);
+			pthread_mutex_lock(&queue->mutex);
+			continue;
+		}
+		request = queue->write_head;
+		if (request == NULL) {
+			if (queue->shutdown) {
+				break;
+			}
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&queue->mutex);
+		runRequest(request);
+		pthread_mutex_lock(&queue->mutex);
+		queue->write_head = request->next;
+		if (queue->write_head == NULL) {
+			queue->write_tail = NULL;
+		}
+		queue->queued_bytes -= request->size;
+		deleteRequest(request);
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	return NULL;
+}
+
+struct IoQueue *sh2ckIoQueueCreate(int64_t max_bytes)
+{
+	struct IoQueue *queue = sh2ckMemoryAlloc(sizeof(*queue));
+	if (queue == NULL) {
+		return NULL;
+	}
+	queue->prefetch_head = NULL;
+	queue->prefetch_tail = NULL;
+	queue->write_head = NULL;
+	queue->write_tail = NULL;
+	queue->queued_bytes = 0;
+	queue->max_bytes = max_bytes;
+	queue->shutdown = 0;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	if (pthread_create(&queue->thread, NULL, ioThread, queue) != 0) {
+		pthread_cond_destroy(&queue->cond);
+		pthread_mutex_destroy(&queue->mutex);
+		sh2ckMemoryFree(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+void sh2ckIoQueueDelete(struct IoQueue *queue)
+{
+	if (queue == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&queue->mutex);
+	queue->shutdown = 1;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_join(queue->thread, NULL);
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->mutex);
+	sh2ckMemoryFree(queue);
+}
+
+static char *copyString(const char *string)
+{
+	size_t size = strlen(string) + 1;
+	char *copy = sh2ckMemoryAlloc(size);
+	if (copy != NULL) {
+		memcpy(copy, string, size);
+	}
+	return copy;
+}
+
+static struct IoRequest *createRequest(int type, const char *file)
+{
+	struct IoRequest *request = sh2ckMemoryAlloc(sizeof(*request));
+	if (request == NULL) {
+		return NULL;
+	}
+	memset(request, 0, sizeof(*request));
+	request->type = type;
+	if (file != NULL) {
+		request->file = copyString(file);
+		if (request->file == NULL) {
+			sh2ckMemoryFree(request);
+			return NULL;
+		}
+	}
+	return request;
+}
+
+int sh2ckIoPrefetch(struct IoQueue *queue, const char *file)
+{
+	struct IoRequest *request = createRequest(IO_REQUEST_PREFETCH, file);
+	if (request == NULL) {
+		return -1;
+	}
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->prefetch_tail != NULL) {
+		queue->prefetch_tail->next = request;
+	} else {
+		queue->prefetch_head = request;
+	}
+	queue->prefetch_tail = request;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+	return 0;
+}
+
+static void queueWrite(struct IoQueue *queue, struct IoRequest *request)
+{
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->queued_bytes + (int64_t)request->size > queue->max_bytes) {
+		pthread_cond_wait(&queue->cond, &queue->mutex);
+	}
+	if (queue->write_tail != NULL) {
+		queue->write_tail->next = request;
+	} else {
+		queue->write_head = request;
+	}
+	queue->write_tail = request;
+	queue->queued_bytes += request->size;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+void sh2ckIoSetThreadQueue(struct IoQueue *queue, int *failed)
+{
+	thread_queue = queue;
+	thread_failed = failed;
+}
+
+int sh2ckIoQueueCall(struct IoQueue *queue, IoFunction function, void *context)
+{
+	struct IoRequest *request = createRequest(IO_REQUEST_CALL, NULL);
+	if (request == NULL) {
+		return -1;
+	}
+	request->function = function;
+	request->context = context;
+	queueWrite(queue, request);
+	return 0;
+}
+
+FILE *sh2ckIoOpen(const char *file)
+{
+	if (thread_queue == NULL) {
+		return fopen(file, "wb");
+	}
+	struct IoStream *stream = NULL;
+	for (int i = 0; i < IO_STREAM_COUNT; i++) {
+		if (thread_streams[i].fp == NULL) {
+			stream = &thread_streams[i];
+			break;
+		}
+	}
+	if (stream == NULL) {
+		return fopen(file, "wb");
+	}
+	stream->file = copyString(file);
+	if (stream->file == NULL) {
+		return NULL;
+	}
+	stream->fp = open_memstream(&stream->data, &stream->size);
+	if (stream->fp == NULL) {
+		sh2ckMemoryFree(stream->file);
+		stream->file = NULL;
+	}
+	return stream->fp;
+}
+
+int sh2ckIoClose(FILE *fp)
+{
+	struct IoStream *stream = NULL;
+	for (int i = 0; i < IO_STREAM_COUNT; i++) {
+		if (thread_streams[i].fp == fp) {
+			stream = &thread_streams[i];
+			break;
+		}
+	}
+	if (stream == NULL) {
+		return fclose(fp);
+	}
+	int ret = fclose(fp);
+	struct IoRequest *request = createRequest(IO_REQUEST_WRITE, NULL);
+	if (ret != 0 || request == NULL) {
+		free(stream->data);
+		sh2ckMemoryFree(stream->file);
+		sh2ckMemoryFree(request);
+		memset(stream, 0, sizeof(*stream));
+		return -1;
+	}
+	request->file = stream->file;
+	request->data = stream->data;
+	request->size = stream->size;
+	request->failed = thread_failed;
+	memset(stream, 0, sizeof(*stream));
+	/*the queue never holds more than max_bytes, so a file larger than that
+	 * would wait forever*/
+	if ((int64_t)request->size > thread_queue->max_bytes) {
+		ret = writeFile(request);
+		deleteRequest(request);
+		return ret;
+	}
+	queueWrite(thread_queue, request);
+	return 0;
+}
+
+int64_t sh2ckIoFileSize(const char *file)
+{
+	struct IoQueue *queue = thread_queue;
+	int64_t size = -1;
+	if (queue != NULL) {
+		pthread_mutex_lock(&queue->mutex);
+		for (struct IoRequest *request = queue->write_head;
+		     request != NULL; request = request->next) {
+			if (request->type == IO_REQUEST_WRITE &&
+			    strcmp(request->file, file) == 0) {
+				size = request->size;
+			}
+		}
+		pthread_mutex_unlock(&queue->mutex);
+	}
+	if (size == -1) {
+		struct stat file_stat;
+		if (stat(file, &file_stat) == -1) {
+			return 0;
+		}
+		size = file_stat.st_size;
+	}
+	return size;
+}
@@ -0,0 +1,70 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_IO_H
+#define SH2CK_IO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*A thread that reads input files ahead and writes output files in the
+ * background, so the threads converting files do not wait on the disk or the
+ * network.*/
+struct IoQueue;
+
+typedef void (*IoFunction)(void *context);
+
+/*At most max_bytes of output files wait in the queue. NULL on failure.*/
+struct IoQueue *sh2ckIoQueueCreate(int64_t max_bytes);
+
+/*writes everything still queued and stops the thread*/
+void sh2ckIoQueueDelete(struct IoQueue *queue);
+
+/*reads file into the page cache on the queue's thread, with posix_fadvise
+ * where available and by reading it otherwise*/
+int sh2ckIoPrefetch(struct IoQueue *queue, const char *file);
+
+/*Files opened with sh2ckIoOpen on the calling thread are written by queue until
+ * this is called again with NULL. failed is set on the queue's thread when
+ * one of them can not be written.*/
+void sh2ckIoSetThreadQueue(struct IoQueue *queue, int *failed);
+
+/*calls function(context) on the queue's thread once every file queued
+ * before it is written*/
+int sh2ckIoQueueCall(struct IoQueue *queue, IoFunction function, void *context);
+
+/*opens file for writing, into memory if the calling thread has a queue*/
+FILE *sh2ckIoOpen(const char *file);
+
+/*Closes a file opened with sh2ckIoOpen. With a queue the data is handed to it,
+ * waiting while the queue is full, and errors on writing the file are only
+ * reported through the failed flag of sh2ckIoSetThreadQueue. Files larger
+ * than the queue are written right away instead.*/
+int sh2ckIoClose(FILE *fp);
+
+/*size of file, or of the data still queued for it*/
+int64_t sh2ckIoFileSize(const char *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_IO_H
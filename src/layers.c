@@ -0,0 +1,170 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "image.h"
+#include "io.h"
+#include "layers.h"
+#include "memory.h"
+
+#define LAYER_ARRAY_HEADER_SIZE 20
+#define LAYER_SIZE_BYTES 4
+
+void sh2ckLayerArraySize(const struct Sh2ckImageList *image_list, int *width,
+                         int *height)
+{
+	*width = 0;
+	*height = 0;
+	for (int i = 0; i < image_list->image_count; i++) {
+		const struct Sh2ckImage *image = &image_list->images[i];
+		if (image->width > *width) {
+			*width = image->width;
+		}
+		if (image->height > *height) {
+			*height = image->height;
+		}
+	}
+}
+
+/*copies image into the bottom left corner of the cleared layer as rgba*/
+static void fillLayer(uint8_t *layer, int width, int height,
+                      const struct Sh2ckImage *image)
+{
+	memset(layer, 0, (size_t)width * height * 4);
+	int top = height - image->height;
+	for (int y = 0; y < image->height; y++) {
+		const struct Sh2ckColor *row = image->pixel + y * image->pitch;
+		uint8_t *out = layer + ((size_t)(top + y) * width) * 4;
+		for (int x = 0; x < image->width; x++) {
+			out[4 * x] = row[x].r;
+			out[4 * x + 1] = row[x].g;
+			out[4 * x + 2] = row[x].b;
+			out[4 * x + 3] = row[x].a;
+		}
+	}
+}
+
+int sh2ckLayerArraySave(const char *file,
+                        const struct Sh2ckImageList *image_list)
+{
+	int width;
+	int height;
+	sh2ckLayerArraySize(image_list, &width, &height);
+	if (width == 0 || height == 0) {
+		return -1;
+	}
+	uint32_t header[4] = {LAYER_ARRAY_VERSION, width, height,
+	                      image_list->image_count};
+	uint8_t *layer = sh2ckMemoryAlloc((size_t)width * height * 4);
+	if (layer == NULL) {
+		return -1;
+	}
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		sh2ckMemoryFree(layer);
+		return -1;
+	}
+	fwrite(LAYER_ARRAY_MAGIC, 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+	for (int i = 0; i < image_list->image_count; i++) {
+		uint16_t size[2] = {image_list->images[i].width,
+		                    image_list->images[i].height};
+		fwrite(size, sizeof(size), 1, fp);
+	}
+	for (int i = 0; i < image_list->image_count && !ferror(fp); i++) {
+		fillLayer(layer, width, height, &image_list->images[i]);
+		fwrite(layer, (size_t)width * height * 4, 1, fp);
+	}
+	sh2ckMemoryFree(layer);
+	if (ferror(fp)) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+int sh2ckLayerArrayLoad(struct LayerArray *array, const char *file)
+{
+	uint32_t header[4];
+	memset(array, 0, sizeof(*array));
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return -1;
+	}
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < LAYER_ARRAY_HEADER_SIZE) {
+		fclose(fp);
+		return -1;
+	}
+	array->buffer = sh2ckMemoryAlloc(size);
+	if (array->buffer == NULL ||
+	    fread(array->buffer, 1, size, fp) < (size_t)size) {
+		fclose(fp);
+		sh2ckLayerArrayDelete(array);
+		return -1;
+	}
+	fclose(fp);
+
+	memcpy(header, array->buffer + 4, sizeof(header));
+	/*images are at most UINT16_MAX wide, so the products below can not
+	 * wrap once the count is known to fit the file*/
+	if (memcmp(array->buffer, LAYER_ARRAY_MAGIC, 4) != 0 ||
+	    header[0] != LAYER_ARRAY_VERSION || header[1] > UINT16_MAX ||
+	    header[2] > UINT16_MAX || header[3] > INT_MAX) {
+		sh2ckLayerArrayDelete(array);
+		return -1;
+	}
+	uint64_t layer_size = (uint64_t)header[1] * header[2] * 4;
+	uint64_t data_size = size - LAYER_ARRAY_HEADER_SIZE;
+	if (header[3] > data_size / (LAYER_SIZE_BYTES + layer_size) ||
+	    header[3] * (LAYER_SIZE_BYTES + layer_size) != data_size) {
+		sh2ckLayerArrayDelete(array);
+		return -1;
+	}
+	array->width = header[1];
+	array->height = header[2];
+	array->layer_count = header[3];
+	array->sizes = (const uint16_t *)(array->buffer + LAYER_ARRAY_HEADER_SIZE);
+	array->pixels = array->buffer + LAYER_ARRAY_HEADER_SIZE +
+	                LAYER_SIZE_BYTES * array->layer_count;
+	return 0;
+}
+
+const uint8_t *sh2ckLayerArrayGet(const struct LayerArray *array, int index)
+{
+	if (index < 0 || index >= array->layer_count) {
+		return NULL;
+	}
+	return array->pixels + (size_t)index * array->width * array->height * 4;
+}
+
+void sh2ckLayerArrayDelete(struct LayerArray *array)
+{
+	if (array != NULL) {
+		sh2ckMemoryFree(array->buffer);
+		memset(array, 0, sizeof(*array));
+	}
+}
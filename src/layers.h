@@ -0,0 +1,71 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_LAYERS_H
+#define SH2CK_LAYERS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Images of about the same size as the layers of a 2d texture array, so
+ * they can be drawn without an atlas or uv lookups. The file starts with
+ * LAYER_ARRAY_MAGIC, the version and the width, height and count of the
+ * layers as uint32. Then follow the width and height of the image in every
+ * layer as uint16 and the pixels of every layer as rgba, top row first.
+ * Images smaller than the layers sit in the bottom left corner, where tiles
+ * have their ground diamond.*/
+
+#define LAYER_ARRAY_MAGIC "SH2L"
+#define LAYER_ARRAY_VERSION 1
+
+struct Sh2ckImageList;
+
+struct LayerArray {
+	int width;
+	int height;
+	int layer_count;
+	/*width and height of the image in every layer*/
+	const uint16_t *sizes;
+	const uint8_t *pixels;
+	uint8_t *buffer;
+};
+
+/*the layer size that fits every image of the list*/
+void sh2ckLayerArraySize(const struct Sh2ckImageList *image_list, int *width,
+                         int *height);
+
+/*Writes one layer per image. Only one layer is composed at a time, but the
+ * whole file is held in memory if the calling thread writes through an io
+ * queue.*/
+int sh2ckLayerArraySave(const char *file,
+                        const struct Sh2ckImageList *image_list);
+
+int sh2ckLayerArrayLoad(struct LayerArray *array, const char *file);
+
+/*the rgba pixels of layer index*/
+const uint8_t *sh2ckLayerArrayGet(const struct LayerArray *array, int index);
+
+void sh2ckLayerArrayDelete(struct LayerArray *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_LAYERS_H
@@ -15,19 +15,48 @@
  *
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "atlas.h"
+#include "cache.h"
+#include "delta.h"
+#include "font.h"
 #include "gm1.h"
 #include "image.h"
+#include "io.h"
+#include "layers.h"
+#include "mask.h"
+#include "sprite.h"
+#include "stats.h"
 #include "tgx.h"
+#include "thread.h"
 
-#define PIXEL_BUFFER_SIZE 100 * 1024 * 1024
+/*bump when the output of a conversion changes for the same options*/
+#define OUTPUT_FORMAT_VERSION 2
+
+#define ATLAS_WIDTH 1024
+#define SHARED_PAGE_SIZE 2048
+/*half and quarter size*/
+#define LOD_LEVELS_MAX 2
+/*atlas and data of every level, sprites, delta, masks, footprints, header
+ * and palette*/
+#define OUTPUT_COUNT_MAX (2 * (LOD_LEVELS_MAX + 1) + 6)
+/*inputs read ahead of the running files in batch mode*/
+#define PREFETCH_COUNT 4
+/*bytes of output files waiting to be written in batch mode, at most a
+ * quarter of the memory budget*/
+#define WRITE_QUEUE_SIZE (64 * 1024 * 1024)
 
 struct Options {
 	unsigned int convert_tgx;
@@ -36,12 +65,67 @@ struct Options {
 	unsigned int assemble;
 	unsigned int pack;
 	unsigned int sort;
+	unsigned int force;
+	unsigned int info;
+	unsigned int csv;
+	unsigned int stats;
+	unsigned int sprites;
+	unsigned int delta;
+	unsigned int masks;
+	unsigned int footprints;
+	unsigned int layers;
+	unsigned int glyphs;
+	/*downscaled copies written next to the full size images*/
+	unsigned int lod;
+	const char *trace_file;
+	const char *batch_file;
+	const char *shared_file;
+	int page_size;
+	int jobs;
+	int64_t max_memory;
+	/*threads that help decoding a single file, may be NULL*/
+	struct Sh2ckThreadPool *pool;
+};
+
+struct Job {
+	struct Options *options;
+	char *line;
+	const char *input_file;
+	const char *output_dir;
+	const char *name;
+	int index;
+	int started;
+	int prefetched;
+	int ret;
+	/*set on the io thread if an output could not be written*/
+	int write_failed;
+	int64_t footprint;
+};
+
+struct Batch {
+	struct Job *jobs;
+	int job_count;
+	int capacity;
+	struct Options *options;
+	/*reads inputs ahead and writes outputs, may be NULL*/
+	struct IoQueue *io;
+	/*estimated bytes of the running jobs and the write queue*/
+	int64_t used;
+	int running;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
 };
 
+/*guards the manifests and stdout of parallel jobs*/
+static pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static void printHelp(FILE *fp)
 {
 	fprintf(fp,
-	        "Usage: sh2ck [options] input_file output_dir name\n\n"
+	        "Usage: sh2ck [options] input_file output_dir name\n"
+	        "       sh2ck [options] --batch list_file\n"
+	        "       sh2ck [options] --shared list_file output_dir name\n"
+	        "       sh2ck --info [--csv] file_or_dir...\n\n"
 	        "Convert strongholds gm1 and tgx files to png and json,\n"
 	        "as needed by castlekeep\n"
 	        "options:\n"
@@ -50,212 +134,1967 @@ static void printHelp(FILE *fp)
 	        "\t--header\t\tSave gm1 file header\n"
 	        "\t-a --assemble\t\tAssemble tile objects\n"
 	        "\t-P --pack\t\tPack images\n"
-	        "\t-s --sort\t\tSort images by height\n");
+	        "\t-s --sort\t\tSort images by height\n"
+	        "\t-f --force\t\tConvert even if the outputs are up to date\n"
+	        "\t--info\t\t\tPrint the headers of gm1 files as json\n"
+	        "\t--csv\t\t\tPrint --info as csv, one row per image\n"
+	        "\t--sprites\t\tAlso save the images as run-length sprites\n"
+	        "\t--delta\t\t\tAlso save animations as keyframes and deltas\n"
+	        "\t--masks\t\t\tAlso save 1 bit hit-test masks of the images\n"
+	        "\t--footprints\t\tAlso save the ground diamonds, depth and\n"
+	        "\t\t\t\televation of the tiles of tile objects\n"
+	        "\t--layers\t\tSave images of one size as the layers of a\n"
+	        "\t\t\t\ttexture array instead of pngs\n"
+	        "\t--glyphs\t\tPack fonts into a trimmed glyph atlas with a\n"
+	        "\t\t\t\tmetrics table\n"
+	        "\t--lod n\t\t\tAlso save n half size levels (at most 2) of\n"
+	        "\t\t\t\ttgx files and packed atlases\n"
+	        "\t--stats\t\t\tPrint time and bytes per stage, peak memory\n"
+	        "\t--trace file\t\tWrite a chrome trace of all stages\n"
+	        "\t--batch file\t\tConvert every \"input_file output_dir name\"\n"
+	        "\t\t\t\tline of file\n"
+	        "\t--shared file\t\tPack the images of every \"input_file name\"\n"
+	        "\t\t\t\tline of file into shared atlas pages\n"
+	        "\t--page-size n\t\tSize of the shared pages (default: 2048)\n"
+	        "\t-j --jobs n\t\tConvert up to n files at once (default: cpus)\n"
+	        "\t--max-memory mb\t\tOnly start a file while the estimated\n"
+	        "\t\t\t\tmemory of all running files stays below mb\n");
+}
+
+static int64_t fileSize(const char *file)
+{
+	struct stat file_stat;
+	if (stat(file, &file_stat) == -1) {
+		return 0;
+	}
+	return file_stat.st_size;
+}
+
+static int64_t imageBytes(struct Sh2ckImage *image)
+{
+	return (int64_t)image->width * image->height * sizeof(*image->pixel);
+}
+
+static int64_t imageListBytes(struct Sh2ckImageList *image_list)
+{
+	int64_t bytes = 0;
+	for (int i = 0; i < image_list->image_count; i++) {
+		bytes += imageBytes(&image_list->images[i]);
+	}
+	return bytes;
+}
+
+/*never 0, so it can be passed to malloc*/
+static int64_t maxImageBytes(struct Sh2ckImageList *image_list)
+{
+	int64_t max_size = sizeof(struct Sh2ckColor);
+	for (int i = 0; i < image_list->image_count; i++) {
+		if (imageBytes(&image_list->images[i]) > max_size) {
+			max_size = imageBytes(&image_list->images[i]);
+		}
+	}
+	return max_size;
 }
 
-static int saveImages(struct ImageList *image_list, const char *output_dir)
+static int saveData(struct Sh2ckImageList *image_list, const char *file,
+                    struct Stats *stats)
+{
+	struct StatsSpan span;
+	sh2ckStatsBegin(&span, STATS_STAGE_METADATA);
+	int ret = sh2ckImageWriteData(image_list, file);
+	sh2ckStatsEnd(stats, &span, sh2ckIoFileSize(file));
+	return ret;
+}
+
+static void deleteMasks(struct HitMask *masks, int mask_count)
+{
+	for (int i = 0; masks != NULL && i < mask_count; i++) {
+		sh2ckMaskDelete(&masks[i]);
+	}
+	free(masks);
+}
+
+/*saves the hit-test masks of the images of the .data file and deletes
+ * them*/
+static int saveMasks(struct HitMask *masks, int mask_count,
+                     const char *output_dir, const char *name,
+                     struct Stats *stats)
 {
 	char string_buffer[256];
+	struct StatsSpan span;
+	int64_t bytes = 0;
+
+	snprintf(string_buffer, 256, "%s/%s.masks", output_dir, name);
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	for (int i = 0; i < mask_count; i++) {
+		bytes += sh2ckMaskDataSize(&masks[i]);
+	}
+	int ret = sh2ckMaskSheetSave(string_buffer, masks, mask_count);
+	sh2ckStatsEnd(stats, &span, bytes);
+	deleteMasks(masks, mask_count);
+	return ret;
+}
+
+/*masks of the packed images, trimmed like their rects in the .data file*/
+static int maskImages(struct Sh2ckImageList *image_list,
+                      struct Sh2ckOffset *offsets, const char *output_dir,
+                      const char *name, struct Stats *stats)
+{
+	struct HitMask *masks =
+	    calloc(image_list->image_count + 1, sizeof(*masks));
+	if (masks == NULL) {
+		return -1;
+	}
 	for (int i = 0; i < image_list->image_count; i++) {
+		if (sh2ckMaskCreateImage(&masks[i], &image_list->images[i],
+		                         offsets != NULL ? &offsets[i] : NULL) == -1) {
+			deleteMasks(masks, image_list->image_count);
+			return -1;
+		}
+	}
+	return saveMasks(masks, image_list->image_count, output_dir, name, stats);
+}
+
+/*Decodes, encodes and writes one image at a time, reusing the same pixel
+ * buffer, so only the largest image has to fit into memory. The masks are
+ * taken from every image while it is decoded.*/
+static int streamImages(struct Gm1 *gm1, const char *output_dir,
+                        const char *name, struct Options *options,
+                        struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImageList image_list;
+	struct Sh2ckImage image;
+	struct StatsSpan span;
+	struct HitMask *masks = NULL;
+
+	if (sh2ckGm1CreateImageListInfo(&image_list, 0, gm1, options->assemble) ==
+	    -1) {
+		fprintf(stderr, "Error on decoding image\n");
+		return -1;
+	}
+	image.pixel = malloc(maxImageBytes(&image_list));
+	if (options->masks) {
+		masks = calloc(image_list.image_count + 1, sizeof(*masks));
+	}
+	if (image.pixel == NULL || (options->masks && masks == NULL)) {
+		free(image.pixel);
+		free(masks);
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+
+	for (int i = 0; i < image_list.image_count; i++) {
+		sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+		if (sh2ckGm1DecodeListImage(&image_list, gm1, i, options->palette,
+		                            &image) == -1 ||
+		    (masks != NULL &&
+		     sh2ckMaskCreateImage(&masks[i], &image, NULL) == -1)) {
+			fprintf(stderr, "Error on decoding image\n");
+			free(image.pixel);
+			deleteMasks(masks, image_list.image_count);
+			sh2ckImageDeleteList(&image_list);
+			return -1;
+		}
+		sh2ckStatsEnd(stats, &span, imageBytes(&image));
+
 		snprintf(string_buffer, 256, "%s/%d.png", output_dir, i);
-		if (imageSave(&image_list->images[i], string_buffer) == -1) {
+		sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+		if (sh2ckImageSave(&image, string_buffer) == -1) {
 			fprintf(stderr, "Error on saving images\n");
-			return 1;
+			free(image.pixel);
+			deleteMasks(masks, image_list.image_count);
+			sh2ckImageDeleteList(&image_list);
+			return -1;
 		}
+		sh2ckStatsEnd(stats, &span, imageBytes(&image));
+	}
+	free(image.pixel);
+
+	if (masks != NULL && saveMasks(masks, image_list.image_count, output_dir,
+	                               name, stats) == -1) {
+		fprintf(stderr, "Error on saving masks\n");
+		sh2ckImageDeleteList(&image_list);
+		return -1;
 	}
-	memset(string_buffer, 0, 256);
 	snprintf(string_buffer, 256, "%s/data.data", output_dir);
-	return imageWriteData(image_list, string_buffer);
+	int ret = saveData(&image_list, string_buffer, stats);
+	sh2ckImageDeleteList(&image_list);
+	return ret;
+}
+
+static int saveSprites(struct Gm1 *gm1, const char *output_dir,
+                       const char *name, struct Options *options,
+                       struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImageList image_list;
+	struct Sh2ckImage image;
+	struct StatsSpan span;
+	int ret = 0;
+
+	if (sh2ckGm1CreateImageListInfo(&image_list, 0, gm1, options->assemble) ==
+	    -1) {
+		return -1;
+	}
+	struct Sprite *sprites =
+	    calloc(image_list.image_count + 1, sizeof(*sprites));
+	image.pixel = malloc(maxImageBytes(&image_list));
+	if (sprites == NULL || image.pixel == NULL) {
+		free(sprites);
+		free(image.pixel);
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	int64_t bytes = 0;
+	for (int i = 0; i < image_list.image_count && ret == 0; i++) {
+		ret = sh2ckGm1EncodeListSprite(&image_list, gm1, i, &image,
+		                               &sprites[i]);
+		bytes += sprites[i].data_size;
+	}
+	snprintf(string_buffer, 256, "%s/%s.sprites", output_dir, name);
+	if (ret == 0) {
+		ret = sh2ckSpriteSheetSave(string_buffer, sprites,
+		                           image_list.image_count);
+	}
+	sh2ckStatsEnd(stats, &span, bytes);
+
+	for (int i = 0; i < image_list.image_count; i++) {
+		sh2ckSpriteDelete(&sprites[i]);
+	}
+	free(sprites);
+	free(image.pixel);
+	sh2ckImageDeleteList(&image_list);
+	return ret;
+}
+
+/*keyframes and deltas of the frames trimmed and aligned on their center*/
+static int saveDelta(struct Gm1 *gm1, const char *output_dir,
+                     const char *name, struct Options *options,
+                     struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImageList image_list;
+	struct DeltaAnimation animation;
+	struct StatsSpan span;
+
+	if (sh2ckGm1CreateImageListParallel(&image_list, 0, gm1, options->palette,
+	                                    0, options->pool) == -1) {
+		return -1;
+	}
+	struct Sh2ckOffset *offsets =
+	    malloc(sizeof(*offsets) * (image_list.image_count + 1));
+	if (offsets == NULL) {
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+	sh2ckShrinkAnimationImages(&image_list, offsets);
+
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	int ret = sh2ckDeltaCreate(&animation, &image_list, offsets,
+	                           DELTA_DEFAULT_BLOCK_SIZE,
+	                           DELTA_DEFAULT_MAX_CHAIN);
+	free(offsets);
+	sh2ckImageDeleteList(&image_list);
+	if (ret == -1) {
+		return -1;
+	}
+	snprintf(string_buffer, 256, "%s/%s.anim", output_dir, name);
+	ret = sh2ckDeltaSave(&animation, string_buffer);
+	sh2ckStatsEnd(stats, &span, animation.size);
+	sh2ckDeltaDelete(&animation);
+	return ret;
+}
+
+/*footprints of the tiles of the objects, independent of the atlas*/
+static int saveFootprints(struct Gm1 *gm1, const char *output_dir,
+                          const char *name, struct Options *options,
+                          struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImageList image_list;
+	struct StatsSpan span;
+
+	if (sh2ckGm1CreateImageListInfo(&image_list, 0, gm1, options->assemble) ==
+	    -1) {
+		return -1;
+	}
+	snprintf(string_buffer, 256, "%s/%s.footprints", output_dir, name);
+	sh2ckStatsBegin(&span, STATS_STAGE_METADATA);
+	int ret = sh2ckImageWriteFootprints(&image_list, string_buffer);
+	sh2ckStatsEnd(stats, &span, sh2ckIoFileSize(string_buffer));
+	sh2ckImageDeleteList(&image_list);
+	return ret;
+}
+
+/*images of one size, or tiles, which are all 30 pixels wide, are saved as
+ * texture array with --layers*/
+static int isLayered(int data_type, struct Options *options)
+{
+	return options->layers &&
+	       (data_type == GM1_DATA_TGX_CONST_SIZE ||
+	        (data_type == GM1_DATA_TGX_AND_TILE && !options->assemble));
+}
+
+/*one texture array layer per image instead of an atlas, the images are
+ * neither trimmed nor laid out*/
+static int saveLayers(struct Gm1 *gm1, const char *output_dir,
+                      const char *name, struct Options *options,
+                      struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImageList image_list;
+	struct StatsSpan span;
+
+	sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+	if (sh2ckGm1CreateImageListParallel(&image_list, 0, gm1, options->palette,
+	                                    0, options->pool) == -1) {
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, imageListBytes(&image_list));
+
+	if (options->masks &&
+	    maskImages(&image_list, NULL, output_dir, name, stats) == -1) {
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+
+	snprintf(string_buffer, 256, "%s/%s.layers", output_dir, name);
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	if (sh2ckLayerArraySave(string_buffer, &image_list) == -1) {
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, sh2ckIoFileSize(string_buffer));
+
+	snprintf(string_buffer, 256, "%s/%s.data", output_dir, name);
+	int ret = saveData(&image_list, string_buffer, stats);
+	sh2ckImageDeleteList(&image_list);
+	return ret;
+}
+
+static int isGlyphFont(int data_type, struct Options *options)
+{
+	return options->glyphs && data_type == GM1_DATA_TGX_FONT;
+}
+
+/*the glyphs are trimmed and packed by height, their metrics go into a
+ * glyph table instead of a .data file*/
+static int packGlyphs(struct Gm1 *gm1, struct Sh2ckImageList *image_list,
+                      struct Sh2ckOffset *offsets, const char *output_dir,
+                      const char *name, struct Options *options,
+                      struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckRect atlas_size;
+	struct GlyphTable table;
+	struct StatsSpan span;
+
+	sh2ckStatsBegin(&span, STATS_STAGE_TRIM);
+	sh2ckFontTrimGlyphs(image_list, offsets);
+	sh2ckStatsEnd(stats, &span, imageListBytes(image_list));
+
+	sh2ckStatsBegin(&span, STATS_STAGE_LAYOUT);
+	if (sh2ckImageLayoutAtlas(image_list, &atlas_size, ATLAS_WIDTH, 1,
+	                          0) == -1) {
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, imageListBytes(image_list));
+
+	if (options->masks &&
+	    maskImages(image_list, offsets, output_dir, name, stats) == -1) {
+		return -1;
+	}
+
+	snprintf(string_buffer, 256, "%s/%s.png", output_dir, name);
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	if (sh2ckImageSaveAtlas(image_list, offsets, &atlas_size,
+	                        SH2CK_IMAGE_ATLAS_BAND_HEIGHT, string_buffer,
+	                        options->pool) == -1) {
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span,
+	              (int64_t)atlas_size.width * atlas_size.height *
+	             sizeof(struct Sh2ckColor));
+
+	snprintf(string_buffer, 256, "%s/%s.glyphs", output_dir, name);
+	sh2ckStatsBegin(&span, STATS_STAGE_METADATA);
+	if (sh2ckFontCreateGlyphTable(&table, gm1, image_list, offsets,
+	                              &atlas_size) == -1) {
+		return -1;
+	}
+	int ret = sh2ckFontSaveGlyphTable(&table, string_buffer);
+	sh2ckFontDeleteGlyphTable(&table);
+	sh2ckStatsEnd(stats, &span, sh2ckIoFileSize(string_buffer));
+	return ret;
+}
+
+static int saveGlyphs(struct Gm1 *gm1, const char *output_dir,
+                      const char *name, struct Options *options,
+                      struct Stats *stats)
+{
+	struct Sh2ckImageList image_list;
+	struct StatsSpan span;
+
+	sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+	if (sh2ckGm1CreateImageListParallel(&image_list, 0, gm1, options->palette,
+	                                    0, options->pool) == -1) {
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, imageListBytes(&image_list));
+
+	struct Sh2ckOffset *offsets =
+	    malloc(sizeof(*offsets) * (image_list.image_count + 1));
+	if (offsets == NULL) {
+		sh2ckImageDeleteList(&image_list);
+		return -1;
+	}
+	int ret = packGlyphs(gm1, &image_list, offsets, output_dir, name,
+	                     options, stats);
+	free(offsets);
+	sh2ckImageDeleteList(&image_list);
+	return ret;
 }
-static int saveAtlas(struct Image *atlas, struct ImageList *image_list,
-                     const char *output_dir, const char *name)
+
+/*the atlas is composed while it is encoded, so its stats span covers both*/
+static int saveAtlas(struct Sh2ckImageList *image_list,
+                     const struct Sh2ckOffset *offsets,
+                     const struct Sh2ckRect *atlas_size, const char *output_dir,
+                     const char *name, struct Options *options,
+                     struct Stats *stats)
 {
 	char string_buffer[256];
+	struct StatsSpan span;
 	snprintf(string_buffer, 256, "%s/%s.png", output_dir, name);
-	if (imageSave(atlas, string_buffer) == -1) {
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	if (sh2ckImageSaveAtlas(image_list, offsets, atlas_size,
+	                        SH2CK_IMAGE_ATLAS_BAND_HEIGHT, string_buffer,
+	                        options->pool) == -1) {
 		fprintf(stderr, "Error on saving images\n");
-		return 1;
+		return -1;
 	}
+	sh2ckStatsEnd(stats, &span,
+	              (int64_t)atlas_size->width * atlas_size->height *
+	             sizeof(struct Sh2ckColor));
 	memset(string_buffer, 0, 256);
 	snprintf(string_buffer, 256, "%s/%s.data", output_dir, name);
-	return imageWriteData(image_list, string_buffer);
+	return saveData(image_list, string_buffer, stats);
 }
 
 static int saveHeader(struct Gm1 *gm1, const char *output_dir)
 {
 	char string_buffer[256];
 	snprintf(string_buffer, 256, "%s/gm1_header.json", output_dir);
-	return gm1SaveHeader(gm1, string_buffer);
+	return sh2ckGm1SaveHeader(gm1, string_buffer);
 }
 
 static int savePalette(struct Gm1 *gm1, const char *output_dir)
 {
 	char string_buffer[256];
-	struct Image img;
+	struct Sh2ckImage img;
 
 	snprintf(string_buffer, 256, "%s/palette.png", output_dir);
-	gm1CreatePaletteImage(&img, gm1->palette, 16);
-	return imageSave(&img, string_buffer);
+	sh2ckGm1CreatePaletteImage(&img, gm1->palette, 16);
+	return sh2ckImageSave(&img, string_buffer);
+}
+
+/*saves the half size levels of a tgx image as 0_lod1.png and so on*/
+static int saveTgxLevels(struct Sh2ckImage *image, const char *output_dir,
+                         struct Options *options, struct Stats *stats)
+{
+	char string_buffer[256];
+	struct Sh2ckImage levels[LOD_LEVELS_MAX];
+	struct StatsSpan span;
+	struct Sh2ckImage *source = image;
+	int ret = 0;
+
+	for (int i = 0; i < (int)options->lod && ret == 0; i++) {
+		sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+		if (sh2ckImageCreate(&levels[i], NULL, (source->width + 1) / 2,
+		                     (source->height + 1) / 2) == -1) {
+			ret = -1;
+			break;
+		}
+		sh2ckImageDownscaleHalf(&levels[i], source);
+		sh2ckStatsEnd(stats, &span, imageBytes(&levels[i]));
+
+		snprintf(string_buffer, 256, "%s/0_lod%d.png", output_dir, i + 1);
+		sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+		ret = sh2ckImageSaveParallel(&levels[i], string_buffer, options->pool);
+		sh2ckStatsEnd(stats, &span, imageBytes(&levels[i]));
+		if (i > 0) {
+			sh2ckImageDelete(source, NULL);
+		}
+		source = &levels[i];
+	}
+	if (source != image) {
+		sh2ckImageDelete(source, NULL);
+	}
+	return ret;
 }
 
-static int convertTgx(const char *input_file, const char *output_dir)
+static int convertTgx(const char *input_file, const char *output_dir,
+                      struct Options *options, struct Stats *stats)
 {
 	char string_buffer[256];
-	struct Image image;
+	struct Sh2ckImage image;
 	struct Tgx tgx;
+	struct StatsSpan span;
 
-	if (tgxCreateFromFile(&tgx, input_file) == -1) {
+	sh2ckStatsBegin(&span, STATS_STAGE_LOAD);
+	if (sh2ckTgxCreateFromFile(&tgx, input_file) == -1) {
 		fprintf(stderr, "Error on loading file\n");
 		return 1;
 	}
+	sh2ckStatsEnd(stats, &span, fileSize(input_file));
 
-	if (tgxCreateImage(&image, tgx.width, tgx.height, tgx.data, tgx.size,
-	                   NULL) == -1) {
+	sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+	struct Sh2ckRect rect = {0, 0, tgx.width, tgx.height};
+	if (sh2ckImageCreate(&image, NULL, tgx.width, tgx.height) == -1) {
 		fprintf(stderr, "Error on decoding image\n");
-		tgxDelete(&tgx);
+		sh2ckTgxDelete(&tgx);
 		return 1;
 	}
+	if (sh2ckTgxDecodeParallel(&image, &rect, tgx.data, tgx.size, NULL,
+	                           options->pool) == -1) {
+		fprintf(stderr, "Error on decoding image\n");
+		sh2ckImageDelete(&image, NULL);
+		sh2ckTgxDelete(&tgx);
+		return 1;
+	}
+	sh2ckStatsEnd(stats, &span, imageBytes(&image));
 
 	snprintf(string_buffer, 256, "%s/0.png", output_dir);
-	if (imageSave(&image, string_buffer) == -1) {
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	if (sh2ckImageSaveParallel(&image, string_buffer, options->pool) == -1) {
+		fprintf(stderr, "Error on saving images\n");
+		sh2ckTgxDelete(&tgx);
+		sh2ckImageDelete(&image, NULL);
+		return 1;
+	}
+	sh2ckStatsEnd(stats, &span, imageBytes(&image));
+
+	if (saveTgxLevels(&image, output_dir, options, stats) == -1) {
 		fprintf(stderr, "Error on saving images\n");
-		tgxDelete(&tgx);
-		imageDelete(&image, NULL);
+		sh2ckTgxDelete(&tgx);
+		sh2ckImageDelete(&image, NULL);
 		return 1;
 	}
 
-	imageDelete(&image, NULL);
-	tgxDelete(&tgx);
+	sh2ckImageDelete(&image, NULL);
+	sh2ckTgxDelete(&tgx);
+
+	return 0;
+}
+
+static int packImages(struct Sh2ckImageList *image_list, const char *output_dir,
+                      const char *name, struct Options *options,
+                      int save_masks, struct Stats *stats)
+{
+	struct Sh2ckRect atlas_size;
+	struct StatsSpan span;
+	struct Sh2ckOffset *offsets = NULL;
+
+	if (image_list->type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		sh2ckStatsBegin(&span, STATS_STAGE_TRIM);
+		offsets = malloc(sizeof(*offsets) * (image_list->image_count + 1));
+		if (offsets == NULL) {
+			return -1;
+		}
+		sh2ckShrinkAnimationImages(image_list, offsets);
+		sh2ckStatsEnd(stats, &span, imageListBytes(image_list));
+	}
+
+	sh2ckStatsBegin(&span, STATS_STAGE_LAYOUT);
+	if (sh2ckImageLayoutAtlas(image_list, &atlas_size, ATLAS_WIDTH,
+	                          options->sort, options->assemble) == -1) {
+		free(offsets);
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, imageListBytes(image_list));
+
+	if (save_masks &&
+	    maskImages(image_list, offsets, output_dir, name, stats) == -1) {
+		fprintf(stderr, "Error on saving masks\n");
+		free(offsets);
+		return -1;
+	}
 
+	if (saveAtlas(image_list, offsets, &atlas_size, output_dir, name,
+	              options, stats) == -1) {
+		free(offsets);
+		return -1;
+	}
+	free(offsets);
 	return 0;
 }
 
+/*Every level is downscaled from the one above while that is still untrimmed,
+ * then each is packed into its own atlas, name_lod1 for half size and so on.
+ * Masks are only saved for the full size images.*/
+static int packLevels(struct Sh2ckImageList *image_list, const char *output_dir,
+                      const char *name, struct Options *options,
+                      struct Stats *stats)
+{
+	char lod_name[256];
+	struct Sh2ckImageList levels[LOD_LEVELS_MAX];
+	struct Sh2ckImageList *source = image_list;
+	struct StatsSpan span;
+	int count = 0;
+	int ret = 0;
+
+	sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+	for (; count < (int)options->lod; count++) {
+		if (sh2ckImageListCreateHalf(&levels[count], source, options->pool) ==
+		    -1) {
+			ret = -1;
+			break;
+		}
+		source = &levels[count];
+	}
+	sh2ckStatsEnd(stats, &span, count > 0 ? imageListBytes(&levels[0]) : 0);
+
+	if (ret == 0) {
+		ret = packImages(image_list, output_dir, name, options,
+		                 options->masks, stats);
+	}
+	for (int i = 0; i < count && ret == 0; i++) {
+		snprintf(lod_name, 256, "%s_lod%d", name, i + 1);
+		ret = packImages(&levels[i], output_dir, lod_name, options, 0, stats);
+	}
+	for (int i = 0; i < count; i++) {
+		sh2ckImageDeleteList(&levels[i]);
+	}
+	return ret;
+}
+
 static int convertGm1(const char *input_file, const char *output_dir,
-                      const char *name, struct Options *options)
+                      const char *name, struct Options *options,
+                      struct Stats *stats)
 {
-	struct ImageList image_list;
+	struct StatsSpan span;
 	struct Gm1 *gm1 = malloc(sizeof(*gm1));
 
-	if (gm1CreateFromFile(gm1, input_file) == -1) {
+	sh2ckStatsBegin(&span, STATS_STAGE_LOAD);
+	if (gm1 == NULL || sh2ckGm1CreateFromFile(gm1, input_file) == -1) {
 		fprintf(stderr, "Error on loading file\n");
+		free(gm1);
 		return 1;
 	}
+	sh2ckStatsEnd(stats, &span, fileSize(input_file));
 
-	if (gm1CreateImageList(&image_list, PIXEL_BUFFER_SIZE, gm1,
-	                       options->palette, options->assemble) == -1) {
-		fprintf(stderr, "Error on decoding image\n");
-		gm1Delete(gm1);
-		return 1;
-	}
-	if (options->pack) {
-		struct Image atlas;
-		if (imagecreateAtlas(&atlas, &image_list, 1024, options->sort,
-		                     options->assemble) == -1) {
-			imageDeleteList(&image_list);
-			gm1Delete(gm1);
-			return -1;
+	if (isLayered(gm1->header.data_type, options)) {
+		if (saveLayers(gm1, output_dir, name, options, stats) == -1) {
+			fprintf(stderr, "Error on saving layers\n");
+			sh2ckGm1Delete(gm1);
+			free(gm1);
+			return 1;
+		}
+	} else if (isGlyphFont(gm1->header.data_type, options)) {
+		if (saveGlyphs(gm1, output_dir, name, options, stats) == -1) {
+			fprintf(stderr, "Error on saving glyphs\n");
+			sh2ckGm1Delete(gm1);
+			free(gm1);
+			return 1;
+		}
+	} else if (options->pack) {
+		struct Sh2ckImageList image_list;
+
+		sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+		if (sh2ckGm1CreateImageListParallel(&image_list, 0, gm1,
+		                                    options->palette, options->assemble,
+		                                    options->pool) == -1) {
+			fprintf(stderr, "Error on decoding image\n");
+			sh2ckGm1Delete(gm1);
+			free(gm1);
+			return 1;
 		}
-		if (saveAtlas(&atlas, &image_list, output_dir, name) == -1) {
+		sh2ckStatsEnd(stats, &span, imageListBytes(&image_list));
+
+		if (packLevels(&image_list, output_dir, name, options, stats) ==
+		    -1) {
 			fprintf(stderr, "Error on saving images\n");
-			imageDeleteList(&image_list);
-			imageDelete(&atlas, NULL);
-			gm1Delete(gm1);
+			sh2ckImageDeleteList(&image_list);
+			sh2ckGm1Delete(gm1);
+			free(gm1);
 			return 1;
 		}
-		imageDelete(&atlas, NULL);
+		sh2ckImageDeleteList(&image_list);
 	} else {
-		if (saveImages(&image_list, output_dir) == -1) {
+		if (streamImages(gm1, output_dir, name, options, stats) == -1) {
 			fprintf(stderr, "Error on saving images\n");
-			imageDeleteList(&image_list);
-			gm1Delete(gm1);
+			sh2ckGm1Delete(gm1);
+			free(gm1);
 			return 1;
 		}
 	}
 
-	imageDeleteList(&image_list);
+	if (options->sprites &&
+	    saveSprites(gm1, output_dir, name, options, stats) == -1) {
+		fprintf(stderr, "Error on saving sprites\n");
+		sh2ckGm1Delete(gm1);
+		free(gm1);
+		return 1;
+	}
+
+	if (options->delta && gm1->header.data_type == GM1_DATA_ANIMATION &&
+	    saveDelta(gm1, output_dir, name, options, stats) == -1) {
+		fprintf(stderr, "Error on saving animation\n");
+		sh2ckGm1Delete(gm1);
+		free(gm1);
+		return 1;
+	}
+
+	if (options->footprints && sh2ckGm1IsTileObject(gm1) &&
+	    saveFootprints(gm1, output_dir, name, options, stats) == -1) {
+		fprintf(stderr, "Error on saving footprints\n");
+		sh2ckGm1Delete(gm1);
+		free(gm1);
+		return 1;
+	}
 
 	if (options->save_header == 1) {
+		sh2ckStatsBegin(&span, STATS_STAGE_METADATA);
 		if (saveHeader(gm1, output_dir) == -1 ||
 		    savePalette(gm1, output_dir) == -1) {
 			fprintf(stderr, "Error on saving header\n");
-			gm1Delete(gm1);
+			sh2ckGm1Delete(gm1);
 			free(gm1);
 			return 1;
 		}
+		sh2ckStatsEnd(stats, &span, 0);
 	}
-	gm1Delete(gm1);
+	sh2ckGm1Delete(gm1);
 	free(gm1);
 
 	return 0;
 }
 
-int main(int argc, char *argv[])
+static int printFileInfo(const char *file, struct Options *options,
+                         int *first)
 {
-	const char *input_file = NULL;
-	const char *output_dir = NULL;
-	const char *name = NULL;
-	struct Options options;
-	memset(&options, 0x0, sizeof(struct Options));
+	struct Gm1Reader reader;
+	if (sh2ckGm1ReaderOpen(&reader, file, 1) == -1) {
+		fprintf(stderr, "Error on loading file %s\n", file);
+		return -1;
+	}
+	if (options->csv) {
+		sh2ckGm1PrintInfo(&reader.gm1, file, GM1_INFO_CSV, stdout);
+	} else {
+		printf("%s", *first ? "\n" : ",\n");
+		sh2ckGm1PrintInfo(&reader.gm1, file, GM1_INFO_JSON, stdout);
+	}
+	*first = 0;
+	sh2ckGm1ReaderClose(&reader);
+	return 0;
+}
 
-	for (int i = 1; i < argc; i++) {
-		if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
-			printHelp(stdout);
-			return 0;
-		}
+static int nameCmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
 
-		if ((strcmp(argv[i], "-t") == 0) || (strcmp(argv[i], "--tgx") == 0)) {
-			options.convert_tgx = 1;
-		}
+static int isGm1File(const char *name)
+{
+	int length = strlen(name);
+	return length > 4 && strcasecmp(name + length - 4, ".gm1") == 0;
+}
 
-		if (strcmp(argv[i], "--header") == 0) {
-			options.save_header = 1;
-		}
+static int isTgxFile(const char *name)
+{
+	int length = strlen(name);
+	return length > 4 && strcasecmp(name + length - 4, ".tgx") == 0;
+}
 
-		if ((strcmp(argv[i], "-p") == 0) ||
-		    (strcmp(argv[i], "--palette") == 0)) {
-			char *tmp = NULL;
-			unsigned long val = strtoul(argv[++i], &tmp, 10);
-			if (*tmp != '\0') {
-				printHelp(stderr);
-				return 1;
-			}
+static int printDirectoryInfo(const char *dir, struct Options *options,
+                              int *first)
+{
+	char string_buffer[PATH_MAX];
+	struct dirent *entry = NULL;
+	char **names = NULL;
+	int count = 0;
+	int capacity = 0;
+	int ret = 0;
 
-			if (val >= 10) {
-				fprintf(stderr, "Error: Palette has to be between 0 and 9\n");
-				return 1;
-			}
-			printf("%d\n", (int)val);
-			options.palette = val;
-		}
-		if ((strcmp(argv[i], "-a") == 0) ||
-		    (strcmp(argv[i], "--assemble") == 0)) {
-			options.assemble = 1;
+	DIR *dp = opendir(dir);
+	if (dp == NULL) {
+		return -1;
+	}
+	while ((entry = readdir(dp)) != NULL) {
+		if (!isGm1File(entry->d_name)) {
+			continue;
 		}
-		if ((strcmp(argv[i], "-P")) == 0 || (strcmp(argv[i], "--pack") == 0)) {
-			options.pack = 1;
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			char **tmp = realloc(names, sizeof(*names) * capacity);
+			if (tmp == NULL) {
+				ret = -1;
+				break;
+			}
+			names = tmp;
 		}
-		if ((strcmp(argv[i], "-s")) == 0 || (strcmp(argv[i], "--sort") == 0)) {
-			options.sort = 1;
+		names[count] = strdup(entry->d_name);
+		if (names[count] == NULL) {
+			ret = -1;
+			break;
 		}
+		count++;
 	}
+	closedir(dp);
 
-	if (argc < 4) {
-		printHelp(stderr);
-		return 1;
+	qsort(names, count, sizeof(*names), nameCmp);
+	for (int i = 0; i < count; i++) {
+		snprintf(string_buffer, sizeof(string_buffer), "%s/%s", dir,
+		         names[i]);
+		if (printFileInfo(string_buffer, options, first) == -1) {
+			ret = -1;
+		}
+		free(names[i]);
 	}
+	free(names);
+	return ret;
+}
 
-	input_file = argv[argc - 3];
-	output_dir = argv[argc - 2];
-	name = argv[argc - 1];
-
-	if (mkdir(output_dir, 0775) == -1 && errno != EEXIST) {
-		fprintf(stderr, "Error on creating directory\n");
-		return 1;
-	}
+/*only reads the headers, no image data is touched*/
+static int printInfo(const char **paths, int count, struct Options *options)
+{
+	struct stat path_stat;
+	int first = 1;
+	int ret = 0;
 
-	if (options.convert_tgx == 1) {
-		return convertTgx(input_file, output_dir);
+	if (options->csv) {
+		sh2ckGm1PrintInfoCsvHeader(stdout);
 	} else {
-		return convertGm1(input_file, output_dir, name, &options);
+		printf("[");
+	}
+	for (int i = 0; i < count; i++) {
+		if (stat(paths[i], &path_stat) == -1) {
+			fprintf(stderr, "Error: %s does not exist\n", paths[i]);
+			ret = 1;
+		} else if (S_ISDIR(path_stat.st_mode)) {
+			if (printDirectoryInfo(paths[i], options, &first) == -1) {
+				ret = 1;
+			}
+		} else if (printFileInfo(paths[i], options, &first) == -1) {
+			ret = 1;
+		}
+	}
+	if (!options->csv) {
+		printf("\n]\n");
+	}
+	return ret;
+}
+
+/*everything that changes the produced files has to be part of the key*/
+static uint64_t optionsHash(struct Options *options)
+{
+	uint32_t key[] = {OUTPUT_FORMAT_VERSION, options->convert_tgx,
+	                  options->save_header,  options->palette,
+	                  options->assemble,     options->pack,
+	                  options->sort,         options->sprites,
+	                  options->delta,        options->masks,
+	                  options->footprints,   options->layers,
+	                  options->glyphs,       options->lod};
+	return cacheHashBytes(CACHE_HASH_SEED, key, sizeof(key));
+}
+
+/*-1 if the file can not be read*/
+static int dataType(const char *input_file)
+{
+	struct Gm1Reader reader;
+	if (sh2ckGm1ReaderOpen(&reader, input_file, 1) == -1) {
+		return -1;
+	}
+	int data_type = reader.gm1.header.data_type;
+	sh2ckGm1ReaderClose(&reader);
+	return data_type;
+}
+
+/*number of images, or assembled objects, written as 0.png, 1.png, ... when
+ * the images are not packed*/
+static int streamedImageCount(const char *input_file, struct Options *options)
+{
+	struct Gm1Reader reader;
+	struct Sh2ckImageList image_list;
+	if (sh2ckGm1ReaderOpen(&reader, input_file, 1) == -1) {
+		return 0;
+	}
+	int count = 0;
+	if (sh2ckGm1CreateImageListInfo(&image_list, 0, &reader.gm1,
+	                                options->assemble) == 0) {
+		count = image_list.image_count;
+		sh2ckImageDeleteList(&image_list);
+	}
+	sh2ckGm1ReaderClose(&reader);
+	return count;
+}
+
+/*every numbered png has to exist, they are too many to be listed*/
+static int streamedImagesExist(const char *output_dir, int image_count)
+{
+	char string_buffer[256];
+	struct stat file_stat;
+	for (int i = 0; i < image_count; i++) {
+		snprintf(string_buffer, 256, "%s/%d.png", output_dir, i);
+		if (stat(string_buffer, &file_stat) == -1) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*image_count receives the number of numbered pngs written besides the
+ * listed outputs*/
+/*-1 if outputs already holds capacity files or the path does not fit*/
+static int addOutput(char outputs[][256], int capacity, int *count,
+                     const char *format, ...)
+{
+	va_list args;
+	if (*count >= capacity) {
+		return -1;
+	}
+	va_start(args, format);
+	int size = vsnprintf(outputs[*count], 256, format, args);
+	va_end(args);
+	if (size < 0 || size >= 256) {
+		return -1;
+	}
+	(*count)++;
+	return 0;
+}
+
+/*fills outputs with at most capacity files, -1 if there are more*/
+static int listOutputs(char outputs[][256], int capacity, int *image_count,
+                       const char *input_file, const char *output_dir,
+                       const char *name, struct Options *options)
+{
+	*image_count = 0;
+	int count = 0;
+	int ret = 0;
+	if (options->convert_tgx) {
+		ret |= addOutput(outputs, capacity, &count, "%s/0.png", output_dir);
+		for (int i = 1; i <= (int)options->lod; i++) {
+			ret |= addOutput(outputs, capacity, &count, "%s/0_lod%d.png",
+			                 output_dir, i);
+		}
+		return ret == 0 ? count : -1;
+	}
+	int data_type = dataType(input_file);
+	if (isLayered(data_type, options)) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.layers",
+		                 output_dir, name);
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.data", output_dir,
+		                 name);
+	} else if (isGlyphFont(data_type, options)) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.png", output_dir,
+		                 name);
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.glyphs",
+		                 output_dir, name);
+	} else if (options->pack) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.png", output_dir,
+		                 name);
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.data", output_dir,
+		                 name);
+		for (int i = 1; i <= (int)options->lod; i++) {
+			ret |= addOutput(outputs, capacity, &count, "%s/%s_lod%d.png",
+			                 output_dir, name, i);
+			ret |= addOutput(outputs, capacity, &count, "%s/%s_lod%d.data",
+			                 output_dir, name, i);
+		}
+	} else {
+		ret |= addOutput(outputs, capacity, &count, "%s/data.data",
+		                 output_dir);
+		*image_count = streamedImageCount(input_file, options);
+	}
+	if (options->sprites) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.sprites",
+		                 output_dir, name);
+	}
+	if (options->delta && data_type == GM1_DATA_ANIMATION) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.anim", output_dir,
+		                 name);
+	}
+	if (options->masks) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.masks",
+		                 output_dir, name);
+	}
+	if (options->footprints && data_type == GM1_DATA_TGX_AND_TILE) {
+		ret |= addOutput(outputs, capacity, &count, "%s/%s.footprints",
+		                 output_dir, name);
+	}
+	if (options->save_header) {
+		ret |= addOutput(outputs, capacity, &count, "%s/gm1_header.json",
+		                 output_dir);
+		ret |= addOutput(outputs, capacity, &count, "%s/palette.png",
+		                 output_dir);
+	}
+	return ret == 0 ? count : -1;
+}
+
+static int isUpToDate(const char *input_file, const char *output_dir,
+                      const char *name, struct Options *options)
+{
+	char outputs[OUTPUT_COUNT_MAX][256];
+	const char *output_list[OUTPUT_COUNT_MAX];
+	int image_count = 0;
+	int count = listOutputs(outputs, OUTPUT_COUNT_MAX, &image_count,
+	                        input_file, output_dir, name, options);
+	if (count == -1) {
+		return 0;
+	}
+	for (int i = 0; i < count; i++) {
+		output_list[i] = outputs[i];
+	}
+	if (!streamedImagesExist(output_dir, image_count)) {
+		return 0;
+	}
+	return cacheIsUpToDate(output_dir, name, input_file, optionsHash(options),
+	                       output_list, count);
+}
+
+/*Peak memory of converting input_file, computed from the headers alone: the
+ * loaded file plus the decoded images and one band of the atlas, or plus the
+ * largest image when the images are streamed. With buffered outputs the
+ * largest output is held in memory until it is closed, its encoded size is
+ * taken to be at most its raw size.*/
+static int64_t estimateFootprint(const char *input_file,
+                                 struct Options *options, int buffered)
+{
+	int64_t bytes = fileSize(input_file);
+	int64_t output = 0;
+	struct Gm1Reader reader;
+	struct Sh2ckImageList image_list;
+
+	if (options->convert_tgx) {
+		uint32_t size[2];
+		FILE *fp = fopen(input_file, "rb");
+		if (fp == NULL) {
+			return bytes;
+		}
+		if (fread(size, sizeof(size), 1, fp) == 1) {
+			int64_t image_bytes =
+			    (int64_t)size[0] * size[1] * sizeof(struct Sh2ckColor);
+			/*a level and the one it is downscaled from*/
+			bytes += options->lod > 0 ? image_bytes * 5 / 4 : image_bytes;
+			output = image_bytes;
+		}
+		fclose(fp);
+		return buffered ? bytes + output : bytes;
+	}
+
+	if (sh2ckGm1ReaderOpen(&reader, input_file, 1) == -1) {
+		return bytes;
+	}
+	if (sh2ckGm1CreateImageListInfo(&image_list, 0, &reader.gm1,
+	                                options->assemble) == -1) {
+		sh2ckGm1ReaderClose(&reader);
+		return bytes;
+	}
+	if (isLayered(reader.gm1.header.data_type, options)) {
+		int width;
+		int height;
+		sh2ckLayerArraySize(&image_list, &width, &height);
+		bytes += imageListBytes(&image_list) +
+		         (int64_t)width * height * sizeof(struct Sh2ckColor);
+		/*every layer, not just the one being filled*/
+		output = (int64_t)width * height * sizeof(struct Sh2ckColor) *
+		         image_list.image_count;
+	} else if (options->pack ||
+	           isGlyphFont(reader.gm1.header.data_type, options)) {
+		struct Sh2ckRect atlas_size;
+		int64_t list_bytes = imageListBytes(&image_list);
+		bytes += list_bytes;
+		/*all levels are downscaled before the first is packed*/
+		for (int i = 0; i < (int)options->lod; i++) {
+			list_bytes /= 4;
+			bytes += list_bytes;
+		}
+		/*animations are laid out untrimmed, so this is an upper bound*/
+		if (sh2ckImageLayoutAtlas(&image_list, &atlas_size, ATLAS_WIDTH,
+		                          options->sort, options->assemble) == 0) {
+			int rows = atlas_size.height < SH2CK_IMAGE_ATLAS_BAND_HEIGHT
+			               ? atlas_size.height
+			               : SH2CK_IMAGE_ATLAS_BAND_HEIGHT;
+			bytes +=
+			    (int64_t)atlas_size.width * rows * sizeof(struct Sh2ckColor);
+			output = (int64_t)atlas_size.width * atlas_size.height *
+			         sizeof(struct Sh2ckColor);
+		}
+	} else {
+		output = maxImageBytes(&image_list);
+		bytes += output;
+	}
+	/*a sprite, delta or mask file covers every image*/
+	if (options->sprites || options->delta || options->masks) {
+		int64_t list_bytes = imageListBytes(&image_list);
+		output = list_bytes > output ? list_bytes : output;
+	}
+	sh2ckImageDeleteList(&image_list);
+	sh2ckGm1ReaderClose(&reader);
+	return buffered ? bytes + output : bytes;
+}
+
+/*0 if converted, 1 on error and 2 if the outputs are up to date*/
+static int runConversion(const char *input_file, const char *output_dir,
+                         const char *name, struct Options *options)
+{
+	if (mkdir(output_dir, 0775) == -1 && errno != EEXIST) {
+		fprintf(stderr, "Error on creating directory %s\n", output_dir);
+		return 1;
+	}
+
+	pthread_mutex_lock(&output_mutex);
+	int up_to_date =
+	    !options->force && isUpToDate(input_file, output_dir, name, options);
+	pthread_mutex_unlock(&output_mutex);
+	if (up_to_date) {
+		printf("Up to date: %s\n", name);
+		return 2;
+	}
+
+	int ret = 0;
+	struct Stats stats;
+	sh2ckStatsInit(&stats, name);
+	if (options->convert_tgx == 1) {
+		ret = convertTgx(input_file, output_dir, options, &stats);
+	} else {
+		ret = convertGm1(input_file, output_dir, name, options, &stats);
+	}
+
+	if (options->stats) {
+		pthread_mutex_lock(&output_mutex);
+		sh2ckStatsPrint(&stats, stdout);
+		pthread_mutex_unlock(&output_mutex);
+	}
+	return ret;
+}
+
+/*only called once all outputs of name are written*/
+static void updateManifest(const char *input_file, const char *output_dir,
+                           const char *name, struct Options *options)
+{
+	pthread_mutex_lock(&output_mutex);
+	if (cacheUpdate(output_dir, name, input_file, optionsHash(options)) ==
+	    -1) {
+		fprintf(stderr, "Warning: could not update %s\n",
+		        CACHE_MANIFEST_NAME);
+	}
+	pthread_mutex_unlock(&output_mutex);
+}
+
+static int convertFile(const char *input_file, const char *output_dir,
+                       const char *name, struct Options *options)
+{
+	int ret = runConversion(input_file, output_dir, name, options);
+	if (ret == 2) {
+		return 0;
+	}
+	if (ret == 0) {
+		updateManifest(input_file, output_dir, name, options);
+	}
+	return ret;
+}
+
+/*fields are separated by tabs if the line has any, otherwise by spaces*/
+static int splitFields(char *line, const char **fields, int max_count)
+{
+	const char *separators = strchr(line, '\t') ? "\t\r\n" : " \t\r\n";
+	char *save = NULL;
+	int count = 0;
+	for (char *field = strtok_r(line, separators, &save);
+	     field != NULL && count < max_count;
+	     field = strtok_r(NULL, separators, &save)) {
+		fields[count++] = field;
+	}
+	return count;
+}
+
+/*lines are "input output_dir name", or "input name" with 2 fields*/
+static int readBatch(struct Batch *batch, const char *file, int field_count)
+{
+	char *line = NULL;
+	size_t line_size = 0;
+	int line_number = 0;
+	int ret = 0;
+
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Error on opening %s\n", file);
+		return -1;
+	}
+	while (getline(&line, &line_size, fp) != -1) {
+		const char *fields[3] = {NULL, NULL, NULL};
+		line_number++;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+			continue;
+		}
+		if (batch->job_count == batch->capacity) {
+			int capacity = batch->capacity ? batch->capacity * 2 : 64;
+			struct Job *jobs =
+			    realloc(batch->jobs, sizeof(*jobs) * capacity);
+			if (jobs == NULL) {
+				ret = -1;
+				break;
+			}
+			batch->jobs = jobs;
+			batch->capacity = capacity;
+		}
+		struct Job *job = &batch->jobs[batch->job_count];
+		job->line = strdup(line);
+		if (job->line == NULL) {
+			ret = -1;
+			break;
+		}
+		if (splitFields(job->line, fields, field_count) != field_count) {
+			fprintf(stderr, "Error: %s:%d is not \"%s\"\n", file, line_number,
+			        field_count == 3 ? "input output_dir name" : "input name");
+			free(job->line);
+			ret = -1;
+			break;
+		}
+		job->options = batch->options;
+		job->input_file = fields[0];
+		job->output_dir = field_count == 3 ? fields[1] : NULL;
+		job->name = fields[field_count - 1];
+		job->index = batch->job_count;
+		job->started = 0;
+		job->prefetched = 0;
+		job->ret = 0;
+		job->write_failed = 0;
+		job->footprint = 0;
+		batch->job_count++;
+	}
+	free(line);
+	fclose(fp);
+	return ret;
+}
+
+static void estimateJob(void *context, int index)
+{
+	struct Batch *batch = context;
+	struct Job *job = &batch->jobs[index];
+	job->footprint = estimateFootprint(job->input_file, batch->options,
+	                                   batch->io != NULL);
+}
+
+/*largest first, so the giant files are not all left for the end*/
+static int jobCmp(const void *a, const void *b)
+{
+	const struct Job *job_a = a;
+	const struct Job *job_b = b;
+	if (job_a->footprint != job_b->footprint) {
+		return job_a->footprint < job_b->footprint ? 1 : -1;
+	}
+	return job_a->index - job_b->index;
+}
+
+/*Takes the first waiting job that fits into what is left of the budget. A
+ * job that does not fit at all still starts once nothing else runs, so giant
+ * files are converted alone. Called with the batch mutex held.*/
+static struct Job *nextJob(struct Batch *batch, int *waiting)
+{
+	*waiting = 0;
+	for (int i = 0; i < batch->job_count; i++) {
+		struct Job *job = &batch->jobs[i];
+		if (job->started) {
+			continue;
+		}
+		*waiting = 1;
+		if (batch->running == 0 ||
+		    batch->used + job->footprint <= batch->options->max_memory) {
+			return job;
+		}
+	}
+	return NULL;
+}
+
+/*Marks up to PREFETCH_COUNT of the jobs that start next, in the order
+ * nextJob goes through them. Called with the batch mutex held.*/
+static int nextPrefetches(struct Batch *batch, struct Job **jobs)
+{
+	int count = 0;
+	for (int i = 0; i < batch->job_count && count < PREFETCH_COUNT; i++) {
+		struct Job *job = &batch->jobs[i];
+		if (job->started) {
+			continue;
+		}
+		if (!job->prefetched) {
+			job->prefetched = 1;
+			jobs[count++] = job;
+		}
+	}
+	return count;
+}
+
+static void finishJob(void *context)
+{
+	struct Job *job = context;
+	if (!job->write_failed) {
+		updateManifest(job->input_file, job->output_dir, job->name,
+		               job->options);
+	}
+}
+
+/*With an io queue the outputs are written in the background and the
+ * manifest is updated after the last of them, from the io thread.*/
+static int convertJob(struct Batch *batch, struct Job *job)
+{
+	if (batch->io == NULL) {
+		return convertFile(job->input_file, job->output_dir, job->name,
+		                   batch->options);
+	}
+	sh2ckIoSetThreadQueue(batch->io, &job->write_failed);
+	int ret = runConversion(job->input_file, job->output_dir, job->name,
+	                        batch->options);
+	sh2ckIoSetThreadQueue(NULL, NULL);
+	if (ret == 2) {
+		return 0;
+	}
+	if (ret == 0 && sh2ckIoQueueCall(batch->io, finishJob, job) == -1) {
+		return 1;
+	}
+	return ret;
+}
+
+static void batchWorker(void *context, int index)
+{
+	struct Batch *batch = context;
+	(void)index;
+
+	pthread_mutex_lock(&batch->mutex);
+	for (;;) {
+		int waiting = 0;
+		struct Job *job = nextJob(batch, &waiting);
+		if (job == NULL) {
+			if (!waiting) {
+				break;
+			}
+			pthread_cond_wait(&batch->cond, &batch->mutex);
+			continue;
+		}
+		job->started = 1;
+		batch->used += job->footprint;
+		batch->running++;
+		struct Job *prefetches[PREFETCH_COUNT];
+		int prefetch_count =
+		    batch->io != NULL ? nextPrefetches(batch, prefetches) : 0;
+		pthread_mutex_unlock(&batch->mutex);
+
+		for (int i = 0; i < prefetch_count; i++) {
+			sh2ckIoPrefetch(batch->io, prefetches[i]->input_file);
+		}
+		job->ret = convertJob(batch, job);
+
+		pthread_mutex_lock(&batch->mutex);
+		batch->used -= job->footprint;
+		batch->running--;
+		pthread_cond_broadcast(&batch->cond);
+	}
+	pthread_mutex_unlock(&batch->mutex);
+}
+
+static int runBatch(struct Options *options)
+{
+	struct Batch batch;
+	struct Sh2ckThreadPool *pool = NULL;
+	int64_t queue_size = WRITE_QUEUE_SIZE;
+	int failed = 0;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.options = options;
+	if (readBatch(&batch, options->batch_file, 3) == -1 ||
+	    (pool = sh2ckThreadPoolCreate(options->jobs)) == NULL) {
+		for (int i = 0; i < batch.job_count; i++) {
+			free(batch.jobs[i].line);
+		}
+		free(batch.jobs);
+		return 1;
+	}
+	pthread_mutex_init(&batch.mutex, NULL);
+	pthread_cond_init(&batch.cond, NULL);
+
+	if (queue_size > options->max_memory / 4) {
+		queue_size = options->max_memory / 4;
+	}
+	/*without the io thread every file is read and written directly*/
+	batch.io = sh2ckIoQueueCreate(queue_size);
+	if (batch.io != NULL) {
+		/*the queued outputs count against the budget*/
+		batch.used = queue_size;
+	}
+	sh2ckThreadPoolParallelFor(pool, batch.job_count, estimateJob, &batch);
+	qsort(batch.jobs, batch.job_count, sizeof(*batch.jobs), jobCmp);
+	/*workers without a job left help decoding the files still running*/
+	options->pool = pool;
+	sh2ckThreadPoolParallelFor(pool, sh2ckThreadPoolThreadCount(pool),
+	                           batchWorker, &batch);
+	options->pool = NULL;
+	sh2ckThreadPoolDelete(pool);
+	sh2ckIoQueueDelete(batch.io);
+
+	for (int i = 0; i < batch.job_count; i++) {
+		if (batch.jobs[i].ret != 0 || batch.jobs[i].write_failed) {
+			fprintf(stderr, "Error on converting %s\n",
+			        batch.jobs[i].input_file);
+			failed++;
+		}
+	}
+	for (int i = 0; i < batch.job_count; i++) {
+		free(batch.jobs[i].line);
+	}
+	free(batch.jobs);
+	pthread_cond_destroy(&batch.cond);
+	pthread_mutex_destroy(&batch.mutex);
+	return failed ? 1 : 0;
+}
+
+struct SharedInput {
+	struct Sh2ckImageList image_list;
+	struct Sh2ckOffset *offsets;
+	int loaded;
+};
+
+struct Shared {
+	struct Batch batch;
+	struct SharedInput *inputs;
+	/*copies of the image lists of the inputs, laid out by the atlas*/
+	struct Sh2ckImageList *lists;
+	struct Sh2ckOffset **offsets;
+	const char **names;
+	struct SharedAtlas atlas;
+	/*the pages that have to be written*/
+	int *pages;
+	int page_count;
+	struct Options *options;
+	const char *output_dir;
+	const char *name;
+	int failed;
+};
+
+static int loadTgxList(struct Sh2ckImageList *image_list, const char *file,
+                       struct Sh2ckThreadPool *pool)
+{
+	struct Tgx tgx;
+	if (sh2ckTgxCreateFromFile(&tgx, file) == -1) {
+		return -1;
+	}
+	struct Sh2ckRect rect = {0, 0, tgx.width, tgx.height};
+	int size = sizeof(struct Sh2ckColor) * tgx.width * tgx.height;
+	if (sh2ckImageCreateList(image_list, size, 1, 0, 0,
+	                         SH2CK_IMAGE_TYPE_OTHER) == -1) {
+		sh2ckTgxDelete(&tgx);
+		return -1;
+	}
+	if (sh2ckImageCreate(&image_list->images[0], image_list, tgx.width,
+	                     tgx.height) == -1 ||
+	    sh2ckTgxDecodeParallel(&image_list->images[0], &rect, tgx.data,
+	                           tgx.size, NULL, pool) == -1) {
+		sh2ckTgxDelete(&tgx);
+		sh2ckImageDeleteList(image_list);
+		return -1;
+	}
+	sh2ckTgxDelete(&tgx);
+	return 0;
+}
+
+static int loadGm1List(struct SharedInput *input, const char *file,
+                       struct Options *options)
+{
+	struct Gm1 *gm1 = malloc(sizeof(*gm1));
+	if (gm1 == NULL || sh2ckGm1CreateFromFile(gm1, file) == -1) {
+		free(gm1);
+		return -1;
+	}
+	int ret = sh2ckGm1CreateImageListParallel(&input->image_list, 0, gm1,
+	                                          options->palette,
+	                                          options->assemble, options->pool);
+	sh2ckGm1Delete(gm1);
+	free(gm1);
+	if (ret == -1) {
+		return -1;
+	}
+	if (input->image_list.type == SH2CK_IMAGE_TYPE_ANIMATION) {
+		input->offsets = malloc(sizeof(*input->offsets) *
+		                        (input->image_list.image_count + 1));
+		if (input->offsets == NULL) {
+			sh2ckImageDeleteList(&input->image_list);
+			return -1;
+		}
+		sh2ckShrinkAnimationImages(&input->image_list, input->offsets);
+	}
+	return 0;
+}
+
+static void loadSharedInput(void *context, int index)
+{
+	struct Shared *shared = context;
+	struct Job *job = &shared->batch.jobs[index];
+	struct SharedInput *input = &shared->inputs[index];
+	int ret = isTgxFile(job->input_file)
+	              ? loadTgxList(&input->image_list, job->input_file,
+	                            shared->options->pool)
+	              : loadGm1List(input, job->input_file, shared->options);
+	if (ret == -1) {
+		fprintf(stderr, "Error on loading file %s\n", job->input_file);
+		job->ret = 1;
+		return;
+	}
+	input->loaded = 1;
+}
+
+static void saveSharedPage(void *context, int index)
+{
+	char string_buffer[PATH_MAX];
+	struct Shared *shared = context;
+	struct Sh2ckImage image;
+	int page = shared->pages[index];
+
+	snprintf(string_buffer, sizeof(string_buffer), "%s/%s_%d.png",
+	         shared->output_dir, shared->name, page);
+	if (sh2ckAtlasComposePage(&shared->atlas, page, &image) == -1) {
+		shared->failed = 1;
+		return;
+	}
+	if (sh2ckImageSaveParallel(&image, string_buffer, shared->options->pool) ==
+	    -1) {
+		fprintf(stderr, "Error on saving %s\n", string_buffer);
+		shared->failed = 1;
+	}
+	sh2ckImageDelete(&image, NULL);
+}
+
+static int saveSharedData(struct Shared *shared)
+{
+	char string_buffer[PATH_MAX];
+	for (int i = 0; i < shared->batch.job_count; i++) {
+		snprintf(string_buffer, sizeof(string_buffer), "%s/%s.data",
+		         shared->output_dir, shared->names[i]);
+		if (sh2ckImageWriteData(&shared->lists[i], string_buffer) == -1) {
+			return -1;
+		}
+	}
+	snprintf(string_buffer, sizeof(string_buffer), "%s/%s.index",
+	         shared->output_dir, shared->name);
+	return sh2ckAtlasWriteIndex(&shared->atlas, shared->names, string_buffer);
+}
+
+/*starts from the layout in the previous index, unless forced*/
+static int layoutShared(struct Shared *shared)
+{
+	char string_buffer[PATH_MAX];
+	struct AtlasIndex previous;
+	struct Options *options = shared->options;
+	int count = shared->batch.job_count;
+
+	snprintf(string_buffer, sizeof(string_buffer), "%s/%s.index",
+	         shared->output_dir, shared->name);
+	if (options->force || sh2ckAtlasReadIndex(&previous, string_buffer) == -1) {
+		return sh2ckAtlasLayout(&shared->atlas, shared->lists, shared->offsets,
+		                        count, options->page_size, options->page_size,
+		                        options->assemble);
+	}
+	int ret = sh2ckAtlasUpdate(&shared->atlas, shared->lists, shared->offsets,
+	                           shared->names, count, options->page_size,
+	                           options->page_size, options->assemble,
+	                           &previous);
+	sh2ckAtlasDeleteIndex(&previous);
+	return ret;
+}
+
+/*-1 if file is not name_N.png, otherwise N*/
+static int sharedPageNumber(const char *file, const char *name)
+{
+	size_t length = strlen(name);
+	if (strncmp(file, name, length) != 0 || file[length] != '_') {
+		return -1;
+	}
+	const char *digits = file + length + 1;
+	int page = 0;
+	int count = 0;
+	for (; digits[count] >= '0' && digits[count] <= '9'; count++) {
+		if (page > (INT_MAX - 9) / 10) {
+			return -1;
+		}
+		page = page * 10 + (digits[count] - '0');
+	}
+	if (count == 0 || strcmp(digits + count, ".png") != 0) {
+		return -1;
+	}
+	return page;
+}
+
+/*Removes the pages past the new page count, whether they come from the
+ * previous index or from a layout that was forced or could not be read.
+ * Only called once the new pages and index are written.*/
+static void removeStalePages(struct Shared *shared)
+{
+	char string_buffer[PATH_MAX];
+	DIR *dir = opendir(shared->output_dir);
+	if (dir == NULL) {
+		return;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (sharedPageNumber(entry->d_name, shared->name) <
+		    shared->atlas.page_count) {
+			continue;
+		}
+		snprintf(string_buffer, sizeof(string_buffer), "%s/%s",
+		         shared->output_dir, entry->d_name);
+		remove(string_buffer);
+	}
+	closedir(dir);
+}
+
+/*the dirty pages and the pages whose png is missing*/
+static int findSharedPages(struct Shared *shared)
+{
+	char string_buffer[PATH_MAX];
+	struct stat page_stat;
+	struct SharedAtlas *atlas = &shared->atlas;
+
+	shared->pages = malloc(sizeof(*shared->pages) * (atlas->page_count + 1));
+	if (shared->pages == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < atlas->page_count; i++) {
+		snprintf(string_buffer, sizeof(string_buffer), "%s/%s_%d.png",
+		         shared->output_dir, shared->name, i);
+		if (atlas->dirty[i] || stat(string_buffer, &page_stat) == -1) {
+			shared->pages[shared->page_count++] = i;
+		}
+	}
+	return 0;
+}
+
+static int packShared(struct Shared *shared, struct Sh2ckThreadPool *pool,
+                      struct Stats *stats)
+{
+	struct StatsSpan span;
+	int count = shared->batch.job_count;
+
+	shared->inputs = calloc(count + 1, sizeof(*shared->inputs));
+	shared->lists = malloc(sizeof(*shared->lists) * (count + 1));
+	shared->offsets = malloc(sizeof(*shared->offsets) * (count + 1));
+	shared->names = malloc(sizeof(*shared->names) * (count + 1));
+	if (shared->inputs == NULL || shared->lists == NULL ||
+	    shared->offsets == NULL || shared->names == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		shared->names[i] = shared->batch.jobs[i].name;
+	}
+
+	sh2ckStatsBegin(&span, STATS_STAGE_DECODE);
+	sh2ckThreadPoolParallelFor(pool, count, loadSharedInput, shared);
+	for (int i = 0; i < count; i++) {
+		if (!shared->inputs[i].loaded) {
+			return -1;
+		}
+		shared->lists[i] = shared->inputs[i].image_list;
+		shared->offsets[i] = shared->inputs[i].offsets;
+	}
+	sh2ckStatsEnd(stats, &span, 0);
+
+	sh2ckStatsBegin(&span, STATS_STAGE_LAYOUT);
+	if (layoutShared(shared) == -1) {
+		fprintf(stderr, "Error: an image does not fit into a page\n");
+		return -1;
+	}
+	sh2ckStatsEnd(stats, &span, 0);
+
+	sh2ckStatsBegin(&span, STATS_STAGE_ENCODE);
+	if (findSharedPages(shared) == -1) {
+		return -1;
+	}
+	sh2ckThreadPoolParallelFor(pool, shared->page_count, saveSharedPage,
+	                           shared);
+	sh2ckStatsEnd(stats, &span, 0);
+
+	sh2ckStatsBegin(&span, STATS_STAGE_METADATA);
+	if (shared->failed || saveSharedData(shared) == -1) {
+		fprintf(stderr, "Error on saving images\n");
+		return -1;
+	}
+	removeStalePages(shared);
+	sh2ckStatsEnd(stats, &span, 0);
+	return 0;
+}
+
+static void deleteShared(struct Shared *shared)
+{
+	sh2ckAtlasDelete(&shared->atlas);
+	for (int i = 0; shared->inputs != NULL && i < shared->batch.job_count;
+	     i++) {
+		if (shared->inputs[i].loaded) {
+			sh2ckImageDeleteList(&shared->inputs[i].image_list);
+		}
+		free(shared->inputs[i].offsets);
+	}
+	for (int i = 0; i < shared->batch.job_count; i++) {
+		free(shared->batch.jobs[i].line);
+	}
+	free(shared->inputs);
+	free(shared->lists);
+	free(shared->offsets);
+	free(shared->names);
+	free(shared->pages);
+	free(shared->batch.jobs);
+}
+
+/*Packs the images of all files of the list into shared atlas pages
+ * name_0.png, name_1.png, ... The page and rect of every image are written
+ * to name.index, the usual metadata of every file to its own .data with
+ * positions in its page.*/
+static int convertShared(const char *output_dir, const char *name,
+                         struct Options *options)
+{
+	struct Shared shared;
+	struct Sh2ckThreadPool *pool = NULL;
+	struct Stats stats;
+
+	memset(&shared, 0, sizeof(shared));
+	shared.options = options;
+	shared.output_dir = output_dir;
+	shared.name = name;
+	if (mkdir(output_dir, 0775) == -1 && errno != EEXIST) {
+		fprintf(stderr, "Error on creating directory %s\n", output_dir);
+		return 1;
+	}
+	if (readBatch(&shared.batch, options->shared_file, 2) == -1 ||
+	    (pool = sh2ckThreadPoolCreate(options->jobs)) == NULL) {
+		deleteShared(&shared);
+		return 1;
+	}
+
+	sh2ckStatsInit(&stats, name);
+	options->pool = pool;
+	int ret = packShared(&shared, pool, &stats) == -1 ? 1 : 0;
+	options->pool = NULL;
+	if (options->stats) {
+		sh2ckStatsPrint(&stats, stdout);
+		printf("%d of %d pages written\n", shared.page_count,
+		       shared.atlas.page_count);
+	}
+	sh2ckThreadPoolDelete(pool);
+	deleteShared(&shared);
+	return ret;
+}
+
+/*1 if option is followed by a value*/
+static int takesValue(const char *option)
+{
+	static const char *const options[] = {
+	    "-p", "--palette", "--lod", "--trace", "--batch", "--shared",
+	    "--page-size", "-j", "--jobs", "--max-memory"};
+	for (size_t i = 0; i < sizeof(options) / sizeof(*options); i++) {
+		if (strcmp(option, options[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int parseNumber(const char *string, long long *value)
+{
+	char *tmp = NULL;
+	if (string == NULL) {
+		return -1;
+	}
+	*value = strtoll(string, &tmp, 10);
+	if (*tmp != '\0' || *value < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *input_file = NULL;
+	const char *output_dir = NULL;
+	const char *name = NULL;
+	struct Options options;
+	memset(&options, 0x0, sizeof(struct Options));
+	options.jobs = sh2ckThreadCpuCount();
+	options.page_size = SHARED_PAGE_SIZE;
+	options.max_memory = INT64_MAX;
+	const char **paths = malloc(sizeof(*paths) * argc);
+	int path_count = 0;
+	if (paths == NULL) {
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
+			printHelp(stdout);
+			return 0;
+		}
+		if (takesValue(argv[i]) && i + 1 >= argc) {
+			fprintf(stderr, "Error: %s needs a value\n", argv[i]);
+			printHelp(stderr);
+			free(paths);
+			return 1;
+		}
+
+		if ((strcmp(argv[i], "-t") == 0) || (strcmp(argv[i], "--tgx") == 0)) {
+			options.convert_tgx = 1;
+		}
+
+		if (strcmp(argv[i], "--header") == 0) {
+			options.save_header = 1;
+		}
+
+		if ((strcmp(argv[i], "-p") == 0) ||
+		    (strcmp(argv[i], "--palette") == 0)) {
+			char *tmp = NULL;
+			unsigned long val = strtoul(argv[++i], &tmp, 10);
+			if (*tmp != '\0') {
+				printHelp(stderr);
+				return 1;
+			}
+
+			if (val >= 10) {
+				fprintf(stderr, "Error: Palette has to be between 0 and 9\n");
+				return 1;
+			}
+			printf("%d\n", (int)val);
+			options.palette = val;
+			continue;
+		}
+		if ((strcmp(argv[i], "-a") == 0) ||
+		    (strcmp(argv[i], "--assemble") == 0)) {
+			options.assemble = 1;
+		}
+		if ((strcmp(argv[i], "-P")) == 0 || (strcmp(argv[i], "--pack") == 0)) {
+			options.pack = 1;
+		}
+		if ((strcmp(argv[i], "-s")) == 0 || (strcmp(argv[i], "--sort") == 0)) {
+			options.sort = 1;
+		}
+		if ((strcmp(argv[i], "-f")) == 0 ||
+		    (strcmp(argv[i], "--force") == 0)) {
+			options.force = 1;
+		}
+		if (strcmp(argv[i], "--info") == 0) {
+			options.info = 1;
+		}
+		if (strcmp(argv[i], "--csv") == 0) {
+			options.csv = 1;
+		}
+		if (strcmp(argv[i], "--sprites") == 0) {
+			options.sprites = 1;
+		}
+		if (strcmp(argv[i], "--delta") == 0) {
+			options.delta = 1;
+		}
+		if (strcmp(argv[i], "--masks") == 0) {
+			options.masks = 1;
+		}
+		if (strcmp(argv[i], "--footprints") == 0) {
+			options.footprints = 1;
+		}
+		if (strcmp(argv[i], "--layers") == 0) {
+			options.layers = 1;
+		}
+		if (strcmp(argv[i], "--glyphs") == 0) {
+			options.glyphs = 1;
+		}
+		if (strcmp(argv[i], "--lod") == 0) {
+			long long val = 0;
+			if (parseNumber(argv[++i], &val) == -1 || val > LOD_LEVELS_MAX) {
+				fprintf(stderr, "Error: Lod has to be between 0 and %d\n",
+				        LOD_LEVELS_MAX);
+				return 1;
+			}
+			options.lod = val;
+			continue;
+		}
+		if (strcmp(argv[i], "--stats") == 0) {
+			options.stats = 1;
+		}
+		if (strcmp(argv[i], "--trace") == 0) {
+			options.trace_file = argv[++i];
+			continue;
+		}
+		if (strcmp(argv[i], "--batch") == 0) {
+			options.batch_file = argv[++i];
+			continue;
+		}
+		if (strcmp(argv[i], "--shared") == 0) {
+			options.shared_file = argv[++i];
+			continue;
+		}
+		if (strcmp(argv[i], "--page-size") == 0) {
+			long long val = 0;
+			if (parseNumber(argv[++i], &val) == -1 || val < 2 ||
+			    val > INT16_MAX) {
+				fprintf(stderr, "Error: Invalid page size\n");
+				return 1;
+			}
+			options.page_size = val;
+			continue;
+		}
+		if ((strcmp(argv[i], "-j") == 0) || (strcmp(argv[i], "--jobs") == 0)) {
+			long long val = 0;
+			if (parseNumber(argv[++i], &val) == -1 || val < 1) {
+				fprintf(stderr, "Error: Jobs has to be at least 1\n");
+				return 1;
+			}
+			options.jobs = val > INT_MAX ? INT_MAX : val;
+			continue;
+		}
+		if (strcmp(argv[i], "--max-memory") == 0) {
+			long long val = 0;
+			if (parseNumber(argv[++i], &val) == -1 || val < 1 ||
+			    val > INT64_MAX / (1024 * 1024)) {
+				fprintf(stderr, "Error: Invalid memory budget\n");
+				return 1;
+			}
+			options.max_memory = val * 1024 * 1024;
+			continue;
+		}
+		if (argv[i][0] != '-') {
+			paths[path_count++] = argv[i];
+		}
+	}
+
+	if (options.info) {
+		int ret = printInfo(paths, path_count, &options);
+		free(paths);
+		return ret;
+	}
+	free(paths);
+
+	if (options.trace_file != NULL &&
+	    sh2ckTraceOpen(options.trace_file) == -1) {
+		fprintf(stderr, "Error on opening %s\n", options.trace_file);
+		return 1;
+	}
+
+	int ret = 0;
+	if (options.batch_file != NULL) {
+		ret = runBatch(&options);
+	} else if (options.shared_file != NULL && argc >= 3) {
+		ret = convertShared(argv[argc - 2], argv[argc - 1], &options);
+	} else if (argc < 4) {
+		printHelp(stderr);
+		ret = 1;
+	} else {
+		struct Sh2ckThreadPool *pool = NULL;
+		input_file = argv[argc - 3];
+		output_dir = argv[argc - 2];
+		name = argv[argc - 1];
+		pool = sh2ckThreadPoolCreate(options.jobs);
+		if (pool == NULL) {
+			sh2ckTraceClose();
+			return 1;
+		}
+		options.pool = pool;
+		ret = convertFile(input_file, output_dir, name, &options);
+		sh2ckThreadPoolDelete(pool);
 	}
+	sh2ckTraceClose();
+	return ret;
 }
@@ -0,0 +1,264 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "image.h"
+#include "io.h"
+#include "mask.h"
+#include "memory.h"
+
+#define MASK_HEADER_SIZE 8
+#define MASK_SHEET_HEADER_SIZE 12
+
+static int rowWords(int width)
+{
+	return (width + 31) / 32;
+}
+
+static uint32_t bitsWords(const struct HitMask *mask)
+{
+	return (uint32_t)rowWords(mask->width) * mask->height;
+}
+
+static uint32_t gridWords(const struct HitMask *mask)
+{
+	return (uint32_t)rowWords(mask->grid_width) * mask->grid_height;
+}
+
+static int testBit(const uint32_t *bits, int row_words, int x, int y)
+{
+	return (bits[y * row_words + x / 32] >> (x % 32)) & 1;
+}
+
+static void setBit(uint32_t *bits, int row_words, int x, int y)
+{
+	bits[y * row_words + x / 32] |= 1u << (x % 32);
+}
+
+int sh2ckMaskCreateImage(struct HitMask *mask, const struct Sh2ckImage *image,
+                         const struct Sh2ckOffset *offset)
+{
+	int offset_x = offset != NULL ? offset->x : 0;
+	int offset_y = offset != NULL ? offset->y : 0;
+	/*the bounding box of a fully transparent frame is negative*/
+	mask->width = image->width > 0 ? image->width : 0;
+	mask->height = image->height > 0 ? image->height : 0;
+	mask->grid_width = (mask->width + MASK_BLOCK_SIZE - 1) / MASK_BLOCK_SIZE;
+	mask->grid_height = (mask->height + MASK_BLOCK_SIZE - 1) / MASK_BLOCK_SIZE;
+
+	uint32_t words = bitsWords(mask) + gridWords(mask);
+	mask->buffer = sh2ckMemoryAlloc(sizeof(uint32_t) * (words + 1));
+	if (mask->buffer == NULL) {
+		return -1;
+	}
+	memset(mask->buffer, 0, sizeof(uint32_t) * words);
+	mask->bits = mask->buffer;
+	mask->grid = mask->buffer + bitsWords(mask);
+
+	int row_words = rowWords(mask->width);
+	int grid_row_words = rowWords(mask->grid_width);
+	for (int y = 0; y < mask->height; y++) {
+		const struct Sh2ckColor *row =
+		    image->pixel + (y + offset_y) * image->pitch + offset_x;
+		for (int x = 0; x < mask->width; x++) {
+			if (row[x].a == 0xFF) {
+				setBit(mask->bits, row_words, x, y);
+				setBit(mask->grid, grid_row_words, x / MASK_BLOCK_SIZE,
+				       y / MASK_BLOCK_SIZE);
+			}
+		}
+	}
+	return 0;
+}
+
+void sh2ckMaskDelete(struct HitMask *mask)
+{
+	if (mask != NULL) {
+		sh2ckMemoryFree(mask->buffer);
+		mask->buffer = NULL;
+		mask->bits = NULL;
+		mask->grid = NULL;
+	}
+}
+
+int sh2ckMaskTest(const struct HitMask *mask, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= mask->width || y >= mask->height) {
+		return 0;
+	}
+	return testBit(mask->bits, rowWords(mask->width), x, y);
+}
+
+int sh2ckMaskTestRect(const struct HitMask *mask, const struct Sh2ckRect *rect)
+{
+	int left = rect->x > 0 ? rect->x : 0;
+	int top = rect->y > 0 ? rect->y : 0;
+	int right = rect->x + rect->width;
+	int bottom = rect->y + rect->height;
+	right = right < mask->width ? right : mask->width;
+	bottom = bottom < mask->height ? bottom : mask->height;
+
+	int row_words = rowWords(mask->width);
+	int grid_row_words = rowWords(mask->grid_width);
+	for (int by = top / MASK_BLOCK_SIZE; by * MASK_BLOCK_SIZE < bottom;
+	     by++) {
+		for (int bx = left / MASK_BLOCK_SIZE; bx * MASK_BLOCK_SIZE < right;
+		     bx++) {
+			if (!testBit(mask->grid, grid_row_words, bx, by)) {
+				continue;
+			}
+			int x_end = (bx + 1) * MASK_BLOCK_SIZE;
+			int y_end = (by + 1) * MASK_BLOCK_SIZE;
+			x_end = x_end < right ? x_end : right;
+			y_end = y_end < bottom ? y_end : bottom;
+			for (int y = by * MASK_BLOCK_SIZE; y < y_end; y++) {
+				if (y < top) {
+					continue;
+				}
+				for (int x = bx * MASK_BLOCK_SIZE; x < x_end; x++) {
+					if (x >= left && testBit(mask->bits, row_words, x, y)) {
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+uint32_t sh2ckMaskDataSize(const struct HitMask *mask)
+{
+	return sizeof(uint32_t) * (bitsWords(mask) + gridWords(mask));
+}
+
+int sh2ckMaskSheetSave(const char *file, const struct HitMask *masks,
+                       int mask_count)
+{
+	uint32_t header[2] = {MASK_SHEET_VERSION, mask_count};
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	fwrite(MASK_SHEET_MAGIC, 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+
+	uint32_t offset = MASK_SHEET_HEADER_SIZE + sizeof(uint32_t) * mask_count;
+	for (int i = 0; i < mask_count; i++) {
+		fwrite(&offset, sizeof(offset), 1, fp);
+		offset += MASK_HEADER_SIZE + sh2ckMaskDataSize(&masks[i]);
+	}
+	for (int i = 0; i < mask_count; i++) {
+		const struct HitMask *mask = &masks[i];
+		uint16_t mask_header[4] = {mask->width, mask->height,
+		                           mask->grid_width, mask->grid_height};
+		fwrite(mask_header, sizeof(mask_header), 1, fp);
+		fwrite(mask->bits, sizeof(uint32_t), bitsWords(mask), fp);
+		fwrite(mask->grid, sizeof(uint32_t), gridWords(mask), fp);
+	}
+	if (ferror(fp)) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+int sh2ckMaskSheetLoad(struct MaskSheet *sheet, const char *file)
+{
+	uint32_t header[2];
+	sheet->buffer = NULL;
+	sheet->mask_count = 0;
+	sheet->size = 0;
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return -1;
+	}
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < MASK_SHEET_HEADER_SIZE || size > UINT32_MAX) {
+		fclose(fp);
+		return -1;
+	}
+	sheet->buffer = sh2ckMemoryAlloc(size);
+	if (sheet->buffer == NULL ||
+	    fread(sheet->buffer, 1, size, fp) < (size_t)size) {
+		fclose(fp);
+		sh2ckMaskSheetDelete(sheet);
+		return -1;
+	}
+	fclose(fp);
+
+	memcpy(header, sheet->buffer + 4, sizeof(header));
+	if (memcmp(sheet->buffer, MASK_SHEET_MAGIC, 4) != 0 ||
+	    header[0] != MASK_SHEET_VERSION ||
+	    header[1] > (size - MASK_SHEET_HEADER_SIZE) / sizeof(uint32_t)) {
+		sh2ckMaskSheetDelete(sheet);
+		return -1;
+	}
+	sheet->mask_count = header[1];
+	sheet->size = size;
+	return 0;
+}
+
+int sh2ckMaskSheetGet(struct MaskSheet *sheet, int index, struct HitMask *mask)
+{
+	uint32_t offset;
+	uint16_t mask_header[4];
+	if (index < 0 || index >= sheet->mask_count) {
+		return -1;
+	}
+	memcpy(&offset,
+	       sheet->buffer + MASK_SHEET_HEADER_SIZE + index * sizeof(offset),
+	       sizeof(offset));
+	if (offset % 4 != 0 || offset > sheet->size - MASK_HEADER_SIZE) {
+		return -1;
+	}
+	memcpy(mask_header, sheet->buffer + offset, sizeof(mask_header));
+	mask->width = mask_header[0];
+	mask->height = mask_header[1];
+	mask->grid_width = mask_header[2];
+	mask->grid_height = mask_header[3];
+	mask->buffer = NULL;
+	offset += MASK_HEADER_SIZE;
+
+	if (mask->grid_width !=
+	        (mask->width + MASK_BLOCK_SIZE - 1) / MASK_BLOCK_SIZE ||
+	    mask->grid_height !=
+	        (mask->height + MASK_BLOCK_SIZE - 1) / MASK_BLOCK_SIZE ||
+	    sh2ckMaskDataSize(mask) > sheet->size - offset) {
+		return -1;
+	}
+	mask->bits = (uint32_t *)(sheet->buffer + offset);
+	mask->grid = mask->bits + bitsWords(mask);
+	return 0;
+}
+
+void sh2ckMaskSheetDelete(struct MaskSheet *sheet)
+{
+	if (sheet != NULL) {
+		sh2ckMemoryFree(sheet->buffer);
+		sheet->buffer = NULL;
+		sheet->mask_count = 0;
+		sheet->size = 0;
+	}
+}
@@ -0,0 +1,88 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_MASK_H
+#define SH2CK_MASK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*1 bit hit-test masks for picking without the pixels. Rows are padded to
+ * whole uint32 words, bit x % 32 of word x / 32 is set if pixel x is
+ * opaque. The coarse grid has one bit per MASK_BLOCK_SIZE square block of
+ * pixels, set if any pixel of the block is opaque, laid out the same way.*/
+
+#define MASK_BLOCK_SIZE 4
+
+#define MASK_SHEET_MAGIC "SH2M"
+#define MASK_SHEET_VERSION 1
+
+struct Sh2ckImage;
+struct Sh2ckOffset;
+struct Sh2ckRect;
+
+struct HitMask {
+	uint16_t width;
+	uint16_t height;
+	uint16_t grid_width;
+	uint16_t grid_height;
+	uint32_t *bits;
+	uint32_t *grid;
+	/*created masks own bits and grid, loaded ones point into the sheet*/
+	uint32_t *buffer;
+};
+
+struct MaskSheet {
+	int mask_count;
+	uint32_t size;
+	uint8_t *buffer;
+};
+
+/*pixels with an alpha of 0xFF are opaque, offset is the top left corner
+ * of a trimmed image in its pixels and may be NULL*/
+int sh2ckMaskCreateImage(struct HitMask *mask, const struct Sh2ckImage *image,
+                         const struct Sh2ckOffset *offset);
+
+void sh2ckMaskDelete(struct HitMask *mask);
+
+/*1 if the pixel at x, y is opaque, 0 if not or outside of the mask*/
+int sh2ckMaskTest(const struct HitMask *mask, int x, int y);
+
+/*1 if any pixel inside of rect is opaque, skips empty blocks on the grid*/
+int sh2ckMaskTestRect(const struct HitMask *mask, const struct Sh2ckRect *rect);
+
+/*bytes of the bits and the grid*/
+uint32_t sh2ckMaskDataSize(const struct HitMask *mask);
+
+int sh2ckMaskSheetSave(const char *file, const struct HitMask *masks,
+                       int mask_count);
+
+int sh2ckMaskSheetLoad(struct MaskSheet *sheet, const char *file);
+
+/*mask points into the sheet and stays valid until the sheet is deleted*/
+int sh2ckMaskSheetGet(struct MaskSheet *sheet, int index, struct HitMask *mask);
+
+void sh2ckMaskSheetDelete(struct MaskSheet *sheet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_MASK_H
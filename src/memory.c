@@ -0,0 +1,67 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "memory.h"
+
+static void *defaultAlloc(size_t size, void *user)
+{
+	return malloc(size);
+}
+
+static void *defaultRealloc(void *ptr, size_t size, void *user)
+{
+	return realloc(ptr, size);
+}
+
+static void defaultFree(void *ptr, void *user)
+{
+	free(ptr);
+}
+
+static struct Sh2ckAllocator allocator = {defaultAlloc, defaultRealloc,
+                                          defaultFree, NULL};
+
+void sh2ckMemorySetAllocator(const struct Sh2ckAllocator *new_allocator)
+{
+	if (new_allocator == NULL) {
+		allocator.alloc = defaultAlloc;
+		allocator.realloc = defaultRealloc;
+		allocator.free = defaultFree;
+		allocator.user = NULL;
+	} else {
+		allocator = *new_allocator;
+	}
+}
+
+void *sh2ckMemoryAlloc(size_t size)
+{
+	return allocator.alloc(size, allocator.user);
+}
+
+void *sh2ckMemoryRealloc(void *ptr, size_t size)
+{
+	return allocator.realloc(ptr, size, allocator.user);
+}
+
+void sh2ckMemoryFree(void *ptr)
+{
+	if (ptr != NULL) {
+		allocator.free(ptr, allocator.user);
+	}
+}
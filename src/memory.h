@@ -0,0 +1,54 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_MEMORY_H
+#define SH2CK_MEMORY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*All allocations of the library go through these callbacks, except the
+ * output files that batch mode of sh2ck buffers with open_memstream, which
+ * libc allocates and which are released with free.*/
+struct Sh2ckAllocator {
+	void *(*alloc)(size_t size, void *user);
+	void *(*realloc)(void *ptr, size_t size, void *user);
+	void (*free)(void *ptr, void *user);
+	void *user;
+};
+
+/*NULL restores the default malloc based allocator. Not thread safe: has to
+ * be called before any other function of the library and while no other
+ * thread uses it, and not while objects created with the previous allocator
+ * are still alive. The callbacks themselves are called from the threads of a
+ * thread pool at the same time, so they have to be thread safe.*/
+void sh2ckMemorySetAllocator(const struct Sh2ckAllocator *allocator);
+
+void *sh2ckMemoryAlloc(size_t size);
+
+void *sh2ckMemoryRealloc(void *ptr, size_t size);
+
+void sh2ckMemoryFree(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_MEMORY_H
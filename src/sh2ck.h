@@ -0,0 +1,43 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_H
+#define SH2CK_H
+
+/*Public interface of libsh2ck, installed as <sh2ck/sh2ck.h>.
+ *
+ * Load a gm1 file with sh2ckGm1CreateFromFile, decode it with
+ * sh2ckGm1CreateImageList and optionally pack it with sh2ckImageCreateAtlas.
+ * Single tgx files are decoded with sh2ckTgxCreateImage. Every allocation goes
+ * through sh2ckMemorySetAllocator.*/
+
+#define SH2CK_VERSION_MAJOR 1
+#define SH2CK_VERSION_MINOR 0
+
+#include "atlas.h"
+#include "delta.h"
+#include "font.h"
+#include "gm1.h"
+#include "image.h"
+#include "layers.h"
+#include "mask.h"
+#include "memory.h"
+#include "sprite.h"
+#include "tgx.h"
+#include "thread.h"
+
+#endif  // SH2CK_H
@@ -0,0 +1,550 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "image.h"
+#include "io.h"
+#include "memory.h"
+#include "sprite.h"
+#include "tgx.h"
+
+#define SPRITE_HEADER_SIZE 12
+#define SPRITE_SHEET_HEADER_SIZE 12
+
+struct SpriteWriter {
+	uint8_t *data;
+	uint32_t size;
+	uint32_t capacity;
+	uint32_t *row_offsets;
+	int pixel_size;
+	uint32_t row_start;
+	uint32_t run_start;
+	int run_count;
+	int run_open;
+	int skip;
+	int count;
+};
+
+static uint16_t read16(const uint8_t *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static void write16(uint8_t *data, uint16_t value)
+{
+	memcpy(data, &value, sizeof(value));
+}
+
+static struct Sh2ckColor spriteColor(uint16_t color)
+{
+	struct Sh2ckColor c = {SH2CK_COLOR_CONVERT_BLUE(color),
+	                       SH2CK_COLOR_CONVERT_GREEN(color),
+	                       SH2CK_COLOR_CONVERT_RED(color), 0xFF};
+	return c;
+}
+
+static uint16_t spriteColor555(const struct Sh2ckColor *color)
+{
+	return ((color->r >> 3) << 10) | ((color->g >> 3) << 5) | (color->b >> 3);
+}
+
+/*returns the offset of the size new bytes, which are zeroed*/
+static int64_t writerGrow(struct SpriteWriter *writer, uint32_t size)
+{
+	if (writer->size + size > writer->capacity) {
+		uint32_t capacity = writer->capacity ? writer->capacity * 2 : 4096;
+		while (capacity < writer->size + size) {
+			capacity *= 2;
+		}
+		uint8_t *data = sh2ckMemoryRealloc(writer->data, capacity);
+		if (data == NULL) {
+			return -1;
+		}
+		writer->data = data;
+		writer->capacity = capacity;
+	}
+	uint32_t offset = writer->size;
+	memset(writer->data + offset, 0, size);
+	writer->size += size;
+	return offset;
+}
+
+static int writerAlign(struct SpriteWriter *writer, uint32_t alignment)
+{
+	uint32_t padding = (alignment - writer->size % alignment) % alignment;
+	return writerGrow(writer, padding) == -1 ? -1 : 0;
+}
+
+static int writerBeginRow(struct SpriteWriter *writer, int row)
+{
+	if (writerAlign(writer, 4) == -1) {
+		return -1;
+	}
+	writer->row_offsets[row] = writer->size;
+	writer->row_start = writer->size;
+	writer->run_count = 0;
+	writer->run_open = 0;
+	writer->skip = 0;
+	return writerGrow(writer, 2) == -1 ? -1 : 0;
+}
+
+static int writerCloseRun(struct SpriteWriter *writer)
+{
+	if (!writer->run_open) {
+		return 0;
+	}
+	write16(writer->data + writer->run_start + 2, writer->count);
+	writer->run_open = 0;
+	return writerAlign(writer, 2);
+}
+
+static int writerEndRow(struct SpriteWriter *writer)
+{
+	if (writerCloseRun(writer) == -1) {
+		return -1;
+	}
+	write16(writer->data + writer->row_start, writer->run_count);
+	return 0;
+}
+
+static int writerSkip(struct SpriteWriter *writer, int count)
+{
+	if (writerCloseRun(writer) == -1) {
+		return -1;
+	}
+	writer->skip += count;
+	return 0;
+}
+
+/*returns the offset to write count opaque pixels to*/
+static int64_t writerPixels(struct SpriteWriter *writer, int count)
+{
+	if (!writer->run_open) {
+		int64_t offset = writerGrow(writer, 4);
+		if (offset == -1) {
+			return -1;
+		}
+		write16(writer->data + offset, writer->skip);
+		writer->run_start = offset;
+		writer->run_open = 1;
+		writer->run_count++;
+		writer->skip = 0;
+		writer->count = 0;
+	}
+	writer->count += count;
+	return writerGrow(writer, count * writer->pixel_size);
+}
+
+static int writerInit(struct SpriteWriter *writer, struct Sprite *sprite,
+                      int width, int height, int format)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->pixel_size = format == SPRITE_FORMAT_INDEXED ? 1 : 2;
+	sprite->width = width;
+	sprite->height = height;
+	sprite->format = format;
+	sprite->reserved = 0;
+	sprite->data_size = 0;
+	sprite->data = NULL;
+	sprite->buffer = NULL;
+	sprite->row_offsets = sh2ckMemoryAlloc(sizeof(uint32_t) * (height + 1));
+	if (width < 0 || width > UINT16_MAX || height < 0 ||
+	    height > UINT16_MAX || sprite->row_offsets == NULL) {
+		sh2ckMemoryFree(sprite->row_offsets);
+		sprite->row_offsets = NULL;
+		return -1;
+	}
+	writer->row_offsets = sprite->row_offsets;
+	return 0;
+}
+
+/*rows from row on are left empty*/
+static int writerFinish(struct SpriteWriter *writer, struct Sprite *sprite,
+                        int row)
+{
+	for (; row < sprite->height; row++) {
+		if (writerBeginRow(writer, row) == -1 || writerEndRow(writer) == -1) {
+			return -1;
+		}
+	}
+	if (writerAlign(writer, 4) == -1) {
+		return -1;
+	}
+	sprite->data_size = writer->size;
+	sprite->data = writer->data;
+	sprite->buffer = writer->data;
+	return 0;
+}
+
+static int writerFail(struct SpriteWriter *writer, struct Sprite *sprite)
+{
+	sh2ckMemoryFree(writer->data);
+	sh2ckMemoryFree(sprite->row_offsets);
+	sprite->row_offsets = NULL;
+	return -1;
+}
+
+int sh2ckSpriteEncodeTgx(struct Sprite *sprite, int width, int height,
+                         const uint8_t *data, int size, int indexed)
+{
+	struct SpriteWriter writer;
+	int format = indexed ? SPRITE_FORMAT_INDEXED : SPRITE_FORMAT_RGB555;
+	if (writerInit(&writer, sprite, width, height, format) == -1) {
+		return -1;
+	}
+	if (height == 0) {
+		return writerFinish(&writer, sprite, 0) == -1
+		           ? writerFail(&writer, sprite)
+		           : 0;
+	}
+
+	int pixel_size = writer.pixel_size;
+	int x = 0;
+	int y = 0;
+	int i = 0;
+	if (writerBeginRow(&writer, 0) == -1) {
+		return writerFail(&writer, sprite);
+	}
+	while (i < size) {
+		int type = TGX_GET_TOKEN_TYPE(data[i]);
+		int length = TGX_GET_TOKEN_VALUE(data[i]) + 1;
+		int64_t offset = 0;
+		i++;
+		if (type != TGX_TOKEN_NEW_LINE && length > width - x) {
+			return writerFail(&writer, sprite);
+		}
+		switch (type) {
+			case TGX_TOKEN_NEW_LINE:
+				if (writerEndRow(&writer) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				if (++y == height) {
+					return writerFinish(&writer, sprite, y) == -1
+					           ? writerFail(&writer, sprite)
+					           : 0;
+				}
+				if (writerBeginRow(&writer, y) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				x = 0;
+				break;
+			case TGX_TOKEN_TRANSPARENT_PIXEL_STRING:
+				if (writerSkip(&writer, length) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				x += length;
+				break;
+			case TGX_TOKEN_PIXEL_STREAM:
+				if (length * pixel_size > size - i ||
+				    (offset = writerPixels(&writer, length)) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				memcpy(writer.data + offset, data + i, length * pixel_size);
+				i += length * pixel_size;
+				x += length;
+				break;
+			case TGX_TOKEN_REPEATING_PIXEL:
+				if (pixel_size > size - i ||
+				    (offset = writerPixels(&writer, length)) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				for (int j = 0; j < length; j++) {
+					memcpy(writer.data + offset + j * pixel_size, data + i,
+					       pixel_size);
+				}
+				i += pixel_size;
+				x += length;
+				break;
+			default:
+				return writerFail(&writer, sprite);
+		}
+	}
+	if (writerEndRow(&writer) == -1 ||
+	    writerFinish(&writer, sprite, y + 1) == -1) {
+		return writerFail(&writer, sprite);
+	}
+	return 0;
+}
+
+int sh2ckSpriteEncodeImage(struct Sprite *sprite,
+                           const struct Sh2ckImage *image)
+{
+	struct SpriteWriter writer;
+	if (writerInit(&writer, sprite, image->width, image->height,
+	               SPRITE_FORMAT_RGB555) == -1) {
+		return -1;
+	}
+	for (int y = 0; y < image->height; y++) {
+		const struct Sh2ckColor *row = image->pixel + y * image->pitch;
+		if (writerBeginRow(&writer, y) == -1) {
+			return writerFail(&writer, sprite);
+		}
+		int x = 0;
+		while (x < image->width) {
+			int start = x;
+			if (row[x].a == 0) {
+				while (x < image->width && row[x].a == 0) {
+					x++;
+				}
+				if (writerSkip(&writer, x - start) == -1) {
+					return writerFail(&writer, sprite);
+				}
+				continue;
+			}
+			while (x < image->width && row[x].a != 0) {
+				x++;
+			}
+			int64_t offset = writerPixels(&writer, x - start);
+			if (offset == -1) {
+				return writerFail(&writer, sprite);
+			}
+			for (int j = start; j < x; j++) {
+				write16(writer.data + offset, spriteColor555(&row[j]));
+				offset += 2;
+			}
+		}
+		if (writerEndRow(&writer) == -1) {
+			return writerFail(&writer, sprite);
+		}
+	}
+	if (writerFinish(&writer, sprite, image->height) == -1) {
+		return writerFail(&writer, sprite);
+	}
+	return 0;
+}
+
+void sh2ckSpriteDelete(struct Sprite *sprite)
+{
+	if (sprite != NULL && sprite->buffer != NULL) {
+		sh2ckMemoryFree(sprite->buffer);
+		sh2ckMemoryFree(sprite->row_offsets);
+		sprite->buffer = NULL;
+		sprite->row_offsets = NULL;
+		sprite->data = NULL;
+	}
+}
+
+int sh2ckSpriteBlit(struct Sh2ckImage *target, int x, int y,
+                    const struct Sprite *sprite, const uint16_t *palette,
+                    const struct Sh2ckRect *clip)
+{
+	int left = 0;
+	int top = 0;
+	int right = target->width;
+	int bottom = target->height;
+	int indexed = sprite->format == SPRITE_FORMAT_INDEXED;
+
+	if (indexed && palette == NULL) {
+		return -1;
+	}
+	if (clip != NULL) {
+		left = clip->x > left ? clip->x : left;
+		top = clip->y > top ? clip->y : top;
+		right = clip->x + clip->width < right ? clip->x + clip->width : right;
+		bottom =
+		    clip->y + clip->height < bottom ? clip->y + clip->height : bottom;
+	}
+	int row_begin = top - y > 0 ? top - y : 0;
+	int row_end = bottom - y < sprite->height ? bottom - y : sprite->height;
+
+	for (int row = row_begin; row < row_end; row++) {
+		const uint8_t *p = sprite->data + sprite->row_offsets[row];
+		struct Sh2ckColor *pixel = target->pixel + (y + row) * target->pitch;
+		int run_count = read16(p);
+		int px = x;
+		p += 2;
+		for (int r = 0; r < run_count && px < right; r++) {
+			int count = read16(p + 2);
+			px += read16(p);
+			p += 4;
+			int begin = left - px > 0 ? left - px : 0;
+			int end = right - px < count ? right - px : count;
+			if (indexed) {
+				for (int j = begin; j < end; j++) {
+					pixel[px + j] = spriteColor(palette[p[j]]);
+				}
+				p += count + (count & 1);
+			} else {
+				for (int j = begin; j < end; j++) {
+					pixel[px + j] = spriteColor(read16(p + 2 * j));
+				}
+				p += 2 * count;
+			}
+			px += count;
+		}
+	}
+	return 0;
+}
+
+static uint32_t spriteRecordSize(const struct Sprite *sprite)
+{
+	return SPRITE_HEADER_SIZE + sizeof(uint32_t) * sprite->height +
+	       sprite->data_size;
+}
+
+int sh2ckSpriteSheetSave(const char *file, const struct Sprite *sprites,
+                         int sprite_count)
+{
+	uint32_t header[2] = {SPRITE_SHEET_VERSION, sprite_count};
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	fwrite(SPRITE_SHEET_MAGIC, 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+
+	uint32_t offset =
+	    SPRITE_SHEET_HEADER_SIZE + sizeof(uint32_t) * sprite_count;
+	for (int i = 0; i < sprite_count; i++) {
+		fwrite(&offset, sizeof(offset), 1, fp);
+		offset += spriteRecordSize(&sprites[i]);
+	}
+	for (int i = 0; i < sprite_count; i++) {
+		const struct Sprite *sprite = &sprites[i];
+		uint16_t sprite_header[4] = {sprite->width, sprite->height,
+		                             sprite->format, 0};
+		fwrite(sprite_header, sizeof(sprite_header), 1, fp);
+		fwrite(&sprite->data_size, sizeof(sprite->data_size), 1, fp);
+		fwrite(sprite->row_offsets, sizeof(uint32_t), sprite->height, fp);
+		fwrite(sprite->data, 1, sprite->data_size, fp);
+	}
+	if (ferror(fp)) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+int sh2ckSpriteSheetLoad(struct SpriteSheet *sheet, const char *file)
+{
+	uint32_t header[2];
+	sheet->buffer = NULL;
+	sheet->sprite_count = 0;
+	sheet->size = 0;
+
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return -1;
+	}
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size < SPRITE_SHEET_HEADER_SIZE || size > UINT32_MAX) {
+		fclose(fp);
+		return -1;
+	}
+	sheet->buffer = sh2ckMemoryAlloc(size);
+	if (sheet->buffer == NULL ||
+	    fread(sheet->buffer, 1, size, fp) < (size_t)size) {
+		fclose(fp);
+		sh2ckSpriteSheetDelete(sheet);
+		return -1;
+	}
+	fclose(fp);
+
+	memcpy(header, sheet->buffer + 4, sizeof(header));
+	if (memcmp(sheet->buffer, SPRITE_SHEET_MAGIC, 4) != 0 ||
+	    header[0] != SPRITE_SHEET_VERSION ||
+	    header[1] > (size - SPRITE_SHEET_HEADER_SIZE) / sizeof(uint32_t)) {
+		sh2ckSpriteSheetDelete(sheet);
+		return -1;
+	}
+	sheet->sprite_count = header[1];
+	sheet->size = size;
+	return 0;
+}
+
+/*checks that every run of every row stays inside of the data and the
+ * sprite width*/
+static int spriteValidate(const struct Sprite *sprite)
+{
+	int pixel_size = sprite->format == SPRITE_FORMAT_INDEXED ? 1 : 2;
+	for (int row = 0; row < sprite->height; row++) {
+		uint32_t offset = sprite->row_offsets[row];
+		if (offset % 4 != 0 || offset > sprite->data_size - 2) {
+			return -1;
+		}
+		int run_count = read16(sprite->data + offset);
+		int x = 0;
+		offset += 2;
+		for (int r = 0; r < run_count; r++) {
+			if (offset > sprite->data_size - 4) {
+				return -1;
+			}
+			int count = read16(sprite->data + offset + 2);
+			x += read16(sprite->data + offset) + count;
+			offset += 4 + count * pixel_size + (count * pixel_size & 1);
+			if (x > sprite->width || offset > sprite->data_size) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+int sh2ckSpriteSheetGet(struct SpriteSheet *sheet, int index,
+                        struct Sprite *sprite)
+{
+	uint32_t offset;
+	uint16_t sprite_header[4];
+	if (index < 0 || index >= sheet->sprite_count) {
+		return -1;
+	}
+	memcpy(&offset,
+	       sheet->buffer + SPRITE_SHEET_HEADER_SIZE + index * sizeof(offset),
+	       sizeof(offset));
+	if (offset % 4 != 0 || offset > sheet->size - SPRITE_HEADER_SIZE) {
+		return -1;
+	}
+	memcpy(sprite_header, sheet->buffer + offset, sizeof(sprite_header));
+	memcpy(&sprite->data_size, sheet->buffer + offset + 8,
+	       sizeof(sprite->data_size));
+	sprite->width = sprite_header[0];
+	sprite->height = sprite_header[1];
+	sprite->format = sprite_header[2];
+	sprite->reserved = 0;
+	sprite->buffer = NULL;
+	offset += SPRITE_HEADER_SIZE;
+
+	uint32_t table_size = sizeof(uint32_t) * sprite->height;
+	if (sprite->format > SPRITE_FORMAT_INDEXED ||
+	    table_size > sheet->size - offset ||
+	    sprite->data_size > sheet->size - offset - table_size ||
+	    (sprite->height > 0 && sprite->data_size < 4)) {
+		return -1;
+	}
+	sprite->row_offsets = (uint32_t *)(sheet->buffer + offset);
+	sprite->data = sheet->buffer + offset + table_size;
+	return spriteValidate(sprite);
+}
+
+void sh2ckSpriteSheetDelete(struct SpriteSheet *sheet)
+{
+	if (sheet != NULL) {
+		sh2ckMemoryFree(sheet->buffer);
+		sheet->buffer = NULL;
+		sheet->sprite_count = 0;
+		sheet->size = 0;
+	}
+}
@@ -0,0 +1,95 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_SPRITE_H
+#define SH2CK_SPRITE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Run-length sprites for software rendering. Every row starts at a 4 byte
+ * aligned offset found in the row table and holds a uint16 run count
+ * followed by the runs. A run is a uint16 count of transparent pixels to
+ * skip, a uint16 count of opaque pixels and the opaque pixels, padded to 2
+ * bytes. Pixels are RGB555 or 8 bit palette indices.*/
+
+#define SPRITE_FORMAT_RGB555 0
+#define SPRITE_FORMAT_INDEXED 1
+
+#define SPRITE_SHEET_MAGIC "SH2S"
+#define SPRITE_SHEET_VERSION 1
+
+struct Sh2ckImage;
+struct Sh2ckRect;
+
+struct Sprite {
+	uint16_t width;
+	uint16_t height;
+	uint16_t format;
+	uint16_t reserved;
+	uint32_t data_size;
+	/*height entries, byte offsets into data*/
+	uint32_t *row_offsets;
+	uint8_t *data;
+	/*encoded sprites own row_offsets and data, loaded ones point into the
+	 * sheet*/
+	uint8_t *buffer;
+};
+
+struct SpriteSheet {
+	int sprite_count;
+	uint32_t size;
+	uint8_t *buffer;
+};
+
+/*encodes tgx tokens, with indexed set the tokens hold palette indices*/
+int sh2ckSpriteEncodeTgx(struct Sprite *sprite, int width, int height,
+                         const uint8_t *data, int size, int indexed);
+
+/*pixels with an alpha of 0 become transparent runs*/
+int sh2ckSpriteEncodeImage(struct Sprite *sprite,
+                           const struct Sh2ckImage *image);
+
+void sh2ckSpriteDelete(struct Sprite *sprite);
+
+/*Draws sprite with its top left corner at x, y into the rgba image target,
+ * clipped to clip, which may be NULL to clip to the target only. palette
+ * maps the indices of an indexed sprite to RGB555 colors and is ignored
+ * for RGB555 sprites.*/
+int sh2ckSpriteBlit(struct Sh2ckImage *target, int x, int y,
+                    const struct Sprite *sprite, const uint16_t *palette,
+                    const struct Sh2ckRect *clip);
+
+int sh2ckSpriteSheetSave(const char *file, const struct Sprite *sprites,
+                         int sprite_count);
+
+int sh2ckSpriteSheetLoad(struct SpriteSheet *sheet, const char *file);
+
+/*sprite points into the sheet and stays valid until the sheet is deleted*/
+int sh2ckSpriteSheetGet(struct SpriteSheet *sheet, int index,
+                        struct Sprite *sprite);
+
+void sh2ckSpriteSheetDelete(struct SpriteSheet *sheet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_SPRITE_H
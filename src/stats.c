@@ -0,0 +1,194 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "thread.h"
+
+struct Trace {
+	FILE *fp;
+	int event_count;
+	double start;
+	pthread_mutex_t mutex;
+};
+
+static struct Trace trace = {NULL, 0, 0.0, PTHREAD_MUTEX_INITIALIZER};
+
+static atomic_int thread_counter = 0;
+static _Thread_local int thread_id = 0;
+
+static const char *stage_names[STATS_STAGE_COUNT] = {
+    "load", "decode", "trim", "layout", "compose", "encode", "metadata"};
+
+double sh2ckStatsNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long peakRss(void)
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == -1) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+const char *sh2ckStatsStageName(int stage)
+{
+	if (stage < 0 || stage >= STATS_STAGE_COUNT) {
+		return "unknown";
+	}
+	return stage_names[stage];
+}
+
+void sh2ckStatsInit(struct Stats *stats, const char *name)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->name = name;
+}
+
+void sh2ckStatsBegin(struct StatsSpan *span, int stage)
+{
+	span->stage = stage;
+	span->wall = sh2ckStatsNow();
+	span->cpu = sh2ckThreadCpuTime();
+}
+
+void sh2ckStatsEnd(struct Stats *stats, struct StatsSpan *span, int64_t bytes)
+{
+	double wall = sh2ckStatsNow();
+	if (stats != NULL) {
+		struct StatsStage *stage = &stats->stages[span->stage];
+		stage->count++;
+		stage->wall += wall - span->wall;
+		stage->cpu += sh2ckThreadCpuTime() - span->cpu;
+		stage->bytes += bytes;
+		stats->peak_rss = peakRss();
+	}
+	if (sh2ckTraceEnabled()) {
+		sh2ckTraceEvent(sh2ckStatsStageName(span->stage),
+		                stats != NULL ? stats->name : NULL, span->wall, wall);
+	}
+}
+
+void sh2ckStatsPrint(struct Stats *stats, FILE *fp)
+{
+	fprintf(fp, "%s:\n", stats->name);
+	fprintf(fp, "  %-10s %10s %10s %10s\n", "stage", "wall ms", "cpu ms",
+	        "MB");
+	for (int i = 0; i < STATS_STAGE_COUNT; i++) {
+		struct StatsStage *stage = &stats->stages[i];
+		if (stage->count == 0) {
+			continue;
+		}
+		fprintf(fp, "  %-10s %10.3f %10.3f %10.3f\n", stage_names[i],
+		        stage->wall * 1e3, stage->cpu * 1e3,
+		        stage->bytes / (1024.0 * 1024.0));
+	}
+	fprintf(fp, "  process peak rss %.1f MB\n", stats->peak_rss / 1024.0);
+}
+
+int sh2ckTraceOpen(const char *file)
+{
+	pthread_mutex_lock(&trace.mutex);
+	if (trace.fp != NULL) {
+		pthread_mutex_unlock(&trace.mutex);
+		return -1;
+	}
+	trace.fp = fopen(file, "w");
+	if (trace.fp == NULL) {
+		pthread_mutex_unlock(&trace.mutex);
+		return -1;
+	}
+	trace.event_count = 0;
+	trace.start = sh2ckStatsNow();
+	fprintf(trace.fp, "{\"traceEvents\": [");
+	pthread_mutex_unlock(&trace.mutex);
+	return 0;
+}
+
+int sh2ckTraceClose(void)
+{
+	int ret = 0;
+	pthread_mutex_lock(&trace.mutex);
+	if (trace.fp != NULL) {
+		fprintf(trace.fp, "\n], \"displayTimeUnit\": \"ms\"}\n");
+		ret = fclose(trace.fp);
+		trace.fp = NULL;
+	}
+	pthread_mutex_unlock(&trace.mutex);
+	return ret;
+}
+
+int sh2ckTraceEnabled(void)
+{
+	return trace.fp != NULL;
+}
+
+static int currentThreadId(void)
+{
+	if (thread_id == 0) {
+		thread_id = atomic_fetch_add(&thread_counter, 1) + 1;
+	}
+	return thread_id;
+}
+
+static void printEscaped(FILE *fp, const char *string)
+{
+	for (const char *c = string; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', fp);
+		}
+		fputc(*c, fp);
+	}
+}
+
+void sh2ckTraceEvent(const char *name, const char *arg, double start,
+                     double end)
+{
+	int tid = currentThreadId();
+	pthread_mutex_lock(&trace.mutex);
+	if (trace.fp != NULL) {
+		fprintf(trace.fp,
+		        "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+		        "\"dur\": %.3f, \"pid\": %d, \"tid\": %d",
+		        trace.event_count == 0 ? "" : ",", name,
+		        (start - trace.start) * 1e6, (end - start) * 1e6,
+		        (int)getpid(), tid);
+		if (arg != NULL) {
+			fprintf(trace.fp, ", \"args\": {\"file\": \"");
+			printEscaped(trace.fp, arg);
+			fprintf(trace.fp, "\"}");
+		}
+		fprintf(trace.fp, "}");
+		trace.event_count++;
+	}
+	pthread_mutex_unlock(&trace.mutex);
+}
@@ -0,0 +1,89 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_STATS_H
+#define SH2CK_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_STAGE_LOAD 0
+#define STATS_STAGE_DECODE 1
+#define STATS_STAGE_TRIM 2
+#define STATS_STAGE_LAYOUT 3
+#define STATS_STAGE_COMPOSE 4
+#define STATS_STAGE_ENCODE 5
+#define STATS_STAGE_METADATA 6
+#define STATS_STAGE_COUNT 7
+
+struct StatsStage {
+	int count;
+	double wall;
+	double cpu;
+	int64_t bytes;
+};
+
+struct Stats {
+	const char *name;
+	struct StatsStage stages[STATS_STAGE_COUNT];
+	/*in KiB, of the whole process, so it includes everything that ran
+	 * alongside*/
+	long peak_rss;
+};
+
+/*cpu is the time of the calling thread plus that of the pool threads
+ * that helped with its parallel loops*/
+struct StatsSpan {
+	int stage;
+	double wall;
+	double cpu;
+};
+
+/*monotonic wall clock in seconds*/
+double sh2ckStatsNow(void);
+
+void sh2ckStatsInit(struct Stats *stats, const char *name);
+
+void sh2ckStatsBegin(struct StatsSpan *span, int stage);
+
+/*stats may be NULL if only a trace event should be recorded*/
+void sh2ckStatsEnd(struct Stats *stats, struct StatsSpan *span, int64_t bytes);
+
+void sh2ckStatsPrint(struct Stats *stats, FILE *fp);
+
+const char *sh2ckStatsStageName(int stage);
+
+/*Chrome trace event output, disabled until sh2ckTraceOpen is called*/
+int sh2ckTraceOpen(const char *file);
+
+int sh2ckTraceClose(void);
+
+int sh2ckTraceEnabled(void);
+
+/*thread safe, start and end are sh2ckStatsNow times*/
+void sh2ckTraceEvent(const char *name, const char *arg, double start,
+                     double end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_STATS_H
@@ -15,14 +15,23 @@
  *
  */
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "image.h"
+#include "memory.h"
 #include "tgx.h"
+#include "thread.h"
 
-int tgxCreateFromFile(struct Tgx *tgx, const char *file)
+/*rows per band are at least this many, so short images are not split into
+ * bands that cost more to hand out than to decode*/
+#define TGX_MIN_BAND_HEIGHT 16
+#define TGX_BANDS_PER_THREAD 4
+
+int sh2ckTgxCreateFromFile(struct Tgx *tgx, const char *file)
 {
+	tgx->data = NULL;
 	FILE *fp = fopen(file, "rb");
 
 	if (fp == NULL) {
@@ -45,142 +54,326 @@ int tgxCreateFromFile(struct Tgx *tgx, const char *file)
 	if (fread(&tgx->width, sizeof(tgx->width), 1, fp) < 1 ||
 	    fread(&tgx->height, sizeof(tgx->height), 1, fp) < 1) {
 		fclose(fp);
-		tgxDelete(tgx);
+		sh2ckTgxDelete(tgx);
 		return -1;
 	}
 	tgx->size = file_size - ftell(fp);
 
-	tgx->data = malloc(sizeof(*(tgx->data)) * tgx->size);
+	tgx->data = sh2ckMemoryAlloc(sizeof(*(tgx->data)) * tgx->size);
 	if (tgx->data == NULL) {
 		fclose(fp);
-		tgxDelete(tgx);
+		sh2ckTgxDelete(tgx);
 		return -1;
 	}
 
 	if (fread(tgx->data, sizeof(*(tgx->data)), tgx->size, fp) < tgx->size) {
 		fclose(fp);
-		tgxDelete(tgx);
+		sh2ckTgxDelete(tgx);
 		return -1;
 	}
+	fclose(fp);
 	return 0;
 }
 
-void tgxDelete(struct Tgx *tgx)
+void sh2ckTgxDelete(struct Tgx *tgx)
 {
 	if (tgx != NULL) {
-		free(tgx->data);
+		sh2ckMemoryFree(tgx->data);
+		tgx->data = NULL;
 	}
-	free(tgx);
 }
 
-int tgxDecode(struct Image *image, struct Rect *rect, uint8_t *data, int size,
-              const uint16_t *palette)
+/*GCC and clang jump from every token handler straight to the next one
+ * through a table of label addresses, others go through a switch*/
+#if defined(__GNUC__) && !defined(TGX_NO_COMPUTED_GOTO)
+#define TGX_COMPUTED_GOTO
+#endif
+
+#ifdef TGX_COMPUTED_GOTO
+#define TGX_NEXT_TOKEN()                                \
+	do {                                                \
+		if (i >= size) {                                \
+			return 0;                                   \
+		}                                               \
+		token = data[i++];                              \
+		length = TGX_GET_TOKEN_VALUE(token) + 1;        \
+		goto *dispatch[TGX_GET_TOKEN_TYPE(token) >> 5]; \
+	} while (0)
+#else
+#define TGX_NEXT_TOKEN() goto next_token
+#endif
+
+static inline struct Sh2ckColor tgxColor(uint16_t color)
 {
+	struct Sh2ckColor c = {SH2CK_COLOR_CONVERT_BLUE(color),
+	                       SH2CK_COLOR_CONVERT_GREEN(color),
+	                       SH2CK_COLOR_CONVERT_RED(color), 0xFF};
+	return c;
+}
+
+int sh2ckTgxDecode(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                   uint8_t *data, int size, const uint16_t *palette)
+{
+#ifdef TGX_COMPUTED_GOTO
+	/*indexed by the token type*/
+	static const void *const dispatch[8] = {
+	    &&pixel_stream, &&transparent_pixel_string, &&repeating_pixel,
+	    &&invalid,      &&new_line,                 &&invalid,
+	    &&invalid,      &&invalid};
+#endif
+	const struct Sh2ckColor transparent = {0x00, 0x00, 0x00, 0x00};
+	const int pixel_size = palette == NULL ? 2 : 1;
 	int left = rect->x;
 	int right = rect->x + rect->width;
-	int top = rect->y;
 	int bottom = rect->y + rect->height;
 	int x = left;
-	int y = top;
+	int y = rect->y;
 	int i = 0;
-	int type = 0;
+	int token = 0;
 	int length = 0;
-	uint16_t color = 0;
+	struct Sh2ckColor *row = image->pixel + y * image->width;
 
-	while (i < size) {
-		type = TGX_GET_TOKEN_TYPE(data[i]);
+	TGX_NEXT_TOKEN();
+
+#ifndef TGX_COMPUTED_GOTO
+next_token:
+	if (i >= size) {
+		return 0;
+	}
+	token = data[i++];
+	length = TGX_GET_TOKEN_VALUE(token) + 1;
+	switch (TGX_GET_TOKEN_TYPE(token)) {
+		case TGX_TOKEN_PIXEL_STREAM:
+			goto pixel_stream;
+		case TGX_TOKEN_TRANSPARENT_PIXEL_STRING:
+			goto transparent_pixel_string;
+		case TGX_TOKEN_REPEATING_PIXEL:
+			goto repeating_pixel;
+		case TGX_TOKEN_NEW_LINE:
+			goto new_line;
+		default:
+			goto invalid;
+	}
+#endif
+
+pixel_stream:
+	if (length > right - x || length * pixel_size > size - i) {
+		return -1;
+	}
+	if (palette == NULL) {
+		for (int j = 0; j < length; j++) {
+			row[x + j] = tgxColor(data[i + 2 * j] | (data[i + 2 * j + 1] << 8));
+		}
+	} else {
+		for (int j = 0; j < length; j++) {
+			row[x + j] = tgxColor(palette[data[i + j]]);
+		}
+	}
+	i += length * pixel_size;
+	x += length;
+	TGX_NEXT_TOKEN();
+
+transparent_pixel_string:
+	if (length > right - x) {
+		return -1;
+	}
+	for (int j = 0; j < length; j++) {
+		row[x + j] = transparent;
+	}
+	x += length;
+	/*a transparent run is almost always followed by pixels, take them
+	 * without going through the dispatch*/
+	if (i < size && TGX_GET_TOKEN_TYPE(data[i]) == TGX_TOKEN_PIXEL_STREAM) {
 		length = TGX_GET_TOKEN_VALUE(data[i]) + 1;
 		i++;
-		switch (type) {
-			case TGX_TOKEN_NEW_LINE:
-				for (int j = x; j < right; j++) {
-					image->pixel[y * image->width + j].a = 0x00;
-					image->pixel[y * image->width + j].r = 0x00;
-					image->pixel[y * image->width + j].g = 0x00;
-					image->pixel[y * image->width + j].b = 0x00;
-				}
-				if (y < bottom - 1) {
-					y++;
-					x = left;
-				} else {
-					return 0;
-				}
-				break;
+		goto pixel_stream;
+	}
+	TGX_NEXT_TOKEN();
+
+repeating_pixel:
+	if (length > right - x || pixel_size > size - i) {
+		return -1;
+	} else {
+		uint16_t color = palette == NULL ? data[i] | (data[i + 1] << 8)
+		                                 : palette[data[i]];
+		struct Sh2ckColor c = tgxColor(color);
+		for (int j = 0; j < length; j++) {
+			row[x + j] = c;
+		}
+	}
+	i += pixel_size;
+	x += length;
+	TGX_NEXT_TOKEN();
+
+new_line:
+	for (int j = x; j < right; j++) {
+		row[j] = transparent;
+	}
+	if (y >= bottom - 1) {
+		return 0;
+	}
+	y++;
+	x = left;
+	row += image->width;
+	TGX_NEXT_TOKEN();
+
+invalid:
+	return -1;
+}
+
+int sh2ckTgxCreateImage(struct Sh2ckImage *image, int width, int height,
+                        uint8_t *data, int size, const uint16_t *palette)
+{
+	struct Sh2ckRect rect = {0, 0, width, height};
+	if (sh2ckImageCreate(image, NULL, width, height)) {
+		return -1;
+	}
+	return sh2ckTgxDecode(image, &rect, data, size, palette);
+}
+
+/*bytes to skip over every token byte and its pixels, 0 for a newline and -1
+ * for an invalid token*/
+static void rowIndexSkips(int *skips, int pixel_size)
+{
+	for (int token = 0; token < 256; token++) {
+		int length = TGX_GET_TOKEN_VALUE(token) + 1;
+		switch (TGX_GET_TOKEN_TYPE(token)) {
 			case TGX_TOKEN_PIXEL_STREAM:
-				for (int j = 0; j < length; j++) {
-					if (palette == NULL) {
-						color = data[i];
-						i++;
-						color |= (data[i] << 8);
-					} else {
-						color = palette[data[i]];
-					}
-					i++;
-					image->pixel[y * image->width + x].a = 0xFF;
-					image->pixel[y * image->width + x].r =
-					    COLOR_CONVERT_RED(color);
-					image->pixel[y * image->width + x].g =
-					    COLOR_CONVERT_GREEN(color);
-					image->pixel[y * image->width + x].b =
-					    COLOR_CONVERT_BLUE(color);
-					if (x < right) {
-						x++;
-					} else {
-						return -1;
-					}
-				}
+				skips[token] = 1 + length * pixel_size;
+				break;
+			case TGX_TOKEN_TRANSPARENT_PIXEL_STRING:
+				skips[token] = 1;
 				break;
 			case TGX_TOKEN_REPEATING_PIXEL:
-				if (palette == NULL) {
-					color = data[i];
-					i++;
-					color |= (data[i] << 8);
-				} else {
-					color = palette[data[i]];
-				}
-				i++;
-				for (int j = 0; j < length; j++) {
-					image->pixel[y * image->width + x].a = 0xFF;
-					image->pixel[y * image->width + x].r =
-					    COLOR_CONVERT_RED(color);
-					image->pixel[y * image->width + x].g =
-					    COLOR_CONVERT_GREEN(color);
-					image->pixel[y * image->width + x].b =
-					    COLOR_CONVERT_BLUE(color);
-					if (x < right) {
-						x++;
-					} else {
-						return -1;
-					}
-				}
+				skips[token] = 1 + pixel_size;
 				break;
-			case TGX_TOKEN_TRANSPARENT_PIXEL_STRING:
-				for (int j = 0; j < length; j++) {
-					image->pixel[y * image->width + x].a = 0x00;
-					image->pixel[y * image->width + x].r = 0x00;
-					image->pixel[y * image->width + x].g = 0x00;
-					image->pixel[y * image->width + x].b = 0x00;
-					if (x < right) {
-						x++;
-					} else {
-						return -1;
-					}
-				}
+			case TGX_TOKEN_NEW_LINE:
+				skips[token] = 0;
 				break;
 			default:
-				return -1;
+				skips[token] = -1;
 				break;
 		}
 	}
+}
+
+int sh2ckTgxCreateRowIndex(struct TgxRowIndex *index, const uint8_t *data,
+                           int size, int height, int indexed)
+{
+	int skips[256];
+	index->row_count = 0;
+	index->offsets = sh2ckMemoryAlloc(sizeof(int) * (height + 1));
+	if (index->offsets == NULL) {
+		return -1;
+	}
+	if (height <= 0) {
+		return 0;
+	}
+	rowIndexSkips(skips, indexed ? 1 : 2);
+	index->offsets[index->row_count++] = 0;
+	int i = 0;
+	while (i < size) {
+		int skip = skips[data[i]];
+		if (skip > 0) {
+			i += skip;
+		} else if (skip == 0) {
+			i++;
+			if (index->row_count == height) {
+				return 0;
+			}
+			index->offsets[index->row_count++] = i;
+		} else {
+			sh2ckTgxDeleteRowIndex(index);
+			return -1;
+		}
+	}
+	/*a last newline does not start another row*/
+	if (index->row_count > 1 && index->offsets[index->row_count - 1] >= size) {
+		index->row_count--;
+	}
 	return 0;
 }
 
-int tgxCreateImage(struct Image *image, int width, int height, uint8_t *data,
-                   int size, const uint16_t *palette)
+void sh2ckTgxDeleteRowIndex(struct TgxRowIndex *index)
 {
-	struct Rect rect = {0, 0, width, height};
-	if (imageCreate(image, NULL, width, height)) {
+	if (index != NULL) {
+		sh2ckMemoryFree(index->offsets);
+		index->offsets = NULL;
+		index->row_count = 0;
+	}
+}
+
+int sh2ckTgxDecodeRows(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                       uint8_t *data, int size, const uint16_t *palette,
+                       const struct TgxRowIndex *index, int first_row,
+                       int row_count)
+{
+	if (first_row < 0 || row_count < 0 || first_row > rect->height ||
+	    row_count > rect->height - first_row) {
 		return -1;
 	}
-	return tgxDecode(image, &rect, data, size, palette);
+	if (first_row + row_count > index->row_count) {
+		row_count = index->row_count - first_row;
+	}
+	if (row_count <= 0) {
+		return 0;
+	}
+	int begin = index->offsets[first_row];
+	int end = first_row + row_count < index->row_count
+	              ? index->offsets[first_row + row_count]
+	              : size;
+	struct Sh2ckRect rows = {rect->x, rect->y + first_row, rect->width,
+	                         row_count};
+	return sh2ckTgxDecode(image, &rows, data + begin, end - begin, palette);
+}
+
+struct TgxBands {
+	struct Sh2ckImage *image;
+	struct Sh2ckRect *rect;
+	uint8_t *data;
+	int size;
+	const uint16_t *palette;
+	struct TgxRowIndex index;
+	int band_height;
+	atomic_int failed;
+};
+
+static void decodeBand(void *context, int band)
+{
+	struct TgxBands *bands = context;
+	int first_row = band * bands->band_height;
+	int row_count = bands->rect->height - first_row;
+	if (row_count > bands->band_height) {
+		row_count = bands->band_height;
+	}
+	if (sh2ckTgxDecodeRows(bands->image, bands->rect, bands->data, bands->size,
+	                       bands->palette, &bands->index, first_row,
+	                       row_count) == -1) {
+		atomic_store(&bands->failed, 1);
+	}
+}
+
+int sh2ckTgxDecodeParallel(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                           uint8_t *data, int size, const uint16_t *palette,
+                           struct Sh2ckThreadPool *pool)
+{
+	if (sh2ckThreadPoolThreadCount(pool) < 2 ||
+	    rect->height < 2 * TGX_MIN_BAND_HEIGHT) {
+		return sh2ckTgxDecode(image, rect, data, size, palette);
+	}
+	struct TgxBands bands = {image, rect, data, size, palette, {0, NULL}, 0, 0};
+	/*an invalid stream fails the same way it does when decoded in one go*/
+	if (sh2ckTgxCreateRowIndex(&bands.index, data, size, rect->height,
+	                           palette != NULL) == -1) {
+		return sh2ckTgxDecode(image, rect, data, size, palette);
+	}
+	int band_count = sh2ckThreadPoolThreadCount(pool) * TGX_BANDS_PER_THREAD;
+	bands.band_height = (rect->height + band_count - 1) / band_count;
+	if (bands.band_height < TGX_MIN_BAND_HEIGHT) {
+		bands.band_height = TGX_MIN_BAND_HEIGHT;
+	}
+	band_count = (rect->height + bands.band_height - 1) / bands.band_height;
+	sh2ckThreadPoolParallelFor(pool, band_count, decodeBand, &bands);
+	sh2ckTgxDeleteRowIndex(&bands.index);
+	return atomic_load(&bands.failed) ? -1 : 0;
 }
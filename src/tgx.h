@@ -15,11 +15,15 @@
  *
  */
 
-#ifndef TGX_H
-#define TGX_H
+#ifndef SH2CK_TGX_H
+#define SH2CK_TGX_H
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define TGX_TOKEN_PIXEL_STREAM 0x00
 #define TGX_TOKEN_TRANSPARENT_PIXEL_STRING 0x20
 #define TGX_TOKEN_REPEATING_PIXEL 0x40
@@ -31,9 +35,10 @@
 #define TGX_GET_TOKEN_TYPE(t) ((int)(t)&TGX_TOKEN_MASK_TYPE)
 #define TGX_GET_TOKEN_VALUE(t) ((int)((t)&TGX_TOKEN_MASK_VALUE))
 
-struct Image;
-struct Color;
-struct Rect;
+struct Sh2ckImage;
+struct Sh2ckColor;
+struct Sh2ckRect;
+struct Sh2ckThreadPool;
 
 struct Tgx {
 	uint32_t width;
@@ -42,13 +47,44 @@ struct Tgx {
 	uint8_t *data;
 };
 
-int tgxCreateFromFile(struct Tgx *tgx, const char *file);
+int sh2ckTgxCreateFromFile(struct Tgx *tgx, const char *file);
+
+int sh2ckTgxDecode(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                   uint8_t *data, int size, const uint16_t *palette);
+
+int sh2ckTgxCreateImage(struct Sh2ckImage *image, int width, int height,
+                        uint8_t *data, int size, const uint16_t *palette);
+
+/*byte offset of the first token of every row*/
+struct TgxRowIndex {
+	int row_count;
+	int *offsets;
+};
+
+/*Finds where every row starts by skipping over the tokens without decoding
+ * any pixels, indexed streams have 1 byte pixels. Rows past the end of the
+ * data are missing from the index.*/
+int sh2ckTgxCreateRowIndex(struct TgxRowIndex *index, const uint8_t *data,
+                           int size, int height, int indexed);
+
+void sh2ckTgxDeleteRowIndex(struct TgxRowIndex *index);
+
+/*Decodes only rows first_row to first_row + row_count - 1 into the same
+ * rows of rect as sh2ckTgxDecode, e.g. the visible part of a large image*/
+int sh2ckTgxDecodeRows(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                       uint8_t *data, int size, const uint16_t *palette,
+                       const struct TgxRowIndex *index, int first_row,
+                       int row_count);
+
+/*Like sh2ckTgxDecode, but decodes bands of rows on the threads of pool*/
+int sh2ckTgxDecodeParallel(struct Sh2ckImage *image, struct Sh2ckRect *rect,
+                           uint8_t *data, int size, const uint16_t *palette,
+                           struct Sh2ckThreadPool *pool);
 
-int tgxDecode(struct Image *image, struct Rect *rect, uint8_t *data, int size,
-              const uint16_t *palette);
+void sh2ckTgxDelete(struct Tgx *tgx);
 
-int tgxCreateImage(struct Image *image, int width, int height, uint8_t *data,
-                   int size, const uint16_t *palette);
+#ifdef __cplusplus
+}
+#endif
 
-void tgxDelete(struct Tgx *tgx);
-#endif  // TGX_H
+#endif  // SH2CK_TGX_H
@@ -0,0 +1,217 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "thread.h"
+
+struct ThreadTask {
+	Sh2ckThreadFunction function;
+	void *context;
+	int count;
+	atomic_int next;
+	atomic_int done;
+	/*cpu nanoseconds of the workers that helped*/
+	atomic_llong helper_cpu;
+	/*workers currently taking items from the task*/
+	int active;
+	struct ThreadTask *next_task;
+};
+
+struct Sh2ckThreadPool {
+	int thread_count;
+	int shutdown;
+	pthread_t *threads;
+	struct ThreadTask *tasks;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+};
+
+/*cpu nanoseconds of loops started by this thread that ran on others*/
+static _Thread_local long long helper_cpu;
+
+static long long cpuNanoseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec + helper_cpu;
+}
+
+static void runTask(struct ThreadTask *task)
+{
+	int i = 0;
+	while ((i = atomic_fetch_add(&task->next, 1)) < task->count) {
+		task->function(task->context, i);
+		atomic_fetch_add(&task->done, 1);
+	}
+}
+
+/*called with the pool mutex held*/
+static struct ThreadTask *findTask(struct Sh2ckThreadPool *pool)
+{
+	for (struct ThreadTask *task = pool->tasks; task != NULL;
+	     task = task->next_task) {
+		if (atomic_load(&task->next) < task->count) {
+			return task;
+		}
+	}
+	return NULL;
+}
+
+static void *worker(void *arg)
+{
+	struct Sh2ckThreadPool *pool = arg;
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->shutdown) {
+		struct ThreadTask *task = findTask(pool);
+		if (task == NULL) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+			continue;
+		}
+		task->active++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		long long start = cpuNanoseconds();
+		runTask(task);
+		atomic_fetch_add(&task->helper_cpu, cpuNanoseconds() - start);
+
+		pthread_mutex_lock(&pool->mutex);
+		task->active--;
+		pthread_cond_broadcast(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+struct Sh2ckThreadPool *sh2ckThreadPoolCreate(int thread_count)
+{
+	if (thread_count < 1) {
+		thread_count = 1;
+	}
+	struct Sh2ckThreadPool *pool = sh2ckMemoryAlloc(sizeof(*pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+	/*the calling thread*/
+	pool->thread_count = 1;
+	pool->shutdown = 0;
+	pool->tasks = NULL;
+	pool->threads = NULL;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	if (thread_count > 1) {
+		pool->threads =
+		    sh2ckMemoryAlloc(sizeof(*pool->threads) * (thread_count - 1));
+		if (pool->threads == NULL) {
+			sh2ckThreadPoolDelete(pool);
+			return NULL;
+		}
+	}
+	for (int i = 0; i < thread_count - 1; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0) {
+			sh2ckThreadPoolDelete(pool);
+			return NULL;
+		}
+		pool->thread_count++;
+	}
+	return pool;
+}
+
+void sh2ckThreadPoolDelete(struct Sh2ckThreadPool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (int i = 0; i < pool->thread_count - 1; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	sh2ckMemoryFree(pool->threads);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	sh2ckMemoryFree(pool);
+}
+
+int sh2ckThreadPoolThreadCount(const struct Sh2ckThreadPool *pool)
+{
+	return pool != NULL ? pool->thread_count : 1;
+}
+
+void sh2ckThreadPoolParallelFor(struct Sh2ckThreadPool *pool, int count,
+                                Sh2ckThreadFunction function, void *context)
+{
+	struct ThreadTask task;
+	task.function = function;
+	task.context = context;
+	task.count = count;
+	atomic_init(&task.next, 0);
+	atomic_init(&task.done, 0);
+	atomic_init(&task.helper_cpu, 0);
+	task.active = 0;
+
+	if (pool == NULL || pool->thread_count <= 1 || count <= 1) {
+		runTask(&task);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	task.next_task = pool->tasks;
+	pool->tasks = &task;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	runTask(&task);
+
+	/*no worker may join once the task is unlinked, wait for the ones that
+	 * still work on it*/
+	pthread_mutex_lock(&pool->mutex);
+	struct ThreadTask **link = &pool->tasks;
+	while (*link != &task) {
+		link = &(*link)->next_task;
+	}
+	*link = task.next_task;
+	while (atomic_load(&task.done) < count || task.active > 0) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	helper_cpu += atomic_load(&task.helper_cpu);
+}
+
+int sh2ckThreadCpuCount(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count < 1) {
+		return 1;
+	}
+	return (int)count;
+}
+
+double sh2ckThreadCpuTime(void)
+{
+	return cpuNanoseconds() * 1e-9;
+}
@@ -0,0 +1,54 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SH2CK_THREAD_H
+#define SH2CK_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Sh2ckThreadPool;
+
+typedef void (*Sh2ckThreadFunction)(void *context, int index);
+
+/*thread_count includes the calling thread, so a pool of 1 starts no
+ * threads and runs everything serially. NULL on failure.*/
+struct Sh2ckThreadPool *sh2ckThreadPoolCreate(int thread_count);
+
+void sh2ckThreadPoolDelete(struct Sh2ckThreadPool *pool);
+
+/*threads of pool including the calling one, 1 if pool is NULL*/
+int sh2ckThreadPoolThreadCount(const struct Sh2ckThreadPool *pool);
+
+/*Calls function(context, i) for every i in [0, count) and returns when all
+ * calls are done. The calling thread takes part, so this may be nested
+ * inside of a running task without deadlocking. pool may be NULL.*/
+void sh2ckThreadPoolParallelFor(struct Sh2ckThreadPool *pool, int count,
+                                Sh2ckThreadFunction function, void *context);
+
+int sh2ckThreadCpuCount(void);
+
+/*cpu seconds of the calling thread, plus those the pool threads spent on
+ * the parallel loops it started*/
+double sh2ckThreadCpuTime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SH2CK_THREAD_H
@@ -0,0 +1,1008 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "atlas.h"
+#include "gm1.h"
+#include "io.h"
+#include "layers.h"
+#include "synth.h"
+#include "test.h"
+#include "tgx.h"
+
+/*runs sh2ck with the arguments and checks whether it reported name as up
+ * to date, -1 if it failed*/
+static int upToDate(const char *name, const char *input, const char *option)
+{
+	char expected[256];
+	int ret;
+	if (option != NULL) {
+		ret = testRun(test_sh2ck, "run.txt", option, input, "out", name,
+		              NULL);
+	} else {
+		ret = testRun(test_sh2ck, "run.txt", input, "out", name, NULL);
+	}
+	char *output = testReadFile("run.txt", NULL);
+	if (ret != 0 || output == NULL) {
+		free(output);
+		return -1;
+	}
+	snprintf(expected, sizeof(expected), "Up to date: %s", name);
+	ret = strstr(output, expected) != NULL;
+	free(output);
+	return ret;
+}
+
+int testCache(void)
+{
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 4, 1) == 0);
+	CHECK(upToDate("a", "in.gm1", NULL) == 0);
+	CHECK(testFileExists("out/sh2ck.manifest"));
+	CHECK(testFileExists("out/3.png"));
+	CHECK(upToDate("a", "in.gm1", NULL) == 1);
+
+	/*a missing output, other options or another input convert again*/
+	CHECK(remove("out/2.png") == 0);
+	CHECK(upToDate("a", "in.gm1", NULL) == 0);
+	CHECK(testFileExists("out/2.png"));
+	CHECK(upToDate("a", "in.gm1", "-P") == 0);
+	CHECK(upToDate("a", "in.gm1", "-P") == 1);
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 4, 2) == 0);
+	CHECK(upToDate("a", "in.gm1", "-P") == 0);
+	return 0;
+}
+
+/*occurrences of string in text*/
+static int countString(const char *text, const char *string)
+{
+	int count = 0;
+	for (const char *found = strstr(text, string); found != NULL;
+	     found = strstr(found + 1, string)) {
+		count++;
+	}
+	return count;
+}
+
+int testInfo(void)
+{
+	CHECK(synthWriteGm1("a\tb.gm1", GM1_DATA_TGX, 5, 1) == 0);
+
+	CHECK(testRun(test_sh2ck, "info.json", "--info", "a\tb.gm1", NULL) == 0);
+	char *output = testReadFile("info.json", NULL);
+	CHECK(output != NULL);
+	int ok = output[0] == '[' && strstr(output, "\"file\": \"a\\tb.gm1\"") &&
+	         strstr(output, "\"data_type\": \"TGX\"") &&
+	         strstr(output, "\"image_count\": 5,") &&
+	         countString(output, "{\"width\": ") == 5;
+	free(output);
+	CHECK(ok);
+
+	/*a header row and a row per image*/
+	CHECK(testRun(test_sh2ck, "info.csv", "--info", "--csv", "a\tb.gm1",
+	              NULL) == 0);
+	output = testReadFile("info.csv", NULL);
+	CHECK(output != NULL);
+	ok = strncmp(output, "file,data_type,", 15) == 0 &&
+	     countString(output, "\n") == 6 &&
+	     countString(output, "\n\"a\tb.gm1\",TGX,") == 5;
+	free(output);
+	CHECK(ok);
+	return 0;
+}
+
+int testBench(void)
+{
+	static const char *cases[] = {
+	    "gm1_tgx",    "gm1_animation",      "gm1_tgx_and_tile", "gm1_tgx_font",
+	    "gm1_bitmap", "gm1_tgx_const_size", "gm1_bitmap_other", "tgx"};
+	char name[64];
+	struct Sh2ckImage image;
+	struct Sh2ckImage saved;
+	struct Tgx tgx;
+
+	CHECK(testRun(test_sh2ck, "report.txt", "-n", "1", "--json",
+	              "bench.json", "--dir", "corpus", NULL) == 0);
+	char *output = testReadFile("bench.json", NULL);
+	CHECK(output != NULL);
+	int ok = strstr(output, "\"iterations\": 1,") != NULL &&
+	         countString(output, "{\"name\": ") == 8 &&
+	         countString(output, "\"decode\": {\"min_ms\": ") == 8;
+	for (int i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "{\"name\": \"%s\", ", cases[i]);
+		ok = ok && strstr(output, name) != NULL;
+	}
+	free(output);
+	CHECK(ok);
+
+	/*every case leaves its converted png in the corpus*/
+	for (int i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "corpus/%s.png", cases[i]);
+		CHECK(testLoadPng(name, &saved) == 0);
+		free(saved.pixel);
+		CHECK(saved.width > 0 && saved.height > 0);
+	}
+
+	CHECK(sh2ckTgxCreateFromFile(&tgx, "corpus/tgx.tgx") == 0);
+	CHECK(sh2ckTgxCreateImage(&image, tgx.width, tgx.height, tgx.data,
+	                          tgx.size, NULL) == 0);
+	CHECK(testLoadPng("corpus/tgx.png", &saved) == 0);
+	ok = testImagesEqual(&image, &saved);
+	free(saved.pixel);
+	sh2ckImageDelete(&image, NULL);
+	sh2ckTgxDelete(&tgx);
+	CHECK(ok);
+	return 0;
+}
+
+int testStats(void)
+{
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 4, 1) == 0);
+	CHECK(testRun(test_sh2ck, "stats.txt", "--stats", "--trace",
+	              "trace.json", "in.gm1", "out", "a", NULL) == 0);
+	CHECK(testFileExists("out/3.png"));
+
+	char *output = testReadFile("stats.txt", NULL);
+	CHECK(output != NULL);
+	int ok = strstr(output, "a:\n  stage ") != NULL &&
+	         strstr(output, "\n  load ") != NULL &&
+	         strstr(output, "\n  decode ") != NULL &&
+	         strstr(output, "\n  encode ") != NULL &&
+	         strstr(output, "\n  process peak rss ") != NULL;
+	free(output);
+	CHECK(ok);
+
+	/*a complete chrome trace with an event per stage*/
+	long size;
+	output = testReadFile("trace.json", &size);
+	CHECK(output != NULL);
+	const char *end = "\n], \"displayTimeUnit\": \"ms\"}\n";
+	ok = strncmp(output, "{\"traceEvents\": [\n{", 19) == 0 &&
+	     size > (long)strlen(end) &&
+	     strcmp(output + size - strlen(end), end) == 0 &&
+	     strstr(output, "{\"name\": \"load\", \"ph\": \"X\", ") != NULL &&
+	     strstr(output, "{\"name\": \"encode\", \"ph\": \"X\", ") != NULL &&
+	     countString(output, "\"args\": {\"file\": \"a\"}}") ==
+	         countString(output, "\"ph\": \"X\"");
+	free(output);
+	CHECK(ok);
+	return 0;
+}
+
+int testStream(void)
+{
+	static const int data_types[] = {GM1_DATA_TGX, GM1_DATA_ANIMATION,
+	                                 GM1_DATA_BITMAP, GM1_DATA_TGX_FONT};
+	char dir[16];
+	char file[64];
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckImage saved;
+
+	for (int i = 0; i < 4; i++) {
+		snprintf(dir, sizeof(dir), "out%d", i);
+		CHECK(synthWriteGm1("in.gm1", data_types[i], 6, i + 1) == 0);
+		CHECK(testRun(test_sh2ck, "run.txt", "in.gm1", dir, "a", NULL) == 0);
+
+		/*every image is written as it is decoded from the whole file*/
+		CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+		CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+		int ok = 1;
+		for (int j = 0; ok && j < images.image_count; j++) {
+			snprintf(file, sizeof(file), "%s/%d.png", dir, j);
+			ok = testLoadPng(file, &saved) == 0;
+			if (ok) {
+				ok = testImagesEqual(&saved, &images.images[j]);
+				free(saved.pixel);
+			}
+		}
+		snprintf(file, sizeof(file), "%s/%d.png", dir, images.image_count);
+		ok = ok && !testFileExists(file);
+		sh2ckImageDeleteList(&images);
+		sh2ckGm1Delete(&gm1);
+		CHECK(ok);
+	}
+	return 0;
+}
+
+#define BATCH_FILE_COUNT 7
+
+static const char *batch_inputs[BATCH_FILE_COUNT] = {
+    "in0.gm1", "in1.gm1", "in2.gm1", "in3.gm1", "in4.gm1", "in5.gm1",
+    "in6.gm1"};
+
+/*a gm1 file of every type for the batch tests, with image_count images*/
+static int writeBatchInputs(int image_count)
+{
+	static const int data_types[BATCH_FILE_COUNT] = {
+	    GM1_DATA_TGX,      GM1_DATA_ANIMATION, GM1_DATA_TGX_AND_TILE,
+	    GM1_DATA_TGX_FONT, GM1_DATA_BITMAP,    GM1_DATA_TGX_CONST_SIZE,
+	    GM1_DATA_BITMAP_OTHER};
+	for (int i = 0; i < BATCH_FILE_COUNT; i++) {
+		if (synthWriteGm1(batch_inputs[i], data_types[i], image_count,
+		                  i + 1) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*creates dir and a list that converts every batch input into it, with the
+ * names n0, n1, ...*/
+static int writeBatchList(const char *list_file, const char *dir)
+{
+	if (mkdir(dir, 0775) == -1) {
+		return -1;
+	}
+	FILE *fp = fopen(list_file, "w");
+	if (fp == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < BATCH_FILE_COUNT; i++) {
+		fprintf(fp, "%s\t%s\tn%d\n", batch_inputs[i], dir, i);
+	}
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+/*1 if the manifest in dir lists every batch file once*/
+static int batchManifestComplete(const char *dir)
+{
+	char file[64];
+	char name[16];
+	snprintf(file, sizeof(file), "%s/sh2ck.manifest", dir);
+	char *manifest = testReadFile(file, NULL);
+	if (manifest == NULL) {
+		return 0;
+	}
+	int complete = countString(manifest, "\n") == BATCH_FILE_COUNT;
+	for (int i = 0; i < BATCH_FILE_COUNT; i++) {
+		snprintf(name, sizeof(name), " n%d\n", i);
+		complete = complete && countString(manifest, name) == 1;
+	}
+	free(manifest);
+	return complete;
+}
+
+int testBatch(void)
+{
+	CHECK(writeBatchInputs(10) == 0);
+	CHECK(writeBatchList("serial.txt", "serial") == 0);
+	CHECK(writeBatchList("budget.txt", "budget") == 0);
+	CHECK(writeBatchList("jobs.txt", "jobs") == 0);
+
+	/*a budget smaller than every file runs them one at a time, with the
+	 * same outputs*/
+	CHECK(testRun(test_sh2ck, "run.txt", "-P", "-j", "1", "--batch",
+	              "serial.txt", NULL) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-P", "-j", "4", "--max-memory",
+	              "1", "--batch", "budget.txt", NULL) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-P", "-j", "4", "--batch",
+	              "jobs.txt", NULL) == 0);
+	CHECK(testFileExists("serial/n0.png"));
+	CHECK(testFileExists("serial/n6.png"));
+	CHECK(batchManifestComplete("serial"));
+	CHECK(batchManifestComplete("budget"));
+	CHECK(batchManifestComplete("jobs"));
+	CHECK(testDirsEqual("serial", "budget"));
+	CHECK(testDirsEqual("serial", "jobs"));
+	return 0;
+}
+
+#define SHARED_PAGES_MAX 16
+
+/*the page count if out/pack.index lists the inputs under names, in this
+ * order, and every image of them is on its page at its rect, 0 otherwise*/
+static int sharedMatches(const char *const *inputs, const char *const *names,
+                         int count)
+{
+	char file[64];
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct AtlasIndex index;
+	struct Sh2ckImage pages[SHARED_PAGES_MAX];
+
+	if (sh2ckAtlasReadIndex(&index, "out/pack.index") == -1) {
+		return 0;
+	}
+	int ok = index.file_count == count && index.page_count <= SHARED_PAGES_MAX;
+	int page_count = 0;
+	for (; ok && page_count < index.page_count; page_count++) {
+		snprintf(file, sizeof(file), "out/pack_%d.png", page_count);
+		ok = testLoadPng(file, &pages[page_count]) == 0;
+	}
+	/*pages that are no longer used are removed*/
+	snprintf(file, sizeof(file), "out/pack_%d.png", index.page_count);
+	ok = ok && !testFileExists(file);
+
+	for (int i = 0; ok && i < count; i++) {
+		struct AtlasFile *atlas_file = &index.files[i];
+		if (sh2ckGm1CreateFromFile(&gm1, inputs[i]) == -1) {
+			ok = 0;
+			break;
+		}
+		if (sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == -1) {
+			sh2ckGm1Delete(&gm1);
+			ok = 0;
+			break;
+		}
+		ok = strcmp(atlas_file->name, names[i]) == 0 &&
+		     atlas_file->image_count == images.image_count;
+		for (int j = 0; ok && j < images.image_count; j++) {
+			struct AtlasSlot *slot =
+			    &index.images[atlas_file->first_image + j];
+			ok = slot->page >= 0 && slot->page < index.page_count;
+			if (!ok) {
+				break;
+			}
+			struct Sh2ckImage view = pages[slot->page];
+			ok = slot->x + slot->width <= view.width &&
+			     slot->y + slot->height <= view.height;
+			view.pixel += slot->y * view.pitch + slot->x;
+			view.width = slot->width;
+			view.height = slot->height;
+			ok = ok && testImagesEqual(&view, &images.images[j]);
+		}
+		sh2ckImageDeleteList(&images);
+		sh2ckGm1Delete(&gm1);
+		snprintf(file, sizeof(file), "out/%s.data", names[i]);
+		ok = ok && testFileExists(file);
+	}
+	if (ok) {
+		ok = index.page_count;
+	}
+	for (int i = 0; i < page_count; i++) {
+		free(pages[i].pixel);
+	}
+	sh2ckAtlasDeleteIndex(&index);
+	return ok;
+}
+
+int testShared(void)
+{
+	static const int data_types[] = {GM1_DATA_TGX, GM1_DATA_BITMAP,
+	                                 GM1_DATA_BITMAP_OTHER};
+	static const char *inputs[] = {"in0.gm1", "in1.gm1", "in2.gm1"};
+	static const char *names[] = {"a,b", "q\"x", "c d"};
+	static const char *list =
+	    "in0.gm1\ta,b\n# comment\nin1.gm1\tq\"x\n\nin2.gm1\tc d\n";
+
+	for (int i = 0; i < 3; i++) {
+		CHECK(synthWriteGm1(inputs[i], data_types[i], 8, i + 1) == 0);
+	}
+	FILE *fp = fopen("list.txt", "w");
+	CHECK(fp != NULL);
+	fputs(list, fp);
+	CHECK(fclose(fp) == 0);
+	CHECK(mkdir("out", 0775) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "--shared", "list.txt",
+	              "--page-size", "512", "out", "pack", NULL) == 0);
+
+	/*the names with separators and quotes are read back from the index*/
+	CHECK(sharedMatches(inputs, names, 3) > 1);
+
+	/*an option without its value is an error, not a crash*/
+	CHECK(testRun(test_sh2ck, "run.txt", "out", "pack", "--shared", NULL) ==
+	      1);
+	CHECK(testRun(test_sh2ck, "run.txt", "in0.gm1", "out", "p", "-p", NULL) ==
+	      1);
+	CHECK(testRun(test_sh2ck, "run.txt", "--max-memory", NULL) == 1);
+	return 0;
+}
+
+/*replaces every page by a marker, so pages that are written again can be
+ * told apart. The pages are kept in saved.*/
+static int markPages(char **saved, long *sizes, int page_count)
+{
+	char file[64];
+	for (int i = 0; i < page_count; i++) {
+		snprintf(file, sizeof(file), "out/pack_%d.png", i);
+		saved[i] = testReadFile(file, &sizes[i]);
+		FILE *fp = fopen(file, "wb");
+		if (saved[i] == NULL || fp == NULL) {
+			return -1;
+		}
+		fputs("marker", fp);
+		if (fclose(fp) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*restores the pages that were not written again and returns a bit for
+ * every page that was, -1 on errors*/
+static int restorePages(char **saved, long *sizes, int page_count)
+{
+	char file[64];
+	int written = 0;
+	for (int i = 0; i < page_count; i++) {
+		snprintf(file, sizeof(file), "out/pack_%d.png", i);
+		char *data = testReadFile(file, NULL);
+		if (data != NULL && strcmp(data, "marker") == 0) {
+			FILE *fp = fopen(file, "wb");
+			if (fp == NULL) {
+				free(data);
+				return -1;
+			}
+			fwrite(saved[i], 1, sizes[i], fp);
+			if (fclose(fp) != 0) {
+				free(data);
+				return -1;
+			}
+		} else if (data != NULL) {
+			written |= 1 << i;
+		}
+		free(data);
+		free(saved[i]);
+		saved[i] = NULL;
+	}
+	return written;
+}
+
+/*a bit for every page that holds an image of file in out/pack.index*/
+static int filePages(int file)
+{
+	struct AtlasIndex index;
+	if (sh2ckAtlasReadIndex(&index, "out/pack.index") == -1) {
+		return -1;
+	}
+	int pages = 0;
+	struct AtlasFile *atlas_file = &index.files[file];
+	for (int i = 0; i < atlas_file->image_count; i++) {
+		pages |= 1 << index.images[atlas_file->first_image + i].page;
+	}
+	sh2ckAtlasDeleteIndex(&index);
+	return pages;
+}
+
+#define UPDATE_FILE_COUNT 7
+
+static const char *update_inputs[UPDATE_FILE_COUNT] = {
+    "in0.gm1", "in1.gm1", "in2.gm1", "in3.gm1",
+    "in4.gm1", "in5.gm1", "in6.gm1"};
+static const char *update_names[UPDATE_FILE_COUNT] = {"n0", "n1", "n2", "n3",
+                                                      "n4", "n5", "n6"};
+
+/*packs the first file_count update inputs into out/pack*/
+static int runShared(int file_count, const char *option)
+{
+	FILE *fp = fopen("list.txt", "w");
+	if (fp == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < file_count; i++) {
+		fprintf(fp, "%s %s\n", update_inputs[i], update_names[i]);
+	}
+	if (fclose(fp) != 0) {
+		return -1;
+	}
+	if (option == NULL) {
+		return testRun(test_sh2ck, "run.txt", "--shared", "list.txt",
+		               "--page-size", "512", "out", "pack", NULL);
+	}
+	return testRun(test_sh2ck, "run.txt", option, "--shared", "list.txt",
+	               "--page-size", "512", "out", "pack", NULL);
+}
+
+int testSharedUpdate(void)
+{
+	const char *const *inputs = update_inputs;
+	const char *const *names = update_names;
+	char *saved[SHARED_PAGES_MAX];
+	long sizes[SHARED_PAGES_MAX];
+
+	for (int i = 0; i < UPDATE_FILE_COUNT - 1; i++) {
+		CHECK(synthWriteGm1(inputs[i], GM1_DATA_TGX, 8, i + 1) == 0);
+	}
+	CHECK(mkdir("out", 0775) == 0);
+	CHECK(runShared(UPDATE_FILE_COUNT - 1, NULL) == 0);
+	int page_count = sharedMatches(inputs, names, UPDATE_FILE_COUNT - 1);
+	CHECK(page_count > 2);
+
+	/*nothing changed, nothing is written*/
+	CHECK(markPages(saved, sizes, page_count) == 0);
+	CHECK(runShared(UPDATE_FILE_COUNT - 1, NULL) == 0);
+	CHECK(restorePages(saved, sizes, page_count) == 0);
+
+	/*a new file only adds to the pages it is placed on*/
+	CHECK(synthWriteGm1(inputs[6], GM1_DATA_TGX, 2, 7) == 0);
+	CHECK(markPages(saved, sizes, page_count) == 0);
+	CHECK(runShared(UPDATE_FILE_COUNT, NULL) == 0);
+	int written = restorePages(saved, sizes, page_count);
+	CHECK(written == (filePages(6) & ((1 << page_count) - 1)));
+	page_count = sharedMatches(inputs, names, UPDATE_FILE_COUNT);
+	CHECK(page_count > 2);
+
+	/*only the pages the changed file was and is on are written*/
+	int old_pages = filePages(2);
+	CHECK(old_pages > 0);
+	CHECK(synthWriteGm1(inputs[2], GM1_DATA_TGX, 8, 100) == 0);
+	CHECK(markPages(saved, sizes, page_count) == 0);
+	CHECK(runShared(UPDATE_FILE_COUNT, NULL) == 0);
+	int new_pages = filePages(2);
+	CHECK(new_pages > 0);
+	written = restorePages(saved, sizes, page_count);
+	CHECK(written > 0);
+	CHECK((written & ~(old_pages | new_pages)) == 0);
+	CHECK((new_pages & ~written & ((1 << page_count) - 1)) == 0);
+	page_count = sharedMatches(inputs, names, UPDATE_FILE_COUNT);
+	CHECK(page_count > 2);
+
+	/*dropped files leave the index, --force packs the rest from scratch*/
+	CHECK(runShared(3, NULL) == 0);
+	CHECK(sharedMatches(inputs, names, 3) > 0);
+	CHECK(runShared(3, "--force") == 0);
+	CHECK(sharedMatches(inputs, names, 3) < page_count);
+	return 0;
+}
+
+struct FootprintObject {
+	int tile_start;
+	int tiles;
+	int size;
+	int elevation;
+	struct Sh2ckRect bounds;
+};
+
+struct FootprintTile {
+	struct Sh2ckPos grid;
+	int depth;
+	struct Sh2ckRect footprint;
+	int elevation;
+};
+
+/*reads a footprints file into objects and tiles, which have room for
+ * capacity entries, and returns the number of tiles or -1*/
+static int readFootprints(const char *file, struct FootprintObject *objects,
+                          int *object_count, struct FootprintTile *tiles,
+                          int capacity)
+{
+	char line[256];
+	int tile_count = 0;
+	int x;
+	int y;
+	int width;
+	int height;
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fgets(line, sizeof(line), fp) == NULL ||
+	    strcmp(line, "!footprints\n") != 0 ||
+	    fscanf(fp, "[objects,%d,8,i,i,i,i,i,i,i,i]\n", object_count) != 1 ||
+	    *object_count > capacity || fgets(line, sizeof(line), fp) == NULL) {
+		fclose(fp);
+		return -1;
+	}
+	for (int i = 0; i < *object_count; i++) {
+		struct FootprintObject *object = &objects[i];
+		if (fscanf(fp, "%d,%d,%d,%d,%d,%d,%d,%d\n", &object->tile_start,
+		           &object->tiles, &object->size, &object->elevation, &x, &y,
+		           &width, &height) != 8) {
+			fclose(fp);
+			return -1;
+		}
+		struct Sh2ckRect bounds = {x, y, width, height};
+		object->bounds = bounds;
+	}
+	if (fscanf(fp, "[tiles,%d,8,i,i,i,i,i,i,i,i]\n", &tile_count) != 1 ||
+	    tile_count > capacity || fgets(line, sizeof(line), fp) == NULL) {
+		fclose(fp);
+		return -1;
+	}
+	for (int i = 0; i < tile_count; i++) {
+		struct FootprintTile *tile = &tiles[i];
+		int grid_x;
+		int grid_y;
+		if (fscanf(fp, "%d,%d,%d,%d,%d,%d,%d,%d\n", &grid_x, &grid_y,
+		           &tile->depth, &x, &y, &width, &height,
+		           &tile->elevation) != 8) {
+			fclose(fp);
+			return -1;
+		}
+		struct Sh2ckPos grid = {grid_x, grid_y};
+		struct Sh2ckRect footprint = {x, y, width, height};
+		tile->grid = grid;
+		tile->footprint = footprint;
+	}
+	int end = fgetc(fp);
+	fclose(fp);
+	return end == EOF ? tile_count : -1;
+}
+
+#define FOOTPRINT_CAPACITY 256
+
+int testFootprints(void)
+{
+	static struct FootprintObject objects[FOOTPRINT_CAPACITY];
+	static struct FootprintTile tiles[FOOTPRINT_CAPACITY];
+	char file[64];
+	int object_count;
+	struct Sh2ckImage image;
+
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX_AND_TILE, 24, 1) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-a", "--footprints", "in.gm1",
+	              "out", "a", NULL) == 0);
+	int tile_count = readFootprints("out/a.footprints", objects,
+	                                &object_count, tiles, FOOTPRINT_CAPACITY);
+	CHECK(tile_count == 24);
+	CHECK(object_count > 1 && object_count < tile_count);
+
+	/*the objects cover the tiles in order and are the union of their
+	 * diamonds, which are drawn in the assembled images*/
+	int tile_start = 0;
+	for (int i = 0; i < object_count; i++) {
+		struct FootprintObject *object = &objects[i];
+		CHECK(object->tile_start == tile_start && object->tiles > 0);
+		tile_start += object->tiles;
+		snprintf(file, sizeof(file), "out/%d.png", i);
+		CHECK(testLoadPng(file, &image) == 0);
+		int inside = object->bounds.x >= 0 && object->bounds.y >= 0 &&
+		             object->bounds.x + object->bounds.width <= image.width &&
+		             object->bounds.y + object->bounds.height <= image.height;
+		int minx = INT16_MAX;
+		int miny = INT16_MAX;
+		int maxx = 0;
+		int maxy = 0;
+		int elevation = 0;
+		int opaque = 1;
+		for (int j = object->tile_start; j < tile_start; j++) {
+			struct FootprintTile *tile = &tiles[j];
+			struct Sh2ckRect *rect = &tile->footprint;
+			CHECK(tile->depth == tile->grid.x + tile->grid.y);
+			CHECK(tile->grid.x < object->size && tile->grid.y < object->size);
+			CHECK(rect->width == GM1_TILE_WIDTH &&
+			      rect->height == GM1_TILE_HEIGHT);
+			minx = rect->x < minx ? rect->x : minx;
+			miny = rect->y < miny ? rect->y : miny;
+			if (rect->x + rect->width > maxx) {
+				maxx = rect->x + rect->width;
+			}
+			if (rect->y + rect->height > maxy) {
+				maxy = rect->y + rect->height;
+			}
+			if (tile->elevation > elevation) {
+				elevation = tile->elevation;
+			}
+			int center = (rect->y + rect->height / 2) * image.pitch + rect->x +
+			             rect->width / 2;
+			opaque = opaque && image.pixel[center].a != 0;
+		}
+		free(image.pixel);
+		CHECK(inside && opaque);
+		CHECK(object->bounds.x == minx && object->bounds.y == miny &&
+		      object->bounds.width == maxx - minx &&
+		      object->bounds.height == maxy - miny);
+		CHECK(object->elevation == elevation);
+	}
+	CHECK(tile_start == tile_count);
+
+	/*without assembling every tile is an image of its own*/
+	CHECK(testRun(test_sh2ck, "run.txt", "--footprints", "in.gm1", "tiles",
+	              "a", NULL) == 0);
+	CHECK(readFootprints("tiles/a.footprints", objects, &object_count, tiles,
+	                     FOOTPRINT_CAPACITY) == 24);
+	for (int i = 0; i < object_count; i++) {
+		CHECK(objects[i].bounds.width == 0 && objects[i].bounds.height == 0);
+	}
+	return 0;
+}
+
+/*1 if the layers of out/a.layers hold the images of in.gm1 in their bottom
+ * left corner and nothing else*/
+static int layersMatch(void)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct LayerArray array;
+	if (sh2ckLayerArrayLoad(&array, "out/a.layers") == -1) {
+		return 0;
+	}
+	if (sh2ckGm1CreateFromFile(&gm1, "in.gm1") == -1 ||
+	    sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == -1) {
+		sh2ckLayerArrayDelete(&array);
+		return 0;
+	}
+	int width;
+	int height;
+	sh2ckLayerArraySize(&images, &width, &height);
+	int ok = array.width == width && array.height == height &&
+	         array.layer_count == images.image_count;
+	for (int i = 0; ok && i < images.image_count; i++) {
+		struct Sh2ckImage *image = &images.images[i];
+		const uint8_t *layer = sh2ckLayerArrayGet(&array, i);
+		int top = height - image->height;
+		ok = array.sizes[2 * i] == image->width &&
+		     array.sizes[2 * i + 1] == image->height;
+		for (int y = 0; ok && y < height; y++) {
+			for (int x = 0; ok && x < width; x++) {
+				const uint8_t *rgba = layer + 4 * (y * width + x);
+				struct Sh2ckColor c = {rgba[2], rgba[1], rgba[0], rgba[3]};
+				struct Sh2ckColor expected = {0, 0, 0, 0};
+				if (x < image->width && y >= top) {
+					expected = image->pixel[(y - top) * image->pitch + x];
+				}
+				ok = memcmp(&c, &expected, sizeof(c)) == 0;
+			}
+		}
+	}
+	ok = ok && sh2ckLayerArrayGet(&array, images.image_count) == NULL;
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	sh2ckLayerArrayDelete(&array);
+	return ok;
+}
+
+/*writes a layer array header and data_size bytes of zeros*/
+static int writeLayers(const char *file, uint32_t width, uint32_t height,
+                       uint32_t count, long data_size)
+{
+	uint32_t header[4] = {LAYER_ARRAY_VERSION, width, height, count};
+	FILE *fp = fopen(file, "wb");
+	if (fp == NULL) {
+		return -1;
+	}
+	fwrite(LAYER_ARRAY_MAGIC, 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+	for (long i = 0; i < data_size; i++) {
+		fputc(0, fp);
+	}
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+int testLayers(void)
+{
+	struct LayerArray array;
+
+	/*tiles are all as wide, but of different heights*/
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX_AND_TILE, 12, 1) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "--layers", "in.gm1", "out", "a",
+	              NULL) == 0);
+	CHECK(layersMatch());
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX_CONST_SIZE, 12, 2) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "--layers", "in.gm1", "out", "a",
+	              NULL) == 0);
+	CHECK(layersMatch());
+
+	/*headers that do not match the file are rejected*/
+	CHECK(writeLayers("ok.layers", 3, 2, 2, 2 * (4 + 3 * 2 * 4)) == 0);
+	CHECK(sh2ckLayerArrayLoad(&array, "ok.layers") == 0);
+	CHECK(array.width == 3 && array.height == 2 && array.layer_count == 2);
+	sh2ckLayerArrayDelete(&array);
+	CHECK(writeLayers("short.layers", 3, 2, 2, 2 * (4 + 3 * 2 * 4) - 1) == 0);
+	CHECK(sh2ckLayerArrayLoad(&array, "short.layers") == -1);
+	CHECK(writeLayers("wide.layers", 65536, 1, 1, 4 + 65536 * 4) == 0);
+	CHECK(sh2ckLayerArrayLoad(&array, "wide.layers") == -1);
+	/*count * (4 + 4) wraps to 8 in 32 bits*/
+	CHECK(writeLayers("wrap.layers", 1, 1, 0x20000001, 8) == 0);
+	CHECK(sh2ckLayerArrayLoad(&array, "wrap.layers") == -1);
+	CHECK(writeLayers("many.layers", 0, 0, 0x80000000u, 0) == 0);
+	CHECK(sh2ckLayerArrayLoad(&array, "many.layers") == -1);
+	return 0;
+}
+
+/*file is the png of image halved levels times*/
+static int savedAsHalf(const char *file, struct Sh2ckImage *image, int levels)
+{
+	struct Sh2ckImage half[2];
+	struct Sh2ckImage saved;
+	struct Sh2ckImage *source = image;
+	int ok = 1;
+	for (int i = 0; i < levels; i++) {
+		if (sh2ckImageCreate(&half[i], NULL, (source->width + 1) / 2,
+		                     (source->height + 1) / 2) == -1) {
+			levels = i;
+			ok = 0;
+			break;
+		}
+		sh2ckImageDownscaleHalf(&half[i], source);
+		source = &half[i];
+	}
+	if (ok && testLoadPng(file, &saved) == 0) {
+		ok = testImagesEqual(&saved, source);
+		free(saved.pixel);
+	} else {
+		ok = 0;
+	}
+	for (int i = 0; i < levels; i++) {
+		sh2ckImageDelete(&half[i], NULL);
+	}
+	return ok;
+}
+
+/*file is the atlas of the images of image_list halved levels times*/
+static int packedAsHalf(const char *file, struct Sh2ckImageList *image_list,
+                        int levels)
+{
+	struct Sh2ckImageList half[2];
+	struct Sh2ckImageList *source = image_list;
+	struct Sh2ckImage atlas;
+	struct Sh2ckImage saved;
+	int ok = 1;
+	for (int i = 0; i < levels; i++) {
+		if (sh2ckImageListCreateHalf(&half[i], source, NULL) == -1) {
+			levels = i;
+			ok = 0;
+			break;
+		}
+		source = &half[i];
+	}
+	if (ok && sh2ckImageCreateAtlas(&atlas, source, 1024, 0, 0) == 0) {
+		if (testLoadPng(file, &saved) == 0) {
+			ok = testImagesEqual(&saved, &atlas);
+			free(saved.pixel);
+		} else {
+			ok = 0;
+		}
+		sh2ckImageDelete(&atlas, NULL);
+	} else {
+		ok = 0;
+	}
+	for (int i = 0; i < levels; i++) {
+		sh2ckImageDeleteList(&half[i]);
+	}
+	return ok;
+}
+
+int testLod(void)
+{
+	struct Sh2ckColor pixels[5 * 3];
+	struct Sh2ckColor halved[3 * 2];
+	struct Sh2ckImage image = {0, 0, 3, 3, 5, pixels};
+	struct Sh2ckImage half = {0, 0, 2, 2, 3, halved};
+	struct Tgx tgx;
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+
+	/*a 2x2 block is averaged by alpha, odd edges by their own pixels*/
+	memset(pixels, 0, sizeof(pixels));
+	memset(halved, 0xAA, sizeof(halved));
+	pixels[0] = (struct Sh2ckColor){10, 20, 200, 0xFF};
+	pixels[1] = (struct Sh2ckColor){30, 40, 100, 0xFF};
+	pixels[5] = (struct Sh2ckColor){0xFF, 0xFF, 0xFF, 0};
+	pixels[2] = (struct Sh2ckColor){50, 60, 70, 0x80};
+	pixels[3] = (struct Sh2ckColor){0xFF, 0xFF, 0xFF, 0xFF};
+	pixels[10] = (struct Sh2ckColor){1, 2, 3, 0xFF};
+	sh2ckImageDownscaleHalf(&half, &image);
+	CHECK(memcmp(&halved[0], &(struct Sh2ckColor){20, 30, 150, 0x80}, 4) == 0);
+	CHECK(memcmp(&halved[1], &(struct Sh2ckColor){50, 60, 70, 0x40}, 4) == 0);
+	CHECK(memcmp(&halved[2], &(struct Sh2ckColor){0xAA, 0xAA, 0xAA, 0xAA}, 4) ==
+	      0);
+	CHECK(memcmp(&halved[3], &(struct Sh2ckColor){1, 2, 3, 0x80}, 4) == 0);
+	CHECK(memcmp(&halved[4], &(struct Sh2ckColor){0, 0, 0, 0}, 4) == 0);
+
+	/*tgx levels are halved from the level above, rounding odd sizes up*/
+	CHECK(synthWriteTgx("in.tgx", 301, 203, 3) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-t", "--lod", "2", "in.tgx", "out",
+	              "a", NULL) == 0);
+	CHECK(sh2ckTgxCreateFromFile(&tgx, "in.tgx") == 0);
+	CHECK(sh2ckTgxCreateImage(&image, tgx.width, tgx.height, tgx.data,
+	                          tgx.size, NULL) == 0);
+	int ok = savedAsHalf("out/0_lod1.png", &image, 1) &&
+	         savedAsHalf("out/0_lod2.png", &image, 2) &&
+	         !testFileExists("out/0_lod3.png");
+	sh2ckImageDelete(&image, NULL);
+	sh2ckTgxDelete(&tgx);
+	CHECK(ok);
+	CHECK(testLoadPng("out/0_lod2.png", &image) == 0);
+	ok = image.width == 76 && image.height == 51;
+	free(image.pixel);
+	CHECK(ok);
+
+	/*packed atlases get one atlas per level, animations trimmed after*/
+	static const int data_types[] = {GM1_DATA_ANIMATION, GM1_DATA_BITMAP};
+	for (int i = 0; i < 2; i++) {
+		CHECK(synthWriteGm1("in.gm1", data_types[i], 9, i + 1) == 0);
+		CHECK(testRun(test_sh2ck, "run.txt", "-P", "-f", "--lod", "2",
+		              "in.gm1", "packed", "a", NULL) == 0);
+		CHECK(testFileExists("packed/a_lod1.data") &&
+		      testFileExists("packed/a_lod2.data") &&
+		      !testFileExists("packed/a_lod3.png"));
+		CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+		CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+		ok = packedAsHalf("packed/a_lod1.png", &images, 1) &&
+		     packedAsHalf("packed/a_lod2.png", &images, 2);
+		sh2ckImageDeleteList(&images);
+		sh2ckGm1Delete(&gm1);
+		CHECK(ok);
+	}
+
+	/*more levels than LOD_LEVELS_MAX are refused*/
+	CHECK(testRun(test_sh2ck, "run.txt", "-t", "--lod", "3", "in.tgx", "bad",
+	              "a", NULL) == 1);
+	CHECK(!testFileExists("bad/0.png"));
+	return 0;
+}
+
+/*writes size bytes of value to file through the queue of the thread*/
+static int writeQueued(const char *file, int value, int size)
+{
+	char data[256];
+	FILE *fp = sh2ckIoOpen(file);
+	if (fp == NULL) {
+		return -1;
+	}
+	memset(data, value, size);
+	if (fwrite(data, 1, size, fp) != (size_t)size) {
+		sh2ckIoClose(fp);
+		return -1;
+	}
+	return sh2ckIoClose(fp);
+}
+
+/*1 if file holds size bytes of value*/
+static int writtenAs(const char *file, int value, int size)
+{
+	long file_size;
+	char *data = testReadFile(file, &file_size);
+	if (data == NULL) {
+		return 0;
+	}
+	int ok = file_size == size;
+	for (int i = 0; ok && i < size; i++) {
+		ok = data[i] == (char)value;
+	}
+	free(data);
+	return ok;
+}
+
+int testBatchIo(void)
+{
+	struct IoQueue *queue;
+	int failed = 0;
+
+	/*small files wait in the queue, larger ones are written right away*/
+	CHECK((queue = sh2ckIoQueueCreate(64)) != NULL);
+	sh2ckIoSetThreadQueue(queue, &failed);
+	CHECK(writeQueued("small", 'a', 16) == 0);
+	CHECK(sh2ckIoFileSize("small") == 16);
+	CHECK(writeQueued("large", 'b', 200) == 0);
+	CHECK(writtenAs("large", 'b', 200));
+	CHECK(writeQueued("missing/file", 'c', 8) == 0);
+	sh2ckIoSetThreadQueue(NULL, NULL);
+	sh2ckIoQueueDelete(queue);
+	CHECK(writtenAs("small", 'a', 16));
+	CHECK(failed);
+
+	/*a batch writes what converting every file on its own writes, also when
+	 * the budget leaves the queue smaller than the largest output*/
+	CHECK(writeBatchInputs(10) == 0);
+	CHECK(synthWriteGm1(batch_inputs[0], GM1_DATA_TGX, 40, 1) == 0);
+	CHECK(mkdir("single", 0775) == 0);
+	for (int i = 0; i < BATCH_FILE_COUNT; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "n%d", i);
+		CHECK(testRun(test_sh2ck, "run.txt", "-P", batch_inputs[i], "single",
+		              name, NULL) == 0);
+	}
+	CHECK(writeBatchList("queued.txt", "queued") == 0);
+	CHECK(writeBatchList("direct.txt", "direct") == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-P", "-j", "4", "--batch",
+	              "queued.txt", NULL) == 0);
+	CHECK(testRun(test_sh2ck, "run.txt", "-P", "-j", "4", "--max-memory",
+	              "1", "--batch", "direct.txt", NULL) == 0);
+	CHECK(sh2ckIoFileSize("direct/n0.png") > 1024 * 1024 / 4);
+	CHECK(batchManifestComplete("single"));
+	CHECK(batchManifestComplete("queued"));
+	CHECK(batchManifestComplete("direct"));
+	CHECK(testDirsEqual("single", "queued"));
+	CHECK(testDirsEqual("single", "direct"));
+	return 0;
+}
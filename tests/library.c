@@ -0,0 +1,920 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta.h"
+#include "font.h"
+#include "gm1.h"
+#include "mask.h"
+#include "memory.h"
+#include "sprite.h"
+#include "tgx.h"
+#include "thread.h"
+#include "synth.h"
+#include "test.h"
+
+/*the part of atlas covered by image, as an image of its own*/
+static struct Sh2ckImage atlasView(const struct Sh2ckImage *atlas,
+                                   const struct Sh2ckImage *image)
+{
+	struct Sh2ckImage view = *atlas;
+	view.width = image->width;
+	view.height = image->height;
+	view.pixel = &atlas->pixel[image->y * atlas->pitch + image->x];
+	return view;
+}
+
+static void *countAlloc(size_t size, void *user)
+{
+	void *ptr = malloc(size);
+	if (ptr != NULL) {
+		(*(int *)user)++;
+	}
+	return ptr;
+}
+
+static void *countRealloc(void *ptr, size_t size, void *user)
+{
+	void *new_ptr = realloc(ptr, size);
+	if (ptr == NULL && new_ptr != NULL) {
+		(*(int *)user)++;
+	}
+	return new_ptr;
+}
+
+static void countFree(void *ptr, void *user)
+{
+	if (ptr != NULL) {
+		(*(int *)user)--;
+	}
+	free(ptr);
+}
+
+int testLibrary(void)
+{
+	int live = 0;
+	struct Sh2ckAllocator allocator = {countAlloc, countRealloc, countFree,
+	                                   &live};
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckImageList packed;
+	struct Sh2ckImage atlas;
+
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX, 12, 1) == 0);
+	sh2ckMemorySetAllocator(&allocator);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(live > 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	CHECK(sh2ckGm1CreateImageList(&packed, 0, &gm1, 0, 0) == 0);
+	CHECK(images.image_count == 12);
+	CHECK(sh2ckImageCreateAtlas(&atlas, &packed, 1024, 1, 0) == 0);
+
+	/*every image is found unchanged at its place in the atlas*/
+	for (int i = 0; i < packed.image_count; i++) {
+		struct Sh2ckImage *image = &packed.images[i];
+		CHECK(image->x >= 0 && image->x + image->width <= atlas.width);
+		CHECK(image->y >= 0 && image->y + image->height <= atlas.height);
+		struct Sh2ckImage view = atlasView(&atlas, image);
+		CHECK(testImagesEqual(&view, &images.images[i]));
+	}
+
+	sh2ckImageDelete(&atlas, NULL);
+	sh2ckImageDeleteList(&packed);
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	sh2ckMemorySetAllocator(NULL);
+	CHECK(live == 0);
+	return 0;
+}
+
+int testReader(void)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Gm1Reader reader;
+
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 8, 1) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 3, 0) == 0);
+	CHECK(sh2ckGm1ReaderOpen(&reader, "in.gm1", 2) == 0);
+	CHECK(sh2ckGm1ReaderImageCount(&reader) == images.image_count);
+
+	/*decoding on demand gives the pixels of decoding the whole file*/
+	for (int i = 0; i < images.image_count; i++) {
+		const struct Sh2ckImage *image = sh2ckGm1ReaderGetImage(&reader, i, 3);
+		CHECK(image != NULL);
+		CHECK(testImagesEqual(image, &images.images[i]));
+	}
+	const struct Sh2ckImage *image = sh2ckGm1ReaderGetImage(&reader, 7, 3);
+	CHECK(image != NULL);
+	CHECK(sh2ckGm1ReaderGetImage(&reader, 7, 3) == image);
+	CHECK(sh2ckGm1ReaderGetImage(&reader, 7, 4) != image);
+
+	CHECK(sh2ckGm1ReaderGetImage(&reader, -1, 3) == NULL);
+	CHECK(sh2ckGm1ReaderGetImage(&reader, images.image_count, 3) == NULL);
+
+	sh2ckGm1ReaderClose(&reader);
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
+
+/*blits sprite at x, y into a transparent image of the size of expected, clipped
+ * to clip, and compares it with expected*/
+static int blitsAs(const struct Sprite *sprite, const uint16_t *palette,
+                   int x, int y, const struct Sh2ckRect *clip,
+                   const struct Sh2ckImage *expected)
+{
+	struct Sh2ckImage target;
+	if (sh2ckImageCreate(&target, NULL, expected->width, expected->height) ==
+	    -1) {
+		return 0;
+	}
+	sh2ckImageClear(&target, 0);
+	int equal = sh2ckSpriteBlit(&target, x, y, sprite, palette, clip) == 0 &&
+	            testImagesEqual(&target, expected);
+	sh2ckImageDelete(&target, NULL);
+	return equal;
+}
+
+int testSprite(void)
+{
+	static const int data_types[] = {GM1_DATA_TGX, GM1_DATA_ANIMATION,
+	                                 GM1_DATA_BITMAP, GM1_DATA_TGX_AND_TILE};
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckImageList info;
+	struct Sprite sprites[8];
+	struct SpriteSheet sheet;
+	struct Sh2ckImage scratch;
+
+	for (int i = 0; i < 4; i++) {
+		CHECK(synthWriteGm1("in.gm1", data_types[i], 8, i + 1) == 0);
+		CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+		CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 2, 0) == 0);
+		CHECK(sh2ckGm1CreateImageListInfo(&info, 0, &gm1, 0) == 0);
+		CHECK(images.image_count == 8);
+		const uint16_t *palette = gm1.palette + 2 * GM1_PALETTE_SIZE;
+
+		/*drawing a sprite gives the decoded image*/
+		for (int j = 0; j < images.image_count; j++) {
+			struct Sh2ckImage *image = &images.images[j];
+			CHECK(sh2ckImageCreate(&scratch, NULL, image->width,
+			                       image->height) == 0);
+			CHECK(sh2ckGm1EncodeListSprite(&info, &gm1, j, &scratch,
+			                               &sprites[j]) == 0);
+			sh2ckImageDelete(&scratch, NULL);
+			CHECK(blitsAs(&sprites[j], palette, 0, 0, NULL, image));
+		}
+
+		/*and so does the sprite loaded from a sheet*/
+		CHECK(sh2ckSpriteSheetSave("in.sprites", sprites, 8) == 0);
+		CHECK(sh2ckSpriteSheetLoad(&sheet, "in.sprites") == 0);
+		CHECK(sheet.sprite_count == 8);
+		for (int j = 0; j < images.image_count; j++) {
+			struct Sprite sprite;
+			CHECK(sh2ckSpriteSheetGet(&sheet, j, &sprite) == 0);
+			CHECK(blitsAs(&sprite, palette, 0, 0, NULL, &images.images[j]));
+		}
+		sh2ckSpriteSheetDelete(&sheet);
+
+		/*moved up and left, the target shows the inner part of the image*/
+		struct Sh2ckImage inner = images.images[0];
+		CHECK(inner.width > 4 && inner.height > 4);
+		inner.pixel += 2 * inner.pitch + 3;
+		inner.width -= 4;
+		inner.height -= 4;
+		CHECK(blitsAs(&sprites[0], palette, -3, -2, NULL, &inner));
+
+		/*nothing is drawn outside of the clip rect*/
+		struct Sh2ckImage *image = &images.images[0];
+		struct Sh2ckRect clip = {2, 1, image->width - 5, image->height - 3};
+		CHECK(sh2ckImageCreate(&scratch, NULL, image->width, image->height) ==
+		      0);
+		for (int y = 0; y < image->height; y++) {
+			for (int x = 0; x < image->width; x++) {
+				struct Sh2ckColor *pixel =
+				    &scratch.pixel[y * scratch.pitch + x];
+				*pixel = image->pixel[y * image->pitch + x];
+				if (x < clip.x || x >= clip.x + clip.width || y < clip.y ||
+				    y >= clip.y + clip.height) {
+					pixel->a = 0;
+				}
+			}
+		}
+		int ok = blitsAs(&sprites[0], palette, 0, 0, &clip, &scratch);
+		sh2ckImageDelete(&scratch, NULL);
+		CHECK(ok);
+
+		for (int j = 0; j < images.image_count; j++) {
+			sh2ckSpriteDelete(&sprites[j]);
+		}
+		sh2ckImageDeleteList(&info);
+		sh2ckImageDeleteList(&images);
+		sh2ckGm1Delete(&gm1);
+	}
+	return 0;
+}
+
+/*1 if frame shows image with center at the center of the animation and
+ * nothing else*/
+static int frameMatches(const struct DeltaAnimation *animation,
+                        const struct Sh2ckImage *frame,
+                        const struct Sh2ckImage *image, struct Sh2ckPos center)
+{
+	int left = animation->center_x - center.x;
+	int top = animation->center_y - center.y;
+	int drawn = 0;
+	int opaque = 0;
+	for (int y = 0; y < animation->height; y++) {
+		for (int x = 0; x < animation->width; x++) {
+			const struct Sh2ckColor *pixel =
+			    &frame->pixel[y * frame->pitch + x];
+			int ix = x - left;
+			int iy = y - top;
+			if (ix < 0 || ix >= image->width || iy < 0 ||
+			    iy >= image->height) {
+				if (pixel->a != 0) {
+					return 0;
+				}
+				continue;
+			}
+			const struct Sh2ckColor *expected =
+			    &image->pixel[iy * image->pitch + ix];
+			if (expected->a != 0) {
+				drawn++;
+			}
+			if ((pixel->a != 0 || expected->a != 0) &&
+			    memcmp(pixel, expected, sizeof(*pixel)) != 0) {
+				return 0;
+			}
+		}
+	}
+	for (int i = 0; i < image->height * image->pitch; i++) {
+		opaque += image->pixel[i].a != 0;
+	}
+	return drawn == opaque;
+}
+
+/*decodes every frame at random and in order and compares it with the
+ * untrimmed images*/
+static int deltaMatches(struct DeltaAnimation *animation,
+                        const struct Sh2ckImageList *images,
+                        const struct Sh2ckPos *centers)
+{
+	struct Sh2ckImage canvas;
+	struct Sh2ckImage sequential;
+	int ok = 1;
+	/*a canvas of one pixel for animations without any*/
+	int width = animation->width > 0 ? animation->width : 1;
+	int height = animation->height > 0 ? animation->height : 1;
+	if (sh2ckImageCreate(&canvas, NULL, width, height) == -1) {
+		return 0;
+	}
+	if (sh2ckImageCreate(&sequential, NULL, width, height) == -1) {
+		sh2ckImageDelete(&canvas, NULL);
+		return 0;
+	}
+	ok = animation->frame_count == images->image_count &&
+	     sh2ckDeltaIsKeyFrame(animation, 0);
+	for (int i = animation->frame_count - 1; ok && i >= 0; i--) {
+		ok = sh2ckDeltaDecodeFrame(animation, i, &canvas) == 0 &&
+		     frameMatches(animation, &canvas, &images->images[i], centers[i]);
+	}
+	for (int i = 0; ok && i < animation->frame_count; i++) {
+		ok = sh2ckDeltaApplyFrame(animation, i, &sequential) == 0 &&
+		     frameMatches(animation, &sequential, &images->images[i],
+		                  centers[i]);
+	}
+	sh2ckImageDelete(&sequential, NULL);
+	sh2ckImageDelete(&canvas, NULL);
+	return ok;
+}
+
+#define DELTA_TEST_FRAMES 9
+
+int testDelta(void)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckImageList trimmed;
+	struct Sh2ckOffset offsets[DELTA_TEST_FRAMES];
+	struct Sh2ckPos centers[DELTA_TEST_FRAMES];
+	struct DeltaAnimation plain;
+	struct DeltaAnimation packed;
+	struct DeltaAnimation loaded;
+
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, DELTA_TEST_FRAMES, 1) ==
+	      0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	CHECK(sh2ckGm1CreateImageList(&trimmed, 0, &gm1, 0, 0) == 0);
+	CHECK(images.image_count == DELTA_TEST_FRAMES);
+	struct Sh2ckAnimation *animation = images.data;
+	for (int i = 0; i < DELTA_TEST_FRAMES; i++) {
+		centers[i] = animation->frames[i].center;
+	}
+
+	/*an empty frame draws nothing, but stays a frame*/
+	for (int i = 0; i < 2; i++) {
+		struct Sh2ckImage *image =
+		    i == 0 ? &images.images[4] : &trimmed.images[4];
+		memset(image->pixel, 0,
+		       sizeof(*image->pixel) * image->pitch * image->height);
+	}
+
+	CHECK(sh2ckDeltaCreate(&plain, &images, NULL, 16, 3) == 0);
+	CHECK(deltaMatches(&plain, &images, centers));
+	for (int i = 0, chain = 0; i < DELTA_TEST_FRAMES; i++) {
+		chain = sh2ckDeltaIsKeyFrame(&plain, i) ? 0 : chain + 1;
+		CHECK(chain <= 3);
+	}
+
+	/*trimmed frames in small blocks give the same frames from a file*/
+	sh2ckShrinkAnimationImages(&trimmed, offsets);
+	CHECK(sh2ckDeltaCreate(&packed, &trimmed, offsets, 7, 2) == 0);
+	CHECK(packed.width <= plain.width && packed.height <= plain.height);
+	CHECK(sh2ckDeltaSave(&packed, "in.anim") == 0);
+	CHECK(sh2ckDeltaLoad(&loaded, "in.anim") == 0);
+	CHECK(loaded.size == packed.size &&
+	      memcmp(loaded.buffer, packed.buffer, packed.size) == 0);
+	CHECK(deltaMatches(&loaded, &images, centers));
+	sh2ckDeltaDelete(&loaded);
+	sh2ckDeltaDelete(&packed);
+	sh2ckDeltaDelete(&plain);
+
+	/*without any pixels the canvas is empty*/
+	for (int i = 0; i < DELTA_TEST_FRAMES; i++) {
+		struct Sh2ckImage *image = &images.images[i];
+		memset(image->pixel, 0,
+		       sizeof(*image->pixel) * image->pitch * image->height);
+	}
+	sh2ckShrinkAnimationImages(&images, offsets);
+	CHECK(sh2ckDeltaCreate(&plain, &images, offsets, 16, 3) == 0);
+	CHECK(plain.width == 0 && plain.height == 0);
+	CHECK(deltaMatches(&plain, &images, centers));
+	sh2ckDeltaDelete(&plain);
+
+	sh2ckImageDeleteList(&trimmed);
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
+
+/*1 if mask agrees with the alpha of the part of image at offset, which is
+ * width by height, by pixel and by rect*/
+static int maskMatches(const struct HitMask *mask,
+                       const struct Sh2ckImage *image,
+                       struct Sh2ckOffset offset, int width, int height)
+{
+	if (mask->width != width || mask->height != height) {
+		return 0;
+	}
+	for (int y = -2; y < height + 2; y++) {
+		for (int x = -2; x < width + 2; x++) {
+			int opaque = 0;
+			if (x >= 0 && x < width && y >= 0 && y < height) {
+				int i = (y + offset.y) * image->pitch + x + offset.x;
+				opaque = image->pixel[i].a == 0xFF;
+			}
+			if (sh2ckMaskTest(mask, x, y) != opaque) {
+				return 0;
+			}
+		}
+	}
+	/*rects of several sizes all over the mask and past its edges*/
+	for (int size = 1; size < 40; size += 6) {
+		for (int y = -size; y < height + 1; y += 3) {
+			for (int x = -size; x < width + 1; x += 5) {
+				struct Sh2ckRect rect = {x, y, size, size + 2};
+				int opaque = 0;
+				for (int ry = y; ry < y + rect.height; ry++) {
+					for (int rx = x; rx < x + rect.width; rx++) {
+						opaque |= sh2ckMaskTest(mask, rx, ry);
+					}
+				}
+				if (sh2ckMaskTestRect(mask, &rect) != opaque) {
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int testMask(void)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct HitMask masks[9];
+	struct Sh2ckOffset offsets[8];
+	struct Sh2ckImage image;
+	struct MaskSheet sheet;
+	const struct Sh2ckOffset zero = {0, 0};
+
+	/*partly transparent pixels are not hit, rows are longer than a word*/
+	CHECK(sh2ckImageCreate(&image, NULL, 37, 19) == 0);
+	for (int y = 0; y < image.height; y++) {
+		for (int x = 0; x < image.width; x++) {
+			struct Sh2ckColor *pixel = &image.pixel[y * image.pitch + x];
+			pixel->r = pixel->g = pixel->b = 0x40;
+			pixel->a = (x * 7 + y * 3) % 5 == 0 ? 0xFF
+			           : (x + y) % 3 == 0      ? 0x80
+			                                   : 0x00;
+		}
+	}
+	CHECK(sh2ckMaskCreateImage(&masks[8], &image, NULL) == 0);
+	CHECK(maskMatches(&masks[8], &image, zero, 37, 19));
+
+	/*trimmed animation frames are masked where they are in their pixels*/
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 8, 1) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	sh2ckShrinkAnimationImages(&images, offsets);
+	for (int i = 0; i < 8; i++) {
+		struct Sh2ckImage *frame = &images.images[i];
+		CHECK(sh2ckMaskCreateImage(&masks[i], frame, &offsets[i]) == 0);
+		CHECK(maskMatches(&masks[i], frame, offsets[i], frame->width,
+		                  frame->height));
+	}
+
+	CHECK(sh2ckMaskSheetSave("in.masks", masks, 9) == 0);
+	CHECK(sh2ckMaskSheetLoad(&sheet, "in.masks") == 0);
+	CHECK(sheet.mask_count == 9);
+	for (int i = 0; i < 9; i++) {
+		struct HitMask mask;
+		CHECK(sh2ckMaskSheetGet(&sheet, i, &mask) == 0);
+		CHECK(sh2ckMaskDataSize(&mask) == sh2ckMaskDataSize(&masks[i]));
+		if (i == 8) {
+			CHECK(maskMatches(&mask, &image, zero, 37, 19));
+		} else {
+			struct Sh2ckImage *frame = &images.images[i];
+			CHECK(maskMatches(&mask, frame, offsets[i], frame->width,
+			                  frame->height));
+		}
+	}
+	CHECK(sh2ckMaskSheetGet(&sheet, 9, &masks[0]) == -1);
+
+	sh2ckMaskSheetDelete(&sheet);
+	for (int i = 0; i < 9; i++) {
+		sh2ckMaskDelete(&masks[i]);
+	}
+	sh2ckImageDelete(&image, NULL);
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
+
+int testParallel(void)
+{
+	static const int data_types[] = {GM1_DATA_TGX, GM1_DATA_ANIMATION,
+	                                 GM1_DATA_TGX_AND_TILE, GM1_DATA_BITMAP};
+	struct Gm1 gm1;
+	struct Sh2ckImageList serial;
+	struct Sh2ckImageList parallel;
+
+	struct Sh2ckThreadPool *pool = sh2ckThreadPoolCreate(4);
+	CHECK(pool != NULL);
+	for (int i = 0; i < 4; i++) {
+		CHECK(synthWriteGm1("in.gm1", data_types[i], 40, i + 1) == 0);
+		CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+		/*tiles are decoded one by one and as assembled objects*/
+		for (int assemble = 0; assemble < 2; assemble++) {
+			CHECK(sh2ckGm1CreateImageList(&serial, 0, &gm1, 1, assemble) == 0);
+			CHECK(sh2ckGm1CreateImageListParallel(&parallel, 0, &gm1, 1,
+			                                      assemble, pool) == 0);
+			int ok = serial.type == parallel.type &&
+			         serial.image_count == parallel.image_count;
+			for (int j = 0; ok && j < serial.image_count; j++) {
+				struct Sh2ckImage *a = &serial.images[j];
+				struct Sh2ckImage *b = &parallel.images[j];
+				ok = a->x == b->x && a->y == b->y && testImagesEqual(a, b);
+			}
+			if (ok && serial.type == SH2CK_IMAGE_TYPE_TILE) {
+				struct Sh2ckTileObjectList *a = serial.data;
+				struct Sh2ckTileObjectList *b = parallel.data;
+				ok = a->tile_count == b->tile_count &&
+				     memcmp(a->tiles, b->tiles,
+				            sizeof(*a->tiles) * a->tile_count) == 0;
+			}
+			sh2ckImageDeleteList(&parallel);
+			sh2ckImageDeleteList(&serial);
+			CHECK(ok);
+		}
+		sh2ckGm1Delete(&gm1);
+	}
+	sh2ckThreadPoolDelete(pool);
+	return 0;
+}
+
+static struct Sh2ckColor color16(const uint8_t *data)
+{
+	uint16_t color = data[0] | (data[1] << 8);
+	struct Sh2ckColor c = {SH2CK_COLOR_CONVERT_BLUE(color),
+	                       SH2CK_COLOR_CONVERT_GREEN(color),
+	                       SH2CK_COLOR_CONVERT_RED(color), 0xFF};
+	return c;
+}
+
+/*1 if the 16 rows from top of image hold the tile diamond of data, 2
+ * pixels wider per side every row down to the middle and narrower after*/
+static int diamondMatches(const struct Sh2ckImage *image, int top,
+                          const uint8_t *data)
+{
+	int count = 0;
+	for (int y = 0; y < GM1_TILE_HEIGHT; y++) {
+		int half = y < GM1_TILE_HEIGHT / 2 ? y : GM1_TILE_HEIGHT - 1 - y;
+		int width = 4 * half + 2;
+		int left = (GM1_TILE_WIDTH - width) / 2;
+		for (int x = left; x < left + width; x++) {
+			struct Sh2ckColor expected = color16(data + 2 * count++);
+			const struct Sh2ckColor *pixel =
+			    &image->pixel[(top + y) * image->pitch + x];
+			if (memcmp(pixel, &expected, sizeof(expected)) != 0) {
+				return 0;
+			}
+		}
+	}
+	/*the diamond holds all 256 pixels of the tile data*/
+	return count == 256;
+}
+
+int testTiles(void)
+{
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX_AND_TILE, 16, 1) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	CHECK(images.image_count == 16);
+	for (int i = 0; i < images.image_count; i++) {
+		struct Sh2ckImage *image = &images.images[i];
+		int top = gm1.image_headers[i].tile_position_y;
+		CHECK(image->width == GM1_TILE_WIDTH);
+		CHECK(top + GM1_TILE_HEIGHT <= image->height);
+		CHECK(diamondMatches(image, top,
+		                     gm1.image_data + gm1.image_offset_list[i]));
+	}
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+
+	/*bitmaps are the same 16 bit colours row by row*/
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_BITMAP, 4, 2) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	for (int i = 0; i < images.image_count; i++) {
+		struct Sh2ckImage *image = &images.images[i];
+		const uint8_t *data = gm1.image_data + gm1.image_offset_list[i];
+		int count = image->width * image->height;
+		CHECK(count > 0 && (uint32_t)count * 2 <= gm1.image_size_list[i]);
+		for (int j = 0; j < count; j++) {
+			struct Sh2ckColor expected = color16(data + 2 * j);
+			CHECK(memcmp(&image->pixel[j], &expected, sizeof(expected)) == 0);
+		}
+	}
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
+
+int testAtlasBands(void)
+{
+	static const int band_heights[] = {1, 7, SH2CK_IMAGE_ATLAS_BAND_HEIGHT,
+	                                   10000};
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckOffset offsets[60];
+	struct Sh2ckRect atlas_size;
+	struct Sh2ckImage atlas;
+	struct Sh2ckImage saved;
+
+	struct Sh2ckThreadPool *pool = sh2ckThreadPoolCreate(4);
+	CHECK(pool != NULL);
+	for (int animation = 0; animation < 2; animation++) {
+		CHECK(synthWriteGm1("in.gm1",
+		                    animation ? GM1_DATA_ANIMATION : GM1_DATA_TGX, 60,
+		                    animation + 1) == 0);
+		CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+		CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+		if (animation) {
+			sh2ckShrinkAnimationImages(&images, offsets);
+		}
+		const struct Sh2ckOffset *image_offsets = animation ? offsets : NULL;
+		CHECK(sh2ckImageLayoutAtlas(&images, &atlas_size, 1024, 1, 0) == 0);
+		CHECK(atlas_size.height > SH2CK_IMAGE_ATLAS_BAND_HEIGHT);
+		CHECK(sh2ckImageComposeAtlas(&atlas, &images, image_offsets,
+		                             &atlas_size) == 0);
+
+		/*any band height, and composing on the pool, give the atlas*/
+		for (int i = 0; i < 5; i++) {
+			int band_height = i < 4 ? band_heights[i] : 16;
+			CHECK(sh2ckImageSaveAtlas(&images, image_offsets, &atlas_size,
+			                          band_height, "atlas.png",
+			                          i < 4 ? NULL : pool) == 0);
+			CHECK(testLoadPng("atlas.png", &saved) == 0);
+			int ok = testImagesEqual(&saved, &atlas);
+			free(saved.pixel);
+			CHECK(ok);
+		}
+		sh2ckImageDelete(&atlas, NULL);
+		sh2ckImageDeleteList(&images);
+		sh2ckGm1Delete(&gm1);
+	}
+	sh2ckThreadPoolDelete(pool);
+	return 0;
+}
+
+/*1 if image saves with and without pool to pngs with its pixels, the one
+ * written on the pool about as small, give or take a few block headers per
+ * chunk*/
+static int savesInParallel(struct Sh2ckImage *image,
+                           struct Sh2ckThreadPool *pool)
+{
+	struct Sh2ckImage serial;
+	struct Sh2ckImage parallel;
+	long serial_size;
+	long parallel_size;
+	if (sh2ckImageSave(image, "serial.png") == -1 ||
+	    sh2ckImageSaveParallel(image, "parallel.png", pool) == -1) {
+		return 0;
+	}
+	char *data = testReadFile("serial.png", &serial_size);
+	free(data);
+	data = testReadFile("parallel.png", &parallel_size);
+	free(data);
+	if (testLoadPng("serial.png", &serial) == -1) {
+		return 0;
+	}
+	if (testLoadPng("parallel.png", &parallel) == -1) {
+		free(serial.pixel);
+		return 0;
+	}
+	int ok = testImagesEqual(&serial, image) &&
+	         testImagesEqual(&parallel, image) &&
+	         parallel_size <= serial_size + serial_size / 50 + 4096;
+	free(parallel.pixel);
+	free(serial.pixel);
+	return ok;
+}
+
+int testSaveParallel(void)
+{
+	struct Sh2ckImage image;
+	struct Tgx tgx;
+	uint32_t seed = 1;
+
+	struct Sh2ckThreadPool *pool = sh2ckThreadPoolCreate(4);
+	CHECK(pool != NULL);
+
+	/*noise in every colour and alpha is saved as rgba*/
+	CHECK(sh2ckImageCreate(&image, NULL, 701, 499) == 0);
+	for (int i = 0; i < image.width * image.height; i++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t word = (seed >> 8) | ((seed & 0x3) << 30);
+		memcpy(&image.pixel[i], &word, sizeof(word));
+	}
+	CHECK(savesInParallel(&image, pool));
+
+	/*few colours are saved as a palette*/
+	for (int i = 0; i < image.width * image.height; i++) {
+		struct Sh2ckColor c = {(i % 7) * 8, (i / 701 % 5) * 8, 0x80,
+		                       i % 3 == 0 ? 0x00 : 0xFF};
+		image.pixel[i] = c;
+	}
+	CHECK(savesInParallel(&image, pool));
+	sh2ckImageDelete(&image, NULL);
+
+	CHECK(synthWriteTgx("in.tgx", 1200, 800, 1) == 0);
+	CHECK(sh2ckTgxCreateFromFile(&tgx, "in.tgx") == 0);
+	CHECK(sh2ckTgxCreateImage(&image, tgx.width, tgx.height, tgx.data,
+	                          tgx.size, NULL) == 0);
+	sh2ckTgxDelete(&tgx);
+	CHECK(savesInParallel(&image, pool));
+	sh2ckImageDelete(&image, NULL);
+
+	sh2ckThreadPoolDelete(pool);
+	return 0;
+}
+
+/*1 if file is an indexed png, 0 if not, -1 if it can not be read*/
+static int pngIndexed(const char *file)
+{
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, file)) {
+		return -1;
+	}
+	int indexed = (png.format & PNG_FORMAT_FLAG_COLORMAP) != 0;
+	png_image_free(&png);
+	return indexed;
+}
+
+/*fills image with color_count rgb555 colours, every seventh pixel
+ * transparent if transparent is set*/
+static void fillColors(struct Sh2ckImage *image, int color_count,
+                       int transparent)
+{
+	for (int i = 0; i < image->width * image->height; i++) {
+		int key = (i % color_count) * 127 % 32768;
+		struct Sh2ckColor c = {SH2CK_COLOR_CONVERT_BLUE(key),
+		                       SH2CK_COLOR_CONVERT_GREEN(key),
+		                       SH2CK_COLOR_CONVERT_RED(key), 0xFF};
+		if (transparent && i % 7 == 0) {
+			memset(&c, 0, sizeof(c));
+		}
+		image->pixel[i] = c;
+	}
+}
+
+/*indexed is 1 if image has to be saved as indexed png, 0 as rgba*/
+static int savesAs(struct Sh2ckImage *image, int indexed)
+{
+	struct Sh2ckImage saved;
+	if (sh2ckImageSave(image, "out.png") == -1 ||
+	    pngIndexed("out.png") != indexed ||
+	    testLoadPng("out.png", &saved) == -1) {
+		return 0;
+	}
+	size_t bytes = sizeof(*image->pixel) * image->width * image->height;
+	int equal = saved.width == image->width &&
+	            saved.height == image->height &&
+	            memcmp(saved.pixel, image->pixel, bytes) == 0;
+	free(saved.pixel);
+	return equal;
+}
+
+int testPalette(void)
+{
+	struct Sh2ckImage image;
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+
+	/*transparency counts as one of the 256 entries*/
+	CHECK(sh2ckImageCreate(&image, NULL, 64, 33) == 0);
+	fillColors(&image, 255, 1);
+	CHECK(savesAs(&image, 1));
+	fillColors(&image, 256, 0);
+	CHECK(savesAs(&image, 1));
+	fillColors(&image, 256, 1);
+	CHECK(savesAs(&image, 0));
+	fillColors(&image, 257, 0);
+	CHECK(savesAs(&image, 0));
+
+	/*colours that are no rgb555, partly transparent pixels and transparent
+	 * pixels with a colour*/
+	fillColors(&image, 16, 1);
+	image.pixel[7].r |= 0x01;
+	CHECK(savesAs(&image, 0));
+	fillColors(&image, 16, 1);
+	image.pixel[9].a = 0x80;
+	CHECK(savesAs(&image, 0));
+	fillColors(&image, 16, 1);
+	image.pixel[14].g = 0x08;
+	CHECK(savesAs(&image, 0));
+	sh2ckImageDelete(&image, NULL);
+
+	/*animations are decoded through a palette*/
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_ANIMATION, 4, 1) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	for (int i = 0; i < images.image_count; i++) {
+		CHECK(savesAs(&images.images[i], 1));
+	}
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
+
+/*the bounds of the pixels with any alpha, counted pixel by pixel*/
+static struct Sh2ckRect refBoundingBox(const struct Sh2ckImage *image)
+{
+	struct Sh2ckRect bbox = {0, 0, 0, 0};
+	int minx = INT16_MAX;
+	int miny = INT16_MAX;
+	int maxx = -1;
+	int maxy = -1;
+	for (int y = 0; y < image->height; y++) {
+		for (int x = 0; x < image->width; x++) {
+			if (image->pixel[y * image->pitch + x].a == 0) {
+				continue;
+			}
+			minx = x < minx ? x : minx;
+			miny = y < miny ? y : miny;
+			maxx = x > maxx ? x : maxx;
+			maxy = y > maxy ? y : maxy;
+		}
+	}
+	if (maxx >= 0) {
+		struct Sh2ckRect found = {minx, miny, maxx - minx + 1, maxy - miny + 1};
+		bbox = found;
+	}
+	return bbox;
+}
+
+static int rectEqual(const struct Sh2ckRect *a, int x, int y, int width,
+                     int height)
+{
+	return a->x == x && a->y == y && a->width == width && a->height == height;
+}
+
+int testGlyphs(void)
+{
+	struct Sh2ckColor pixels[8 * 4];
+	struct Sh2ckImage image = {0, 0, 5, 4, 8, pixels};
+	struct Sh2ckRect bbox;
+	struct Gm1 gm1;
+	struct Sh2ckImageList images;
+	struct Sh2ckImageList source;
+	struct Sh2ckOffset offsets[40];
+	struct Sh2ckRect atlas_size;
+	struct Sh2ckImage atlas;
+	struct GlyphTable table;
+	struct GlyphTable loaded;
+
+	/*single pixels, corners, alpha of 1 and pixels past the width*/
+	memset(pixels, 0, sizeof(pixels));
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 0, 0, 0, 0));
+	pixels[7].a = 0xFF;
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 0, 0, 0, 0));
+	pixels[3 * 8 + 4].a = 1;
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 4, 3, 1, 1));
+	pixels[0].a = 0xFF;
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 0, 0, 5, 4));
+	pixels[0].a = 0;
+	pixels[8 + 2].a = 0x80;
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 2, 1, 3, 3));
+	image.width = 1;
+	image.height = 1;
+	pixels[0].a = 0xFF;
+	sh2ckImageBoundingBox(&bbox, &image);
+	CHECK(rectEqual(&bbox, 0, 0, 1, 1));
+
+	/*every glyph is trimmed to its bounding box*/
+	CHECK(synthWriteGm1("in.gm1", GM1_DATA_TGX_FONT, 40, 1) == 0);
+	CHECK(sh2ckGm1CreateFromFile(&gm1, "in.gm1") == 0);
+	CHECK(sh2ckGm1CreateImageList(&images, 0, &gm1, 0, 0) == 0);
+	CHECK(sh2ckGm1CreateImageList(&source, 0, &gm1, 0, 0) == 0);
+	CHECK(images.image_count == 40);
+	sh2ckFontTrimGlyphs(&images, offsets);
+	CHECK(sh2ckImageLayoutAtlas(&images, &atlas_size, 1024, 1, 0) == 0);
+	CHECK(sh2ckImageComposeAtlas(&atlas, &images, offsets, &atlas_size) == 0);
+	CHECK(sh2ckFontCreateGlyphTable(&table, &gm1, &images, offsets,
+	                                &atlas_size) == 0);
+	CHECK(table.glyph_count == 40);
+	CHECK(sh2ckFontSaveGlyphTable(&table, "in.glyphs") == 0);
+	CHECK(sh2ckFontLoadGlyphTable(&loaded, "in.glyphs") == 0);
+	CHECK(loaded.glyph_count == 40 && loaded.line_height == table.line_height &&
+	      memcmp(loaded.glyphs, table.glyphs, sizeof(*table.glyphs) * 40) == 0);
+	for (int i = 0; i < 40; i++) {
+		struct Sh2ckRect expected = refBoundingBox(&source.images[i]);
+		struct Glyph *glyph = &loaded.glyphs[i];
+		CHECK(glyph->width == expected.width &&
+		      glyph->height == expected.height);
+		if (expected.width == 0) {
+			continue;
+		}
+		CHECK(offsets[i].x == expected.x && offsets[i].y == expected.y);
+		struct Sh2ckImage view = atlas;
+		view.pixel += glyph->y * atlas.pitch + glyph->x;
+		view.width = glyph->width;
+		view.height = glyph->height;
+		struct Sh2ckImage trimmed = source.images[i];
+		trimmed.pixel += expected.y * trimmed.pitch + expected.x;
+		trimmed.width = expected.width;
+		trimmed.height = expected.height;
+		CHECK(testImagesEqual(&view, &trimmed));
+	}
+
+	sh2ckFontDeleteGlyphTable(&loaded);
+	sh2ckFontDeleteGlyphTable(&table);
+	sh2ckImageDelete(&atlas, NULL);
+	sh2ckImageDeleteList(&source);
+	sh2ckImageDeleteList(&images);
+	sh2ckGm1Delete(&gm1);
+	return 0;
+}
@@ -0,0 +1,447 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gm1.h"
+#include "synth.h"
+#include "tgx.h"
+
+#define GM1_FILE_HEADER_FIELDS 22
+#define TGX_MAX_TOKEN_LENGTH 32
+
+struct Rng {
+	uint32_t state;
+};
+
+struct Buffer {
+	uint8_t *data;
+	int size;
+	int capacity;
+};
+
+static uint32_t rngNext(struct Rng *rng)
+{
+	uint32_t x = rng->state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng->state = x;
+	return x;
+}
+
+/*uniform in [min, max]*/
+static int rngRange(struct Rng *rng, int min, int max)
+{
+	return min + (int)(rngNext(rng) % (uint32_t)(max - min + 1));
+}
+
+static int rngChance(struct Rng *rng, int percent)
+{
+	return (int)(rngNext(rng) % 100) < percent;
+}
+
+static int bufferReserve(struct Buffer *buffer, int size)
+{
+	if (buffer->size + size <= buffer->capacity) {
+		return 0;
+	}
+	int capacity = buffer->capacity ? buffer->capacity : 4096;
+	while (capacity < buffer->size + size) {
+		capacity *= 2;
+	}
+	uint8_t *data = realloc(buffer->data, capacity);
+	if (data == NULL) {
+		return -1;
+	}
+	buffer->data = data;
+	buffer->capacity = capacity;
+	return 0;
+}
+
+static int bufferPut8(struct Buffer *buffer, uint8_t value)
+{
+	if (bufferReserve(buffer, 1) == -1) {
+		return -1;
+	}
+	buffer->data[buffer->size++] = value;
+	return 0;
+}
+
+static int bufferPut16(struct Buffer *buffer, uint16_t value)
+{
+	if (bufferPut8(buffer, value & 0xFF) == -1 ||
+	    bufferPut8(buffer, value >> 8) == -1) {
+		return -1;
+	}
+	return 0;
+}
+
+static int bufferPut32(struct Buffer *buffer, uint32_t value)
+{
+	if (bufferPut16(buffer, value & 0xFFFF) == -1 ||
+	    bufferPut16(buffer, value >> 16) == -1) {
+		return -1;
+	}
+	return 0;
+}
+
+/*neighbouring pixels of sprites have similar colors*/
+static uint16_t nextColor(struct Rng *rng, uint16_t color)
+{
+	int r = (color >> 10) & 0x1F;
+	int g = (color >> 5) & 0x1F;
+	int b = color & 0x1F;
+	r = (r + rngRange(rng, -2, 2)) & 0x1F;
+	g = (g + rngRange(rng, -2, 2)) & 0x1F;
+	b = (b + rngRange(rng, -2, 2)) & 0x1F;
+	return (uint16_t)((r << 10) | (g << 5) | b);
+}
+
+static int putPixel(struct Buffer *buffer, struct Rng *rng, uint16_t *color,
+                    int indexed)
+{
+	*color = nextColor(rng, *color);
+	if (indexed) {
+		return bufferPut8(buffer, *color & 0xFF);
+	}
+	return bufferPut16(buffer, *color);
+}
+
+static int putTransparent(struct Buffer *buffer, int length)
+{
+	while (length > 0) {
+		int token_length = length;
+		if (token_length > TGX_MAX_TOKEN_LENGTH) {
+			token_length = TGX_MAX_TOKEN_LENGTH;
+		}
+		if (bufferPut8(buffer, TGX_TOKEN_TRANSPARENT_PIXEL_STRING |
+		                           (token_length - 1)) == -1) {
+			return -1;
+		}
+		length -= token_length;
+	}
+	return 0;
+}
+
+/*Sprites are a noisy ellipse. Inside, most tokens are short pixel streams,
+ * with some repeated pixels and small transparent holes in between, which is
+ * roughly what the token statistics of the game files look like.*/
+static int encodeSprite(struct Buffer *buffer, struct Rng *rng, int width,
+                        int height, int indexed)
+{
+	uint16_t color = rngNext(rng) & 0x7FFF;
+	for (int y = 0; y < height; y++) {
+		double dy = (y + 0.5) / height * 2.0 - 1.0;
+		double half = sqrt(1.0 - dy * dy) * width / 2.0;
+		int left = (int)(width / 2.0 - half) + rngRange(rng, -1, 1);
+		int right = (int)(width / 2.0 + half) + rngRange(rng, -1, 1);
+		if (left < 0) {
+			left = 0;
+		}
+		if (right > width) {
+			right = width;
+		}
+		if (putTransparent(buffer, left) == -1) {
+			return -1;
+		}
+		int x = left;
+		while (x < right) {
+			int length = 0;
+			int kind = rngRange(rng, 0, 99);
+			if (kind < 12) {
+				length = rngRange(rng, 2, 12);
+				if (length > right - x) {
+					length = right - x;
+				}
+				if (bufferPut8(buffer, TGX_TOKEN_REPEATING_PIXEL |
+				                           (length - 1)) == -1 ||
+				    putPixel(buffer, rng, &color, indexed) == -1) {
+					return -1;
+				}
+			} else if (kind < 17) {
+				length = rngRange(rng, 1, 6);
+				if (length > right - x) {
+					length = right - x;
+				}
+				if (putTransparent(buffer, length) == -1) {
+					return -1;
+				}
+			} else {
+				/*geometric length distribution with a mean around 6*/
+				length = 1;
+				while (length < TGX_MAX_TOKEN_LENGTH && rngChance(rng, 83)) {
+					length++;
+				}
+				if (length > right - x) {
+					length = right - x;
+				}
+				if (bufferPut8(buffer,
+				               TGX_TOKEN_PIXEL_STREAM | (length - 1)) == -1) {
+					return -1;
+				}
+				for (int i = 0; i < length; i++) {
+					if (putPixel(buffer, rng, &color, indexed) == -1) {
+						return -1;
+					}
+				}
+			}
+			x += length;
+		}
+		if (bufferPut8(buffer, TGX_TOKEN_NEW_LINE) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int encodeBitmap(struct Buffer *buffer, struct Rng *rng, int width,
+                        int height)
+{
+	uint16_t color = rngNext(rng) & 0x7FFF;
+	for (int i = 0; i < width * height; i++) {
+		if (putPixel(buffer, rng, &color, 0) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int encodeTile(struct Buffer *buffer, struct Rng *rng)
+{
+	uint16_t color = rngNext(rng) & 0x7FFF;
+	/*a tile diamond always has 256 pixels*/
+	for (int i = 0; i < 256; i++) {
+		if (putPixel(buffer, rng, &color, 0) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+struct SynthImage {
+	struct Gm1ImageHeader header;
+	int offset;
+	int size;
+};
+
+static void imageHeader(struct Gm1ImageHeader *header, int width, int height)
+{
+	memset(header, 0, sizeof(*header));
+	header->image_width = width;
+	header->image_height = height;
+	header->parts = 1;
+	header->drawing_box_width = width;
+}
+
+static int createImages(struct Buffer *data, struct SynthImage *images,
+                        int *image_count, int data_type, struct Rng *rng)
+{
+	int count = *image_count;
+	int i = 0;
+	while (i < count) {
+		struct SynthImage *image = &images[i];
+		int width = 0;
+		int height = 0;
+		int ret = 0;
+		image->offset = data->size;
+
+		switch (data_type) {
+			case GM1_DATA_TGX_AND_TILE: {
+				/*a building of n*n tile parts, the upper ones with a tgx
+				 * part on top*/
+				int length = rngRange(rng, 1, 4);
+				int parts = length * length;
+				if (i + parts > count) {
+					parts = 1;
+				}
+				for (int part = 0; part < parts; part++) {
+					int tgx_height = 0;
+					image = &images[i + part];
+					image->offset = data->size;
+					if (part < parts / 2 + 1 && rngChance(rng, 70)) {
+						tgx_height = rngRange(rng, 8, 90);
+					}
+					imageHeader(&image->header, GM1_TILE_WIDTH,
+					            GM1_TILE_HEIGHT + tgx_height);
+					image->header.part = part;
+					image->header.parts = parts;
+					image->header.tile_position_y = tgx_height;
+					if (encodeTile(data, rng) == -1) {
+						return -1;
+					}
+					if (tgx_height > 0 &&
+					    encodeSprite(data, rng, GM1_TILE_WIDTH,
+					                 tgx_height + GM1_TILE_HEIGHT / 2,
+					                 0) == -1) {
+						return -1;
+					}
+					image->size = data->size - image->offset;
+				}
+				i += parts;
+				continue;
+			}
+			case GM1_DATA_ANIMATION:
+				width = rngRange(rng, 40, 70);
+				height = rngRange(rng, 50, 90);
+				ret = encodeSprite(data, rng, width, height, 1);
+				break;
+			case GM1_DATA_TGX_FONT:
+				width = rngRange(rng, 4, 20);
+				height = rngRange(rng, 10, 24);
+				ret = encodeSprite(data, rng, width, height, 0);
+				break;
+			case GM1_DATA_TGX_CONST_SIZE:
+				width = 64;
+				height = 64;
+				ret = encodeSprite(data, rng, width, height, 0);
+				break;
+			case GM1_DATA_BITMAP:
+			case GM1_DATA_BITMAP_OTHER:
+				width = rngRange(rng, 64, 256);
+				height = rngRange(rng, 64, 256);
+				ret = encodeBitmap(data, rng, width, height);
+				break;
+			case GM1_DATA_TGX:
+			default:
+				width = rngRange(rng, 16, 200);
+				height = rngRange(rng, 16, 200);
+				ret = encodeSprite(data, rng, width, height, 0);
+				break;
+		}
+		if (ret == -1) {
+			return -1;
+		}
+		imageHeader(&image->header, width, height);
+		if (data_type == GM1_DATA_TGX_FONT) {
+			image->header.tile_position_y = rngRange(rng, 0, 4);
+		}
+		image->size = data->size - image->offset;
+		i++;
+	}
+	*image_count = i;
+	return 0;
+}
+
+static int writeImageHeader(struct Buffer *buffer,
+                            struct Gm1ImageHeader *header)
+{
+	if (bufferPut16(buffer, header->image_width) == -1 ||
+	    bufferPut16(buffer, header->image_height) == -1 ||
+	    bufferPut16(buffer, header->position_x) == -1 ||
+	    bufferPut16(buffer, header->position_y) == -1 ||
+	    bufferPut8(buffer, header->part) == -1 ||
+	    bufferPut8(buffer, header->parts) == -1 ||
+	    bufferPut16(buffer, header->tile_position_y) == -1 ||
+	    bufferPut8(buffer, header->tile_placement_alignment) == -1 ||
+	    bufferPut8(buffer, header->horizontal_offset) == -1 ||
+	    bufferPut8(buffer, header->drawing_box_width) == -1 ||
+	    bufferPut8(buffer, header->performance_id) == -1) {
+		return -1;
+	}
+	return 0;
+}
+
+static int writeFile(const char *file, struct Buffer *head,
+                     struct Buffer *data)
+{
+	FILE *fp = fopen(file, "wb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fwrite(head->data, 1, head->size, fp) < head->size ||
+	    fwrite(data->data, 1, data->size, fp) < data->size) {
+		fclose(fp);
+		return -1;
+	}
+	return fclose(fp);
+}
+
+int synthWriteGm1(const char *file, int data_type, int image_count,
+                  uint32_t seed)
+{
+	struct Rng rng = {seed ? seed : 1};
+	struct Buffer head = {NULL, 0, 0};
+	struct Buffer data = {NULL, 0, 0};
+	struct SynthImage *images = malloc(sizeof(*images) * image_count);
+	int ret = -1;
+	if (images == NULL) {
+		return -1;
+	}
+
+	if (createImages(&data, images, &image_count, data_type, &rng) == -1) {
+		goto out;
+	}
+
+	uint32_t header[GM1_FILE_HEADER_FIELDS];
+	memset(header, 0, sizeof(header));
+	header[3] = image_count;
+	header[5] = data_type;
+	header[18] = 32;
+	header[19] = 48;
+	header[20] = data.size;
+	for (int i = 0; i < GM1_FILE_HEADER_FIELDS; i++) {
+		if (bufferPut32(&head, header[i]) == -1) {
+			goto out;
+		}
+	}
+	for (int i = 0; i < GM1_PALETTE_SIZE * GM1_PALETTE_COUNT; i++) {
+		if (bufferPut16(&head, rngNext(&rng) & 0x7FFF) == -1) {
+			goto out;
+		}
+	}
+	for (int i = 0; i < image_count; i++) {
+		if (bufferPut32(&head, images[i].offset) == -1) {
+			goto out;
+		}
+	}
+	for (int i = 0; i < image_count; i++) {
+		if (bufferPut32(&head, images[i].size) == -1) {
+			goto out;
+		}
+	}
+	for (int i = 0; i < image_count; i++) {
+		if (writeImageHeader(&head, &images[i].header) == -1) {
+			goto out;
+		}
+	}
+	ret = writeFile(file, &head, &data);
+
+out:
+	free(images);
+	free(head.data);
+	free(data.data);
+	return ret;
+}
+
+int synthWriteTgx(const char *file, int width, int height, uint32_t seed)
+{
+	struct Rng rng = {seed ? seed : 1};
+	struct Buffer head = {NULL, 0, 0};
+	struct Buffer data = {NULL, 0, 0};
+	int ret = -1;
+	if (bufferPut32(&head, width) == 0 && bufferPut32(&head, height) == 0 &&
+	    encodeSprite(&data, &rng, width, height, 0) == 0) {
+		ret = writeFile(file, &head, &data);
+	}
+	free(head.data);
+	free(data.data);
+	return ret;
+}
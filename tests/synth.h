@@ -0,0 +1,32 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+
+/*Synthetic gm1 and tgx files, so the pipeline can be measured without the
+ * original game files. The output is deterministic for a given seed.*/
+
+/*writes a gm1 file of the given GM1_DATA_* type*/
+int synthWriteGm1(const char *file, int data_type, int image_count,
+                  uint32_t seed);
+
+int synthWriteTgx(const char *file, int width, int height, uint32_t seed);
+
+#endif  // SYNTH_H
@@ -0,0 +1,297 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*nftw*/
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <png.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define TEST_MAX_ARGS 32
+
+struct Test {
+	const char *name;
+	int (*run)(void);
+};
+
+static const struct Test tests[] = {
+    {"cache", testCache},
+    {"library", testLibrary},
+    {"reader", testReader},
+    {"info", testInfo},
+    {"bench", testBench},
+    {"stats", testStats},
+    {"stream", testStream},
+    {"batch", testBatch},
+    {"tgx", testTgx},
+    {"sprite", testSprite},
+    {"delta", testDelta},
+    {"shared", testShared},
+    {"shared_update", testSharedUpdate},
+    {"mask", testMask},
+    {"footprints", testFootprints},
+    {"parallel", testParallel},
+    {"tgx_rows", testTgxRows},
+    {"tiles", testTiles},
+    {"atlas_bands", testAtlasBands},
+    {"save_parallel", testSaveParallel},
+    {"palette", testPalette},
+    {"layers", testLayers},
+    {"glyphs", testGlyphs},
+    {"lod", testLod},
+    {"batch_io", testBatchIo},
+};
+
+const char *test_sh2ck;
+
+int testRun(const char *program, const char *out_file, ...)
+{
+	char *args[TEST_MAX_ARGS];
+	int count = 0;
+	va_list list;
+
+	args[count++] = (char *)program;
+	va_start(list, out_file);
+	for (char *arg = va_arg(list, char *); arg != NULL;
+	     arg = va_arg(list, char *)) {
+		if (count == TEST_MAX_ARGS - 1) {
+			va_end(list);
+			return -1;
+		}
+		args[count++] = arg;
+	}
+	va_end(list);
+	args[count] = NULL;
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		return -1;
+	}
+	if (pid == 0) {
+		if (out_file != NULL) {
+			int fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd == -1 || dup2(fd, STDOUT_FILENO) == -1) {
+				_exit(127);
+			}
+			close(fd);
+		}
+		execv(program, args);
+		_exit(127);
+	}
+	int status;
+	if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status)) {
+		return -1;
+	}
+	return WEXITSTATUS(status);
+}
+
+char *testReadFile(const char *file, long *size)
+{
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL) {
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *data = malloc(length + 1);
+	if (data == NULL || fread(data, 1, length, fp) != (size_t)length) {
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	data[length] = '\0';
+	if (size != NULL) {
+		*size = length;
+	}
+	return data;
+}
+
+int testFileExists(const char *file)
+{
+	struct stat file_stat;
+	return stat(file, &file_stat) == 0;
+}
+
+int testLoadPng(const char *file, struct Sh2ckImage *image)
+{
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, file)) {
+		return -1;
+	}
+	png.format = PNG_FORMAT_BGRA;
+	image->x = 0;
+	image->y = 0;
+	image->width = png.width;
+	image->height = png.height;
+	image->pitch = png.width;
+	image->pixel = malloc(PNG_IMAGE_SIZE(png));
+	if (image->pixel == NULL ||
+	    !png_image_finish_read(&png, NULL, image->pixel, 0, NULL)) {
+		free(image->pixel);
+		image->pixel = NULL;
+		png_image_free(&png);
+		return -1;
+	}
+	return 0;
+}
+
+int testImagesEqual(const struct Sh2ckImage *a, const struct Sh2ckImage *b)
+{
+	if (a->width != b->width || a->height != b->height) {
+		return 0;
+	}
+	for (int y = 0; y < a->height; y++) {
+		for (int x = 0; x < a->width; x++) {
+			const struct Sh2ckColor *pa = &a->pixel[y * a->pitch + x];
+			const struct Sh2ckColor *pb = &b->pixel[y * b->pitch + x];
+			if (pa->a == 0 && pb->a == 0) {
+				continue;
+			}
+			if (memcmp(pa, pb, sizeof(*pa)) != 0) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*1 if file_a and file_b are equal, as described at testDirsEqual*/
+static int filesEqual(const char *file_a, const char *file_b)
+{
+	size_t length = strlen(file_a);
+	if (length > 4 && strcmp(file_a + length - 4, ".png") == 0) {
+		struct Sh2ckImage a;
+		struct Sh2ckImage b;
+		if (testLoadPng(file_a, &a) == -1) {
+			return 0;
+		}
+		if (testLoadPng(file_b, &b) == -1) {
+			free(a.pixel);
+			return 0;
+		}
+		int equal = testImagesEqual(&a, &b);
+		free(a.pixel);
+		free(b.pixel);
+		return equal;
+	}
+	long size_a;
+	long size_b;
+	char *data_a = testReadFile(file_a, &size_a);
+	char *data_b = testReadFile(file_b, &size_b);
+	int equal = data_a != NULL && data_b != NULL && size_a == size_b &&
+	            memcmp(data_a, data_b, size_a) == 0;
+	free(data_a);
+	free(data_b);
+	return equal;
+}
+
+/*number of files in dir, -1 if it can not be read*/
+static int countFiles(const char *dir)
+{
+	DIR *dp = opendir(dir);
+	if (dp == NULL) {
+		return -1;
+	}
+	int count = 0;
+	for (struct dirent *entry = readdir(dp); entry != NULL;
+	     entry = readdir(dp)) {
+		if (entry->d_name[0] != '.') {
+			count++;
+		}
+	}
+	closedir(dp);
+	return count;
+}
+
+int testDirsEqual(const char *dir_a, const char *dir_b)
+{
+	char file_a[512];
+	char file_b[512];
+	int count = countFiles(dir_a);
+	if (count == -1 || countFiles(dir_b) != count) {
+		return 0;
+	}
+	DIR *dp = opendir(dir_a);
+	if (dp == NULL) {
+		return 0;
+	}
+	int equal = 1;
+	for (struct dirent *entry = readdir(dp); equal && entry != NULL;
+	     entry = readdir(dp)) {
+		if (entry->d_name[0] == '.' ||
+		    strcmp(entry->d_name, "sh2ck.manifest") == 0) {
+			continue;
+		}
+		snprintf(file_a, sizeof(file_a), "%s/%s", dir_a, entry->d_name);
+		snprintf(file_b, sizeof(file_b), "%s/%s", dir_b, entry->d_name);
+		equal = filesEqual(file_a, file_b);
+	}
+	closedir(dp);
+	return equal;
+}
+
+static int removeEntry(const char *path, const struct stat *file_stat,
+                       int type, struct FTW *ftw)
+{
+	(void)file_stat;
+	(void)type;
+	(void)ftw;
+	return remove(path);
+}
+
+/*usage: sh2ck_test test sh2ck_path work_dir*/
+int main(int argc, char *argv[])
+{
+	if (argc != 4) {
+		fprintf(stderr, "Usage: sh2ck_test test sh2ck_path work_dir\n");
+		return 1;
+	}
+	test_sh2ck = argv[2];
+	for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); i++) {
+		if (strcmp(tests[i].name, argv[1]) != 0) {
+			continue;
+		}
+		if (testFileExists(argv[3]) &&
+		    nftw(argv[3], removeEntry, 16, FTW_DEPTH | FTW_PHYS) == -1) {
+			fprintf(stderr, "Error on clearing %s\n", argv[3]);
+			return 1;
+		}
+		if (mkdir(argv[3], 0775) == -1 || chdir(argv[3]) == -1) {
+			fprintf(stderr, "Error on creating %s\n", argv[3]);
+			return 1;
+		}
+		return tests[i].run() == 0 ? 0 : 1;
+	}
+	fprintf(stderr, "Unknown test %s\n", argv[1]);
+	return 1;
+}
@@ -0,0 +1,111 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+
+#include "image.h"
+
+/*Every test runs in its own empty directory, the current directory while it
+ * runs, and returns 0 if it passed and -1 otherwise.*/
+
+#define CHECK(cond)                                                            \
+	do {                                                                       \
+		if (!(cond)) {                                                         \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,             \
+			        __LINE__, #cond);                                          \
+			return -1;                                                         \
+		}                                                                      \
+	} while (0)
+
+/*path of the executable under test, sh2ck for all but the bench test*/
+extern const char *test_sh2ck;
+
+/*Runs program with the NULL terminated arguments and returns its exit
+ * status, -1 if it could not be run. stdout goes to out_file unless it is
+ * NULL.*/
+int testRun(const char *program, const char *out_file, ...);
+
+/*the whole file with a terminating 0, NULL if it can not be read*/
+char *testReadFile(const char *file, long *size);
+
+int testFileExists(const char *file);
+
+/*loads a png as bgra into image, whose pixels have to be freed with free*/
+int testLoadPng(const char *file, struct Sh2ckImage *image);
+
+/*1 if both images have the same size and pixels, fully transparent pixels
+ * are equal whatever their colour*/
+int testImagesEqual(const struct Sh2ckImage *a, const struct Sh2ckImage *b);
+
+/*1 if both directories hold the same files, pngs with the same pixels and
+ * all others with the same bytes. Manifests are not compared.*/
+int testDirsEqual(const char *dir_a, const char *dir_b);
+
+int testCache(void);
+
+int testLibrary(void);
+
+int testReader(void);
+
+int testInfo(void);
+
+int testBench(void);
+
+int testStats(void);
+
+int testStream(void);
+
+int testBatch(void);
+
+int testTgx(void);
+
+int testSprite(void);
+
+int testDelta(void);
+
+int testShared(void);
+
+int testSharedUpdate(void);
+
+int testMask(void);
+
+int testFootprints(void);
+
+int testParallel(void);
+
+int testTgxRows(void);
+
+int testTiles(void);
+
+int testAtlasBands(void);
+
+int testSaveParallel(void);
+
+int testPalette(void);
+
+int testLayers(void);
+
+int testGlyphs(void);
+
+int testLod(void);
+
+int testBatchIo(void);
+
+#endif  // TEST_H
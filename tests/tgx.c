@@ -0,0 +1,228 @@
+/**
+ *	Copyright (C) 2014 David Leiter
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "synth.h"
+#include "test.h"
+#include "tgx.h"
+#include "thread.h"
+
+static struct Sh2ckColor refColor(uint16_t color)
+{
+	struct Sh2ckColor c = {SH2CK_COLOR_CONVERT_BLUE(color),
+	                       SH2CK_COLOR_CONVERT_GREEN(color),
+	                       SH2CK_COLOR_CONVERT_RED(color), 0xFF};
+	return c;
+}
+
+/*a plain decoder of the token stream to check sh2ckTgxDecode against*/
+static int refDecode(struct Sh2ckImage *image, const uint8_t *data, int size,
+                     const uint16_t *palette)
+{
+	const struct Sh2ckColor transparent = {0, 0, 0, 0};
+	int pixel_size = palette == NULL ? 2 : 1;
+	int x = 0;
+	int y = 0;
+	int i = 0;
+	while (i < size) {
+		int type = TGX_GET_TOKEN_TYPE(data[i]);
+		int length = TGX_GET_TOKEN_VALUE(data[i]) + 1;
+		i++;
+		if (type == TGX_TOKEN_NEW_LINE) {
+			for (; x < image->width; x++) {
+				image->pixel[y * image->width + x] = transparent;
+			}
+			if (++y == image->height) {
+				return 0;
+			}
+			x = 0;
+			continue;
+		}
+		if (x + length > image->width) {
+			return -1;
+		}
+		for (int j = 0; j < length; j++) {
+			struct Sh2ckColor *pixel = &image->pixel[y * image->width + x + j];
+			int offset = i;
+			if (type == TGX_TOKEN_PIXEL_STREAM) {
+				offset = i + j * pixel_size;
+			} else if (type == TGX_TOKEN_TRANSPARENT_PIXEL_STRING) {
+				*pixel = transparent;
+				continue;
+			} else if (type != TGX_TOKEN_REPEATING_PIXEL) {
+				return -1;
+			}
+			if (offset + pixel_size > size) {
+				return -1;
+			}
+			*pixel = refColor(palette == NULL
+			                      ? data[offset] | (data[offset + 1] << 8)
+			                      : palette[data[offset]]);
+		}
+		x += length;
+		if (type == TGX_TOKEN_PIXEL_STREAM) {
+			i += length * pixel_size;
+		} else if (type == TGX_TOKEN_REPEATING_PIXEL) {
+			i += pixel_size;
+		}
+	}
+	return 0;
+}
+
+/*decodes data with sh2ckTgxDecode and refDecode into images filled with the
+ * same garbage and checks that they agree, also on errors*/
+static int decodesAsReference(int width, int height, uint8_t *data, int size,
+                              const uint16_t *palette)
+{
+	struct Sh2ckImage image;
+	struct Sh2ckImage reference;
+	struct Sh2ckRect rect = {0, 0, width, height};
+	int equal = 0;
+	if (sh2ckImageCreate(&image, NULL, width, height) == -1) {
+		return 0;
+	}
+	if (sh2ckImageCreate(&reference, NULL, width, height) == 0) {
+		size_t bytes = sizeof(*image.pixel) * width * height;
+		memset(image.pixel, 0x5A, bytes);
+		memset(reference.pixel, 0x5A, bytes);
+		int ret = sh2ckTgxDecode(&image, &rect, data, size, palette);
+		int ref_ret = refDecode(&reference, data, size, palette);
+		equal = ret == ref_ret &&
+		        (ret == -1 || memcmp(image.pixel, reference.pixel, bytes) == 0);
+		sh2ckImageDelete(&reference, NULL);
+	}
+	sh2ckImageDelete(&image, NULL);
+	return equal;
+}
+
+int testTgx(void)
+{
+	uint16_t palette[256];
+	struct Tgx tgx;
+
+	for (int i = 0; i < 256; i++) {
+		palette[i] = (uint16_t)(i * 0x0123);
+	}
+
+	/*every token type, with a pixel stream right after a transparent run*/
+	uint8_t direct[] = {0x22, 0x01, 0x34, 0x12, 0xFF, 0x7F, 0x41, 0x00,
+	                    0x7C, 0x80, 0x05, 0x01, 0x00, 0x02, 0x00, 0x03,
+	                    0x00, 0x04, 0x00, 0x05, 0x00, 0x06, 0x00, 0x80,
+	                    0x80};
+	CHECK(decodesAsReference(8, 3, direct, sizeof(direct), NULL));
+	CHECK(decodesAsReference(8, 2, direct, sizeof(direct), NULL));
+	uint8_t indexed[] = {0x41, 0x07, 0x21, 0x02, 0x10, 0x20, 0x30,
+	                     0x80, 0x47, 0xFF, 0x80};
+	CHECK(decodesAsReference(8, 2, indexed, sizeof(indexed), palette));
+
+	/*broken streams fail instead of writing past the image or the data*/
+	uint8_t invalid[] = {0x00, 0x01, 0x00, 0x60, 0x80};
+	CHECK(decodesAsReference(4, 1, invalid, sizeof(invalid), NULL));
+	uint8_t too_long[] = {0x23, 0x80};
+	CHECK(decodesAsReference(2, 1, too_long, sizeof(too_long), NULL));
+	uint8_t truncated[] = {0x02, 0x01, 0x00, 0x02};
+	CHECK(decodesAsReference(4, 1, truncated, sizeof(truncated), NULL));
+	CHECK(decodesAsReference(4, 1, truncated, 1, palette));
+
+	CHECK(synthWriteTgx("in.tgx", 301, 157, 1) == 0);
+	CHECK(sh2ckTgxCreateFromFile(&tgx, "in.tgx") == 0);
+	int ok =
+	    decodesAsReference(tgx.width, tgx.height, tgx.data, tgx.size, NULL);
+	sh2ckTgxDelete(&tgx);
+	CHECK(ok);
+	return 0;
+}
+
+/*1 if rows first_row to first_row + row_count - 1 of image are those of
+ * full and all others are still filled with fill*/
+static int rowsMatch(const struct Sh2ckImage *image,
+                     const struct Sh2ckImage *full, int first_row,
+                     int row_count, uint8_t fill)
+{
+	size_t row_size = sizeof(*image->pixel) * image->width;
+	for (int y = 0; y < image->height; y++) {
+		const uint8_t *row = (const uint8_t *)&image->pixel[y * image->pitch];
+		if (y >= first_row && y < first_row + row_count) {
+			if (memcmp(row, &full->pixel[y * full->pitch], row_size) != 0) {
+				return 0;
+			}
+			continue;
+		}
+		for (size_t i = 0; i < row_size; i++) {
+			if (row[i] != fill) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+int testTgxRows(void)
+{
+	static const int windows[][2] = {
+	    {0, 1}, {0, 17}, {100, 137}, {612, 1}, {590, 23}, {0, 613}};
+	struct Tgx tgx;
+	struct Sh2ckImage full;
+	struct Sh2ckImage image;
+	struct TgxRowIndex index;
+
+	CHECK(synthWriteTgx("in.tgx", 777, 613, 1) == 0);
+	CHECK(sh2ckTgxCreateFromFile(&tgx, "in.tgx") == 0);
+	CHECK(sh2ckTgxCreateImage(&full, tgx.width, tgx.height, tgx.data,
+	                          tgx.size, NULL) == 0);
+	CHECK(sh2ckImageCreate(&image, NULL, tgx.width, tgx.height) == 0);
+	size_t bytes = sizeof(*image.pixel) * image.width * image.height;
+	struct Sh2ckRect rect = {0, 0, tgx.width, tgx.height};
+
+	/*every row starts right after the newline of the one before*/
+	CHECK(sh2ckTgxCreateRowIndex(&index, tgx.data, tgx.size, tgx.height, 0) ==
+	      0);
+	CHECK(index.row_count == (int)tgx.height && index.offsets[0] == 0);
+	for (int y = 1; y < index.row_count; y++) {
+		CHECK(index.offsets[y] > index.offsets[y - 1]);
+		CHECK(TGX_GET_TOKEN_TYPE(tgx.data[index.offsets[y] - 1]) ==
+		      TGX_TOKEN_NEW_LINE);
+	}
+
+	/*a band of rows is decoded as in the whole image, the rest untouched*/
+	for (size_t i = 0; i < sizeof(windows) / sizeof(*windows); i++) {
+		memset(image.pixel, 0x5A, bytes);
+		CHECK(sh2ckTgxDecodeRows(&image, &rect, tgx.data, tgx.size, NULL,
+		                         &index, windows[i][0], windows[i][1]) == 0);
+		CHECK(rowsMatch(&image, &full, windows[i][0], windows[i][1], 0x5A));
+	}
+
+	for (int threads = 1; threads <= 4; threads += 3) {
+		struct Sh2ckThreadPool *pool = sh2ckThreadPoolCreate(threads);
+		CHECK(pool != NULL);
+		memset(image.pixel, 0x5A, bytes);
+		int ret = sh2ckTgxDecodeParallel(&image, &rect, tgx.data, tgx.size,
+		                                 NULL, pool);
+		sh2ckThreadPoolDelete(pool);
+		CHECK(ret == 0);
+		CHECK(memcmp(image.pixel, full.pixel, bytes) == 0);
+	}
+
+	sh2ckTgxDeleteRowIndex(&index);
+	sh2ckImageDelete(&image, NULL);
+	sh2ckImageDelete(&full, NULL);
+	sh2ckTgxDelete(&tgx);
+	return 0;
+}